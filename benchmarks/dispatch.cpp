@@ -0,0 +1,116 @@
+//
+// measures the cost of a single opcode dispatch in Vm::exec.
+//
+// build once with -DBOND_COMPUTED_GOTO=ON and once with -DBOND_COMPUTED_GOTO=OFF
+// and compare the ns/op column to see the difference between the two dispatch loops.
+//
+
+#include "../src/engine.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+    const char *source = R"(
+fn locals_loop(n) {
+    var i = 0;
+    while i < n {
+        i = i + 1;
+    }
+    return i;
+}
+
+var g = 0;
+
+fn globals_loop(n) {
+    g = 0;
+    while g < n {
+        g = g + 1;
+    }
+    return g;
+}
+
+fn stack_loop(n) {
+    var i = 0;
+    var a = 1;
+    while i < n {
+        a = a;
+        a = a;
+        a = a;
+        a = a;
+        i = i + 1;
+    }
+    return i;
+}
+)";
+
+    // number of instructions executed by one pass through the innermost loop,
+    // that is everything between the target of the backward jump and the jump
+    uint32_t loop_length(const bond::GcPtr<bond::Code> &code) {
+        auto &instructions = code->get_opcodes();
+        std::vector<uint32_t> starts;
+        uint32_t start = 0;
+        uint32_t end = 0;
+
+        for (size_t ip = 0; ip < instructions.size();) {
+            auto at = (uint32_t) ip;
+            auto opcode = static_cast<bond::Opcode>(instructions[ip++]);
+            starts.push_back(at);
+
+            uint32_t oprand = 0;
+            for (uint32_t i = 0; i < bond::oprand_count(opcode); i++) {
+                oprand = bond::read_oprand(opcode, i, instructions.data(), ip);
+            }
+
+            if (opcode == bond::Opcode::JUMP and oprand < at) {
+                start = oprand;
+                end = at;
+            }
+        }
+
+        return (uint32_t) std::count_if(starts.begin(), starts.end(),
+                                        [&](auto ip) { return ip >= start and ip <= end; });
+    }
+}
+
+int main(int argc, char **argv) {
+    int64_t iterations = argc > 1 ? std::stoll(argv[1]) : 5'000'000;
+
+    auto engine = bond::create_engine("");
+    auto ctx = engine->get_context();
+    auto vm = bond::Vm(ctx);
+    bond::set_current_vm(&vm);
+
+    auto id = ctx->new_module("<bench>");
+    auto lexer = bond::Lexer(source, ctx, id);
+    auto parser = bond::Parser(lexer.tokenize(), ctx);
+    auto nodes = parser.parse();
+    auto codegen = bond::CodeGenerator(ctx, parser.get_scopes());
+    auto code = codegen.generate_code(nodes);
+
+    if (ctx->has_error()) return 1;
+
+    vm.run(code);
+
+#ifdef BOND_COMPUTED_GOTO
+    fmt::print("dispatch: computed goto\n");
+#else
+    fmt::print("dispatch: switch\n");
+#endif
+    fmt::print("{:<14} {:>12} {:>10} {:>10}\n", "benchmark", "ns/iter", "ops/iter", "ns/op");
+
+    for (auto name: {"locals_loop", "globals_loop", "stack_loop"}) {
+        auto function = vm.get_globals()->get(name).value()->as<bond::Function>();
+        auto ops = loop_length(function->get_code());
+
+        auto start = std::chrono::steady_clock::now();
+        vm.call_function_ex(function, {bond::make_int(iterations)});
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        if (vm.had_error()) return 1;
+
+        auto per_iteration = elapsed / (double) iterations;
+        fmt::print("{:<14} {:>12.2f} {:>10} {:>10.2f}\n", name, per_iteration, ops, per_iteration / ops);
+    }
+
+    return 0;
+}
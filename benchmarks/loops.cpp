@@ -0,0 +1,126 @@
+//
+// compares hot loops run by the plain interpreter with the same loops run as traces.
+//
+// every loop is run once by a vm without the jit and once by a vm with loop tracing on,
+// the speedup column is the interpreter's time over the trace's.
+//
+
+#include "../src/engine.h"
+#include <chrono>
+
+namespace {
+    const char *source = R"(
+import "core";
+
+fn count_loop(n) {
+    var i = 0;
+    while i < n {
+        i = i + 1;
+    }
+    return i;
+}
+
+fn branch_loop(n) {
+    var i = 0;
+    var total = 0;
+    while i < n {
+        if i % 3 == 0 {
+            total = total + i * 2;
+        } else {
+            total = total - 1;
+        }
+        i = i + 1;
+    }
+    return total;
+}
+
+fn float_loop(n) {
+    var i = 0;
+    var x = 0.0;
+    while i < n {
+        x = x * 0.5 + 1.5;
+        i = i + 1;
+    }
+    return x;
+}
+
+fn nested_loop(n) {
+    var i = 0;
+    var total = 0;
+    while i < n / 100 {
+        var j = 0;
+        while j < 100 {
+            total = total + j;
+            j = j + 1;
+        }
+        i = i + 1;
+    }
+    return total;
+}
+
+fn range_loop(n) {
+    var total = 0;
+    for i in core.Range(0, n, 1) {
+        total = total + i;
+    }
+    return total;
+}
+)";
+
+    // runs the source in a vm and times each loop, in ns per iteration
+    std::vector<double> run_loops(bond::Context *ctx, const bond::GcPtr<bond::Code> &code,
+                                  const std::vector<const char *> &names, int64_t iterations) {
+        auto vm = bond::Vm(ctx);
+        bond::set_current_vm(&vm);
+        vm.run(code);
+
+        std::vector<double> times;
+        for (auto name: names) {
+            auto function = vm.get_globals()->get(name).value()->as<bond::Function>();
+
+            auto start = std::chrono::steady_clock::now();
+            vm.call_function_ex(function, {bond::make_int(iterations)});
+            auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+            if (vm.had_error()) return {};
+            times.push_back(elapsed / (double) iterations);
+        }
+        return times;
+    }
+}
+
+int main(int argc, char **argv) {
+    int64_t iterations = argc > 1 ? std::stoll(argv[1]) : 10'000'000;
+
+    auto engine = bond::create_engine("");
+    auto ctx = engine->get_context();
+
+    if (!bond::Jit::is_supported()) {
+        fmt::print("the jit is not supported on this platform\n");
+        return 0;
+    }
+
+    auto id = ctx->new_module("<bench>");
+    auto lexer = bond::Lexer(source, ctx, id);
+    auto parser = bond::Parser(lexer.tokenize(), ctx);
+    auto nodes = parser.parse();
+    auto codegen = bond::CodeGenerator(ctx, parser.get_scopes());
+    auto code = codegen.generate_code(nodes);
+
+    if (ctx->has_error()) return 1;
+
+    std::vector<const char *> names{"count_loop", "branch_loop", "float_loop", "nested_loop", "range_loop"};
+
+    auto interpreted = run_loops(ctx, code, names, iterations);
+    ctx->set_trace(true);
+    auto traced = run_loops(ctx, code, names, iterations);
+    if (interpreted.empty() or traced.empty()) return 1;
+
+    fmt::print("{:<14} {:>16} {:>16} {:>10}\n", "benchmark", "interp ns/iter", "trace ns/iter", "speedup");
+    for (size_t i = 0; i < names.size(); i++) {
+        fmt::print("{:<14} {:>16.2f} {:>16.2f} {:>9.2f}x\n", names[i], interpreted[i], traced[i],
+                   interpreted[i] / traced[i]);
+    }
+
+    return 0;
+}
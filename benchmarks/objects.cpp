@@ -0,0 +1,143 @@
+//
+// measures the cost of builtin type checks: GcObject::is/as, parse_args and
+// the same checks done through dynamic_cast for comparison, followed by the
+// time and heap bytes spent creating struct instances, reading their fields and
+// calling their methods.
+//
+
+#include "../src/engine.h"
+#include <chrono>
+
+namespace {
+    template<typename F>
+    double time_ns(int64_t iterations, F &&body) {
+        auto start = std::chrono::steady_clock::now();
+        for (int64_t i = 0; i < iterations; i++) {
+            body(i);
+        }
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        return elapsed / (double) iterations;
+    }
+
+    // keeps the optimiser from dropping the measured work
+    volatile int64_t sink = 0;
+
+    const char *source = R"(
+struct Point {
+    var x;
+    var y;
+    var z;
+
+    fn one(self) {
+        return 1;
+    }
+}
+
+fn create_loop(n) {
+    var i = 0;
+    while i < n {
+        Point(i, i, i);
+        i = i + 1;
+    }
+    return i;
+}
+
+fn field_loop(n) {
+    var p = Point(1, 2, 3);
+    var i = 0;
+    while i < n {
+        i = i + p.x;
+    }
+    return i;
+}
+
+fn method_loop(n) {
+    var p = Point(1, 2, 3);
+    var i = 0;
+    while i < n {
+        i = i + p.one();
+    }
+    return i;
+}
+
+fn native_method_loop(n) {
+    var items = [1];
+    var i = 0;
+    while i < n {
+        i = i + items.size();
+    }
+    return i;
+}
+)";
+}
+
+int main(int argc, char **argv) {
+    int64_t iterations = argc > 1 ? std::stoll(argv[1]) : 10'000'000;
+
+    auto engine = bond::create_engine("");
+
+    bond::t_vector args = {bond::make_string("key"), bond::make_list({}), bond::Runtime::ins()->C_NONE};
+    bond::GcPtr<bond::Object> objects[] = {bond::make_string("a"), bond::make_list({}), bond::Runtime::ins()->C_TRUE};
+
+    fmt::print("{:<32} {:>10}\n", "benchmark", "ns/op");
+
+    auto report = [](const char *name, double ns) { fmt::print("{:<32} {:>10.2f}\n", name, ns); };
+
+    report("is<NativeInstance>", time_ns(iterations, [&](int64_t i) {
+        sink = sink + objects[i % 3]->is<bond::NativeInstance>();
+    }));
+
+    report("dynamic_cast<NativeInstance>", time_ns(iterations, [&](int64_t i) {
+        sink = sink + (dynamic_cast<bond::NativeInstance *>(objects[i % 3].get()) != nullptr);
+    }));
+
+    report("as<String>", time_ns(iterations, [&](int64_t i) {
+        sink = sink + (objects[i % 3]->as<bond::String>().get() != nullptr);
+    }));
+
+    report("dynamic_cast<String>", time_ns(iterations, [&](int64_t i) {
+        sink = sink + (dynamic_cast<bond::String *>(objects[i % 3].get()) != nullptr);
+    }));
+
+    report("parse_args(String, List, None)", time_ns(iterations, [&](int64_t) {
+        bond::String *key;
+        bond::List *list;
+        bond::None *none;
+        sink = sink + bond::parse_args(args, key, list, none).has_value();
+    }));
+
+    auto ctx = engine->get_context();
+    auto vm = bond::Vm(ctx);
+    bond::set_current_vm(&vm);
+
+    auto id = ctx->new_module("<bench>");
+    auto lexer = bond::Lexer(source, ctx, id);
+    auto parser = bond::Parser(lexer.tokenize(), ctx);
+    auto nodes = parser.parse();
+    auto codegen = bond::CodeGenerator(ctx, parser.get_scopes());
+    auto code = codegen.generate_code(nodes);
+
+    if (ctx->has_error()) return 1;
+
+    vm.run(code);
+
+    int64_t instances = iterations / 10;
+    fmt::print("\n{:<32} {:>10} {:>10}\n", "benchmark", "ns/op", "bytes/op");
+
+    for (auto name: {"create_loop", "field_loop", "method_loop", "native_method_loop"}) {
+        auto function = vm.get_globals()->get(name).value()->as<bond::Function>();
+
+        auto bytes = GC_get_total_bytes();
+        auto start = std::chrono::steady_clock::now();
+        vm.call_function_ex(function, {bond::make_int(instances)});
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        bytes = GC_get_total_bytes() - bytes;
+
+        if (vm.had_error()) return 1;
+
+        fmt::print("{:<32} {:>10.2f} {:>10.2f}\n", name, elapsed / (double) instances,
+                   (double) bytes / (double) instances);
+    }
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+//
+// compares functions run on the stack bytecode with the same functions run on the register
+// backend, see src/compiler/regcodegen.h.
+//
+// the source is compiled twice, once as usual and once with register code, and each is run by
+// its own vm. the speedup column is the stack code's time over the register code's.
+//
+
+#include "../src/engine.h"
+#include <chrono>
+
+namespace {
+    const char *source = R"(
+import "core";
+
+fn add(a, b) {
+    return a + b;
+}
+
+fn call_loop(n) {
+    var i = 0;
+    var total = 0;
+    while i < n {
+        total = add(total, i);
+        i = i + 1;
+    }
+    return total;
+}
+
+fn fib(n) {
+    if n < 2 {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+
+fn fib_loop(n) {
+    var i = 0;
+    var total = 0;
+    while i < n / 1000 {
+        total = total + fib(14);
+        i = i + 1;
+    }
+    return total;
+}
+
+fn branch_loop(n) {
+    var i = 0;
+    var total = 0;
+    while i < n {
+        if i % 3 == 0 {
+            total = total + i * 2;
+        } else {
+            total = total - 1;
+        }
+        i = i + 1;
+    }
+    return total;
+}
+
+fn float_loop(n) {
+    var i = 0;
+    var x = 0.0;
+    while i < n {
+        x = x * 0.5 + 1.5;
+        i = i + 1;
+    }
+    return x;
+}
+
+fn nested_loop(n) {
+    var i = 0;
+    var total = 0;
+    while i < n / 100 {
+        var j = 0;
+        while j < 100 {
+            total = total + j;
+            j = j + 1;
+        }
+        i = i + 1;
+    }
+    return total;
+}
+
+fn range_loop(n) {
+    var total = 0;
+    for i in core.Range(0, n, 1) {
+        total = total + i;
+    }
+    return total;
+}
+)";
+
+    bond::GcPtr<bond::Code> compile(bond::Context *ctx) {
+        auto id = ctx->new_module("<bench>");
+        auto lexer = bond::Lexer(source, ctx, id);
+        auto parser = bond::Parser(lexer.tokenize(), ctx);
+        auto nodes = parser.parse();
+        auto codegen = bond::CodeGenerator(ctx, parser.get_scopes());
+        return codegen.generate_code(nodes);
+    }
+
+    // runs the source in a vm and times each function, in ns per iteration
+    std::vector<double> run_functions(bond::Context *ctx, const bond::GcPtr<bond::Code> &code,
+                                      const std::vector<const char *> &names, int64_t iterations) {
+        auto vm = bond::Vm(ctx);
+        bond::set_current_vm(&vm);
+        vm.run(code);
+
+        std::vector<double> times;
+        for (auto name: names) {
+            auto function = vm.get_globals()->get(name).value()->as<bond::Function>();
+
+            auto start = std::chrono::steady_clock::now();
+            vm.call_function_ex(function, {bond::make_int(iterations)});
+            auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+            if (vm.had_error()) return {};
+            times.push_back(elapsed / (double) iterations);
+        }
+        return times;
+    }
+}
+
+int main(int argc, char **argv) {
+    int64_t iterations = argc > 1 ? std::stoll(argv[1]) : 10'000'000;
+
+    auto engine = bond::create_engine("");
+    auto ctx = engine->get_context();
+
+    auto stack_code = compile(ctx);
+    ctx->set_register_vm(true);
+    auto register_code = compile(ctx);
+    if (ctx->has_error()) return 1;
+
+    std::vector<const char *> names{"call_loop", "fib_loop", "branch_loop", "float_loop", "nested_loop",
+                                    "range_loop"};
+
+    ctx->set_register_vm(false);
+    auto stack = run_functions(ctx, stack_code, names, iterations);
+    ctx->set_register_vm(true);
+    auto registers = run_functions(ctx, register_code, names, iterations);
+    if (stack.empty() or registers.empty()) return 1;
+
+    fmt::print("{:<14} {:>16} {:>16} {:>10}\n", "benchmark", "stack ns/iter", "register ns/iter", "speedup");
+    for (size_t i = 0; i < names.size(); i++) {
+        fmt::print("{:<14} {:>16.2f} {:>16.2f} {:>9.2f}x\n", names[i], stack[i], registers[i],
+                   stack[i] / registers[i]);
+    }
+
+    return 0;
+}
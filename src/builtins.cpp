@@ -17,7 +17,7 @@
 #endif
 
 namespace bond {
-    obj_result b_println(const t_vector &args) {
+    obj_result b_println(t_args args) {
         for (auto &arg: args) {
             fmt::print("{} ", arg->str());
         }
@@ -26,14 +26,14 @@ namespace bond {
     }
 
 
-    obj_result b_print(const t_vector &args) {
+    obj_result b_print(t_args args) {
         for (auto &arg: args) {
             fmt::print("{} ", arg->str());
         }
         return OK();
     }
 
-    obj_result b_dump(const t_vector &args) {
+    obj_result b_dump(t_args args) {
 #ifdef DEBUG
 //        GC_dump();
 //        GC_generate_random_backtrace();
@@ -42,7 +42,7 @@ namespace bond {
         return OK();
     }
 
-    obj_result b_exit(const t_vector &args) {
+    obj_result b_exit(t_args args) {
         Int* code;
         TRY(parse_args(args, code));
         exit(code->get_value());
@@ -111,7 +111,7 @@ namespace bond {
         return OK(make_string(help.str()));
     }
 
-    obj_result b_help(const t_vector &args) {
+    obj_result b_help(t_args args) {
         Object *obj;
         TRY(parse_args(args, obj));
 
@@ -134,7 +134,7 @@ namespace bond {
         return ERR("help() only works on structs and native structs");
     }
 
-    obj_result b_type_of(const t_vector &args) {
+    obj_result b_type_of(t_args args) {
         Object *obj;
         TRY(parse_args(args, obj));
         if (obj->is<NativeStruct>() or obj->is<Struct>()) {
@@ -149,7 +149,7 @@ namespace bond {
         return ERR(fmt::format("unable to get type of {}", obj->str()));
     }
 
-    obj_result b_instance_of(const t_vector &args) {
+    obj_result b_instance_of(t_args args) {
         Object *obj;
         Object *struct_;
         TRY(parse_args(args, obj, struct_));
@@ -179,7 +179,7 @@ namespace bond {
         return ERR("expected an instance as the first argument");
     }
 
-    obj_result b_input(const t_vector &args) {
+    obj_result b_input(t_args args) {
         String* prompt;
         TRY(parse_args(args, prompt));
         fmt::print("{}", prompt->get_value());
@@ -188,20 +188,20 @@ namespace bond {
         return OK(make_string(input));
     }
 
-    obj_result b_debug_break(const t_vector &args) {
+    obj_result b_debug_break(t_args args) {
         debug_break();
         return OK();
     }
 
 
-    obj_result b_to_string(const t_vector &args) {
+    obj_result b_to_string(t_args args) {
         Object *obj;
         TRY(parse_args(args, obj));
         return OK(make_string(obj->str()));
     }
 
 
-    obj_result b_format(const t_vector &args) {
+    obj_result b_format(t_args args) {
         if (args.empty()) {
             return ERR("expected at least one argument");
         }
@@ -613,7 +613,7 @@ namespace bond {
             return {};
         }
 
-        static obj_result map(const GcPtr<Object>& self, const t_vector &args) {
+        static obj_result map(const GcPtr<Object>& self, t_args args) {
             Object *func;
             TRY(parse_args(args, func));
             auto it = self->as<Iter>();
@@ -623,7 +623,7 @@ namespace bond {
             return self;
         }
 
-        static obj_result take(const GcPtr<Object>& self, const t_vector &args) {
+        static obj_result take(const GcPtr<Object>& self, t_args args) {
             Int *count;
             TRY(parse_args(args, count));
             auto iter = self->as<Iter>();
@@ -633,7 +633,7 @@ namespace bond {
             return self;
         }
 
-        static obj_result filter(const GcPtr<Object>& self, const t_vector &args) {
+        static obj_result filter(const GcPtr<Object>& self, t_args args) {
             Object *func;
             TRY(parse_args(args, func));
             auto iter = self->as<Iter>();
@@ -643,14 +643,14 @@ namespace bond {
             return self;
         }
 
-        static obj_result to_list(const GcPtr<Object>& self, const t_vector &args) {
+        static obj_result to_list(const GcPtr<Object>& self, t_args args) {
             auto iter = self->as<Iter>();
             auto value = iter->iterable->to_list();
             TRY(value);
             return OK(value.value());
         }
 
-        static obj_result reduce(const GcPtr<Object>& self, const t_vector &args) {
+        static obj_result reduce(const GcPtr<Object>& self, t_args args) {
             Object *func;
             TRY(parse_args(args, func));
             auto iter = self->as<Iter>();
@@ -677,7 +677,7 @@ namespace bond {
             return first;
         }
 
-        static obj_result skip(const GcPtr<Object>& self, const t_vector &args) {
+        static obj_result skip(const GcPtr<Object>& self, t_args args) {
             Int *count;
             TRY(parse_args(args, count));
             auto iter = self->as<Iter>();
@@ -687,7 +687,7 @@ namespace bond {
             return self;
         }
 
-        static obj_result step_by(const GcPtr<Object>& self, const t_vector &args) {
+        static obj_result step_by(const GcPtr<Object>& self, t_args args) {
             Int *count;
             TRY(parse_args(args, count));
             auto iter = self->as<Iter>();
@@ -697,7 +697,7 @@ namespace bond {
             return self;
         }
 
-        static obj_result enumerate(const GcPtr<Object>& self, const t_vector &args) {
+        static obj_result enumerate(const GcPtr<Object>& self, t_args args) {
             TRY(parse_args(args));
             auto iter = self->as<Iter>();
 
@@ -706,7 +706,7 @@ namespace bond {
             return self;
         }
 
-        static obj_result chain(const GcPtr<Object>& self, const t_vector& args) {
+        static obj_result chain(const GcPtr<Object>& self, t_args args) {
             Iter *next_iter;
             TRY(parse_args(args, next_iter));
             auto iter = self->as<Iter>();
@@ -716,7 +716,7 @@ namespace bond {
             return self;
         }
 
-        static obj_result take_while(const GcPtr<Object>& self, const t_vector& args) {
+        static obj_result take_while(const GcPtr<Object>& self, t_args args) {
             Object *func;
             TRY(parse_args(args, func));
             auto iter = self->as<Iter>();
@@ -742,7 +742,7 @@ namespace bond {
     };
 
 
-    obj_result b_iter(const t_vector &args) {
+    obj_result b_iter(t_args args) {
         Object *iterable;
         TRY(parse_args(args, iterable));
 
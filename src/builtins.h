@@ -8,5 +8,5 @@
 
 namespace bond {
     void add_builtins_to_globals(const GcPtr<StringMap> &globals);
-    obj_result b_help(const t_vector &args);
+    obj_result b_help(t_args args);
 }
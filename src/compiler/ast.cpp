@@ -54,10 +54,11 @@ namespace bond {
         visitor->visit(this);
     }
 
-    NumberLiteral::NumberLiteral(const SharedSpan &span, const std::string &lexeme, bool is_int) {
+    NumberLiteral::NumberLiteral(const SharedSpan &span, const std::string &lexeme, bool is_int, bool is_exact) {
         m_span = span;
         m_value = lexeme;
         m_is_int = is_int;
+        m_is_exact = is_exact;
     }
 
     void NumberLiteral::accept(NodeVisitor *visitor) {
@@ -43,6 +43,12 @@ namespace bond {
             : name(std::move(name)), type(std::move(type)), span(std::move(span)) {}
     };
 
+    // a cell that a closure takes from a slot of its enclosing function when it is created
+    struct Capture {
+        uint32_t from;
+        uint32_t to;
+    };
+
     // types
 
     class TypeNode : public Node {
@@ -139,8 +145,12 @@ namespace bond {
 
         SharedNode get_left() { return m_left; }
 
+        void set_left(const SharedNode &left) { m_left = left; }
+
         SharedNode get_right() { return m_right; }
 
+        void set_right(const SharedNode &right) { m_right = right; }
+
         Token get_op() { return m_op; }
 
     private:
@@ -157,6 +167,8 @@ namespace bond {
 
         SharedNode get_expr() { return m_expr; }
 
+        void set_expr(const SharedNode &expr) { m_expr = expr; }
+
         Token get_op() { return m_op; }
 
     private:
@@ -190,7 +202,9 @@ namespace bond {
 
     class NumberLiteral : public Node {
     public:
-        NumberLiteral(const SharedSpan &span, const std::string &lexeme, bool is_int);
+        // an exact float holds the shortest text that reads back as the same double, the
+        // constant folder makes these so folded values match what the vm would compute
+        NumberLiteral(const SharedSpan &span, const std::string &lexeme, bool is_int, bool is_exact = false);
 
         void accept(NodeVisitor *visitor) override;
 
@@ -198,9 +212,12 @@ namespace bond {
 
         [[nodiscard]] bool is_int() const { return m_is_int; }
 
+        [[nodiscard]] bool is_exact() const { return m_is_exact; }
+
     private:
         std::string m_value;
         bool m_is_int;
+        bool m_is_exact;
     };
 
     class StringLiteral : public Node {
@@ -238,6 +255,8 @@ namespace bond {
 
         SharedNode get_expr() { return m_expr; }
 
+        void set_expr(const SharedNode &expr) { m_expr = expr; }
+
         std::optional<SharedTypeNode> get_type() { return m_type; }
 
     private:
@@ -255,6 +274,8 @@ namespace bond {
 
         SharedNode get_expr() { return m_expr; }
 
+        void set_expr(const SharedNode &expr) { m_expr = expr; }
+
     private:
         SharedNode m_expr;
 
@@ -270,6 +291,8 @@ namespace bond {
 
         SharedNode get_expr() { return m_node; }
 
+        void set_expr(const SharedNode &expr) { m_node = expr; }
+
     private:
         std::string m_name;
         SharedNode m_node;
@@ -284,6 +307,8 @@ namespace bond {
 
         std::vector<SharedNode> get_nodes() { return m_nodes; }
 
+        void set_nodes(const std::vector<SharedNode> &nodes) { m_nodes = nodes; }
+
     private:
         std::vector<SharedNode> m_nodes;
     };
@@ -296,6 +321,8 @@ namespace bond {
 
         std::vector<SharedNode> get_nodes() { return m_nodes; }
 
+        void set_nodes(const std::vector<SharedNode> &nodes) { m_nodes = nodes; }
+
     private:
         std::vector<SharedNode> m_nodes;
     };
@@ -308,8 +335,12 @@ namespace bond {
 
         SharedNode get_expr() { return m_expr; }
 
+        void set_expr(const SharedNode &expr) { m_expr = expr; }
+
         SharedNode get_index() { return m_index; }
 
+        void set_index(const SharedNode &index) { m_index = index; }
+
     private:
         SharedNode m_expr;
         SharedNode m_index;
@@ -323,10 +354,16 @@ namespace bond {
 
         SharedNode get_expr() { return m_expr; }
 
+        void set_expr(const SharedNode &expr) { m_expr = expr; }
+
         SharedNode get_index() { return m_index; }
 
+        void set_index(const SharedNode &index) { m_index = index; }
+
         SharedNode get_value() { return m_value; }
 
+        void set_value(const SharedNode &value) { m_value = value; }
+
     private:
         SharedNode m_expr;
         SharedNode m_index;
@@ -342,10 +379,16 @@ namespace bond {
 
         SharedNode get_condition() { return m_condition; }
 
+        void set_condition(const SharedNode &condition) { m_condition = condition; }
+
         SharedNode get_then() { return m_then; }
 
+        void set_then(const SharedNode &then) { m_then = then; }
+
         std::optional<SharedNode> get_else() { return m_else; }
 
+        void set_else(const std::optional<SharedNode> &else_node) { m_else = else_node; }
+
     private:
         SharedNode m_condition;
         SharedNode m_then;
@@ -360,8 +403,12 @@ namespace bond {
 
         SharedNode get_condition() { return m_condition; }
 
+        void set_condition(const SharedNode &condition) { m_condition = condition; }
+
         SharedNode get_statement() { return m_statement; }
 
+        void set_statement(const SharedNode &statement) { m_statement = statement; }
+
     private:
         SharedNode m_condition;
         SharedNode m_statement;
@@ -375,8 +422,12 @@ namespace bond {
 
         SharedNode get_expr() { return m_expr; }
 
+        void set_expr(const SharedNode &expr) { m_expr = expr; }
+
         std::vector<SharedNode> get_args() { return m_args; }
 
+        void set_args(const std::vector<SharedNode> &args) { m_args = args; }
+
     private:
         SharedNode m_expr;
         std::vector<SharedNode> m_args;
@@ -393,8 +444,12 @@ namespace bond {
 
         SharedNode get_expr() { return m_expr; }
 
+        void set_expr(const SharedNode &expr) { m_expr = expr; }
+
         SharedNode get_statement() { return m_statement; }
 
+        void set_statement(const SharedNode &statement) { m_statement = statement; }
+
     private:
         std::string m_name;
         SharedNode m_expr;
@@ -416,6 +471,8 @@ namespace bond {
 
         SharedNode get_body() { return m_body; }
 
+        void set_body(const SharedNode &body) { m_body = body; }
+
         [[nodiscard]] bool can_error() const { return m_can_error; }
 
         std::optional<SharedTypeNode> get_return_type() { return m_return_type; }
@@ -436,6 +493,8 @@ namespace bond {
 
         SharedNode get_expr() { return m_expr; }
 
+        void set_expr(const SharedNode &expr) { m_expr = expr; }
+
     private:
         SharedNode m_expr;
     };
@@ -486,6 +545,8 @@ namespace bond {
 
         SharedNode get_expr() { return m_expr; }
 
+        void set_expr(const SharedNode &expr) { m_expr = expr; }
+
         std::string get_name() { return m_name; }
 
     private:
@@ -501,10 +562,14 @@ namespace bond {
 
         SharedNode get_expr() { return m_expr; }
 
+        void set_expr(const SharedNode &expr) { m_expr = expr; }
+
         std::string get_name() { return m_name; }
 
         SharedNode get_value() { return m_value; }
 
+        void set_value(const SharedNode &value) { m_value = value; }
+
     private:
         SharedNode m_expr;
         std::string m_name;
@@ -539,6 +604,8 @@ namespace bond {
 
         SharedNode get_expr() { return m_expr; }
 
+        void set_expr(const SharedNode &expr) { m_expr = expr; }
+
     private:
         SharedNode m_expr;
     };
@@ -579,6 +646,8 @@ namespace bond {
 
         SharedNode get_expr() { return m_expr; }
 
+        void set_expr(const SharedNode &expr) { m_expr = expr; }
+
     private:
         SharedNode m_expr;
     };
@@ -591,6 +660,8 @@ namespace bond {
 
         SharedNode get_value() { return m_value; }
 
+        void set_value(const SharedNode &value) { m_value = value; }
+
         void accept(NodeVisitor *visitor) override;
 
     private:
@@ -610,6 +681,8 @@ namespace bond {
 
         std::vector<SharedNode> get_args() { return m_args; }
 
+        void set_args(const std::vector<SharedNode> &args) { m_args = args; }
+
     private:
         std::shared_ptr<GetAttribute> m_get_attr;
         std::vector<SharedNode> m_args;
@@ -623,6 +696,8 @@ namespace bond {
 
         SharedNode get_expr() { return m_expr; }
 
+        void set_expr(const SharedNode &expr) { m_expr = expr; }
+
         bool is_error() { return m_is_error; }
 
     private:
@@ -638,6 +713,8 @@ namespace bond {
 
         std::vector<std::pair<SharedNode, SharedNode>> get_pairs() { return m_pairs; }
 
+        void set_pairs(const std::vector<std::pair<SharedNode, SharedNode>> &pairs) { m_pairs = pairs; }
+
     private:
         std::vector<std::pair<SharedNode, SharedNode>> m_pairs;
     };
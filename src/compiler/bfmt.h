@@ -17,7 +17,7 @@
 
 
 #define BOND_MAGIC_NUMBER 0x424F4E44
-#define BOND_BAR_VERSION 0x00000001
+#define BOND_BAR_VERSION 0x00000008
 
 
 namespace bond {
@@ -30,19 +30,26 @@ namespace bond {
     // for each module (code object)
     // module id u32
     // constant count u32
-    // instructions count u32
-    // span count u32
+    // instruction byte count u32
+    // span table byte count u32
     // constants
     // instructions
-    // spans
+    // span table
+    // local count u32
+    // local names
+    // capture count u32
+    // captures [from u32, to u32], ...
+    // method cache count u32
 
     // for each constant
     // type u8
     // value
 
-    // instructions array<u32>
+    // instructions array<u8>, one byte opcodes followed by varint oprands
 
-    // for each span
+    // span table array<u8>, runs of instruction bytes that share a span, see Code::add_span
+
+    // for each span of a parameter
     // module id u32
     // start u32
     // end u32
@@ -271,11 +278,11 @@ namespace bond {
     inline auto write_code_impl(S &stream, const GcPtr<Code> &code) -> void {
         auto constants = code->get_constants();
         auto instructions = code->get_instructions();
-        auto spans = code->get_spans();
+        auto &span_table = code->get_span_table();
 
         write_val<S, uint32_t>(stream, (uint32_t)constants.size());
         write_val<S, uint32_t>(stream, (uint32_t)instructions.size());
-        write_val<S, uint32_t>(stream, (uint32_t)spans.size());
+        write_val<S, uint32_t>(stream, (uint32_t)span_table.size());
 
         for (auto &constant: constants) {
             if (instanceof<Int>(constant.get())) {
@@ -299,14 +306,22 @@ namespace bond {
             }
         }
 
-        for (auto &instruction: instructions) {
-            write_val<S, uint32_t>(stream, instruction);
+        stream.write(reinterpret_cast<const char *>(instructions.data()), (std::streamsize) instructions.size());
+
+        stream.write(reinterpret_cast<const char *>(span_table.data()), (std::streamsize) span_table.size());
+
+        write_val<S, uint32_t>(stream, code->get_local_count());
+        for (auto &local: code->get_locals()) {
+            write_string(stream, local);
         }
 
-        for (auto &span: spans) {
-            write_span(stream, span);
+        write_val<S, uint32_t>(stream, (uint32_t)code->get_captures().size());
+        for (auto &capture: code->get_captures()) {
+            write_val<S, uint32_t>(stream, capture.from);
+            write_val<S, uint32_t>(stream, capture.to);
         }
 
+        write_val<S, uint32_t>(stream, code->get_method_cache_count());
     }
 
     template<typename S>
@@ -351,7 +366,7 @@ namespace bond {
     auto read_code_impl(S &stream) -> GcPtr<Code> {
         auto constants_count = read_val<S, uint32_t>(stream);
         auto code_size = read_val<S, uint32_t>(stream);
-        auto spans_count = read_val<S, uint32_t>(stream);
+        auto span_table_size = read_val<S, uint32_t>(stream);
 
         t_vector constants;
 
@@ -382,20 +397,37 @@ namespace bond {
             }
         }
 
-        auto instructions = std::vector<uint32_t>();
+        auto instructions = std::vector<uint8_t>(code_size);
+        stream.read(reinterpret_cast<char *>(instructions.data()), (std::streamsize) code_size);
+
+        auto span_table = std::vector<uint8_t>(span_table_size);
+        stream.read(reinterpret_cast<char *>(span_table.data()), (std::streamsize) span_table_size);
 
-        for (uint32_t i = 0; i < code_size; i++) {
-            auto instruction = read_val<S, uint32_t>(stream);
-            instructions.emplace_back(instruction);
+        auto local_count = read_val<S, uint32_t>(stream);
+        auto locals = t_string_vector();
+
+        for (uint32_t i = 0; i < local_count; i++) {
+            locals.emplace_back(read_string<S>(stream));
         }
 
-        auto spans = std::vector<SharedSpan>();
+        auto capture_count = read_val<S, uint32_t>(stream);
+        auto captures = std::vector<Capture>();
 
-        for (uint32_t i = 0; i < spans_count; i++) {
-            spans.emplace_back(read_span(stream));
+        for (uint32_t i = 0; i < capture_count; i++) {
+            auto from = read_val<S, uint32_t>(stream);
+            auto to = read_val<S, uint32_t>(stream);
+            captures.push_back({from, to});
         }
 
-        return Runtime::ins()->CODE_STRUCT->create_instance<Code>(instructions, spans, constants);
+        auto method_cache_count = read_val<S, uint32_t>(stream);
+
+        auto code = Runtime::ins()->CODE_STRUCT->create_instance<Code>(instructions, span_table, constants);
+        code->set_locals(locals);
+        code->set_captures(captures);
+        for (uint32_t i = 0; i < method_cache_count; i++) {
+            code->add_method_cache();
+        }
+        return code;
     }
 
 
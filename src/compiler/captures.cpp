@@ -0,0 +1,207 @@
+//
+// finds the locals closures capture, see captures.h
+//
+
+#include "captures.h"
+#include "nodevisitor.h"
+
+namespace bond {
+    // walks a module with the scopes the code generator opens, noting for every function the
+    // names of its locals that a nested function uses
+    class CaptureScanner : public NodeVisitor {
+    public:
+        explicit CaptureScanner(std::unordered_map<const FuncDef *, std::unordered_set<std::string>> &cells)
+                : m_cells(cells) {
+            m_functions.push_back(&m_cells[nullptr]);
+        }
+
+        void scan(const SharedNode &node) {
+            if (node) node->accept(this);
+        }
+
+        void scan(const std::vector<SharedNode> &nodes) {
+            for (auto &node: nodes) scan(node);
+        }
+
+        void visit(BinaryOp *expr) override {
+            scan(expr->get_left());
+            scan(expr->get_right());
+        }
+
+        void visit(Unary *expr) override { scan(expr->get_expr()); }
+
+        void visit(TrueLiteral *expr) override {}
+
+        void visit(FalseLiteral *expr) override {}
+
+        void visit(NumberLiteral *expr) override {}
+
+        void visit(StringLiteral *expr) override {}
+
+        void visit(NilLiteral *expr) override {}
+
+        void visit(ExprStmnt *stmnt) override { scan(stmnt->get_expr()); }
+
+        void visit(Identifier *expr) override { use(expr->get_name()); }
+
+        void visit(NewVar *stmnt) override {
+            scan(stmnt->get_expr());
+            declare(stmnt->get_name());
+        }
+
+        void visit(Assign *stmnt) override {
+            scan(stmnt->get_expr());
+            use(stmnt->get_name());
+        }
+
+        void visit(Block *stmnt) override {
+            m_scopes.emplace_back();
+            scan(stmnt->get_nodes());
+            m_scopes.pop_back();
+        }
+
+        void visit(ListLiteral *expr) override { scan(expr->get_nodes()); }
+
+        void visit(GetItem *expr) override {
+            scan(expr->get_expr());
+            scan(expr->get_index());
+        }
+
+        void visit(SetItem *expr) override {
+            scan(expr->get_expr());
+            scan(expr->get_index());
+            scan(expr->get_value());
+        }
+
+        void visit(If *stmnt) override {
+            scan(stmnt->get_condition());
+            scan(stmnt->get_then());
+            if (stmnt->get_else().has_value()) scan(stmnt->get_else().value());
+        }
+
+        void visit(While *stmnt) override {
+            scan(stmnt->get_condition());
+            scan(stmnt->get_statement());
+        }
+
+        // an inlined body only sees its parameters and the globals, so it captures nothing
+        void visit(Call *expr) override {
+            scan(expr->get_expr());
+            scan(expr->get_args());
+        }
+
+        // the loop variable is declared before the iterable is evaluated, as the code generator does
+        void visit(For *stmnt) override {
+            m_scopes.emplace_back();
+            declare(stmnt->get_name());
+            scan(stmnt->get_expr());
+            scan(stmnt->get_statement());
+            m_scopes.pop_back();
+        }
+
+        void visit(FuncDef *stmnt) override {
+            function(stmnt);
+            declare(stmnt->get_name());
+        }
+
+        void visit(Return *stmnt) override { scan(stmnt->get_expr()); }
+
+        void visit(ClosureDef *stmnt) override {
+            function(stmnt->get_func_def().get());
+            if (!stmnt->is_expression()) declare(stmnt->get_name());
+        }
+
+        void visit(StructNode *stmnt) override {
+            for (auto &method: stmnt->get_methods()) {
+                function(dynamic_cast<FuncDef *>(method.get()));
+            }
+            declare(stmnt->get_name());
+        }
+
+        void visit(GetAttribute *expr) override { scan(expr->get_expr()); }
+
+        void visit(SetAttribute *expr) override {
+            scan(expr->get_expr());
+            scan(expr->get_value());
+        }
+
+        void visit(ImportDef *stmnt) override {}
+
+        void visit(Try *stmnt) override { scan(stmnt->get_expr()); }
+
+        void visit(Break *stmnt) override {}
+
+        void visit(Continue *stmnt) override {}
+
+        void visit(AsyncDef *stmnt) override { scan(stmnt->get_function()); }
+
+        void visit(Await *expr) override { scan(expr->get_expr()); }
+
+        void visit(StructuredAssign *stmnt) override {
+            scan(stmnt->get_value());
+            for (auto &target: stmnt->get_targets()) {
+                if (auto identifier = dynamic_cast<Identifier *>(target.get())) declare(identifier->get_name());
+            }
+        }
+
+        void visit(CallMethod *expr) override {
+            scan(expr->get_node());
+            scan(expr->get_args());
+        }
+
+        void visit(ResultStatement *expr) override { scan(expr->get_expr()); }
+
+        void visit(DictLiteral *expr) override {
+            for (auto &[key, value]: expr->get_pairs()) {
+                scan(key);
+                scan(value);
+            }
+        }
+
+    private:
+        std::unordered_map<const FuncDef *, std::unordered_set<std::string>> &m_cells;
+        // the cells of each function being walked, the module's own code first
+        std::vector<std::unordered_set<std::string> *> m_functions;
+        // the function each visible local belongs to, as an index into m_functions. names at
+        // the top level of the module are globals and are left out
+        std::vector<std::unordered_map<std::string, size_t>> m_scopes;
+
+        void declare(const std::string &name) {
+            if (!m_scopes.empty()) m_scopes.back()[name] = m_functions.size() - 1;
+        }
+
+        void use(const std::string &name) {
+            for (auto scope = m_scopes.rbegin(); scope != m_scopes.rend(); scope++) {
+                auto local = scope->find(name);
+                if (local == scope->end()) continue;
+
+                if (local->second != m_functions.size() - 1) m_functions[local->second]->insert(name);
+                return;
+            }
+        }
+
+        void function(FuncDef *stmnt) {
+            if (!stmnt) return;
+
+            m_functions.push_back(&m_cells[stmnt]);
+            m_scopes.emplace_back();
+            for (auto &param: stmnt->get_params()) {
+                declare(param->name);
+            }
+            scan(stmnt->get_body());
+            m_scopes.pop_back();
+            m_functions.pop_back();
+        }
+    };
+
+    Captures::Captures(const std::vector<SharedNode> &nodes) {
+        CaptureScanner(m_cells).scan(nodes);
+    }
+
+    const std::unordered_set<std::string> &Captures::cells(const FuncDef *function) const {
+        static const std::unordered_set<std::string> none;
+
+        auto cells = m_cells.find(function);
+        return cells == m_cells.end() ? none : cells->second;
+    }
+}
@@ -0,0 +1,33 @@
+//
+// finds the locals closures capture before the code generator runs
+//
+
+#ifndef BOND_CAPTURES_H
+#define BOND_CAPTURES_H
+
+#include "ast.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace bond {
+    // the locals of every function in a module that a nested function uses, so the code
+    // generator knows which of them live in cells before it compiles the function
+    class Captures {
+    public:
+        // resolves the names in nodes the way the code generator does, a name declared in a
+        // function and used inside one of its nested functions is captured
+        explicit Captures(const std::vector<SharedNode> &nodes);
+
+        // names of the locals of function that live in cells, nullptr for the module's own code.
+        // locals are told apart by name, sibling blocks that reuse a name share the answer
+        const std::unordered_set<std::string> &cells(const FuncDef *function) const;
+
+    private:
+        std::unordered_map<const FuncDef *, std::unordered_set<std::string>> m_cells;
+    };
+}
+
+#endif //BOND_CAPTURES_H
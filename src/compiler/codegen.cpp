@@ -3,6 +3,9 @@
 //
 
 #include "codegen.h"
+#include "folder.h"
+#include "optimizer.h"
+#include "regcodegen.h"
 #include "../object.h"
 #include "parser.h"
 #include "../runtime.h"
@@ -27,26 +30,109 @@ namespace bond {
         m_code->add_ins(Opcode::RETURN, std::make_shared<Span>(0, 0, 0, 0));
     }
 
+    void CodeGenerator::finish_function(const GcPtr<Code> &code) {
+        auto function = m_scopes->end_function();
+
+        t_string_vector locals;
+        for (auto &name: function.locals) {
+            locals.emplace_back(name);
+        }
+
+        code->set_locals(locals);
+        code->set_captures(function.captures);
+    }
+
     GcPtr<Code> CodeGenerator::generate_code(const std::vector<std::shared_ptr<Node>> &nodes) {
+        auto program = nodes;
+        if (m_ctx->get_optimize_level() >= OPTIMIZE_PEEPHOLE) {
+            program = ConstantFolder().fold(nodes);
+        }
+        // an inlined call leaves no frame of its own in tracebacks, so it waits for -O2
+        if (m_ctx->get_optimize_level() >= OPTIMIZE_SSA and !m_is_repl) {
+            m_inliner = std::make_shared<Inliner>(program);
+        }
+
+        m_captures = std::make_shared<Captures>(program);
+        m_scopes->new_function(m_captures->cells(nullptr));
+
         try {
             m_code = Runtime::ins()->make_code();
 
-            for (const auto &node: nodes) {
+            for (const auto &node: program) {
                 node->accept(this);
             }
 
             finish_generation(false);
-            return m_code;
         }
         catch (ParserError &err) {
             m_ctx->error(err.span, err.error);
-            return m_code;
         }
+        finish_function(m_code);
+
+        if (!m_ctx->has_error()) {
+            Optimizer(m_ctx->get_optimize_level()).optimize(m_code);
+        }
+
+        return m_code;
     }
 
-    void CodeGenerator::visit(BinaryOp *expr) {
+    static std::optional<Opcode> compare_opcode(TokenType type) {
+        switch (type) {
+            case TokenType::BANG_EQUAL:
+                return Opcode::NE;
+            case TokenType::EQUAL_EQUAL:
+                return Opcode::EQ;
+            case TokenType::LESS:
+                return Opcode::LT;
+            case TokenType::LESS_EQUAL:
+                return Opcode::LE;
+            case TokenType::GREATER:
+                return Opcode::GT;
+            case TokenType::GREATER_EQUAL:
+                return Opcode::GE;
+            default:
+                return std::nullopt;
+        }
+    }
+
+    std::optional<uint32_t> CodeGenerator::local_slot(const SharedNode &node) {
+        auto identifier = dynamic_cast<Identifier *>(node.get());
+        if (!identifier) return std::nullopt;
+
+        auto var = m_scopes->get(identifier->get_name());
+        if (!var.has_value() or var.value()->is_global or m_scopes->is_cell(var.value())) return std::nullopt;
+
+        return m_scopes->get_slot(var.value());
+    }
+
+    void CodeGenerator::binary_operands(BinaryOp *expr) {
+        auto left = local_slot(expr->get_left());
+        auto right = local_slot(expr->get_right());
+
+        if (left.has_value() and right.has_value()) {
+            m_code->add_ins(Opcode::LOAD_FAST_LOAD_FAST, *left, *right, expr->get_left()->get_span());
+            return;
+        }
+
         expr->get_left()->accept(this);
         expr->get_right()->accept(this);
+    }
+
+    uint32_t CodeGenerator::jump_if_false(const SharedNode &condition, const SharedSpan &span) {
+        if (auto binary = dynamic_cast<BinaryOp *>(condition.get())) {
+            if (auto compare = compare_opcode(binary->get_op().get_type())) {
+                binary_operands(binary);
+                return m_code->add_jump(Opcode::COMPARE_AND_JUMP, static_cast<uint32_t>(*compare),
+                                        binary->get_op().get_span());
+            }
+        }
+
+        condition->accept(this);
+        return m_code->add_jump(Opcode::JUMP_IF_FALSE, span);
+    }
+
+    void CodeGenerator::visit(BinaryOp *expr) {
+        binary_operands(expr);
 
         switch (expr->get_op().get_type()) {
             case TokenType::PLUS:
@@ -127,7 +213,8 @@ namespace bond {
     void CodeGenerator::visit(NumberLiteral *expr) {
         size_t idx = 0;
 
-        if (expr->is_int()) idx = m_code->add_constant(Runtime::ins()->make_int(std::stoi(expr->get_value())));
+        if (expr->is_int()) idx = m_code->add_constant(Runtime::ins()->make_int(std::stoll(expr->get_value())));
+        else if (expr->is_exact()) idx = m_code->add_constant(Runtime::ins()->make_float(std::stod(expr->get_value())));
         else idx = m_code->add_constant(Runtime::ins()->make_float(std::stof(expr->get_value())));
 
         m_code->add_ins(Opcode::LOAD_CONST, idx, expr->get_span());
@@ -144,6 +231,16 @@ namespace bond {
     }
 
     void CodeGenerator::visit(ExprStmnt *stmnt) {
+        // an assignment to a local whose value is discarded stores and pops in one instruction
+        if (auto assign = dynamic_cast<Assign *>(stmnt->get_expr().get()); assign and !m_is_repl) {
+            auto var = m_scopes->get(assign->get_name());
+            if (var.has_value() and !var.value()->is_global and !m_scopes->is_cell(var.value())) {
+                assign->get_expr()->accept(this);
+                m_code->add_ins(Opcode::CREATE_LOCAL, m_scopes->get_slot(var.value()), assign->get_span());
+                return;
+            }
+        }
+
         stmnt->get_expr()->accept(this);
 
         if (!m_is_repl) m_code->add_ins(Opcode::POP_TOP, stmnt->get_span());
@@ -151,17 +248,18 @@ namespace bond {
 
     void CodeGenerator::visit(Identifier *expr) {
         auto var = m_scopes->get(expr->get_name());
-        auto idx = m_code->add_constant(Runtime::ins()->make_string_cache(expr->get_name()));
 
         if (var.has_value()) {
             auto v = var.value();
 
             if (v->is_global) {
+                auto idx = m_code->add_constant(Runtime::ins()->make_string_cache(expr->get_name()));
                 m_code->add_ins(Opcode::LOAD_GLOBAL, idx, expr->get_span());
                 return;
             }
 
-            m_code->add_ins(Opcode::LOAD_FAST, idx, expr->get_span());
+            auto slot = m_scopes->get_slot(v);
+            m_code->add_ins(m_scopes->is_cell(v) ? Opcode::LOAD_CELL : Opcode::LOAD_FAST, slot, expr->get_span());
             return;
         }
         m_ctx->error(expr->get_span(), fmt::format("Undefined variable {}", expr->get_name()));
@@ -170,34 +268,41 @@ namespace bond {
     void CodeGenerator::visit(NewVar *stmnt) {
         stmnt->get_expr()->accept(this);
         auto var = m_scopes->get(stmnt->get_name());
-        auto idx = m_code->add_constant(Runtime::ins()->make_string_cache(stmnt->get_name()));
 
         if (var.has_value()) {
+            auto idx = m_code->add_constant(Runtime::ins()->make_string_cache(stmnt->get_name()));
             m_code->add_ins(Opcode::CREATE_GLOBAL, idx, stmnt->get_span());
             return;
         }
 
         m_scopes->declare(stmnt->get_name(), stmnt->get_span(), true, false);
-        m_code->add_ins(Opcode::CREATE_LOCAL, idx, stmnt->get_span());
+        declare_local(stmnt->get_name(), stmnt->get_span());
     }
 
     void CodeGenerator::visit(Assign *stmnt) {
         stmnt->get_expr()->accept(this);
         auto var = m_scopes->get(stmnt->get_name());
-        auto idx = m_code->add_constant(Runtime::ins()->make_string_cache(stmnt->get_name()));
 
         if (var.has_value()) {
             auto v = var.value();
             if (v->is_global) {
+                auto idx = m_code->add_constant(Runtime::ins()->make_string_cache(stmnt->get_name()));
                 m_code->add_ins(Opcode::STORE_GLOBAL, idx, stmnt->get_span());
                 return;
             }
-            m_code->add_ins(Opcode::STORE_FAST, idx, stmnt->get_span());
+            auto slot = m_scopes->get_slot(v);
+            m_code->add_ins(m_scopes->is_cell(v) ? Opcode::STORE_CELL : Opcode::STORE_FAST, slot, stmnt->get_span());
             return;
         }
         m_ctx->error(stmnt->get_span(), "Undefined variable '" + stmnt->get_name() + "'.");
     }
 
+    void CodeGenerator::declare_local(const std::string &name, const SharedSpan &span) {
+        auto var = m_scopes->get(name).value();
+        auto slot = m_scopes->get_slot(var);
+        m_code->add_ins(m_scopes->is_cell(var) ? Opcode::CREATE_CELL : Opcode::CREATE_LOCAL, slot, span);
+    }
+
     void CodeGenerator::visit(Block *stmnt) {
         m_scopes->new_scope();
         for (auto &s: stmnt->get_nodes()) {
@@ -227,28 +332,22 @@ namespace bond {
     }
 
     void CodeGenerator::visit(If *stmnt) {
-        stmnt->get_condition()->accept(this);
-        auto next = m_code->current_index() + 1;
-        m_code->add_ins(Opcode::JUMP_IF_FALSE, next, stmnt->get_span());
+        auto next = jump_if_false(stmnt->get_condition(), stmnt->get_span());
 
         stmnt->get_then()->accept(this);
-        m_code->patch_code(next, m_code->current_index() + 2);
-
-        next = m_code->current_index() + 1;
-        m_code->add_ins(Opcode::JUMP, next, stmnt->get_span());
+        auto end = m_code->add_jump(Opcode::JUMP, stmnt->get_span());
+        m_code->patch_code(next, m_code->current_index());
 
         if (stmnt->get_else().has_value()) {
             stmnt->get_else().value()->accept(this);
         }
-        m_code->patch_code(next, m_code->current_index());
+        m_code->patch_code(end, m_code->current_index());
     }
 
     void CodeGenerator::visit(While *stmnt) {
         start_loop();
         auto start = m_code->current_index();
-        stmnt->get_condition()->accept(this);
-        auto next = m_code->current_index() + 1;
-        m_code->add_ins(Opcode::JUMP_IF_FALSE, next, stmnt->get_span());
+        auto next = jump_if_false(stmnt->get_condition(), stmnt->get_span());
 
         stmnt->get_statement()->accept(this);
         m_code->add_ins(Opcode::JUMP, start, stmnt->get_span());
@@ -259,6 +358,8 @@ namespace bond {
     }
 
     void CodeGenerator::visit(Call *expr) {
+        if (inline_call(expr)) return;
+
         expr->get_expr()->accept(this);
         for (auto &e: expr->get_args()) {
             e->accept(this);
@@ -266,29 +367,83 @@ namespace bond {
         m_code->add_ins(Opcode::CALL, expr->get_args().size(), expr->get_span());
     }
 
+    bool CodeGenerator::inline_call(Call *expr) {
+        // calls inside a body being inlined stay calls, so recursion cannot unroll forever
+        if (!m_inliner or !m_inline_exits.empty()) return false;
+
+        auto identifier = dynamic_cast<Identifier *>(expr->get_expr().get());
+        if (!identifier) return false;
+
+        auto var = m_scopes->get(identifier->get_name());
+        if (!var.has_value() or !var.value()->is_global) return false;
+
+        auto args = expr->get_args();
+        auto function = m_inliner->find(identifier->get_name(), args.size());
+        if (!function) return false;
+
+        for (auto &arg: args) {
+            arg->accept(this);
+        }
+
+        // the parameters become locals of the caller, the body sees them and the globals
+        m_scopes->isolate();
+        m_scopes->new_scope();
+
+        auto params = function->get_params();
+        for (auto &param: params) {
+            m_scopes->declare(param->name, param->span, true, false);
+        }
+        for (auto it = params.rbegin(); it != params.rend(); it++) {
+            declare_local((*it)->name, expr->get_span());
+        }
+
+        m_inline_exits.emplace_back();
+        auto body = function->get_body();
+        body->accept(this);
+
+        // a block body that runs off its end returns nil
+        if (instanceof<Block>(body.get())) {
+            m_code->add_ins(Opcode::PUSH_NIL, expr->get_span());
+        }
+
+        for (auto exit: m_inline_exits.back()) {
+            m_code->patch_code(exit, m_code->current_index());
+        }
+        m_inline_exits.pop_back();
+
+        m_scopes->end_scope();
+        m_scopes->end_isolation();
+        return true;
+    }
+
     void CodeGenerator::visit(For *stmnt) {
         start_loop();
         m_scopes->new_scope();
 
         m_scopes->declare(stmnt->get_name(), stmnt->get_span(), true, false);
-        auto local_name = m_code->add_constant(make_string(stmnt->get_name()));
+        auto local = m_scopes->get(stmnt->get_name()).value();
+        auto local_slot = m_scopes->get_slot(local);
 
         m_code->add_ins(Opcode::PUSH_NIL, stmnt->get_span());
-        m_code->add_ins(Opcode::CREATE_LOCAL, local_name, stmnt->get_span());
+        declare_local(stmnt->get_name(), stmnt->get_span());
 
         stmnt->get_expr()->accept(this);
         m_code->add_ins(Opcode::ITER, stmnt->get_span());
 
         auto start = m_code->current_index();
-        m_code->add_ins(Opcode::ITER_END, 0, stmnt->get_span());
+        auto exit = m_code->add_jump(Opcode::FOR_ITER, local_slot, stmnt->get_span());
 
-        m_code->add_ins(Opcode::ITER_NEXT, local_name, stmnt->get_span());
+        // every iteration gets its own cell, closures made in the body keep the value they saw
+        if (m_scopes->is_cell(local)) {
+            m_code->add_ins(Opcode::LOAD_FAST, local_slot, stmnt->get_span());
+            m_code->add_ins(Opcode::CREATE_CELL, local_slot, stmnt->get_span());
+        }
 
         stmnt->get_statement()->accept(this);
         m_code->add_ins(Opcode::JUMP, start, stmnt->get_span());
 
         auto end = m_code->current_index();
-        m_code->patch_code(start + 1, end);
+        m_code->patch_code(exit, end);
         finish_loop(end, start);
         m_code->add_ins(Opcode::POP_TOP, stmnt->get_span());
         m_scopes->end_scope();
@@ -305,26 +460,10 @@ namespace bond {
 
         auto var = m_scopes->get(stmnt->get_name());
 
-        auto generator = CodeGenerator(m_ctx, m_scopes);
-        generator.m_in_function = true;
-
-        m_scopes->new_scope();
-        for (auto &param: stmnt->get_params()) {
-            m_scopes->declare(param->name, param->span, true, false);
-        }
-
-        auto code = generator.generate_code(stmnt->get_body(), stmnt->can_error());
+        auto code = function_code(stmnt, true);
 
-        if (!instanceof<Block>(stmnt->get_body().get())) {
-            code->add_ins(Opcode::RETURN, stmnt->get_span());
-        }
-
-        generator.m_in_function = false;
-
-        m_scopes->end_scope();
         auto fn = Runtime::ins()->make_function(stmnt->get_name(), stmnt->get_params(), code);
         auto idx = m_code->add_constant(fn);
-        auto name = m_code->add_constant(Runtime::ins()->make_string_cache(stmnt->get_name()));
 
         if (is_async) {
             m_code->add_ins(Opcode::MAKE_ASYNC, idx, stmnt->get_span());
@@ -333,11 +472,14 @@ namespace bond {
         }
 
         if (var.has_value()) {
+            auto name = m_code->add_constant(Runtime::ins()->make_string_cache(stmnt->get_name()));
             m_code->add_ins(Opcode::CREATE_GLOBAL, name, stmnt->get_span());
             m_in_function = false;
             return;
         }
-        m_code->add_ins(Opcode::STORE_FAST, name, stmnt->get_span());
+
+        m_scopes->declare(stmnt->get_name(), stmnt->get_span(), false, false);
+        declare_local(stmnt->get_name(), stmnt->get_span());
         m_in_function = false;
 
 //        finish_generation(stmnt->can_error());
@@ -348,33 +490,54 @@ namespace bond {
 
         auto var = m_scopes->get(stmnt->get_name());
 
+        auto code = function_code(stmnt, instanceof<Block>(stmnt->get_body().get()));
+        m_in_function = false;
+
+        return Runtime::ins()->make_function(stmnt->get_name(), stmnt->get_params(), code);
+    }
+
+    GcPtr<Code> CodeGenerator::function_code(FuncDef *stmnt, bool f_generation) {
         auto generator = CodeGenerator(m_ctx, m_scopes);
         generator.m_in_function = true;
+        generator.m_inliner = m_inliner;
+        generator.m_captures = m_captures;
 
+        m_scopes->new_function(m_captures->cells(stmnt));
         m_scopes->new_scope();
         for (auto &param: stmnt->get_params()) {
             m_scopes->declare(param->name, param->span, true, false);
-        }
 
-        bool is_expr = !instanceof<Block>(stmnt->get_body().get());
+            auto var = m_scopes->get(param->name).value();
+            if (m_scopes->is_cell(var)) generator.m_cell_params.push_back(m_scopes->get_slot(var));
+        }
 
-        auto code = generator.generate_code(stmnt->get_body(), stmnt->can_error(), !is_expr);
+        auto code = generator.generate_code(stmnt->get_body(), stmnt->can_error(), f_generation);
 
-        if (is_expr) {
+        if (!instanceof<Block>(stmnt->get_body().get())) {
             code->add_ins(Opcode::RETURN, stmnt->get_span());
         }
 
-        generator.m_in_function = false;
-
         m_scopes->end_scope();
-        m_in_function = false;
+        finish_function(code);
 
-        return Runtime::ins()->make_function(stmnt->get_name(), stmnt->get_params(), code);
+        register_code(stmnt, code);
+        return code;
+    }
+
+    void CodeGenerator::register_code(FuncDef *stmnt, const GcPtr<Code> &code) {
+        if (!m_ctx->get_register_vm() or m_ctx->has_error()) return;
+        code->set_register_code(RegisterGenerator(m_ctx, code).generate(stmnt));
     }
 
     GcPtr<Code> CodeGenerator::generate_code(const std::shared_ptr<Node> &node, bool can_error, bool f_generation) {
         try {
             m_code = Runtime::ins()->make_code();
+
+            // captured parameters are moved into cells before the body runs
+            for (auto slot: m_cell_params) {
+                m_code->add_ins(Opcode::LOAD_FAST, slot, node->get_span());
+                m_code->add_ins(Opcode::CREATE_CELL, slot, node->get_span());
+            }
             node->accept(this);
             if (f_generation) {
                 finish_generation(can_error);
@@ -388,8 +551,28 @@ namespace bond {
     }
 
     void CodeGenerator::visit(Return *stmnt) {
+        // a return in a body being inlined leaves its value on the stack and jumps past the body
+        if (!m_inline_exits.empty()) {
+            if (stmnt->get_expr().get() == nullptr) {
+                m_code->add_ins(Opcode::PUSH_NIL, stmnt->get_span());
+            } else {
+                stmnt->get_expr()->accept(this);
+            }
+            m_inline_exits.back().push_back(m_code->add_jump(Opcode::JUMP, stmnt->get_span()));
+            return;
+        }
+
         if (stmnt->get_expr().get() == nullptr) {
             m_code->add_ins(Opcode::PUSH_NIL, stmnt->get_span());
+        } else if (auto call = dynamic_cast<Call *>(stmnt->get_expr().get())) {
+            // a call in tail position, the RETURN only runs when the callee is not a script function
+            if (!inline_call(call)) {
+                call->get_expr()->accept(this);
+                for (auto &e: call->get_args()) {
+                    e->accept(this);
+                }
+                m_code->add_ins(Opcode::TAIL_CALL, call->get_args().size(), call->get_span());
+            }
         } else {
             stmnt->get_expr()->accept(this);
         }
@@ -401,16 +584,13 @@ namespace bond {
         bool prev = m_in_closure;
         m_in_closure = true;
 
-        //FIXME: for now copy all locals from parent scope
         auto func = create_function(stmnt->get_func_def().get());
         auto idx = m_code->add_constant(func);
+        m_code->add_ins(Opcode::CREATE_CLOSURE, idx, stmnt->get_span());
 
-        if (stmnt->is_expression()) {
-            m_code->add_ins(Opcode::CREATE_CLOSURE_EX, idx, stmnt->get_span());
-        }
-        else {
+        if (!stmnt->is_expression()) {
             m_scopes->declare(stmnt->get_name(), stmnt->get_span(), false, false);
-            m_code->add_ins(Opcode::CREATE_CLOSURE, idx, stmnt->get_span());
+            declare_local(stmnt->get_name(), stmnt->get_span());
         }
 
         m_in_closure = prev;
@@ -434,18 +614,26 @@ namespace bond {
         }
 
         m_code->add_ins(Opcode::CREATE_STRUCT, idx, stmnt->get_span());
-        auto struct_idx = m_code->add_constant(Runtime::ins()->make_string_cache(stmnt->get_name()));
 
         if (var.has_value()) {
+            auto struct_idx = m_code->add_constant(Runtime::ins()->make_string_cache(stmnt->get_name()));
             m_code->add_ins(Opcode::CREATE_GLOBAL, struct_idx, stmnt->get_span());
             return;
         }
-        m_code->add_ins(Opcode::STORE_FAST, struct_idx, stmnt->get_span());
+
+        m_scopes->declare(stmnt->get_name(), stmnt->get_span(), false, false);
+        declare_local(stmnt->get_name(), stmnt->get_span());
     }
 
     void CodeGenerator::visit(GetAttribute *expr) {
-        expr->get_expr()->accept(this);
         auto name = m_code->add_constant(Runtime::ins()->make_string_cache(expr->get_name()));
+
+        if (auto slot = local_slot(expr->get_expr())) {
+            m_code->add_ins(Opcode::LOAD_FAST_ATTR, *slot, name, expr->get_span());
+            return;
+        }
+
+        expr->get_expr()->accept(this);
         m_code->add_ins(Opcode::GET_ATTRIBUTE, name, expr->get_span());
     }
 
@@ -481,21 +669,19 @@ namespace bond {
 
     void CodeGenerator::visit(Try *stmnt) {
         stmnt->get_expr()->accept(this);
-        auto next = m_code->current_index() + 3;
-        m_code->add_ins(Opcode::TRY, next, stmnt->get_span());
+        auto next = m_code->add_jump(Opcode::TRY, stmnt->get_span());
         m_code->add_ins(Opcode::RETURN, stmnt->get_span());
+        m_code->patch_code(next, m_code->current_index());
 
     }
 
     void CodeGenerator::visit(Break *stmnt) {
-        auto next = m_code->current_index() + 1;
-        m_code->add_ins(Opcode::BREAK, next, stmnt->get_span());
+        auto next = m_code->add_jump(Opcode::BREAK, stmnt->get_span());
         m_break_stack.back().push_back(next);
     }
 
     void CodeGenerator::visit(Continue *stmnt) {
-        auto next = m_code->current_index() + 1;
-        m_code->add_ins(Opcode::CONTINUE, next, stmnt->get_span());
+        auto next = m_code->add_jump(Opcode::CONTINUE, stmnt->get_span());
         m_continue_stack.back().push_back(next);
     }
 
@@ -543,18 +729,14 @@ namespace bond {
         m_code->add_ins(Opcode::UNPACK_SEQ, targets.size(), stmnt->get_span());
 
         for (auto &[name, is_global]: std::ranges::reverse_view(targets)) {
-            auto idx = m_code->add_constant(Runtime::ins()->make_string_cache(name));
-
             if (is_global) {
+                auto idx = m_code->add_constant(Runtime::ins()->make_string_cache(name));
                 m_code->add_ins(Opcode::CREATE_GLOBAL, idx, stmnt->get_span());
             } else {
                 // TODO: this might be safe to do as the parser should have already
                 //  checked that the name is not already declared
-                // we do this for local variables as we did not keep track of the
-                // local variables in the scope
-                // in the future we should keep track of the local variables
                 m_scopes->declare(name, stmnt->get_span(), true);
-                m_code->add_ins(Opcode::CREATE_LOCAL, idx, stmnt->get_span());
+                declare_local(name, stmnt->get_span());
             }
 
         }
@@ -572,7 +754,7 @@ namespace bond {
             arg->accept(this);
         }
 
-        m_code->add_ins(Opcode::CALL_METHOD, expr->get_args().size(), expr->get_span());
+        m_code->add_ins(Opcode::CALL_METHOD, expr->get_args().size(), m_code->add_method_cache(), expr->get_span());
     }
 
     void CodeGenerator::visit(ResultStatement *expr) {
@@ -7,7 +7,10 @@
 
 #include "nodevisitor.h"
 #include "ast.h"
+#include "captures.h"
+#include "inliner.h"
 #include <cstdint>
+#include <memory>
 #include <vector>
 // #include "vm.h"
 #include "../object.h"
@@ -107,16 +110,52 @@ namespace bond {
 
         void finish_generation(bool can_error);
 
+        // gives code the locals and captures of the function scope it was compiled in
+        void finish_function(const GcPtr<Code> &code);
+
+        // compiles the parameters and body of a function into a new code object
+        GcPtr<Code> function_code(FuncDef *stmnt, bool f_generation);
+
+        // parameter slots that closures capture
+        std::vector<uint32_t> m_cell_params;
+
+        // pops the value on top of the stack into an already declared local
+        void declare_local(const std::string &name, const SharedSpan &span);
+
         GcPtr<Function> create_function(FuncDef *stmnt);
 
+        // gives code the register form of the function as well, when the context asks for it
+        void register_code(FuncDef *stmnt, const GcPtr<Code> &code);
+
         std::vector<std::vector<uint32_t>> m_break_stack;
         std::vector<std::vector<uint32_t>> m_continue_stack;
 
+        // functions of the module being compiled that calls are inlined to, shared with the
+        // generators of nested functions
+        std::shared_ptr<Inliner> m_inliner;
+        // the locals of each function of the module that live in cells, shared like m_inliner
+        std::shared_ptr<Captures> m_captures;
+        // jumps from the returns of each function body being inlined to its end
+        std::vector<std::vector<uint32_t>> m_inline_exits;
+
+        // compiles a call of a small module function as its body, false when it cannot be
+        bool inline_call(Call *expr);
+
         void start_loop();
 
         void finish_loop(uint32_t loop_end, uint32_t loop_start);
 
         void func_def(FuncDef *stmnt, bool is_async);
+
+        // slot of node when it names a local variable that is not in a cell
+        std::optional<uint32_t> local_slot(const SharedNode &node);
+
+        // pushes both operands, two locals are loaded by a single LOAD_FAST_LOAD_FAST
+        void binary_operands(BinaryOp *expr);
+
+        // emits a jump taken when condition is false, returns the offset of its target to patch.
+        // comparisons jump directly with COMPARE_AND_JUMP
+        uint32_t jump_if_false(const SharedNode &condition, const SharedSpan &span);
     };
 
 } // bond
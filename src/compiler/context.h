@@ -52,11 +52,49 @@ namespace bond {
 
         void add_module(std::string const &path, const GcPtr<GcObject> &module) { m_compiled_modules[path] = module; }
 
+        // how hard the optimizer works on code generated in this context, 0 turns it off
+        void set_optimize_level(uint32_t level) { m_optimize_level = level; }
+
+        [[nodiscard]] uint32_t get_optimize_level() const { return m_optimize_level; }
+
+        // lets vms created in this context compile hot code to machine code, see jit/jit.h
+        void set_jit(bool enabled) { m_jit = enabled; }
+
+        [[nodiscard]] bool get_jit() const { return m_jit; }
+
+        // lets vms created in this context trace hot loops and compile the traces
+        void set_trace(bool enabled) { m_trace = enabled; }
+
+        [[nodiscard]] bool get_trace() const { return m_trace; }
+
+        // set once a module compiled ahead of time is loaded, vms created in this context then
+        // run the native code it supplied, see core/aot.h
+        void set_aot(bool enabled) { m_aot = enabled; }
+
+        [[nodiscard]] bool get_aot() const { return m_aot; }
+
+        // generates register code for functions next to their stack bytecode and runs them on
+        // the register backend, see compiler/regcodegen.h
+        void set_register_vm(bool enabled) { m_register_vm = enabled; }
+
+        [[nodiscard]] bool get_register_vm() const { return m_register_vm; }
+
+        // times a code object is entered, or a loop goes round, before the jit compiles it
+        void set_jit_threshold(uint32_t threshold) { m_jit_threshold = threshold; }
+
+        [[nodiscard]] uint32_t get_jit_threshold() const { return m_jit_threshold; }
+
 
     private:
         std::unordered_map<uint32_t, std::string> m_modules;
         c_map m_compiled_modules;
         bool m_has_error = false;
+        uint32_t m_optimize_level = 1;
+        bool m_jit = false;
+        bool m_trace = false;
+        bool m_aot = false;
+        bool m_register_vm = false;
+        uint32_t m_jit_threshold = 1000;
         std::string m_lib_path;
         std::vector<std::string, gc_allocator<std::string>> m_args;
     };
@@ -0,0 +1,390 @@
+//
+// constant folding, see folder.h
+//
+
+#include "folder.h"
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <fmt/core.h>
+#include <variant>
+
+namespace bond {
+    using Constant = std::variant<int64_t, double, bool, std::string>;
+
+    // number literals are read the way codegen reads them so folding sees the values the vm would
+    static std::optional<Constant> constant_of(Node *node) {
+        if (auto number = dynamic_cast<NumberLiteral *>(node)) {
+            if (number->is_int()) return std::stoll(number->get_value());
+            if (number->is_exact()) return std::stod(number->get_value());
+            return static_cast<double>(std::stof(number->get_value()));
+        }
+        if (auto string = dynamic_cast<StringLiteral *>(node)) return string->get_value();
+        if (dynamic_cast<TrueLiteral *>(node)) return true;
+        if (dynamic_cast<FalseLiteral *>(node)) return false;
+        return std::nullopt;
+    }
+
+    static std::optional<bool> bool_of(Node *node) {
+        auto constant = constant_of(node);
+        if (!constant.has_value() or !std::holds_alternative<bool>(*constant)) return std::nullopt;
+        return std::get<bool>(*constant);
+    }
+
+    static SharedNode make_literal(const SharedSpan &span, const Constant &constant) {
+        if (auto i = std::get_if<int64_t>(&constant)) {
+            return std::make_shared<NumberLiteral>(span, fmt::format("{}", *i), true);
+        }
+        if (auto f = std::get_if<double>(&constant)) {
+            return std::make_shared<NumberLiteral>(span, fmt::format("{}", *f), false, true);
+        }
+        if (auto b = std::get_if<bool>(&constant)) {
+            if (*b) return std::make_shared<TrueLiteral>(span);
+            return std::make_shared<FalseLiteral>(span);
+        }
+        return std::make_shared<StringLiteral>(span, std::get<std::string>(constant));
+    }
+
+    template<typename T>
+    static std::optional<Constant> compare(TokenType type, T l, T r) {
+        switch (type) {
+            case TokenType::EQUAL_EQUAL:
+                return l == r;
+            case TokenType::BANG_EQUAL:
+                return l != r;
+            case TokenType::LESS:
+                return l < r;
+            case TokenType::LESS_EQUAL:
+                return l <= r;
+            case TokenType::GREATER:
+                return l > r;
+            case TokenType::GREATER_EQUAL:
+                return l >= r;
+            default:
+                return std::nullopt;
+        }
+    }
+
+    // overflow and division by zero are left for the vm to handle
+    static std::optional<Constant> fold_int(TokenType type, int64_t l, int64_t r) {
+        constexpr auto max = std::numeric_limits<int64_t>::max();
+        constexpr auto min = std::numeric_limits<int64_t>::min();
+
+        switch (type) {
+            case TokenType::PLUS:
+                if ((r > 0 and l > max - r) or (r < 0 and l < min - r)) return std::nullopt;
+                return l + r;
+            case TokenType::MINUS:
+                if ((r < 0 and l > max + r) or (r > 0 and l < min + r)) return std::nullopt;
+                return l - r;
+            case TokenType::STAR:
+                // a double product this far inside the range cannot have overflowed
+                if (std::abs(static_cast<double>(l) * static_cast<double>(r)) >= 9.2e18) return std::nullopt;
+                return l * r;
+            case TokenType::SLASH:
+                if (r == 0 or (r == -1 and l == min)) return std::nullopt;
+                return l / r;
+            case TokenType::MOD:
+                if (r == 0 or (r == -1 and l == min)) return std::nullopt;
+                return l % r;
+            case TokenType::BITWISE_OR:
+                return l | r;
+            case TokenType::BITWISE_AND:
+                return l & r;
+            case TokenType::BITWISE_XOR:
+                return l ^ r;
+            default:
+                return compare(type, l, r);
+        }
+    }
+
+    static std::optional<Constant> fold_float(TokenType type, double l, double r) {
+        double result;
+
+        switch (type) {
+            case TokenType::PLUS:
+                result = l + r;
+                break;
+            case TokenType::MINUS:
+                result = l - r;
+                break;
+            case TokenType::STAR:
+                result = l * r;
+                break;
+            case TokenType::SLASH:
+                if (r == 0) return std::nullopt;
+                result = l / r;
+                break;
+            default:
+                return compare(type, l, r);
+        }
+
+        if (!std::isfinite(result)) return std::nullopt;
+        return result;
+    }
+
+    static std::optional<Constant> fold_binary(TokenType type, const Constant &left, const Constant &right) {
+        auto number = [](const Constant &c) -> std::optional<double> {
+            if (auto i = std::get_if<int64_t>(&c)) return static_cast<double>(*i);
+            if (auto f = std::get_if<double>(&c)) return *f;
+            return std::nullopt;
+        };
+
+        if (std::holds_alternative<int64_t>(left) and std::holds_alternative<int64_t>(right)) {
+            return fold_int(type, std::get<int64_t>(left), std::get<int64_t>(right));
+        }
+
+        // the vm has no modulo or bitwise operators on floats
+        auto l = number(left);
+        auto r = number(right);
+        if (l.has_value() and r.has_value()) {
+            if (type == TokenType::MOD or type == TokenType::BITWISE_OR or type == TokenType::BITWISE_AND or
+                type == TokenType::BITWISE_XOR)
+                return std::nullopt;
+            return fold_float(type, *l, *r);
+        }
+
+        if (std::holds_alternative<std::string>(left) and std::holds_alternative<std::string>(right)) {
+            auto &ls = std::get<std::string>(left);
+            auto &rs = std::get<std::string>(right);
+            switch (type) {
+                case TokenType::PLUS:
+                    return fmt::format("{}{}", ls.c_str(), rs.c_str());
+                case TokenType::EQUAL_EQUAL:
+                    return ls == rs;
+                case TokenType::BANG_EQUAL:
+                    return ls != rs;
+                default:
+                    return std::nullopt;
+            }
+        }
+
+        if (std::holds_alternative<bool>(left) and std::holds_alternative<bool>(right)) {
+            auto lb = std::get<bool>(left);
+            auto rb = std::get<bool>(right);
+            switch (type) {
+                case TokenType::EQUAL_EQUAL:
+                    return lb == rb;
+                case TokenType::BANG_EQUAL:
+                    return lb != rb;
+                case TokenType::AND:
+                    return lb and rb;
+                case TokenType::OR:
+                    return lb or rb;
+                default:
+                    return std::nullopt;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    // a literal on the left of and/or decides which side the vm pushes, whatever the right is
+    static SharedNode simplify_binary(BinaryOp *expr) {
+        auto left = bool_of(expr->get_left().get());
+        if (!left.has_value()) return nullptr;
+
+        switch (expr->get_op().get_type()) {
+            case TokenType::AND:
+                return *left ? expr->get_right() : nullptr;
+            case TokenType::OR:
+                return *left ? nullptr : expr->get_right();
+            default:
+                return nullptr;
+        }
+    }
+
+    std::vector<SharedNode> ConstantFolder::fold(const std::vector<SharedNode> &nodes) {
+        return fold_all(nodes);
+    }
+
+    SharedNode ConstantFolder::fold(const SharedNode &node) {
+        if (!node) return node;
+
+        m_result = nullptr;
+        node->accept(this);
+
+        auto result = m_result ? m_result : node;
+        m_result = nullptr;
+        return result;
+    }
+
+    std::vector<SharedNode> ConstantFolder::fold_all(const std::vector<SharedNode> &nodes) {
+        std::vector<SharedNode> folded;
+        folded.reserve(nodes.size());
+        for (auto &node: nodes) {
+            folded.push_back(fold(node));
+        }
+        return folded;
+    }
+
+    void ConstantFolder::visit(BinaryOp *expr) {
+        expr->set_left(fold(expr->get_left()));
+        expr->set_right(fold(expr->get_right()));
+
+        auto left = constant_of(expr->get_left().get());
+        auto right = constant_of(expr->get_right().get());
+
+        if (left.has_value() and right.has_value()) {
+            if (auto value = fold_binary(expr->get_op().get_type(), *left, *right)) {
+                m_result = make_literal(expr->get_span(), *value);
+                return;
+            }
+        }
+
+        m_result = simplify_binary(expr);
+    }
+
+    void ConstantFolder::visit(Unary *expr) {
+        expr->set_expr(fold(expr->get_expr()));
+        auto operand = expr->get_expr();
+
+        if (expr->get_op().get_type() == TokenType::BANG) {
+            if (auto value = bool_of(operand.get())) {
+                m_result = make_literal(expr->get_span(), !*value);
+            }
+            return;
+        }
+
+        if (expr->get_op().get_type() != TokenType::MINUS) return;
+
+        auto value = constant_of(operand.get());
+        if (!value.has_value()) return;
+
+        if (auto i = std::get_if<int64_t>(&*value); i and *i != std::numeric_limits<int64_t>::min()) {
+            m_result = make_literal(expr->get_span(), -*i);
+        } else if (auto f = std::get_if<double>(&*value)) {
+            m_result = make_literal(expr->get_span(), -*f);
+        }
+    }
+
+    void ConstantFolder::visit(ExprStmnt *stmnt) {
+        stmnt->set_expr(fold(stmnt->get_expr()));
+    }
+
+    void ConstantFolder::visit(NewVar *stmnt) {
+        stmnt->set_expr(fold(stmnt->get_expr()));
+    }
+
+    void ConstantFolder::visit(Assign *stmnt) {
+        stmnt->set_expr(fold(stmnt->get_expr()));
+    }
+
+    void ConstantFolder::visit(Block *stmnt) {
+        stmnt->set_nodes(fold_all(stmnt->get_nodes()));
+    }
+
+    void ConstantFolder::visit(ListLiteral *expr) {
+        expr->set_nodes(fold_all(expr->get_nodes()));
+    }
+
+    void ConstantFolder::visit(GetItem *expr) {
+        expr->set_expr(fold(expr->get_expr()));
+        expr->set_index(fold(expr->get_index()));
+    }
+
+    void ConstantFolder::visit(SetItem *expr) {
+        expr->set_expr(fold(expr->get_expr()));
+        expr->set_index(fold(expr->get_index()));
+        expr->set_value(fold(expr->get_value()));
+    }
+
+    void ConstantFolder::visit(If *stmnt) {
+        stmnt->set_condition(fold(stmnt->get_condition()));
+        stmnt->set_then(fold(stmnt->get_then()));
+        if (stmnt->get_else().has_value()) {
+            stmnt->set_else(fold(stmnt->get_else().value()));
+        }
+
+        auto condition = bool_of(stmnt->get_condition().get());
+        if (!condition.has_value()) return;
+
+        if (*condition) {
+            m_result = stmnt->get_then();
+        } else if (stmnt->get_else().has_value()) {
+            m_result = stmnt->get_else().value();
+        } else {
+            m_result = std::make_shared<Block>(stmnt->get_span(), std::vector<SharedNode>{});
+        }
+    }
+
+    void ConstantFolder::visit(While *stmnt) {
+        stmnt->set_condition(fold(stmnt->get_condition()));
+        stmnt->set_statement(fold(stmnt->get_statement()));
+
+        if (bool_of(stmnt->get_condition().get()) == false) {
+            m_result = std::make_shared<Block>(stmnt->get_span(), std::vector<SharedNode>{});
+        }
+    }
+
+    void ConstantFolder::visit(Call *expr) {
+        expr->set_expr(fold(expr->get_expr()));
+        expr->set_args(fold_all(expr->get_args()));
+    }
+
+    void ConstantFolder::visit(For *stmnt) {
+        stmnt->set_expr(fold(stmnt->get_expr()));
+        stmnt->set_statement(fold(stmnt->get_statement()));
+    }
+
+    void ConstantFolder::visit(FuncDef *stmnt) {
+        stmnt->set_body(fold(stmnt->get_body()));
+    }
+
+    void ConstantFolder::visit(Return *stmnt) {
+        stmnt->set_expr(fold(stmnt->get_expr()));
+    }
+
+    void ConstantFolder::visit(ClosureDef *stmnt) {
+        fold(stmnt->get_func_def());
+    }
+
+    void ConstantFolder::visit(StructNode *stmnt) {
+        for (auto &method: stmnt->get_methods()) {
+            fold(method);
+        }
+    }
+
+    void ConstantFolder::visit(GetAttribute *expr) {
+        expr->set_expr(fold(expr->get_expr()));
+    }
+
+    void ConstantFolder::visit(SetAttribute *expr) {
+        expr->set_expr(fold(expr->get_expr()));
+        expr->set_value(fold(expr->get_value()));
+    }
+
+    void ConstantFolder::visit(Try *stmnt) {
+        stmnt->set_expr(fold(stmnt->get_expr()));
+    }
+
+    void ConstantFolder::visit(AsyncDef *stmnt) {
+        fold(stmnt->get_function());
+    }
+
+    void ConstantFolder::visit(Await *expr) {
+        expr->set_expr(fold(expr->get_expr()));
+    }
+
+    void ConstantFolder::visit(StructuredAssign *stmnt) {
+        stmnt->set_value(fold(stmnt->get_value()));
+    }
+
+    void ConstantFolder::visit(CallMethod *expr) {
+        fold(expr->get_node());
+        expr->set_args(fold_all(expr->get_args()));
+    }
+
+    void ConstantFolder::visit(ResultStatement *expr) {
+        expr->set_expr(fold(expr->get_expr()));
+    }
+
+    void ConstantFolder::visit(DictLiteral *expr) {
+        auto pairs = expr->get_pairs();
+        for (auto &[key, value]: pairs) {
+            key = fold(key);
+            value = fold(value);
+        }
+        expr->set_pairs(pairs);
+    }
+}
@@ -0,0 +1,101 @@
+//
+// constant folding, rewrites the syntax tree before codegen
+//
+
+#ifndef BOND_FOLDER_H
+#define BOND_FOLDER_H
+
+#include "ast.h"
+#include "nodevisitor.h"
+#include <vector>
+
+namespace bond {
+    // folds operators on literals into literals, reduces and/or with a literal on the left to
+    // the side the vm would push, and prunes branches whose condition is a literal. nothing that
+    // could fail or have side effects at runtime is folded away
+    class ConstantFolder : public NodeVisitor {
+    public:
+        std::vector<SharedNode> fold(const std::vector<SharedNode> &nodes);
+
+        // the node to compile in place of node, children are folded in place
+        SharedNode fold(const SharedNode &node);
+
+        void visit(BinaryOp *expr) override;
+
+        void visit(Unary *expr) override;
+
+        void visit(TrueLiteral *expr) override {}
+
+        void visit(FalseLiteral *expr) override {}
+
+        void visit(NumberLiteral *expr) override {}
+
+        void visit(StringLiteral *expr) override {}
+
+        void visit(NilLiteral *expr) override {}
+
+        void visit(ExprStmnt *stmnt) override;
+
+        void visit(Identifier *expr) override {}
+
+        void visit(NewVar *stmnt) override;
+
+        void visit(Assign *stmnt) override;
+
+        void visit(Block *stmnt) override;
+
+        void visit(ListLiteral *expr) override;
+
+        void visit(GetItem *expr) override;
+
+        void visit(SetItem *expr) override;
+
+        void visit(If *stmnt) override;
+
+        void visit(While *stmnt) override;
+
+        void visit(Call *expr) override;
+
+        void visit(For *stmnt) override;
+
+        void visit(FuncDef *stmnt) override;
+
+        void visit(Return *stmnt) override;
+
+        void visit(ClosureDef *stmnt) override;
+
+        void visit(StructNode *stmnt) override;
+
+        void visit(GetAttribute *expr) override;
+
+        void visit(SetAttribute *expr) override;
+
+        void visit(ImportDef *stmnt) override {}
+
+        void visit(Try *stmnt) override;
+
+        void visit(Break *stmnt) override {}
+
+        void visit(Continue *stmnt) override {}
+
+        void visit(AsyncDef *stmnt) override;
+
+        void visit(Await *expr) override;
+
+        void visit(StructuredAssign *stmnt) override;
+
+        void visit(CallMethod *expr) override;
+
+        void visit(ResultStatement *expr) override;
+
+        void visit(DictLiteral *expr) override;
+
+    private:
+        // set by a visit when the visited node is replaced
+        SharedNode m_result;
+
+        std::vector<SharedNode> fold_all(const std::vector<SharedNode> &nodes);
+    };
+}
+
+#endif //BOND_FOLDER_H
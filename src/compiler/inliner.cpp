@@ -0,0 +1,184 @@
+//
+// picks the functions the code generator inlines, see inliner.h
+//
+
+#include "inliner.h"
+#include "nodevisitor.h"
+#include <unordered_set>
+
+namespace bond {
+    // walks a syntax tree, counting its nodes, noting the names assigned to and whether it
+    // holds anything an inlined body cannot
+    class InlineScanner : public NodeVisitor {
+    public:
+        size_t size = 0;
+        // no loops, nested functions, imports, try or await
+        bool straight = true;
+        std::unordered_set<std::string> assigned;
+
+        void scan(const SharedNode &node) {
+            if (!node) return;
+            size++;
+            node->accept(this);
+        }
+
+        void scan(const std::vector<SharedNode> &nodes) {
+            for (auto &node: nodes) scan(node);
+        }
+
+        void visit(BinaryOp *expr) override {
+            scan(expr->get_left());
+            scan(expr->get_right());
+        }
+
+        void visit(Unary *expr) override { scan(expr->get_expr()); }
+
+        void visit(TrueLiteral *expr) override {}
+
+        void visit(FalseLiteral *expr) override {}
+
+        void visit(NumberLiteral *expr) override {}
+
+        void visit(StringLiteral *expr) override {}
+
+        void visit(NilLiteral *expr) override {}
+
+        void visit(ExprStmnt *stmnt) override { scan(stmnt->get_expr()); }
+
+        void visit(Identifier *expr) override {}
+
+        void visit(NewVar *stmnt) override { scan(stmnt->get_expr()); }
+
+        void visit(Assign *stmnt) override {
+            assigned.insert(stmnt->get_name());
+            scan(stmnt->get_expr());
+        }
+
+        void visit(Block *stmnt) override { scan(stmnt->get_nodes()); }
+
+        void visit(ListLiteral *expr) override { scan(expr->get_nodes()); }
+
+        void visit(GetItem *expr) override {
+            scan(expr->get_expr());
+            scan(expr->get_index());
+        }
+
+        void visit(SetItem *expr) override {
+            scan(expr->get_expr());
+            scan(expr->get_index());
+            scan(expr->get_value());
+        }
+
+        void visit(If *stmnt) override {
+            scan(stmnt->get_condition());
+            scan(stmnt->get_then());
+            if (stmnt->get_else().has_value()) scan(stmnt->get_else().value());
+        }
+
+        void visit(While *stmnt) override {
+            straight = false;
+            scan(stmnt->get_condition());
+            scan(stmnt->get_statement());
+        }
+
+        void visit(Call *expr) override {
+            scan(expr->get_expr());
+            scan(expr->get_args());
+        }
+
+        void visit(For *stmnt) override {
+            straight = false;
+            scan(stmnt->get_expr());
+            scan(stmnt->get_statement());
+        }
+
+        void visit(FuncDef *stmnt) override {
+            straight = false;
+            scan(stmnt->get_body());
+        }
+
+        void visit(Return *stmnt) override { scan(stmnt->get_expr()); }
+
+        void visit(ClosureDef *stmnt) override {
+            straight = false;
+            scan(stmnt->get_func_def());
+        }
+
+        void visit(StructNode *stmnt) override {
+            straight = false;
+            scan(stmnt->get_methods());
+        }
+
+        void visit(GetAttribute *expr) override { scan(expr->get_expr()); }
+
+        void visit(SetAttribute *expr) override {
+            scan(expr->get_expr());
+            scan(expr->get_value());
+        }
+
+        void visit(ImportDef *stmnt) override { straight = false; }
+
+        // try returns from the function it is in
+        void visit(Try *stmnt) override {
+            straight = false;
+            scan(stmnt->get_expr());
+        }
+
+        void visit(Break *stmnt) override { straight = false; }
+
+        void visit(Continue *stmnt) override { straight = false; }
+
+        void visit(AsyncDef *stmnt) override {
+            straight = false;
+            scan(stmnt->get_function());
+        }
+
+        void visit(Await *expr) override {
+            straight = false;
+            scan(expr->get_expr());
+        }
+
+        void visit(StructuredAssign *stmnt) override {
+            straight = false;
+            for (auto &target: stmnt->get_targets()) {
+                if (auto identifier = dynamic_cast<Identifier *>(target.get())) assigned.insert(identifier->get_name());
+            }
+            scan(stmnt->get_value());
+        }
+
+        void visit(CallMethod *expr) override {
+            scan(expr->get_node());
+            scan(expr->get_args());
+        }
+
+        void visit(ResultStatement *expr) override { scan(expr->get_expr()); }
+
+        void visit(DictLiteral *expr) override {
+            for (auto &[key, value]: expr->get_pairs()) {
+                scan(key);
+                scan(value);
+            }
+        }
+    };
+
+    Inliner::Inliner(const std::vector<SharedNode> &nodes) {
+        InlineScanner module;
+        module.scan(nodes);
+
+        for (auto &node: nodes) {
+            auto function = std::dynamic_pointer_cast<FuncDef>(node);
+            // functions returning a Result wrap what they return, which an inlined body does not
+            if (!function or function->can_error() or module.assigned.contains(function->get_name())) continue;
+
+            InlineScanner body;
+            body.scan(function->get_body());
+            if (body.straight and body.size <= MAX_INLINE_SIZE) m_functions[function->get_name()] = function;
+        }
+    }
+
+    std::shared_ptr<FuncDef> Inliner::find(const std::string &name, size_t arg_count) const {
+        auto function = m_functions.find(name);
+        if (function == m_functions.end() or function->second->get_params().size() != arg_count) return nullptr;
+        return function->second;
+    }
+}
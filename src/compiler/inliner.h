@@ -0,0 +1,33 @@
+//
+// picks the functions the code generator inlines at their call sites
+//
+
+#ifndef BOND_INLINER_H
+#define BOND_INLINER_H
+
+#include "ast.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bond {
+    // the most syntax tree nodes the body of an inlined function may have
+    constexpr size_t MAX_INLINE_SIZE = 24;
+
+    class Inliner {
+    public:
+        // collects the top level functions of a module whose body is small and straight line
+        // code that only returns, branches and evaluates expressions, and whose name is never
+        // assigned to
+        explicit Inliner(const std::vector<SharedNode> &nodes);
+
+        // the function a call of name with arg_count arguments can be replaced by
+        std::shared_ptr<FuncDef> find(const std::string &name, size_t arg_count) const;
+
+    private:
+        std::unordered_map<std::string, std::shared_ptr<FuncDef>> m_functions;
+    };
+}
+
+#endif //BOND_INLINER_H
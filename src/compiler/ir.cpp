@@ -0,0 +1,739 @@
+//
+// ssa form of a code object, see ir.h
+//
+
+#include "ir.h"
+#include <algorithm>
+
+namespace bond::ir {
+    // values a generic instruction pops and pushes, nothing for instructions the ir does not
+    // model and those simulate handles itself
+    static std::optional<std::pair<uint32_t, uint32_t>> stack_use(Opcode opcode, uint32_t oprand) {
+        switch (opcode) {
+            case Opcode::LOAD_CONST:
+            case Opcode::PUSH_TRUE:
+            case Opcode::PUSH_FALSE:
+            case Opcode::PUSH_NIL:
+            case Opcode::LOAD_GLOBAL:
+            case Opcode::CREATE_FUNCTION:
+            case Opcode::CREATE_STRUCT:
+                return std::pair{0, 1};
+            case Opcode::BIN_ADD:
+            case Opcode::BIN_SUB:
+            case Opcode::BIN_MUL:
+            case Opcode::BIN_DIV:
+            case Opcode::BIN_MOD:
+            case Opcode::NE:
+            case Opcode::EQ:
+            case Opcode::LE:
+            case Opcode::GT:
+            case Opcode::GE:
+            case Opcode::LT:
+            case Opcode::OR:
+            case Opcode::AND:
+            case Opcode::BIT_OR:
+            case Opcode::BIT_AND:
+            case Opcode::BIT_XOR:
+            case Opcode::GET_ITEM:
+            case Opcode::SET_ATTRIBUTE:
+                return std::pair{2, 1};
+            case Opcode::NOT:
+            case Opcode::UNARY_SUB:
+            case Opcode::GET_ATTRIBUTE:
+            case Opcode::ITER:
+            case Opcode::TRY:
+            case Opcode::MAKE_OK:
+            case Opcode::MAKE_ERROR:
+            case Opcode::STORE_GLOBAL:
+                return std::pair{1, 1};
+            case Opcode::SET_ITEM:
+                return std::pair{3, 1};
+            case Opcode::RETURN:
+            case Opcode::POP_TOP:
+            case Opcode::CREATE_GLOBAL:
+            case Opcode::JUMP_IF_FALSE:
+            case Opcode::IMPORT:
+            case Opcode::IMPORT_PRE_COMPILED:
+                return std::pair{1, 0};
+            case Opcode::JUMP:
+            case Opcode::BREAK:
+            case Opcode::CONTINUE:
+                return std::pair{0, 0};
+            case Opcode::BUILD_LIST:
+                return std::pair{oprand, 1};
+            case Opcode::BUILD_DICT:
+                return std::pair{2 * oprand, 1};
+            case Opcode::CALL:
+            case Opcode::TAIL_CALL:
+                return std::pair{oprand + 1, 1};
+            case Opcode::CALL_METHOD:
+                return std::pair{oprand + 2, 1};
+            default:
+                return std::nullopt;
+        }
+    }
+
+    static bool ends_block(Opcode opcode) {
+        return is_jump(opcode) or opcode == Opcode::RETURN;
+    }
+
+    static bool falls_through(Opcode opcode) {
+        return opcode != Opcode::RETURN and opcode != Opcode::JUMP and opcode != Opcode::BREAK and
+               opcode != Opcode::CONTINUE;
+    }
+
+    static bool is_number(Type type) {
+        return type == Type::Int or type == Type::Float or type == Type::Number;
+    }
+
+    // types whose operators are native code
+    static bool is_builtin(Type type) {
+        return type != Type::Unset and type != Type::Unknown;
+    }
+
+    static Type join(Type a, Type b) {
+        if (a == Type::Unset) return b;
+        if (b == Type::Unset or a == b) return a;
+        if (is_number(a) and is_number(b)) return Type::Number;
+        return Type::Unknown;
+    }
+
+    std::optional<Graph> Graph::build(const std::vector<Instruction> &instructions, const GcPtr<Code> &code,
+                                      uint32_t local_count) {
+        Graph graph;
+        graph.m_constants = code->get_constants();
+        graph.m_local_count = local_count;
+
+        if (instructions.empty() or !graph.split_blocks(instructions)) return std::nullopt;
+        if (!graph.simulate(instructions)) return std::nullopt;
+
+        graph.remove_trivial_phis();
+        graph.compute_dominators();
+        graph.infer_types();
+        return graph;
+    }
+
+    ValueId Graph::new_value(Value::Kind kind, uint32_t block, uint32_t node) {
+        m_values.push_back({kind, block, node});
+        m_alias.push_back(NONE);
+        return (ValueId) m_values.size() - 1;
+    }
+
+    uint32_t Graph::add_block() {
+        m_blocks.emplace_back();
+        return (uint32_t) m_blocks.size() - 1;
+    }
+
+    // block 0 is an empty entry block so the first real block can be a loop header, block i + 1
+    // starts at the i-th leader
+    bool Graph::split_blocks(const std::vector<Instruction> &instructions) {
+        auto size = instructions.size();
+        std::vector<bool> leader(size + 1, false);
+        leader[0] = true;
+
+        for (size_t i = 0; i < size; i++) {
+            auto &instruction = instructions[i];
+            if (is_jump(instruction.opcode)) {
+                if (instruction.target >= size) return false;
+                leader[instruction.target] = true;
+            }
+            if (ends_block(instruction.opcode)) leader[i + 1] = true;
+        }
+
+        if (falls_through(instructions.back().opcode)) return false;
+
+        std::vector<uint32_t> block_of(size, NONE);
+        std::vector<size_t> starts;
+        for (size_t i = 0; i < size; i++) {
+            if (leader[i]) starts.push_back(i);
+            block_of[i] = (uint32_t) starts.size();
+        }
+
+        m_blocks.resize(starts.size() + 1);
+
+        auto edge = [&](uint32_t from, uint32_t to) {
+            auto &succs = m_blocks[from].succs;
+            if (std::find(succs.begin(), succs.end(), to) == succs.end()) succs.push_back(to);
+        };
+
+        edge(0, 1);
+        for (size_t b = 0; b < starts.size(); b++) {
+            auto end = b + 1 < starts.size() ? starts[b + 1] : size;
+            auto &last = instructions[end - 1];
+            auto id = (uint32_t) b + 1;
+
+            if (falls_through(last.opcode)) edge(id, id + 1);
+            if (is_jump(last.opcode)) edge(id, block_of[last.target]);
+        }
+
+        // reverse post order, blocks nothing reaches are left out
+        std::vector<bool> visited(m_blocks.size(), false);
+        std::vector<std::pair<uint32_t, size_t>> stack{{0, 0}};
+        visited[0] = true;
+
+        while (!stack.empty()) {
+            auto &[block, next] = stack.back();
+            if (next < m_blocks[block].succs.size()) {
+                auto succ = m_blocks[block].succs[next++];
+                if (!visited[succ]) {
+                    visited[succ] = true;
+                    stack.emplace_back(succ, 0);
+                }
+                continue;
+            }
+            m_order.push_back(block);
+            stack.pop_back();
+        }
+        std::reverse(m_order.begin(), m_order.end());
+
+        for (auto block: m_order) {
+            for (auto succ: m_blocks[block].succs) {
+                m_blocks[succ].preds.push_back(block);
+            }
+        }
+
+        for (uint32_t b = 0; b < m_blocks.size(); b++) {
+            if (visited[b]) m_layout.push_back(b);
+        }
+
+        // the instructions of each block are turned into nodes by simulate, which finds them
+        // through the first instruction of the block
+        m_block_starts.assign(m_blocks.size(), 0);
+        for (size_t b = 0; b < starts.size(); b++) {
+            m_block_starts[b + 1] = starts[b];
+        }
+        m_block_of = std::move(block_of);
+        return true;
+    }
+
+    bool Graph::simulate(const std::vector<Instruction> &instructions) {
+        std::vector<std::vector<ValueId>> exit_stacks(m_blocks.size());
+        std::vector<bool> done(m_blocks.size(), false);
+
+        for (auto b: m_order) {
+            auto &block = m_blocks[b];
+            std::vector<ValueId> locals;
+            // each value with the node that pushed it
+            std::vector<std::pair<ValueId, uint32_t>> stack;
+
+            if (b == 0) {
+                for (uint32_t slot = 0; slot < m_local_count; slot++) {
+                    locals.push_back(new_value(Value::Kind::Entry, b));
+                }
+            } else if (block.preds.size() == 1) {
+                auto pred = block.preds[0];
+                if (!done[pred]) return false;
+                locals = m_blocks[pred].exit_locals;
+                for (auto value: exit_stacks[pred]) stack.emplace_back(value, NONE);
+            } else {
+                auto first = std::find_if(block.preds.begin(), block.preds.end(),
+                                          [&](uint32_t pred) { return done[pred]; });
+                if (first == block.preds.end()) return false;
+
+                for (uint32_t slot = 0; slot < m_local_count; slot++) {
+                    locals.push_back(new_value(Value::Kind::Phi, b));
+                }
+                for (size_t i = 0; i < exit_stacks[*first].size(); i++) {
+                    stack.emplace_back(new_value(Value::Kind::Phi, b), NONE);
+                }
+            }
+
+            block.locals = locals;
+            for (auto &[value, _]: stack) block.stack.push_back(value);
+
+            auto start = m_block_starts[b];
+            auto end = b == 0 ? 0 : b + 1 < m_blocks.size() ? m_block_starts[b + 1] : instructions.size();
+
+            for (auto i = start; i < end; i++) {
+                auto &instruction = instructions[i];
+                auto &span = instruction.span;
+                auto oprand = instruction.oprands[0];
+
+                auto add = [&](Opcode opcode, uint32_t first, uint32_t second, uint32_t pops, bool pushes) {
+                    if (stack.size() < pops) return false;
+
+                    Node node{opcode, {first, second}, span};
+                    for (auto k = stack.size() - pops; k < stack.size(); k++) {
+                        node.inputs.push_back(stack[k].first);
+                        node.producers.push_back(stack[k].second);
+                    }
+                    stack.resize(stack.size() - pops);
+
+                    auto index = (uint32_t) block.nodes.size();
+                    if (pushes) {
+                        node.output = new_value(Value::Kind::Result, b, index);
+                        stack.emplace_back(node.output, index);
+                    }
+                    block.nodes.push_back(std::move(node));
+                    return true;
+                };
+
+                auto load = [&](uint32_t slot) {
+                    if (slot >= m_local_count) return false;
+                    auto index = (uint32_t) block.nodes.size();
+                    block.nodes.push_back({Opcode::LOAD_FAST, {slot, 0}, span});
+                    block.nodes.back().local = block.nodes.back().output = locals[slot];
+                    stack.emplace_back(locals[slot], index);
+                    return true;
+                };
+
+                // STORE_FAST keeps the value on the stack, the iterator opcodes only look at it
+                auto peek = [&](Opcode opcode, bool pop) {
+                    if (stack.empty()) return false;
+                    auto [value, producer] = stack.back();
+                    if (pop) stack.pop_back();
+                    block.nodes.push_back({opcode, {oprand, 0}, span, {value}, {producer}});
+                    return true;
+                };
+
+                auto store = [&](uint32_t slot, Value::Kind kind) {
+                    auto &node = block.nodes.back();
+                    auto index = (uint32_t) block.nodes.size() - 1;
+                    if (slot >= m_local_count) return false;
+
+                    node.local = new_value(kind, b, index);
+                    if (kind == Value::Kind::Copy) m_values[node.local].inputs.push_back(node.inputs[0]);
+                    locals[slot] = node.local;
+                    return true;
+                };
+
+                bool ok;
+                switch (instruction.opcode) {
+                    case Opcode::LOAD_FAST:
+                        ok = load(oprand);
+                        break;
+                    case Opcode::LOAD_FAST_LOAD_FAST:
+                        ok = load(oprand) and load(instruction.oprands[1]);
+                        break;
+                    case Opcode::LOAD_FAST_ATTR:
+                        ok = load(oprand) and add(Opcode::GET_ATTRIBUTE, instruction.oprands[1], 0, 1, true);
+                        break;
+                    case Opcode::STORE_FAST:
+                        ok = peek(Opcode::STORE_FAST, false) and store(oprand, Value::Kind::Copy);
+                        if (ok) {
+                            block.nodes.back().output = stack.back().first;
+                            stack.back().second = (uint32_t) block.nodes.size() - 1;
+                        }
+                        break;
+                    case Opcode::CREATE_LOCAL:
+                        ok = peek(Opcode::CREATE_LOCAL, true) and store(oprand, Value::Kind::Copy);
+                        break;
+                    case Opcode::ITER_NEXT:
+                        ok = peek(Opcode::ITER_NEXT, false) and store(oprand, Value::Kind::Result);
+                        break;
+                    case Opcode::ITER_END:
+                        ok = peek(Opcode::ITER_END, false);
+                        break;
+                    case Opcode::FOR_ITER:
+                        ok = peek(Opcode::FOR_ITER, false) and store(oprand, Value::Kind::Result);
+                        break;
+                    case Opcode::COMPARE_AND_JUMP:
+                        ok = add(static_cast<Opcode>(oprand), 0, 0, 2, true) and
+                             add(Opcode::JUMP_IF_FALSE, 0, 0, 1, false);
+                        break;
+                    case Opcode::CREATE_CLOSURE: {
+                        ok = oprand < m_constants.size() and m_constants[oprand]->is<Function>() and
+                             add(Opcode::CREATE_CLOSURE, oprand, 0, 0, true);
+                        if (!ok) break;
+
+                        auto function = m_constants[oprand]->as<Function>();
+                        for (auto &capture: function->get_code()->get_captures()) {
+                            if (capture.from >= m_local_count) return false;
+                            block.nodes.back().captures.push_back(locals[capture.from]);
+                        }
+                        break;
+                    }
+                    default: {
+                        auto use = stack_use(instruction.opcode, oprand);
+                        ok = use.has_value() and
+                             add(instruction.opcode, oprand, instruction.oprands[1], use->first, use->second > 0);
+                        break;
+                    }
+                }
+
+                if (!ok) return false;
+                if (is_jump(instruction.opcode)) block.nodes.back().target = m_block_of[instruction.target];
+            }
+
+            block.exit_locals = locals;
+            for (auto &[value, _]: stack) exit_stacks[b].push_back(value);
+            done[b] = true;
+        }
+
+        for (auto b: m_order) {
+            auto &block = m_blocks[b];
+            if (block.preds.size() < 2) continue;
+
+            for (auto pred: block.preds) {
+                if (exit_stacks[pred].size() != block.stack.size()) return false;
+                for (uint32_t slot = 0; slot < m_local_count; slot++) {
+                    m_values[block.locals[slot]].inputs.push_back(m_blocks[pred].exit_locals[slot]);
+                }
+                for (size_t i = 0; i < block.stack.size(); i++) {
+                    m_values[block.stack[i]].inputs.push_back(exit_stacks[pred][i]);
+                }
+            }
+        }
+
+        for (auto b: m_order) {
+            for (auto succ: m_blocks[b].succs) {
+                if (m_blocks[succ].preds.size() == 1 and exit_stacks[b].size() != m_blocks[succ].stack.size()) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    ValueId Graph::resolve(ValueId id) {
+        if (id == NONE) return id;
+        while (m_alias[id] != NONE) {
+            // point straight at the end of the chain so later lookups are short
+            auto next = m_alias[id];
+            if (m_alias[next] != NONE) m_alias[id] = m_alias[next];
+            id = next;
+        }
+        return id;
+    }
+
+    // a phi whose inputs are all one value, or itself, is that value
+    void Graph::remove_trivial_phis() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+
+            for (ValueId id = 0; id < m_values.size(); id++) {
+                if (m_values[id].kind != Value::Kind::Phi or m_alias[id] != NONE) continue;
+
+                auto same = NONE;
+                bool trivial = true;
+                for (auto input: m_values[id].inputs) {
+                    input = resolve(input);
+                    if (input == id or input == same) continue;
+                    if (same != NONE) {
+                        trivial = false;
+                        break;
+                    }
+                    same = input;
+                }
+
+                if (trivial and same != NONE) {
+                    m_alias[id] = same;
+                    changed = true;
+                }
+            }
+        }
+
+        auto update = [&](std::vector<ValueId> &values) {
+            for (auto &value: values) value = resolve(value);
+        };
+
+        for (auto &value: m_values) update(value.inputs);
+        for (auto &block: m_blocks) {
+            update(block.stack);
+            update(block.locals);
+            update(block.exit_locals);
+            for (auto &node: block.nodes) {
+                update(node.inputs);
+                update(node.captures);
+                node.output = resolve(node.output);
+                node.local = resolve(node.local);
+            }
+        }
+    }
+
+    void Graph::compute_dominators() {
+        std::vector<uint32_t> position(m_blocks.size(), NONE);
+        for (uint32_t i = 0; i < m_order.size(); i++) position[m_order[i]] = i;
+
+        auto intersect = [&](uint32_t a, uint32_t b) {
+            while (a != b) {
+                while (position[a] > position[b]) a = m_blocks[a].idom;
+                while (position[b] > position[a]) b = m_blocks[b].idom;
+            }
+            return a;
+        };
+
+        m_blocks[0].idom = 0;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto b: m_order) {
+                if (b == 0) continue;
+
+                auto idom = NONE;
+                for (auto pred: m_blocks[b].preds) {
+                    if (m_blocks[pred].idom == NONE) continue;
+                    idom = idom == NONE ? pred : intersect(pred, idom);
+                }
+
+                if (idom != m_blocks[b].idom) {
+                    m_blocks[b].idom = idom;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    bool Graph::dominates(uint32_t a, uint32_t b) const {
+        while (true) {
+            if (a == b) return true;
+            if (b == 0 or b == NONE) return false;
+            b = m_blocks[b].idom;
+        }
+    }
+
+    void Graph::infer_types() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+
+            for (ValueId id = 0; id < m_values.size(); id++) {
+                if (m_alias[id] != NONE) continue;
+                auto &value = m_values[id];
+
+                Type type = Type::Unset;
+                switch (value.kind) {
+                    case Value::Kind::Entry:
+                        type = Type::Unknown;
+                        break;
+                    case Value::Kind::Copy:
+                        type = m_values[value.inputs[0]].type;
+                        break;
+                    case Value::Kind::Phi:
+                        for (auto input: value.inputs) type = join(type, m_values[input].type);
+                        break;
+                    case Value::Kind::Result: {
+                        auto &node = m_blocks[value.block].nodes[value.node];
+                        // ITER_NEXT and FOR_ITER define the loop variable without pushing it
+                        type = node.output == id ? result_type(node) : Type::Unknown;
+                        break;
+                    }
+                }
+
+                if (type != value.type) {
+                    value.type = type;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    Type Graph::constant_type(uint32_t index) const {
+        if (index >= m_constants.size()) return Type::Unknown;
+
+        auto &constant = m_constants[index];
+        if (constant.is_immediate_int() or constant->is<Int>()) return Type::Int;
+        if (constant.is_immediate_float() or constant->is<Float>()) return Type::Float;
+        if (constant->is<String>()) return Type::String;
+        if (constant->is<Bool>()) return Type::Bool;
+        if (constant->is<None>()) return Type::Nil;
+        return Type::Unknown;
+    }
+
+    Type Graph::result_type(const Node &node) const {
+        auto input = [&](size_t i) { return i < node.inputs.size() ? m_values[node.inputs[i]].type : Type::Unknown; };
+
+        switch (node.opcode) {
+            case Opcode::LOAD_CONST:
+                return constant_type(node.oprands[0]);
+            case Opcode::PUSH_TRUE:
+            case Opcode::PUSH_FALSE:
+            case Opcode::NOT:
+                return Type::Bool;
+            case Opcode::PUSH_NIL:
+                return Type::Nil;
+            case Opcode::BIT_OR:
+            case Opcode::BIT_AND:
+            case Opcode::BIT_XOR:
+                return Type::Int;
+            case Opcode::AND:
+            case Opcode::OR:
+                return join(input(0), input(1));
+            case Opcode::UNARY_SUB: {
+                auto type = input(0);
+                if (type == Type::Unset or type == Type::Int or type == Type::Float) return type;
+                return Type::Number;
+            }
+            case Opcode::BIN_MOD: {
+                auto left = input(0);
+                if (left == Type::Unset or left == Type::Int) return left;
+                return Type::Unknown;
+            }
+            case Opcode::BIN_ADD:
+            case Opcode::BIN_SUB:
+            case Opcode::BIN_MUL:
+            case Opcode::BIN_DIV: {
+                auto left = input(0);
+                auto right = input(1);
+                if (left == Type::Unset or right == Type::Unset) return Type::Unset;
+                if (left == Type::String and node.opcode == Opcode::BIN_ADD) return Type::String;
+                if (!is_number(left)) return Type::Unknown;
+                if (left == Type::Int and right == Type::Int) return Type::Int;
+                if (left == Type::Float or right == Type::Float) return Type::Float;
+                return Type::Number;
+            }
+            case Opcode::NE:
+            case Opcode::EQ:
+            case Opcode::LE:
+            case Opcode::GT:
+            case Opcode::GE:
+            case Opcode::LT: {
+                auto left = input(0);
+                if (left == Type::Unset) return left;
+                return is_builtin(left) ? Type::Bool : Type::Unknown;
+            }
+            default:
+                return Type::Unknown;
+        }
+    }
+
+    ValueId Graph::root(ValueId id) const {
+        while (id != NONE and m_values[id].kind == Value::Kind::Copy) id = m_values[id].inputs[0];
+        return id;
+    }
+
+    Type Graph::type_of(ValueId id) const {
+        auto type = m_values[id].type;
+        return type == Type::Unset ? Type::Unknown : type;
+    }
+
+    Effects Graph::effects_of(const Node &node) const {
+        Effects effects;
+        auto input = [&](size_t i) { return i < node.inputs.size() ? type_of(node.inputs[i]) : Type::Unknown; };
+
+        switch (node.opcode) {
+            case Opcode::LOAD_CONST:
+            case Opcode::PUSH_TRUE:
+            case Opcode::PUSH_FALSE:
+            case Opcode::PUSH_NIL:
+            case Opcode::LOAD_FAST:
+            case Opcode::STORE_FAST:
+            case Opcode::CREATE_LOCAL:
+            case Opcode::JUMP:
+            case Opcode::BREAK:
+            case Opcode::CONTINUE:
+            case Opcode::JUMP_IF_FALSE:
+            case Opcode::NOT:
+            case Opcode::AND:
+            case Opcode::OR:
+            case Opcode::CREATE_FUNCTION:
+            case Opcode::CREATE_CLOSURE:
+            case Opcode::CREATE_STRUCT:
+            case Opcode::BUILD_LIST:
+            case Opcode::MAKE_OK:
+            case Opcode::MAKE_ERROR:
+                break;
+            case Opcode::POP_TOP:
+                // an unhandled Result is an error
+                effects.may_fail = !is_builtin(input(0));
+                break;
+            case Opcode::LOAD_GLOBAL:
+                effects.may_fail = true;
+                effects.reads_globals = true;
+                break;
+            case Opcode::STORE_GLOBAL:
+            case Opcode::CREATE_GLOBAL:
+                effects.may_fail = true;
+                effects.writes_globals = true;
+                break;
+            case Opcode::GET_ATTRIBUTE:
+                effects.may_fail = true;
+                effects.reads_heap = true;
+                break;
+            case Opcode::SET_ATTRIBUTE:
+                effects.may_fail = true;
+                effects.writes_heap = true;
+                break;
+            case Opcode::UNARY_SUB:
+                effects.may_fail = !is_number(input(0));
+                break;
+            case Opcode::BIT_OR:
+            case Opcode::BIT_AND:
+            case Opcode::BIT_XOR:
+                effects.may_fail = input(0) != Type::Int or input(1) != Type::Int;
+                break;
+            case Opcode::BIN_ADD:
+            case Opcode::BIN_SUB:
+            case Opcode::BIN_MUL:
+            case Opcode::BIN_DIV:
+            case Opcode::BIN_MOD:
+            case Opcode::NE:
+            case Opcode::EQ:
+            case Opcode::LE:
+            case Opcode::GT:
+            case Opcode::GE:
+            case Opcode::LT: {
+                auto left = input(0);
+                auto right = input(1);
+
+                // operators on builtin values are native code, anything else may be a script method
+                if (!is_builtin(left)) {
+                    effects = {true, true, true, true, true, true};
+                    break;
+                }
+
+                bool numbers = is_number(left) and is_number(right);
+                bool divides = node.opcode == Opcode::BIN_DIV or node.opcode == Opcode::BIN_MOD;
+                bool integers = left == Type::Int and right == Type::Int;
+                effects.may_fail = !numbers or divides or (node.opcode == Opcode::BIN_MOD and !integers);
+                break;
+            }
+            default:
+                effects = {true, true, true, true, true, true};
+                break;
+        }
+
+        return effects;
+    }
+
+    bool Graph::is_leaf(const Node &node) const {
+        if (node.removed or node.spill != NONE) return false;
+        if (node.reload != NONE) return true;
+
+        switch (node.opcode) {
+            case Opcode::LOAD_CONST:
+            case Opcode::PUSH_TRUE:
+            case Opcode::PUSH_FALSE:
+            case Opcode::PUSH_NIL:
+            case Opcode::LOAD_FAST:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    const t_string *Graph::constant_name(uint32_t index) const {
+        if (index >= m_constants.size() or !m_constants[index]->is<String>()) return nullptr;
+        return &m_constants[index]->as<String>()->get_value_ref();
+    }
+
+    std::vector<Instruction> Graph::lower() const {
+        std::vector<Instruction> out;
+        std::vector<size_t> starts(m_blocks.size(), 0);
+        std::vector<std::pair<size_t, uint32_t>> jumps;
+
+        for (auto b: m_layout) {
+            starts[b] = out.size();
+
+            for (auto &node: m_blocks[b].nodes) {
+                if (node.removed) continue;
+
+                if (node.reload != NONE) {
+                    out.push_back({Opcode::LOAD_FAST, {node.reload, 0}, node.span});
+                } else {
+                    if (node.target != NONE) jumps.emplace_back(out.size(), node.target);
+                    out.push_back({node.opcode, node.oprands, node.span});
+                }
+
+                if (node.spill != NONE) out.push_back({Opcode::STORE_FAST, {node.spill, 0}, node.span});
+            }
+        }
+
+        for (auto &[index, block]: jumps) {
+            out[index].target = starts[block];
+        }
+        return out;
+    }
+}
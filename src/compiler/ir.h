@@ -0,0 +1,196 @@
+//
+// ssa form of a code object, built from its bytecode for the passes in passes.h and lowered
+// back into bytecode once they are done
+//
+
+#ifndef BOND_IR_H
+#define BOND_IR_H
+
+#include "../object.h"
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace bond {
+    // a decoded instruction, jumps hold the index of the instruction they go to
+    struct Instruction {
+        Opcode opcode;
+        std::array<uint32_t, 2> oprands;
+        SharedSpan span;
+        size_t target = 0;
+        bool removed = false;
+    };
+
+    namespace ir {
+        using ValueId = uint32_t;
+
+        // no value, block, node or slot
+        constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+        // what is known about the type of a value, Number is an Int or a Float. Unset is only
+        // seen while types are being inferred
+        enum class Type : uint8_t {
+            Unset,
+            Nil,
+            Bool,
+            Int,
+            Float,
+            Number,
+            String,
+            Unknown,
+        };
+
+        struct Value {
+            enum class Kind : uint8_t {
+                // what a local slot holds when the frame starts, an argument, an up value or nothing
+                Entry,
+                // pushed by a node
+                Result,
+                // a value stored into a local slot, each store makes a new version of the slot
+                Copy,
+                // a local slot or stack entry merged where a block has several predecessors
+                Phi,
+            };
+
+            Kind kind;
+            uint32_t block = NONE;
+            uint32_t node = NONE;
+            // the stored value of a Copy, one value per predecessor for a Phi
+            std::vector<ValueId> inputs;
+            Type type = Type::Unset;
+        };
+
+        // how a node reaches outside its own inputs and outputs
+        struct Effects {
+            bool may_fail = false;
+            bool reads_globals = false;
+            bool reads_heap = false;
+            bool writes_globals = false;
+            bool writes_heap = false;
+            // may run script code, which can do anything
+            bool calls = false;
+
+            [[nodiscard]] bool writes() const { return writes_globals or writes_heap or calls; }
+        };
+
+        struct Node {
+            Opcode opcode;
+            std::array<uint32_t, 2> oprands;
+            SharedSpan span;
+
+            // values popped, or peeked by the iterator opcodes, deepest first
+            std::vector<ValueId> inputs;
+            // node in the same block that pushed each input, NONE for values already on the
+            // stack when the block starts
+            std::vector<uint32_t> producers;
+            ValueId output = NONE;
+            // version of the local slot a LOAD_FAST reads or a store writes
+            ValueId local = NONE;
+            // versions of the local slots a CREATE_CLOSURE copies into the closure
+            std::vector<ValueId> captures;
+            // block a jump goes to
+            uint32_t target = NONE;
+
+            // rewrites applied by lowering
+            bool removed = false;
+            // replaced by a LOAD_FAST of this slot
+            uint32_t reload = NONE;
+            // followed by a STORE_FAST of its output into this slot
+            uint32_t spill = NONE;
+        };
+
+        struct Block {
+            std::vector<Node> nodes;
+            std::vector<uint32_t> preds;
+            std::vector<uint32_t> succs;
+            // stack and local slot versions when the block starts
+            std::vector<ValueId> stack;
+            std::vector<ValueId> locals;
+            // local slot versions when the block ends
+            std::vector<ValueId> exit_locals;
+            uint32_t idom = NONE;
+        };
+
+        class Graph {
+        public:
+            // the ssa form of instructions, nothing when they use something the ir does not model
+            static std::optional<Graph> build(const std::vector<Instruction> &instructions,
+                                              const GcPtr<Code> &code, uint32_t local_count);
+
+            // bytecode for the graph with every rewrite applied
+            [[nodiscard]] std::vector<Instruction> lower() const;
+
+            std::vector<Block> &blocks() { return m_blocks; }
+
+            Value &value(ValueId id) { return m_values[id]; }
+
+            size_t value_count() const { return m_values.size(); }
+
+            Node &node_of(ValueId id) { return m_blocks[m_values[id].block].nodes[m_values[id].node]; }
+
+            // the value a copy was made from, followed through every copy
+            ValueId root(ValueId id) const;
+
+            Type type_of(ValueId id) const;
+
+            [[nodiscard]] Effects effects_of(const Node &node) const;
+
+            // true for nodes that push a value and do nothing else, so removing the node and
+            // the one that consumes its value changes nothing
+            [[nodiscard]] bool is_leaf(const Node &node) const;
+
+            bool dominates(uint32_t a, uint32_t b) const;
+
+            // blocks in reverse post order, the order every block follows its dominator in
+            const std::vector<uint32_t> &order() const { return m_order; }
+
+            // blocks in the order they are laid out in bytecode
+            std::vector<uint32_t> &layout() { return m_layout; }
+
+            const t_string *constant_name(uint32_t index) const;
+
+            uint32_t local_count() const { return m_local_count; }
+
+            // a fresh local slot for a value the passes keep around
+            uint32_t new_local() { return m_local_count++; }
+
+            uint32_t add_block();
+
+        private:
+            std::vector<Block> m_blocks;
+            std::vector<Value> m_values;
+            std::vector<uint32_t> m_order;
+            std::vector<uint32_t> m_layout;
+            std::vector<ValueId> m_alias;
+            uint32_t m_local_count = 0;
+            t_vector m_constants;
+
+            // first instruction of each block and the block of each instruction, used while
+            // the graph is built
+            std::vector<size_t> m_block_starts;
+            std::vector<uint32_t> m_block_of;
+
+            ValueId new_value(Value::Kind kind, uint32_t block, uint32_t node = NONE);
+
+            bool split_blocks(const std::vector<Instruction> &instructions);
+
+            bool simulate(const std::vector<Instruction> &instructions);
+
+            ValueId resolve(ValueId id);
+
+            void remove_trivial_phis();
+
+            void compute_dominators();
+
+            void infer_types();
+
+            Type result_type(const Node &node) const;
+
+            Type constant_type(uint32_t index) const;
+        };
+    }
+}
+
+#endif //BOND_IR_H
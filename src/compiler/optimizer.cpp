@@ -0,0 +1,324 @@
+//
+// bytecode optimizer, see optimizer.h
+//
+
+#include "optimizer.h"
+#include "passes.h"
+#include "../runtime.h"
+
+namespace bond {
+    // the most times the passes are repeated over one code object, each round can expose more
+    // work for the others but real code settles within two or three
+    constexpr uint32_t MAX_ROUNDS = 8;
+
+    static bool is_unconditional_jump(Opcode opcode) {
+        return opcode == Opcode::JUMP or opcode == Opcode::BREAK or opcode == Opcode::CONTINUE;
+    }
+
+    // instructions that never fall through to the next one
+    static bool is_terminal(Opcode opcode) {
+        return opcode == Opcode::RETURN or is_unconditional_jump(opcode);
+    }
+
+    // pushes a value without side effects, so a push followed by POP_TOP does nothing
+    static bool is_pure_push(Opcode opcode) {
+        switch (opcode) {
+            case Opcode::LOAD_CONST:
+            case Opcode::PUSH_NIL:
+            case Opcode::PUSH_TRUE:
+            case Opcode::PUSH_FALSE:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void Optimizer::optimize(const GcPtr<Code> &code) {
+        if (m_level == OPTIMIZE_NONE) return;
+
+        optimize_code(code);
+
+        for (auto &constant: code->get_constants()) {
+            if (constant->is<Function>()) {
+                optimize(constant->as<Function>()->get_code());
+            } else if (constant->is<Struct>()) {
+                for (auto &[_, method]: constant->as<Struct>()->get_methods()) {
+                    optimize(method->as<Function>()->get_code());
+                }
+            }
+        }
+    }
+
+    static bool is_compare(Opcode opcode) {
+        switch (opcode) {
+            case Opcode::NE:
+            case Opcode::EQ:
+            case Opcode::LE:
+            case Opcode::GT:
+            case Opcode::GE:
+            case Opcode::LT:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void Optimizer::optimize_code(const GcPtr<Code> &code) {
+        decode(code);
+
+        bool optimized = run_passes();
+        if (m_level >= OPTIMIZE_SSA and run_ssa_passes(code)) {
+            run_passes();
+            optimized = true;
+        }
+
+        if (optimized) encode(code);
+        m_instructions.clear();
+    }
+
+    bool Optimizer::run_passes() {
+        bool optimized = false;
+        for (uint32_t round = 0; round < MAX_ROUNDS; round++) {
+            count_jumps();
+            bool changed = thread_jumps();
+            changed |= remove_dead_code();
+            count_jumps();
+            changed |= peephole();
+
+            if (!changed) break;
+            optimized = true;
+        }
+        return optimized;
+    }
+
+    bool Optimizer::run_ssa_passes(const GcPtr<Code> &code) {
+        std::vector<size_t> index_of(m_instructions.size() + 1, 0);
+        std::vector<Instruction> instructions;
+
+        for (size_t i = 0; i < m_instructions.size(); i++) {
+            index_of[i] = instructions.size();
+            if (!m_instructions[i].removed) instructions.push_back(m_instructions[i]);
+        }
+        index_of[m_instructions.size()] = instructions.size();
+
+        for (auto &instruction: instructions) {
+            if (is_jump(instruction.opcode)) instruction.target = index_of[live(instruction.target)];
+        }
+
+        auto local_count = code->get_local_count();
+        if (!PassManager().run(instructions, code, local_count)) return false;
+
+        // slots the passes added hold values they keep around
+        auto locals = code->get_locals();
+        while (locals.size() < local_count) {
+            locals.push_back(fmt::format(".t{}", locals.size()));
+        }
+        code->set_locals(locals);
+
+        m_instructions = std::move(instructions);
+        return true;
+    }
+
+    void Optimizer::decode(const GcPtr<Code> &code) {
+        auto &bytes = code->get_instructions();
+        auto spans = code->decode_spans();
+
+        // instruction index of each byte offset that starts an instruction
+        std::vector<size_t> index_of(bytes.size() + 1, bytes.size());
+        size_t offset = 0;
+
+        while (offset < bytes.size()) {
+            index_of[offset] = m_instructions.size();
+
+            Instruction instruction{static_cast<Opcode>(bytes[offset]), {0, 0}, spans[offset]};
+            offset++;
+            for (uint32_t i = 0; i < oprand_count(instruction.opcode); i++) {
+                instruction.oprands[i] = read_oprand(instruction.opcode, i, bytes.data(), offset);
+            }
+            m_instructions.push_back(instruction);
+        }
+        index_of[bytes.size()] = m_instructions.size();
+
+        for (auto &instruction: m_instructions) {
+            if (!is_jump(instruction.opcode)) continue;
+
+            auto target = instruction.oprands[oprand_count(instruction.opcode) - 1];
+            instruction.target = target < index_of.size() ? index_of[target] : m_instructions.size();
+        }
+    }
+
+    void Optimizer::encode(const GcPtr<Code> &code) {
+        auto out = Runtime::ins()->make_code();
+
+        // removed instructions get the offset of the next live one, which is where jumps to
+        // them now land
+        std::vector<uint32_t> offsets(m_instructions.size() + 1);
+        std::vector<std::pair<uint32_t, size_t>> patches;
+
+        for (size_t i = 0; i < m_instructions.size(); i++) {
+            offsets[i] = out->current_index();
+            auto &instruction = m_instructions[i];
+            if (instruction.removed) continue;
+
+            auto opcode = instruction.opcode;
+            auto &oprands = instruction.oprands;
+
+            if (is_jump(opcode)) {
+                auto patch = oprand_count(opcode) == 1 ? out->add_jump(opcode, instruction.span)
+                                                       : out->add_jump(opcode, oprands[0], instruction.span);
+                patches.emplace_back(patch, instruction.target);
+                continue;
+            }
+
+            switch (oprand_count(opcode)) {
+                case 0:
+                    out->add_ins(opcode, instruction.span);
+                    break;
+                case 1:
+                    out->add_ins(opcode, oprands[0], instruction.span);
+                    break;
+                default:
+                    out->add_ins(opcode, oprands[0], oprands[1], instruction.span);
+                    break;
+            }
+        }
+        offsets[m_instructions.size()] = out->current_index();
+
+        for (auto &[patch, target]: patches) {
+            out->patch_code(patch, offsets[target]);
+        }
+
+        code->replace_bytecode(out);
+    }
+
+    size_t Optimizer::live(size_t index) const {
+        while (index < m_instructions.size() and m_instructions[index].removed) index++;
+        return index;
+    }
+
+    void Optimizer::count_jumps() {
+        m_jumps_to.assign(m_instructions.size() + 1, 0);
+
+        for (auto &instruction: m_instructions) {
+            if (instruction.removed or !is_jump(instruction.opcode)) continue;
+            m_jumps_to[live(instruction.target)]++;
+        }
+    }
+
+    // points jumps that land on an unconditional jump at its final destination, and drops
+    // unconditional jumps to the instruction right after them
+    bool Optimizer::thread_jumps() {
+        bool changed = false;
+        auto size = m_instructions.size();
+
+        for (size_t i = live(0); i < size; i = next(i)) {
+            auto &instruction = m_instructions[i];
+            if (!is_jump(instruction.opcode)) continue;
+
+            auto target = live(instruction.target);
+            for (size_t steps = 0; target < size and steps < size; steps++) {
+                auto &landing = m_instructions[target];
+                if (!is_unconditional_jump(landing.opcode) or live(landing.target) == target) break;
+                target = live(landing.target);
+            }
+
+            if (target != instruction.target) {
+                instruction.target = target;
+                changed = true;
+            }
+
+            if (is_unconditional_jump(instruction.opcode) and target == next(i)) {
+                remove(i);
+                changed = true;
+            }
+        }
+
+        return changed;
+    }
+
+    bool Optimizer::remove_dead_code() {
+        auto size = m_instructions.size();
+        std::vector<bool> reached(size, false);
+        std::vector<size_t> pending{live(0)};
+
+        while (!pending.empty()) {
+            auto i = pending.back();
+            pending.pop_back();
+            if (i >= size or reached[i]) continue;
+            reached[i] = true;
+
+            auto opcode = m_instructions[i].opcode;
+            if (is_jump(opcode)) pending.push_back(live(m_instructions[i].target));
+            if (!is_terminal(opcode)) pending.push_back(next(i));
+        }
+
+        bool changed = false;
+        for (size_t i = 0; i < size; i++) {
+            if (!m_instructions[i].removed and !reached[i]) {
+                remove(i);
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    // rewrites pairs of instructions, the second of a pair must not be a jump target since
+    // the rewrite folds it into the first
+    bool Optimizer::peephole() {
+        bool changed = false;
+        auto size = m_instructions.size();
+
+        for (size_t i = live(0); i < size; i = next(i)) {
+            auto j = next(i);
+            if (j >= size or m_jumps_to[j] > 0) continue;
+
+            auto &first = m_instructions[i];
+            auto &second = m_instructions[j];
+            bool same_slot = first.oprands[0] == second.oprands[0];
+
+            if (is_pure_push(first.opcode) and second.opcode == Opcode::POP_TOP) {
+                remove(i);
+                remove(j);
+            } else if (first.opcode == Opcode::STORE_FAST and second.opcode == Opcode::POP_TOP) {
+                first.opcode = Opcode::CREATE_LOCAL;
+                remove(j);
+            } else if (first.opcode == Opcode::CREATE_LOCAL and second.opcode == Opcode::LOAD_FAST and same_slot) {
+                // the stored value is still the one wanted on the stack
+                first.opcode = Opcode::STORE_FAST;
+                remove(j);
+            } else if (first.opcode == Opcode::LOAD_FAST and second.opcode == Opcode::CREATE_LOCAL and same_slot) {
+                remove(i);
+                remove(j);
+            } else if (first.opcode == Opcode::PUSH_TRUE and second.opcode == Opcode::JUMP_IF_FALSE) {
+                remove(i);
+                remove(j);
+            } else if (first.opcode == Opcode::PUSH_FALSE and second.opcode == Opcode::JUMP_IF_FALSE) {
+                first.opcode = Opcode::JUMP;
+                first.target = second.target;
+                remove(j);
+            } else if (first.opcode == Opcode::LOAD_FAST and second.opcode == Opcode::LOAD_FAST) {
+                // the ssa passes take superinstructions apart, these put them back together
+                first.opcode = Opcode::LOAD_FAST_LOAD_FAST;
+                first.oprands[1] = second.oprands[0];
+                remove(j);
+            } else if (first.opcode == Opcode::LOAD_FAST and second.opcode == Opcode::GET_ATTRIBUTE) {
+                first.opcode = Opcode::LOAD_FAST_ATTR;
+                first.oprands[1] = second.oprands[0];
+                first.span = second.span;
+                remove(j);
+            } else if (is_compare(first.opcode) and second.opcode == Opcode::JUMP_IF_FALSE) {
+                first.oprands[0] = static_cast<uint32_t>(first.opcode);
+                first.opcode = Opcode::COMPARE_AND_JUMP;
+                first.target = second.target;
+                remove(j);
+            } else {
+                continue;
+            }
+
+            changed = true;
+            count_jumps();
+        }
+
+        return changed;
+    }
+}
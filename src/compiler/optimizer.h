@@ -0,0 +1,67 @@
+//
+// bytecode optimizer, rewrites code objects after codegen and before they run
+//
+
+#ifndef BOND_OPTIMIZER_H
+#define BOND_OPTIMIZER_H
+
+#include "../object.h"
+#include "ir.h"
+#include <cstdint>
+#include <vector>
+
+namespace bond {
+    // levels accepted by Context::set_optimize_level
+    constexpr uint32_t OPTIMIZE_NONE = 0;
+    // constant folding of the syntax tree, then jump threading, dead code removal and
+    // peephole rewrites of instruction pairs
+    constexpr uint32_t OPTIMIZE_PEEPHOLE = 1;
+    // everything above and inlining of small module functions, then value numbering, loop
+    // invariant code motion and dead store removal over the ssa form of each code object,
+    // see passes.h
+    constexpr uint32_t OPTIMIZE_SSA = 2;
+
+    class Optimizer {
+    public:
+        explicit Optimizer(uint32_t level) : m_level(level) {}
+
+        // optimizes code and the code of every function and struct method among its constants
+        void optimize(const GcPtr<Code> &code);
+
+    private:
+        uint32_t m_level;
+        std::vector<Instruction> m_instructions;
+        // number of jumps that land on each instruction
+        std::vector<uint32_t> m_jumps_to;
+
+        void optimize_code(const GcPtr<Code> &code);
+
+        // runs the jump threading, dead code and peephole passes until nothing changes
+        bool run_passes();
+
+        // runs the ssa passes over the live instructions
+        bool run_ssa_passes(const GcPtr<Code> &code);
+
+        void decode(const GcPtr<Code> &code);
+
+        void encode(const GcPtr<Code> &code);
+
+        // first instruction at or after index that is still in the code
+        size_t live(size_t index) const;
+
+        // next live instruction after index
+        size_t next(size_t index) const { return live(index + 1); }
+
+        void count_jumps();
+
+        bool thread_jumps();
+
+        bool remove_dead_code();
+
+        bool peephole();
+
+        void remove(size_t index) { m_instructions[index].removed = true; }
+    };
+}
+
+#endif //BOND_OPTIMIZER_H
@@ -1044,17 +1044,23 @@ namespace bond {
     void Scopes::declare(const std::string &name, const std::shared_ptr<Span> &span, bool is_mut) {
         if (m_scopes.empty()) return;
 
-        for (auto &scope: std::ranges::reverse_view(m_scopes)) {
+        for (size_t i = m_scopes.size(); i-- > 0;) {
+            if (!is_visible(i)) continue;
+            auto &scope = m_scopes[i];
             if (scope.find(name) != scope.end()) {
                 throw ParserError("Variable with this name already declared in this scope.", span);
             }
         }
 
-        m_scopes[m_scopes.size() - 1][name] = std::make_shared<Variable>(name, span, m_scopes.size() == 1, is_mut);
+        auto var = std::make_shared<Variable>(name, span, m_scopes.size() == 1, is_mut);
+        if (!var->is_global) allocate_slot(var);
+        m_scopes[m_scopes.size() - 1][name] = var;
     }
 
     bool Scopes::is_declared(const std::string &name) {
-        for (auto &scope: std::ranges::reverse_view(m_scopes)) {
+        for (size_t i = m_scopes.size(); i-- > 0;) {
+            if (!is_visible(i)) continue;
+            auto &scope = m_scopes[i];
             if (scope.find(name) != scope.end()) {
                 return true;
             }
@@ -1064,7 +1070,9 @@ namespace bond {
     }
 
     std::optional<std::shared_ptr<Variable>> Scopes::get(const std::string &name) {
-        for (auto &scope: std::ranges::reverse_view(m_scopes)) {
+        for (size_t i = m_scopes.size(); i-- > 0;) {
+            if (!is_visible(i)) continue;
+            auto &scope = m_scopes[i];
             if (scope.contains(name)) {
                 return scope[name];
             }
@@ -1076,7 +1084,9 @@ namespace bond {
     void Scopes::declare(const std::string &name, const std::shared_ptr<Span> &span, bool is_mut, bool is_global) {
         if (m_scopes.empty()) return;
 
-        for (auto &scope: std::ranges::reverse_view(m_scopes)) {
+        for (size_t i = m_scopes.size(); i-- > 0;) {
+            if (!is_visible(i)) continue;
+            auto &scope = m_scopes[i];
             if (scope.find(name) != scope.end()) {
                 auto sp = scope[name]->span;
                 throw ParserError("Variable with this name already declared in this scope.", span);
@@ -1084,7 +1094,57 @@ namespace bond {
             }
         }
 
-        m_scopes[m_scopes.size() - 1][name] = std::make_shared<Variable>(name, span, is_global, is_mut);
+        auto var = std::make_shared<Variable>(name, span, is_global, is_mut);
+        if (!var->is_global) allocate_slot(var);
+        m_scopes[m_scopes.size() - 1][name] = var;
+    }
+
+    void Scopes::new_function(std::unordered_set<std::string> cells) {
+        m_functions.emplace_back();
+        m_functions.back().cells = std::move(cells);
+    }
+
+    FunctionScope Scopes::end_function() {
+        auto function = std::move(m_functions.back());
+        m_functions.pop_back();
+        return function;
+    }
+
+    uint32_t Scopes::allocate_slot(const std::shared_ptr<Variable> &variable) {
+        // the parser only tracks names, slots are handed out while generating code
+        if (m_functions.empty()) return 0;
+
+        auto &function = m_functions.back();
+        variable->slot = function.locals.size();
+        variable->function = m_functions.size();
+        function.locals.push_back(variable->name);
+        return variable->slot;
+    }
+
+    uint32_t Scopes::get_slot(const std::shared_ptr<Variable> &variable) {
+        if (variable->function == m_functions.size()) return variable->slot;
+        return capture(variable.get(), m_functions.size());
+    }
+
+    bool Scopes::is_cell(const std::shared_ptr<Variable> &variable) {
+        if (m_functions.empty()) return false;
+        // captures always arrive in a cell
+        if (variable->function != m_functions.size()) return true;
+        return m_functions.back().cells.contains(variable->name);
+    }
+
+    uint32_t Scopes::capture(Variable *variable, size_t function) {
+        auto &current = m_functions[function - 1];
+        if (current.captured.contains(variable)) return current.captured[variable];
+
+        // every function between the declaration and the use gets a slot for the variable's cell
+        auto from = variable->function == function - 1 ? variable->slot : capture(variable, function - 1);
+
+        uint32_t to = current.locals.size();
+        current.locals.push_back(variable->name);
+        current.captures.push_back({from, to});
+        current.captured[variable] = to;
+        return to;
     }
 
     bool Scopes::is_declared_in_current_scope(const std::string &name) {
@@ -40,6 +40,20 @@ namespace bond {
         std::shared_ptr<Span> span;
         bool is_mut = true;
         bool is_global = false;
+
+        // index into the locals of the function that declared it, only meaningful for locals
+        uint32_t slot = 0;
+        size_t function = 0;
+    };
+
+    // slot allocation state for a function that is being compiled
+    struct FunctionScope {
+        std::vector<std::string> locals;
+        std::vector<Capture> captures;
+        std::unordered_map<Variable *, uint32_t> captured;
+
+        // names of the own locals that live in cells because closures capture them, see Captures
+        std::unordered_set<std::string> cells;
     };
 
     class Scopes {
@@ -64,10 +78,34 @@ namespace bond {
 
         bool has_globals() { return !m_scopes.empty(); }
 
+        void new_function(std::unordered_set<std::string> cells = {});
+
+        FunctionScope end_function();
+
+        uint32_t get_slot(const std::shared_ptr<Variable> &variable);
+
+        // whether the variable is accessed through a cell in the current function
+        bool is_cell(const std::shared_ptr<Variable> &variable);
+
+        // hides every scope but the global one until end_isolation, an inlined function body
+        // only sees its own names and the globals
+        void isolate() { m_barriers.push_back(m_scopes.size()); }
+
+        void end_isolation() { m_barriers.pop_back(); }
+
         void print();
 
     private:
+        uint32_t allocate_slot(const std::shared_ptr<Variable> &variable);
+
+        bool is_visible(size_t scope) const { return m_barriers.empty() or scope == 0 or scope >= m_barriers.back(); }
+
+        uint32_t capture(Variable *variable, size_t function);
+
         std::vector<std::unordered_map<std::string, std::shared_ptr<Variable>>> m_scopes;
+        std::vector<FunctionScope> m_functions;
+        // first scope visible inside each isolation
+        std::vector<size_t> m_barriers;
         Context *m_ctx;
     };
 
@@ -0,0 +1,498 @@
+//
+// optimization passes, see passes.h
+//
+
+#include "passes.h"
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+namespace bond {
+    using ir::Graph;
+    using ir::NONE;
+    using ir::ValueId;
+
+    // the most times the pipeline is repeated over one code object
+    constexpr uint32_t MAX_PASS_ROUNDS = 4;
+
+    PassManager::PassManager() {
+        add(std::make_unique<GvnPass>());
+        add(std::make_unique<LicmPass>());
+        add(std::make_unique<DcePass>());
+    }
+
+    bool PassManager::run(std::vector<Instruction> &instructions, const GcPtr<Code> &code, uint32_t &local_count) {
+        bool optimized = false;
+
+        for (uint32_t round = 0; round < MAX_PASS_ROUNDS; round++) {
+            bool changed = false;
+
+            // every pass gets a fresh graph, so none has to keep the ssa form up to date
+            for (auto &pass: m_passes) {
+                auto graph = Graph::build(instructions, code, local_count);
+                if (!graph) return optimized;
+                if (!pass->run(*graph)) continue;
+
+                instructions = graph->lower();
+                local_count = graph->local_count();
+                changed = optimized = true;
+            }
+
+            if (!changed) break;
+        }
+
+        return optimized;
+    }
+
+    // operations that compute their result from their inputs alone, or from a global or field
+    // that nothing between two of them wrote to
+    static bool is_value_operation(Opcode opcode) {
+        switch (opcode) {
+            case Opcode::LOAD_GLOBAL:
+            case Opcode::GET_ATTRIBUTE:
+            case Opcode::BIN_ADD:
+            case Opcode::BIN_SUB:
+            case Opcode::BIN_MUL:
+            case Opcode::BIN_DIV:
+            case Opcode::BIN_MOD:
+            case Opcode::NE:
+            case Opcode::EQ:
+            case Opcode::LE:
+            case Opcode::GT:
+            case Opcode::GE:
+            case Opcode::LT:
+            case Opcode::BIT_OR:
+            case Opcode::BIT_AND:
+            case Opcode::BIT_XOR:
+            case Opcode::UNARY_SUB:
+            case Opcode::NOT:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static bool falls_through(const ir::Block &block) {
+        if (block.nodes.empty()) return true;
+        auto opcode = block.nodes.back().opcode;
+        return opcode != Opcode::RETURN and opcode != Opcode::JUMP and opcode != Opcode::BREAK and
+               opcode != Opcode::CONTINUE;
+    }
+
+    // the pushes feeding node can be dropped along with it
+    static bool has_leaf_inputs(Graph &graph, const ir::Block &block, const ir::Node &node) {
+        return std::all_of(node.producers.begin(), node.producers.end(), [&](uint32_t producer) {
+            return producer != NONE and graph.is_leaf(block.nodes[producer]);
+        });
+    }
+
+    // pushed by a LOAD_CONST or PUSH_*, the same every time
+    static bool is_constant(Graph &graph, ValueId id) {
+        if (graph.value(id).kind != ir::Value::Kind::Result) return false;
+
+        auto &node = graph.node_of(id);
+        if (node.output != id or node.reload != NONE) return false;
+
+        switch (node.opcode) {
+            case Opcode::LOAD_CONST:
+            case Opcode::PUSH_TRUE:
+            case Opcode::PUSH_FALSE:
+            case Opcode::PUSH_NIL:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static void remove_inputs(ir::Block &block, const ir::Node &node) {
+        for (auto producer: node.producers) block.nodes[producer].removed = true;
+    }
+
+    struct GvnKey {
+        Opcode opcode;
+        uint32_t oprand;
+        // a value id, or the opcode and oprand of a constant in the upper and lower half
+        std::vector<uint64_t> inputs;
+
+        auto operator<=>(const GvnKey &other) const = default;
+    };
+
+    struct GvnEntry {
+        uint32_t block;
+        uint32_t node;
+        // entries that read globals or fields are only valid in the epoch they were made in
+        bool reads_memory;
+        uint64_t epoch;
+    };
+
+    class GvnWalk {
+    public:
+        explicit GvnWalk(Graph &graph) : m_graph(graph), m_children(graph.blocks().size()) {
+            for (auto b: graph.order()) {
+                auto idom = graph.blocks()[b].idom;
+                if (b != 0 and idom != NONE) m_children[idom].push_back(b);
+            }
+        }
+
+        bool run() {
+            visit(0, 0);
+            return m_changed;
+        }
+
+    private:
+        Graph &m_graph;
+        std::vector<std::vector<uint32_t>> m_children;
+        std::map<GvnKey, GvnEntry> m_table;
+        // outputs of replaced nodes, mapped to the output of the node replacing them
+        std::unordered_map<ValueId, ValueId> m_replaced;
+        uint64_t m_epochs = 0;
+        bool m_changed = false;
+
+        uint64_t canonical(ValueId id) {
+            id = m_graph.root(id);
+            if (is_constant(m_graph, id)) {
+                auto &node = m_graph.node_of(id);
+                return ((uint64_t) node.opcode + 1) << 32 | node.oprands[0];
+            }
+
+            auto replaced = m_replaced.find(id);
+            return replaced == m_replaced.end() ? id : replaced->second;
+        }
+
+        void visit(uint32_t b, uint64_t epoch) {
+            auto &block = m_graph.blocks()[b];
+
+            // memory reads carry over only into a block nothing else can reach first
+            if (block.preds.size() != 1 or block.preds[0] != block.idom) epoch = ++m_epochs;
+
+            std::vector<std::pair<GvnKey, std::optional<GvnEntry>>> undo;
+
+            for (uint32_t i = 0; i < block.nodes.size(); i++) {
+                auto &node = block.nodes[i];
+                auto effects = m_graph.effects_of(node);
+
+                if (is_value_operation(node.opcode) and !effects.writes() and node.output != NONE) {
+                    GvnKey key{node.opcode, node.oprands[0], {}};
+                    for (auto input: node.inputs) key.inputs.push_back(canonical(input));
+
+                    bool reads_memory = effects.reads_globals or effects.reads_heap;
+                    auto found = m_table.find(key);
+
+                    if (found != m_table.end() and (!found->second.reads_memory or found->second.epoch == epoch) and
+                        has_leaf_inputs(m_graph, block, node)) {
+                        replace(block, node, found->second);
+                        continue;
+                    }
+
+                    undo.emplace_back(key, found == m_table.end() ? std::nullopt : std::optional(found->second));
+                    m_table[key] = {b, i, reads_memory, epoch};
+                }
+
+                if (effects.writes()) epoch = ++m_epochs;
+            }
+
+            for (auto child: m_children[b]) visit(child, epoch);
+
+            for (auto it = undo.rbegin(); it != undo.rend(); it++) {
+                if (it->second) {
+                    m_table[it->first] = *it->second;
+                } else {
+                    m_table.erase(it->first);
+                }
+            }
+        }
+
+        void replace(ir::Block &block, ir::Node &node, const GvnEntry &entry) {
+            auto &original = m_graph.blocks()[entry.block].nodes[entry.node];
+            if (original.spill == NONE) original.spill = m_graph.new_local();
+
+            remove_inputs(block, node);
+            node.reload = original.spill;
+            m_replaced[node.output] = original.output;
+            m_changed = true;
+        }
+    };
+
+    bool GvnPass::run(Graph &graph) {
+        return GvnWalk(graph).run();
+    }
+
+    struct Loop {
+        uint32_t header;
+        std::vector<bool> blocks;
+        size_t size = 0;
+    };
+
+    static std::vector<Loop> find_loops(Graph &graph) {
+        auto &blocks = graph.blocks();
+        std::vector<Loop> loops;
+
+        for (auto b: graph.order()) {
+            for (auto header: blocks[b].succs) {
+                if (!graph.dominates(header, b)) continue;
+
+                auto loop = std::find_if(loops.begin(), loops.end(),
+                                         [&](const Loop &l) { return l.header == header; });
+                if (loop == loops.end()) {
+                    loops.push_back({header, std::vector<bool>(blocks.size(), false)});
+                    loop = loops.end() - 1;
+                    loop->blocks[header] = true;
+                    loop->size = 1;
+                }
+
+                // everything that reaches the back edge without going through the header
+                std::vector<uint32_t> pending{b};
+                while (!pending.empty()) {
+                    auto block = pending.back();
+                    pending.pop_back();
+                    if (loop->blocks[block]) continue;
+
+                    loop->blocks[block] = true;
+                    loop->size++;
+                    for (auto pred: blocks[block].preds) pending.push_back(pred);
+                }
+            }
+        }
+
+        // inner loops first, their hoisted code can then move out of the outer loop next round
+        std::sort(loops.begin(), loops.end(), [](const Loop &a, const Loop &b) { return a.size < b.size; });
+        return loops;
+    }
+
+    class LoopHoist {
+    public:
+        LoopHoist(Graph &graph, const Loop &loop) : m_graph(graph), m_loop(loop) {
+            auto &blocks = graph.blocks();
+            for (uint32_t b = 0; b < loop.blocks.size(); b++) {
+                if (!loop.blocks[b]) continue;
+                for (auto &node: blocks[b].nodes) {
+                    auto effects = graph.effects_of(node);
+                    m_writes_globals |= effects.writes_globals or effects.calls;
+                    m_writes_heap |= effects.writes_heap or effects.calls;
+                }
+            }
+        }
+
+        bool run() {
+            auto &layout = m_graph.layout();
+            auto position = std::find(layout.begin(), layout.end(), m_loop.header);
+            if (position == layout.begin() or position == layout.end()) return false;
+
+            // the preheader goes right before the header, where a loop block falling into the
+            // header would run into it
+            auto previous = *(position - 1);
+            if (m_loop.blocks[previous] and falls_through(m_graph.blocks()[previous])) return false;
+
+            hoist_from(m_loop.header);
+            if (!m_hoisted.empty()) {
+                add_preheader(m_loop.header, std::nullopt);
+                return true;
+            }
+
+            auto body = rotatable_body();
+            if (!body) return false;
+
+            hoist_from(*body);
+            if (m_hoisted.empty()) return false;
+
+            add_preheader(m_loop.header, body);
+            return true;
+        }
+
+    private:
+        Graph &m_graph;
+        const Loop &m_loop;
+        bool m_writes_globals = false;
+        bool m_writes_heap = false;
+        // copies of the hoisted nodes and their inputs, in order
+        std::vector<ir::Node> m_hoisted;
+        std::vector<ValueId> m_invariant;
+
+        bool is_invariant(ValueId id) {
+            auto &value = m_graph.value(id);
+            if (value.kind == ir::Value::Kind::Entry or !m_loop.blocks[value.block]) return true;
+            if (is_constant(m_graph, id)) return true;
+            return std::find(m_invariant.begin(), m_invariant.end(), id) != m_invariant.end();
+        }
+
+        bool can_hoist(const ir::Block &block, const ir::Node &node) {
+            if (!is_value_operation(node.opcode) or node.output == NONE) return false;
+
+            auto effects = m_graph.effects_of(node);
+            if (effects.writes()) return false;
+            if (effects.reads_globals and m_writes_globals) return false;
+            if (effects.reads_heap and m_writes_heap) return false;
+
+            return has_leaf_inputs(m_graph, block, node) and
+                   std::all_of(node.inputs.begin(), node.inputs.end(), [&](ValueId id) { return is_invariant(id); });
+        }
+
+        static ir::Node copy(const ir::Node &node) {
+            if (node.reload != NONE) return {Opcode::LOAD_FAST, {node.reload, 0}, node.span};
+            return {node.opcode, node.oprands, node.span};
+        }
+
+        // hoists the operations at the start of block that run before anything observable
+        void hoist_from(uint32_t b) {
+            auto &block = m_graph.blocks()[b];
+
+            for (auto &node: block.nodes) {
+                if (is_jump(node.opcode)) break;
+
+                if (can_hoist(block, node)) {
+                    auto slot = m_graph.new_local();
+                    for (auto producer: node.producers) m_hoisted.push_back(copy(block.nodes[producer]));
+                    m_hoisted.push_back(copy(node));
+                    m_hoisted.push_back({Opcode::CREATE_LOCAL, {slot, 0}, node.span});
+
+                    remove_inputs(block, node);
+                    node.reload = slot;
+                    m_invariant.push_back(node.output);
+                    continue;
+                }
+
+                if (m_graph.is_leaf(node)) continue;
+
+                auto effects = m_graph.effects_of(node);
+                if (effects.may_fail or effects.writes()) break;
+            }
+        }
+
+        // a loop whose header only tests a condition, the block it falls into when the test
+        // passes can have its operations hoisted behind a copy of the test
+        std::optional<uint32_t> rotatable_body() {
+            auto &blocks = m_graph.blocks();
+            auto &header = blocks[m_loop.header];
+            if (!header.stack.empty() or header.nodes.empty()) return std::nullopt;
+
+            auto &branch = header.nodes.back();
+            if (branch.opcode != Opcode::JUMP_IF_FALSE or m_loop.blocks[branch.target]) return std::nullopt;
+
+            for (size_t i = 0; i + 1 < header.nodes.size(); i++) {
+                if (m_graph.effects_of(header.nodes[i]).writes()) return std::nullopt;
+            }
+
+            auto &layout = m_graph.layout();
+            auto position = std::find(layout.begin(), layout.end(), m_loop.header);
+            if (position + 1 == layout.end()) return std::nullopt;
+
+            auto body = *(position + 1);
+            if (!m_loop.blocks[body] or blocks[body].preds.size() != 1) return std::nullopt;
+            return body;
+        }
+
+        void add_preheader(uint32_t header, std::optional<uint32_t> body) {
+            auto preheader = m_graph.add_block();
+            auto &blocks = m_graph.blocks();
+
+            std::vector<ir::Node> nodes;
+            if (body) {
+                for (auto &node: blocks[header].nodes) {
+                    nodes.push_back(copy(node));
+                    nodes.back().target = node.target;
+                }
+            }
+            nodes.insert(nodes.end(), m_hoisted.begin(), m_hoisted.end());
+            if (body) {
+                nodes.push_back({Opcode::JUMP, {0, 0}, blocks[header].nodes.back().span});
+                nodes.back().target = *body;
+            }
+            blocks[preheader].nodes = std::move(nodes);
+
+            for (auto pred: blocks[header].preds) {
+                if (m_loop.blocks[pred] or blocks[pred].nodes.empty()) continue;
+                auto &last = blocks[pred].nodes.back();
+                if (last.target == header) last.target = preheader;
+            }
+
+            auto &layout = m_graph.layout();
+            layout.insert(std::find(layout.begin(), layout.end(), header), preheader);
+        }
+    };
+
+    bool LicmPass::run(Graph &graph) {
+        auto loops = find_loops(graph);
+        std::vector<bool> touched(graph.blocks().size(), false);
+        bool changed = false;
+
+        for (auto &loop: loops) {
+            // a loop sharing blocks with one already rewritten waits for the next round
+            bool overlaps = false;
+            for (uint32_t b = 0; b < touched.size(); b++) overlaps |= loop.blocks[b] and touched[b];
+            if (overlaps) continue;
+
+            if (!LoopHoist(graph, loop).run()) continue;
+
+            for (uint32_t b = 0; b < touched.size(); b++) touched[b] = touched[b] or loop.blocks[b];
+            changed = true;
+        }
+
+        return changed;
+    }
+
+    bool DcePass::run(Graph &graph) {
+        auto &blocks = graph.blocks();
+        std::vector<bool> live(graph.value_count(), false);
+        std::vector<ValueId> pending;
+
+        for (auto b: graph.order()) {
+            for (auto &node: blocks[b].nodes) {
+                if (node.opcode == Opcode::LOAD_FAST) pending.push_back(node.local);
+                pending.insert(pending.end(), node.captures.begin(), node.captures.end());
+            }
+        }
+
+        // a merged version is read wherever the merge is
+        while (!pending.empty()) {
+            auto id = pending.back();
+            pending.pop_back();
+            if (live[id]) continue;
+
+            live[id] = true;
+            if (graph.value(id).kind == ir::Value::Kind::Phi) {
+                auto &inputs = graph.value(id).inputs;
+                pending.insert(pending.end(), inputs.begin(), inputs.end());
+            }
+        }
+
+        bool changed = false;
+        for (auto b: graph.order()) {
+            auto &block = blocks[b];
+
+            for (auto &node: block.nodes) {
+                bool dead_store = node.local != NONE and !live[node.local];
+
+                if (node.opcode == Opcode::STORE_FAST and dead_store) {
+                    node.removed = true;
+                    changed = true;
+                    continue;
+                }
+
+                // a value that is only popped, together with whatever computed it
+                bool discards = node.opcode == Opcode::POP_TOP or (node.opcode == Opcode::CREATE_LOCAL and dead_store);
+                if (!discards or node.producers[0] == NONE) continue;
+
+                auto &producer = block.nodes[node.producers[0]];
+                if (producer.removed) continue;
+
+                auto effects = graph.effects_of(producer);
+                bool pure = !effects.may_fail and !effects.writes() and !effects.reads_globals and
+                            !effects.reads_heap and producer.output != NONE and producer.spill == NONE;
+
+                if (graph.is_leaf(producer)) {
+                    producer.removed = true;
+                } else if (pure and producer.local == NONE and has_leaf_inputs(graph, block, producer)) {
+                    remove_inputs(block, producer);
+                    producer.removed = true;
+                } else {
+                    continue;
+                }
+
+                node.removed = true;
+                changed = true;
+            }
+        }
+
+        return changed;
+    }
+}
@@ -0,0 +1,59 @@
+//
+// optimization passes over the ssa form in ir.h
+//
+
+#ifndef BOND_PASSES_H
+#define BOND_PASSES_H
+
+#include "ir.h"
+#include <memory>
+#include <vector>
+
+namespace bond {
+    class Pass {
+    public:
+        virtual ~Pass() = default;
+
+        // rewrites graph through the rewrites in ir::Node, true when anything changed
+        virtual bool run(ir::Graph &graph) = 0;
+    };
+
+    // replaces an operation by a local holding the result of an identical one that dominates
+    // it. operations that read globals or fields are only reused while nothing in between can
+    // have written to them
+    class GvnPass : public Pass {
+    public:
+        bool run(ir::Graph &graph) override;
+    };
+
+    // moves operations whose inputs do not change inside a loop in front of it, when the loop
+    // would have run them on its first iteration anyway
+    class LicmPass : public Pass {
+    public:
+        bool run(ir::Graph &graph) override;
+    };
+
+    // removes stores to locals that are never read and values pushed only to be popped
+    class DcePass : public Pass {
+    public:
+        bool run(ir::Graph &graph) override;
+    };
+
+    class PassManager {
+    public:
+        // the default pipeline, gvn then licm then dce
+        PassManager();
+
+        void add(std::unique_ptr<Pass> pass) { m_passes.push_back(std::move(pass)); }
+
+        // runs the passes over instructions until they stop changing anything, local_count
+        // grows by the locals the passes added. false when nothing changed or the code uses
+        // something the ir does not model
+        bool run(std::vector<Instruction> &instructions, const GcPtr<Code> &code, uint32_t &local_count);
+
+    private:
+        std::vector<std::unique_ptr<Pass>> m_passes;
+    };
+}
+
+#endif //BOND_PASSES_H
@@ -0,0 +1,591 @@
+//
+// register code generation, see regcodegen.h
+//
+
+#include "regcodegen.h"
+#include "../runtime.h"
+
+namespace bond {
+    namespace {
+        // thrown when a node only the stack vm can run is met, the function keeps its stack code
+        struct Unsupported {};
+    }
+
+    t_string RegisterCode::disassemble() const {
+        t_string out;
+        for (size_t i = 0; i < m_instructions.size(); i++) {
+            auto &ins = m_instructions[i];
+            out += fmt::format("{:>4} {:<16} {} {} {}\n", i, reg_opcode_name(ins.opcode), ins.a, ins.b, ins.c);
+        }
+        return out;
+    }
+
+    RegisterGenerator::RegisterGenerator(Context *ctx, const GcPtr<Code> &code) : m_ctx(ctx), m_code(code) {}
+
+    void RegisterGenerator::unsupported() {
+        throw Unsupported{};
+    }
+
+    std::shared_ptr<RegisterCode> RegisterGenerator::generate(FuncDef *function) {
+        // captured values are copied into slots of the stack frame, which registers do not follow.
+        // a body that is a bare expression returns what the stack code does after it, so it is
+        // left to the stack code as well
+        auto body = function->get_body();
+        if (!m_code->get_captures().empty() or !instanceof<Block>(body.get())) return nullptr;
+
+        try {
+            m_scopes.emplace_back();
+            for (auto &param: function->get_params()) {
+                declare(param->name, temporary());
+            }
+            m_live = m_top;
+
+            statement(body);
+
+            auto span = function->get_span();
+            auto nil = singleton(m_nil, Runtime::ins()->C_NONE);
+            if (function->can_error()) {
+                auto result = temporary();
+                emit(RegOpcode::MAKE_OK, result, nil, 0, span);
+                emit(RegOpcode::RETURN, result, 0, 0, span);
+            } else {
+                emit(RegOpcode::RETURN, nil, 0, 0, span);
+            }
+        } catch (Unsupported &) {
+            return nullptr;
+        }
+
+        // the constant registers go after the others now they are all counted, no other
+        // field gets anywhere near CONSTANT_BASE
+        auto relocate = [this](uint32_t &field) {
+            if (field >= CONSTANT_BASE) field = field - CONSTANT_BASE + m_register_count;
+        };
+        for (auto &ins: m_instructions) {
+            relocate(ins.a);
+            relocate(ins.b);
+            relocate(ins.c);
+        }
+
+        return std::make_shared<RegisterCode>(std::move(m_instructions), std::move(m_spans), std::move(m_constants),
+                                              m_register_count, m_stack_size);
+    }
+
+    size_t RegisterGenerator::emit(RegOpcode opcode, uint32_t a, uint32_t b, uint32_t c, const SharedSpan &span) {
+        m_instructions.push_back({opcode, a, b, c});
+        m_spans.push_back(span);
+        return m_instructions.size() - 1;
+    }
+
+    void RegisterGenerator::patch(size_t index, size_t target) {
+        auto &ins = m_instructions[index];
+        switch (ins.opcode) {
+            case RegOpcode::JUMP:
+                ins.a = (uint32_t) target;
+                break;
+            case RegOpcode::JUMP_IF_FALSE:
+                ins.b = (uint32_t) target;
+                break;
+            default:
+                ins.c = (uint32_t) target;
+                break;
+        }
+    }
+
+    uint32_t RegisterGenerator::temporary() {
+        auto reg = m_top++;
+        m_register_count = std::max(m_register_count, m_top);
+        return reg;
+    }
+
+    void RegisterGenerator::declare(const t_string &name, uint32_t reg) {
+        m_scopes.back()[name] = reg;
+    }
+
+    std::optional<uint32_t> RegisterGenerator::local(const t_string &name) {
+        for (auto scope = m_scopes.rbegin(); scope != m_scopes.rend(); scope++) {
+            if (auto it = scope->find(name); it != scope->end()) return it->second;
+        }
+        return std::nullopt;
+    }
+
+    uint32_t RegisterGenerator::constant(const GcPtr<Object> &value) {
+        auto index = m_code->add_constant(value);
+        if (auto it = m_constant_registers.find(index); it != m_constant_registers.end()) return it->second;
+
+        auto reg = CONSTANT_BASE + (uint32_t) m_constants.size();
+        m_constants.push_back(m_code->get_constant(index));
+        m_constant_registers[index] = reg;
+        return reg;
+    }
+
+    uint32_t RegisterGenerator::singleton(uint32_t &reg, const GcPtr<Object> &value) {
+        if (reg == NO_REGISTER) {
+            reg = CONSTANT_BASE + (uint32_t) m_constants.size();
+            m_constants.push_back(value);
+        }
+        return reg;
+    }
+
+    uint32_t RegisterGenerator::expression(const SharedNode &node, uint32_t target) {
+        auto previous = m_target;
+        m_target = target;
+        m_result = NO_REGISTER;
+
+        node->accept(this);
+
+        m_target = previous;
+        if (m_result == NO_REGISTER) unsupported();
+        return m_result;
+    }
+
+    uint32_t RegisterGenerator::destination() {
+        return m_target != NO_REGISTER ? m_target : temporary();
+    }
+
+    void RegisterGenerator::result(uint32_t reg, const SharedSpan &span) {
+        if (m_target != NO_REGISTER and m_target != reg) {
+            emit(RegOpcode::MOVE, m_target, reg, 0, span);
+            reg = m_target;
+        }
+        m_result = reg;
+    }
+
+    void RegisterGenerator::statement(const SharedNode &node) {
+        m_target = NO_REGISTER;
+        node->accept(this);
+        // temporaries do not outlive the statement that made them
+        m_top = m_live;
+    }
+
+    static std::optional<RegOpcode> compare_jump(TokenType type) {
+        switch (type) {
+            case TokenType::BANG_EQUAL:
+                return RegOpcode::JUMP_IF_NOT_NE;
+            case TokenType::EQUAL_EQUAL:
+                return RegOpcode::JUMP_IF_NOT_EQ;
+            case TokenType::LESS:
+                return RegOpcode::JUMP_IF_NOT_LT;
+            case TokenType::LESS_EQUAL:
+                return RegOpcode::JUMP_IF_NOT_LE;
+            case TokenType::GREATER:
+                return RegOpcode::JUMP_IF_NOT_GT;
+            case TokenType::GREATER_EQUAL:
+                return RegOpcode::JUMP_IF_NOT_GE;
+            default:
+                return std::nullopt;
+        }
+    }
+
+    size_t RegisterGenerator::jump_if_false(const SharedNode &condition, const SharedSpan &span) {
+        if (auto binary = dynamic_cast<BinaryOp *>(condition.get())) {
+            if (auto jump = compare_jump(binary->get_op().get_type())) {
+                auto left = expression(binary->get_left());
+                auto right = expression(binary->get_right());
+                return emit(*jump, left, right, 0, binary->get_op().get_span());
+            }
+        }
+
+        auto reg = expression(condition);
+        return emit(RegOpcode::JUMP_IF_FALSE, reg, 0, 0, span);
+    }
+
+    void RegisterGenerator::visit(BinaryOp *expr) {
+        RegOpcode opcode;
+        switch (expr->get_op().get_type()) {
+            case TokenType::PLUS:
+                opcode = RegOpcode::ADD;
+                break;
+            case TokenType::MINUS:
+                opcode = RegOpcode::SUB;
+                break;
+            case TokenType::STAR:
+                opcode = RegOpcode::MUL;
+                break;
+            case TokenType::SLASH:
+                opcode = RegOpcode::DIV;
+                break;
+            case TokenType::MOD:
+                opcode = RegOpcode::MOD;
+                break;
+            case TokenType::BANG_EQUAL:
+                opcode = RegOpcode::NE;
+                break;
+            case TokenType::EQUAL_EQUAL:
+                opcode = RegOpcode::EQ;
+                break;
+            case TokenType::LESS:
+                opcode = RegOpcode::LT;
+                break;
+            case TokenType::LESS_EQUAL:
+                opcode = RegOpcode::LE;
+                break;
+            case TokenType::GREATER:
+                opcode = RegOpcode::GT;
+                break;
+            case TokenType::GREATER_EQUAL:
+                opcode = RegOpcode::GE;
+                break;
+            case TokenType::OR:
+                opcode = RegOpcode::OR;
+                break;
+            case TokenType::AND:
+                opcode = RegOpcode::AND;
+                break;
+            case TokenType::BITWISE_OR:
+                opcode = RegOpcode::BIT_OR;
+                break;
+            case TokenType::BITWISE_AND:
+                opcode = RegOpcode::BIT_AND;
+                break;
+            case TokenType::BITWISE_XOR:
+                opcode = RegOpcode::BIT_XOR;
+                break;
+            default:
+                unsupported();
+        }
+
+        // only the last instruction of an expression writes its target, so the operands may
+        // be read straight from the registers of locals, the target among them
+        auto left = expression(expr->get_left());
+        auto right = expression(expr->get_right());
+        auto dest = destination();
+        emit(opcode, dest, left, right, expr->get_op().get_span());
+        m_result = dest;
+    }
+
+    void RegisterGenerator::visit(Unary *expr) {
+        RegOpcode opcode;
+        switch (expr->get_op().get_type()) {
+            case TokenType::MINUS:
+                opcode = RegOpcode::NEG;
+                break;
+            case TokenType::BANG:
+                opcode = RegOpcode::NOT;
+                break;
+            default:
+                unsupported();
+        }
+
+        auto value = expression(expr->get_expr());
+        auto dest = destination();
+        emit(opcode, dest, value, 0, expr->get_op().get_span());
+        m_result = dest;
+    }
+
+    void RegisterGenerator::visit(TrueLiteral *expr) {
+        result(singleton(m_true, Runtime::ins()->C_TRUE), expr->get_span());
+    }
+
+    void RegisterGenerator::visit(FalseLiteral *expr) {
+        result(singleton(m_false, Runtime::ins()->C_FALSE), expr->get_span());
+    }
+
+    void RegisterGenerator::visit(NumberLiteral *expr) {
+        GcPtr<Object> value;
+        if (expr->is_int()) value = Runtime::ins()->make_int(std::stoll(expr->get_value()));
+        else if (expr->is_exact()) value = Runtime::ins()->make_float(std::stod(expr->get_value()));
+        else value = Runtime::ins()->make_float(std::stof(expr->get_value()));
+
+        result(constant(value), expr->get_span());
+    }
+
+    void RegisterGenerator::visit(StringLiteral *expr) {
+        result(constant(Runtime::ins()->make_string_cache(expr->get_value())), expr->get_span());
+    }
+
+    void RegisterGenerator::visit(NilLiteral *expr) {
+        result(singleton(m_nil, Runtime::ins()->C_NONE), expr->get_span());
+    }
+
+    void RegisterGenerator::visit(ExprStmnt *stmnt) {
+        // assignments are statements here, as expressions they could change a local an
+        // enclosing expression has already read
+        if (auto assign = dynamic_cast<Assign *>(stmnt->get_expr().get())) {
+            if (auto reg = local(assign->get_name())) {
+                expression(assign->get_expr(), *reg);
+                return;
+            }
+
+            auto value = expression(assign->get_expr());
+            auto name = m_code->add_constant(Runtime::ins()->make_string_cache(assign->get_name()));
+            emit(RegOpcode::STORE_GLOBAL, name, value, 0, assign->get_span());
+            emit(RegOpcode::DISCARD, value, 0, 0, stmnt->get_span());
+            return;
+        }
+
+        auto value = expression(stmnt->get_expr());
+        emit(RegOpcode::DISCARD, value, 0, 0, stmnt->get_span());
+    }
+
+    void RegisterGenerator::visit(Identifier *expr) {
+        if (auto reg = local(expr->get_name())) {
+            result(*reg, expr->get_span());
+            return;
+        }
+
+        // anything else is a global, a function that captured would have been turned down
+        auto name = m_code->add_constant(Runtime::ins()->make_string_cache(expr->get_name()));
+        auto dest = destination();
+        emit(RegOpcode::LOAD_GLOBAL, dest, name, 0, expr->get_span());
+        m_result = dest;
+    }
+
+    void RegisterGenerator::visit(NewVar *stmnt) {
+        // the new local takes the first free register, its initializer is compiled before the
+        // name is in scope
+        auto reg = temporary();
+        expression(stmnt->get_expr(), reg);
+        declare(stmnt->get_name(), reg);
+        m_live = reg + 1;
+    }
+
+    void RegisterGenerator::visit(Assign *) {
+        unsupported();
+    }
+
+    void RegisterGenerator::visit(Block *stmnt) {
+        auto live = m_live;
+        m_scopes.emplace_back();
+
+        for (auto &node: stmnt->get_nodes()) {
+            statement(node);
+        }
+
+        m_scopes.pop_back();
+        m_live = m_top = live;
+    }
+
+    void RegisterGenerator::visit(ListLiteral *expr) {
+        auto nodes = expr->get_nodes();
+        auto base = m_top;
+        for (auto &node: nodes) {
+            auto reg = temporary();
+            expression(node, reg);
+            m_top = reg + 1;
+        }
+
+        auto dest = destination();
+        emit(RegOpcode::BUILD_LIST, dest, base, (uint32_t) nodes.size(), expr->get_span());
+        m_result = dest;
+    }
+
+    void RegisterGenerator::visit(DictLiteral *expr) {
+        auto pairs = expr->get_pairs();
+        auto base = m_top;
+        for (auto &[key, value]: pairs) {
+            auto reg = temporary();
+            expression(key, reg);
+            m_top = reg + 1;
+
+            reg = temporary();
+            expression(value, reg);
+            m_top = reg + 1;
+        }
+
+        auto dest = destination();
+        emit(RegOpcode::BUILD_DICT, dest, base, (uint32_t) pairs.size(), expr->get_span());
+        m_result = dest;
+    }
+
+    void RegisterGenerator::visit(GetItem *expr) {
+        auto object = expression(expr->get_expr());
+        auto index = expression(expr->get_index());
+        auto dest = destination();
+        emit(RegOpcode::GET_ITEM, dest, object, index, expr->get_span());
+        m_result = dest;
+    }
+
+    void RegisterGenerator::visit(SetItem *expr) {
+        auto object = expression(expr->get_expr());
+        auto index = expression(expr->get_index());
+        auto value = expression(expr->get_value());
+        emit(RegOpcode::SET_ITEM, object, index, value, expr->get_span());
+        result(value, expr->get_span());
+    }
+
+    void RegisterGenerator::visit(If *stmnt) {
+        auto next = jump_if_false(stmnt->get_condition(), stmnt->get_span());
+        m_top = m_live;
+        statement(stmnt->get_then());
+
+        if (!stmnt->get_else().has_value()) {
+            patch(next, current_index());
+            return;
+        }
+
+        auto end = emit(RegOpcode::JUMP, 0, 0, 0, stmnt->get_span());
+        patch(next, current_index());
+        statement(stmnt->get_else().value());
+        patch(end, current_index());
+    }
+
+    void RegisterGenerator::visit(While *stmnt) {
+        m_break_stack.emplace_back();
+        m_continue_stack.emplace_back();
+
+        auto start = current_index();
+        auto exit = jump_if_false(stmnt->get_condition(), stmnt->get_span());
+        m_top = m_live;
+
+        statement(stmnt->get_statement());
+        emit(RegOpcode::JUMP, (uint32_t) start, 0, 0, stmnt->get_span());
+
+        auto end = current_index();
+        patch(exit, end);
+        for (auto index: m_break_stack.back()) patch(index, end);
+        for (auto index: m_continue_stack.back()) patch(index, start);
+        m_break_stack.pop_back();
+        m_continue_stack.pop_back();
+    }
+
+    void RegisterGenerator::visit(For *stmnt) {
+        m_break_stack.emplace_back();
+        m_continue_stack.emplace_back();
+
+        auto live = m_live;
+        m_scopes.emplace_back();
+
+        // the loop variable and the iterator are held for the whole loop. the variable is in
+        // scope, as nil, while the iterable is evaluated, like in the stack code
+        auto item = temporary();
+        auto iterator = temporary();
+        m_live = m_top;
+        declare(stmnt->get_name(), item);
+        emit(RegOpcode::MOVE, item, singleton(m_nil, Runtime::ins()->C_NONE), 0, stmnt->get_span());
+
+        auto iterable = expression(stmnt->get_expr());
+        emit(RegOpcode::ITER, iterator, iterable, 0, stmnt->get_span());
+        m_top = m_live;
+
+        auto start = current_index();
+        auto exit = emit(RegOpcode::FOR_ITER, item, iterator, 0, stmnt->get_span());
+
+        statement(stmnt->get_statement());
+        emit(RegOpcode::JUMP, (uint32_t) start, 0, 0, stmnt->get_span());
+
+        auto end = current_index();
+        patch(exit, end);
+        for (auto index: m_break_stack.back()) patch(index, end);
+        for (auto index: m_continue_stack.back()) patch(index, start);
+        m_break_stack.pop_back();
+        m_continue_stack.pop_back();
+
+        m_scopes.pop_back();
+        m_live = m_top = live;
+    }
+
+    void RegisterGenerator::visit(Call *expr) {
+        // the callee and its arguments go in consecutive registers
+        auto args = expr->get_args();
+        auto base = temporary();
+        expression(expr->get_expr(), base);
+        m_top = base + 1;
+
+        for (auto &arg: args) {
+            auto reg = temporary();
+            expression(arg, reg);
+            m_top = reg + 1;
+        }
+
+        auto dest = destination();
+        emit(RegOpcode::CALL, dest, base, (uint32_t) args.size(), expr->get_span());
+        m_stack_size = std::max(m_stack_size, (uint32_t) args.size() + 2);
+        m_result = dest;
+    }
+
+    void RegisterGenerator::visit(CallMethod *expr) {
+        auto attribute = expr->get_node();
+        auto args = expr->get_args();
+
+        auto base = temporary();
+        expression(attribute->get_expr(), base);
+        m_top = base + 1;
+
+        for (auto &arg: args) {
+            auto reg = temporary();
+            expression(arg, reg);
+            m_top = reg + 1;
+        }
+
+        auto dest = destination();
+        auto name = m_code->add_constant(Runtime::ins()->make_string_cache(attribute->get_name()));
+        emit(RegOpcode::CALL_METHOD, dest, base, (uint32_t) args.size(), expr->get_span());
+        emit(RegOpcode::EXTRA, m_code->add_method_cache(), name, 0, expr->get_span());
+        m_stack_size = std::max(m_stack_size, (uint32_t) args.size() + 3);
+        m_result = dest;
+    }
+
+    void RegisterGenerator::visit(GetAttribute *expr) {
+        auto object = expression(expr->get_expr());
+        auto name = m_code->add_constant(Runtime::ins()->make_string_cache(expr->get_name()));
+        auto dest = destination();
+        emit(RegOpcode::GET_ATTR, dest, object, name, expr->get_span());
+        m_result = dest;
+    }
+
+    void RegisterGenerator::visit(SetAttribute *expr) {
+        auto object = expression(expr->get_expr());
+        auto name = m_code->add_constant(Runtime::ins()->make_string_cache(expr->get_name()));
+        auto value = expression(expr->get_value());
+        emit(RegOpcode::SET_ATTR, object, name, value, expr->get_span());
+        result(value, expr->get_span());
+    }
+
+    void RegisterGenerator::visit(Return *stmnt) {
+        auto expr = stmnt->get_expr();
+        auto value = expr ? expression(expr) : singleton(m_nil, Runtime::ins()->C_NONE);
+        emit(RegOpcode::RETURN, value, 0, 0, stmnt->get_span());
+    }
+
+    void RegisterGenerator::visit(Try *stmnt) {
+        auto value = expression(stmnt->get_expr());
+        auto dest = destination();
+        emit(RegOpcode::TRY, dest, value, 0, stmnt->get_span());
+        m_result = dest;
+    }
+
+    void RegisterGenerator::visit(ResultStatement *expr) {
+        auto value = expression(expr->get_expr());
+        auto result = temporary();
+        emit(expr->is_error() ? RegOpcode::MAKE_ERROR : RegOpcode::MAKE_OK, result, value, 0, expr->get_span());
+        emit(RegOpcode::RETURN, result, 0, 0, expr->get_span());
+    }
+
+    void RegisterGenerator::visit(Break *stmnt) {
+        if (m_break_stack.empty()) unsupported();
+        m_break_stack.back().push_back(emit(RegOpcode::JUMP, 0, 0, 0, stmnt->get_span()));
+    }
+
+    void RegisterGenerator::visit(Continue *stmnt) {
+        if (m_continue_stack.empty()) unsupported();
+        m_continue_stack.back().push_back(emit(RegOpcode::JUMP, 0, 0, 0, stmnt->get_span()));
+    }
+
+    void RegisterGenerator::visit(FuncDef *) {
+        unsupported();
+    }
+
+    void RegisterGenerator::visit(ClosureDef *) {
+        unsupported();
+    }
+
+    void RegisterGenerator::visit(StructNode *) {
+        unsupported();
+    }
+
+    void RegisterGenerator::visit(ImportDef *) {
+        unsupported();
+    }
+
+    void RegisterGenerator::visit(AsyncDef *) {
+        unsupported();
+    }
+
+    void RegisterGenerator::visit(Await *) {
+        unsupported();
+    }
+
+    void RegisterGenerator::visit(StructuredAssign *) {
+        unsupported();
+    }
+}
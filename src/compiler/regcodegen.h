@@ -0,0 +1,285 @@
+//
+// register backend, an alternative to the stack bytecode for script functions
+//
+// the register code of a function is generated from the same ast as its stack bytecode by
+// RegisterGenerator below and run by Vm::call_registers, see regvm.cpp. instructions are three
+// address, a = b op c, and read and write registers in place rather than going through the
+// operand stack. registers are the frame's local slots: the arguments first, then the
+// function's locals and temporaries, then one register per constant the code reads, filled in
+// when the frame is entered.
+//
+// functions whose bodies use something only the stack vm runs (closures, nested functions,
+// structs, imports, async) get no register code and always run on the stack vm
+//
+
+#ifndef BOND_REGCODEGEN_H
+#define BOND_REGCODEGEN_H
+
+#include "nodevisitor.h"
+#include "ast.h"
+#include "../object.h"
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace bond {
+    class Context;
+
+    // every register instruction, with what it does to its a, b and c fields
+#define BOND_REGISTER_OPCODES(X) \
+        X(MOVE)             /* a = b */ \
+        X(LOAD_GLOBAL)      /* a = the global named by constant b */ \
+        X(STORE_GLOBAL)     /* the global named by constant a = b */ \
+        X(ADD)              /* a = b + c */ \
+        X(SUB) \
+        X(MUL) \
+        X(DIV) \
+        X(MOD) \
+        X(LT)               /* a = b < c */ \
+        X(LE) \
+        X(GT) \
+        X(GE) \
+        X(EQ) \
+        X(NE) \
+        X(BIT_OR)           /* a = b | c */ \
+        X(BIT_AND) \
+        X(BIT_XOR) \
+        X(OR)               /* a = b or c, both sides are evaluated like the stack vm does */ \
+        X(AND) \
+        X(NEG)              /* a = -b */ \
+        X(NOT)              /* a = !b */ \
+        X(JUMP)             /* goes to a */ \
+        X(JUMP_IF_FALSE)    /* goes to b when a is falsy */ \
+        X(JUMP_IF_NOT_LT)   /* goes to c unless a < b */ \
+        X(JUMP_IF_NOT_LE) \
+        X(JUMP_IF_NOT_GT) \
+        X(JUMP_IF_NOT_GE) \
+        X(JUMP_IF_NOT_EQ) \
+        X(JUMP_IF_NOT_NE) \
+        X(CALL)             /* a = b(b + 1, .., b + c) */ \
+        X(CALL_METHOD)      /* a = b.name(b + 1, .., b + c), see the EXTRA after it */ \
+        X(EXTRA)            /* the method cache a and the name's constant b of the CALL_METHOD before it */ \
+        X(GET_ATTR)         /* a = b.(constant c) */ \
+        X(SET_ATTR)         /* a.(constant b) = c */ \
+        X(GET_ITEM)         /* a = b[c] */ \
+        X(SET_ITEM)         /* a[b] = c */ \
+        X(BUILD_LIST)       /* a = [b, .., b + c - 1] */ \
+        X(BUILD_DICT)       /* a = {b: b + 1, ..}, with c pairs */ \
+        X(ITER)             /* a = an iterator over b */ \
+        X(FOR_ITER)         /* a = the next item of iterator b, goes to c when it is done */ \
+        X(MAKE_OK)          /* a = Ok(b) */ \
+        X(MAKE_ERROR)       /* a = Error(b) */ \
+        X(TRY)              /* a = the value of result b, returns b when it is an error */ \
+        X(DISCARD)          /* fails when a is a result, the stack vm's POP_TOP check */ \
+        X(RETURN)           /* returns a */
+
+    enum class RegOpcode : uint32_t {
+#define BOND_REGISTER_OPCODE_ENUM(name) name,
+        BOND_REGISTER_OPCODES(BOND_REGISTER_OPCODE_ENUM)
+#undef BOND_REGISTER_OPCODE_ENUM
+    };
+
+    constexpr const char *reg_opcode_name(RegOpcode opcode) {
+        constexpr const char *names[] = {
+#define BOND_REGISTER_OPCODE_NAME(name) #name,
+                BOND_REGISTER_OPCODES(BOND_REGISTER_OPCODE_NAME)
+#undef BOND_REGISTER_OPCODE_NAME
+        };
+        return names[static_cast<uint32_t>(opcode)];
+    }
+
+    struct RegInstruction {
+        RegOpcode opcode;
+        uint32_t a;
+        uint32_t b;
+        uint32_t c;
+    };
+
+    class RegisterCode {
+    public:
+        RegisterCode(std::vector<RegInstruction> instructions, std::vector<SharedSpan> spans,
+                     std::vector<GcPtr<Object>> constants, uint32_t register_count, uint32_t stack_size)
+                : m_instructions(std::move(instructions)), m_spans(std::move(spans)),
+                  m_constants(std::move(constants)), m_register_count(register_count),
+                  m_stack_size(stack_size) {}
+
+        [[nodiscard]] const std::vector<RegInstruction> &get_instructions() const { return m_instructions; }
+
+        [[nodiscard]] SharedSpan get_span(size_t index) const {
+            return m_spans[std::min(index, m_spans.size() - 1)];
+        }
+
+        // values of the constant registers, which follow the other registers. these are
+        // constants of the code object or the runtime's singletons, which keep them alive
+        // while this vector is out of the collector's sight
+        [[nodiscard]] const std::vector<GcPtr<Object>> &get_constants() const { return m_constants; }
+
+        // registers that are not constants, the arguments are the first of them
+        [[nodiscard]] uint32_t get_register_count() const { return m_register_count; }
+
+        [[nodiscard]] uint32_t get_frame_size() const { return m_register_count + (uint32_t) m_constants.size(); }
+
+        // operand stack slots the frame needs, for the calls it makes and the operations
+        // that fall back to the vm's helpers
+        [[nodiscard]] uint32_t get_stack_size() const { return m_stack_size; }
+
+        [[nodiscard]] t_string disassemble() const;
+
+    private:
+        std::vector<RegInstruction> m_instructions;
+        std::vector<SharedSpan> m_spans;
+        std::vector<GcPtr<Object>> m_constants;
+        uint32_t m_register_count;
+        uint32_t m_stack_size;
+    };
+
+    class RegisterGenerator : public NodeVisitor {
+    public:
+        // constants are added to code, the stack bytecode of the same function
+        RegisterGenerator(Context *ctx, const GcPtr<Code> &code);
+
+        // register code for function, null when its body uses something the backend does not run
+        std::shared_ptr<RegisterCode> generate(FuncDef *function);
+
+        void visit(BinaryOp *expr) override;
+
+        void visit(Unary *expr) override;
+
+        void visit(TrueLiteral *expr) override;
+
+        void visit(FalseLiteral *expr) override;
+
+        void visit(NumberLiteral *expr) override;
+
+        void visit(StringLiteral *expr) override;
+
+        void visit(NilLiteral *expr) override;
+
+        void visit(ExprStmnt *stmnt) override;
+
+        void visit(Identifier *expr) override;
+
+        void visit(NewVar *stmnt) override;
+
+        void visit(Assign *stmnt) override;
+
+        void visit(Block *stmnt) override;
+
+        void visit(ListLiteral *expr) override;
+
+        void visit(GetItem *expr) override;
+
+        void visit(SetItem *expr) override;
+
+        void visit(If *stmnt) override;
+
+        void visit(While *stmnt) override;
+
+        void visit(Call *expr) override;
+
+        void visit(For *stmnt) override;
+
+        void visit(FuncDef *stmnt) override;
+
+        void visit(Return *stmnt) override;
+
+        void visit(ClosureDef *stmnt) override;
+
+        void visit(StructNode *stmnt) override;
+
+        void visit(GetAttribute *expr) override;
+
+        void visit(SetAttribute *expr) override;
+
+        void visit(ImportDef *stmnt) override;
+
+        void visit(Try *stmnt) override;
+
+        void visit(Break *stmnt) override;
+
+        void visit(Continue *stmnt) override;
+
+        void visit(AsyncDef *stmnt) override;
+
+        void visit(Await *expr) override;
+
+        void visit(StructuredAssign *stmnt) override;
+
+        void visit(CallMethod *expr) override;
+
+        void visit(ResultStatement *expr) override;
+
+        void visit(DictLiteral *expr) override;
+
+    private:
+        static constexpr uint32_t NO_REGISTER = std::numeric_limits<uint32_t>::max();
+        // constant registers are numbered from here until the other registers are counted
+        static constexpr uint32_t CONSTANT_BASE = 1u << 30;
+
+        Context *m_ctx;
+        GcPtr<Code> m_code;
+
+        std::vector<RegInstruction> m_instructions;
+        std::vector<SharedSpan> m_spans;
+
+        std::vector<GcPtr<Object>> m_constants;
+        // constant register of each constant pool index, and of nil, true and false
+        std::unordered_map<uint32_t, uint32_t> m_constant_registers;
+        uint32_t m_nil = NO_REGISTER;
+        uint32_t m_true = NO_REGISTER;
+        uint32_t m_false = NO_REGISTER;
+
+        // locals of each open block by name
+        std::vector<std::unordered_map<t_string, uint32_t>> m_scopes;
+        // first register not held by a local, temporaries of a statement are taken from here
+        uint32_t m_live = 0;
+        uint32_t m_top = 0;
+        uint32_t m_register_count = 0;
+        uint32_t m_stack_size = 0;
+
+        // where the expression being compiled has to leave its value, and where it did
+        uint32_t m_target = NO_REGISTER;
+        uint32_t m_result = NO_REGISTER;
+
+        std::vector<std::vector<size_t>> m_break_stack;
+        std::vector<std::vector<size_t>> m_continue_stack;
+
+        size_t emit(RegOpcode opcode, uint32_t a, uint32_t b, uint32_t c, const SharedSpan &span);
+
+        // points the jump at index to target
+        void patch(size_t index, size_t target);
+
+        size_t current_index() const { return m_instructions.size(); }
+
+        uint32_t temporary();
+
+        void declare(const t_string &name, uint32_t reg);
+
+        std::optional<uint32_t> local(const t_string &name);
+
+        uint32_t constant(const GcPtr<Object> &value);
+
+        uint32_t singleton(uint32_t &reg, const GcPtr<Object> &value);
+
+        // compiles node, leaving its value in target when one is given, returns the register
+        // that holds the value
+        uint32_t expression(const SharedNode &node, uint32_t target = NO_REGISTER);
+
+        // register an expression writes its value to, the target or a new temporary
+        uint32_t destination();
+
+        // finishes an expression whose value is in reg
+        void result(uint32_t reg, const SharedSpan &span);
+
+        void statement(const SharedNode &node);
+
+        // emits a jump taken when condition is false and returns it for patch
+        size_t jump_if_false(const SharedNode &condition, const SharedSpan &span);
+
+        // the stack vm has to run this function
+        [[noreturn]] static void unsupported();
+    };
+}
+
+#endif //BOND_REGCODEGEN_H
@@ -0,0 +1,427 @@
+//
+// C++ emitter for modules compiled ahead of time and the loader their bond_module_init calls,
+// see aot.h
+//
+
+#include "aot.h"
+#include "../compiler/bfmt.h"
+#include "../jit/emit.h"
+#include "../api.h"
+#include "../import.h"
+#include "core.h"
+#include <algorithm>
+#include <sstream>
+
+namespace bond {
+    static void collect_code_objects(const GcPtr<Code> &code, const t_string &name, std::vector<AotCode> &out) {
+        out.push_back({name, code});
+
+        for (auto &constant: code->get_constants()) {
+            if (constant.is_immediate()) continue;
+
+            if (constant->is<Function>()) {
+                auto function = constant->as<Function>();
+                collect_code_objects(function->get_code(), "fn " + function->get_name(), out);
+            } else if (constant->is<Struct>()) {
+                auto s = constant->as<Struct>();
+
+                // methods are kept in a hash map, sorting them keeps the numbering stable
+                std::vector<t_string> names;
+                for (auto &[method, _]: s->get_methods()) names.push_back(method);
+                std::sort(names.begin(), names.end());
+
+                for (auto &method: names) {
+                    collect_code_objects(s->get_methods()[method]->get_code(),
+                                         fmt::format("fn {}.{}", s->get_name(), method), out);
+                }
+            }
+        }
+    }
+
+    std::vector<AotCode> aot_code_objects(const GcPtr<Code> &code, const t_string &name) {
+        std::vector<AotCode> out;
+        collect_code_objects(code, name, out);
+        return out;
+    }
+
+    class AotEmitter {
+    public:
+        AotEmitter(Code *code, size_t number) : m_code(code), m_number(number) {}
+
+        // the C++ function for the code object, empty for bytecode that does not decode
+        t_string emit(const t_string &name);
+
+    private:
+        struct Instruction {
+            Opcode opcode;
+            uint32_t offset;
+            uint32_t next;
+            std::array<uint32_t, 2> oprands;
+
+            [[nodiscard]] uint32_t target() const { return oprands[oprand_count(opcode) - 1]; }
+        };
+
+        Code *m_code;
+        size_t m_number;
+        std::vector<Instruction> m_instructions;
+        // offsets the code is entered at or jumps to, the only ones that get a label
+        std::vector<bool> m_labels;
+        t_string m_out;
+
+        bool decode();
+
+        void find_labels();
+
+        template<typename... T>
+        void line(fmt::format_string<T...> format, T &&...args) {
+            m_out += "        ";
+            m_out += fmt::format(format, std::forward<T>(args)...);
+            m_out += "\n";
+        }
+
+        // runs the instruction with the interpreter and carries on wherever it left the frame
+        t_string step(const Instruction &ins);
+
+        void emit(const Instruction &ins);
+
+        void push_constant(uint32_t index);
+    };
+
+    bool AotEmitter::decode() {
+        auto &bytes = m_code->get_opcodes();
+        auto size = bytes.size();
+        std::vector<bool> starts(size + 1, false);
+
+        for (size_t offset = 0; offset < size;) {
+            auto opcode = bytes[offset];
+            if (opcode >= OPCODE_COUNT) return false;
+
+            Instruction ins{static_cast<Opcode>(opcode), (uint32_t) offset++, 0, {0, 0}};
+            for (uint32_t i = 0; i < oprand_count(ins.opcode); i++) {
+                ins.oprands[i] = read_oprand(ins.opcode, i, bytes.data(), offset);
+            }
+            if (offset > size) return false;
+
+            ins.next = (uint32_t) offset;
+            starts[ins.offset] = true;
+            m_instructions.push_back(ins);
+        }
+        starts[size] = true;
+
+        for (auto &ins: m_instructions) {
+            if (is_jump(ins.opcode) and (ins.target() > size or !starts[ins.target()])) return false;
+        }
+        return true;
+    }
+
+    // instructions that run inline, or leave the frame to the interpreter for good, are never
+    // entered after. the interpreter enters wherever it hands the frame back after any other
+    void AotEmitter::find_labels() {
+        m_labels.assign(m_code->get_code_size() + 1, false);
+        m_labels[0] = true;
+
+        for (auto &ins: m_instructions) {
+            if (is_jump(ins.opcode)) m_labels[ins.target()] = true;
+
+            switch (generic_form(ins.opcode)) {
+                case Opcode::LOAD_CONST:
+                case Opcode::PUSH_TRUE:
+                case Opcode::PUSH_FALSE:
+                case Opcode::PUSH_NIL:
+                case Opcode::LOAD_FAST:
+                case Opcode::LOAD_FAST_LOAD_FAST:
+                case Opcode::STORE_FAST:
+                case Opcode::CREATE_LOCAL:
+                case Opcode::JUMP:
+                case Opcode::BREAK:
+                case Opcode::CONTINUE:
+                case Opcode::RETURN:
+                case Opcode::IMPORT:
+                case Opcode::IMPORT_PRE_COMPILED:
+                    break;
+                default:
+                    // the end is only reached by jumps, frames are never entered there
+                    if (ins.next < m_code->get_code_size()) m_labels[ins.next] = true;
+                    break;
+            }
+        }
+    }
+
+    t_string AotEmitter::emit(const t_string &name) {
+        if (!decode()) return "";
+        find_labels();
+
+        auto size = m_code->get_code_size();
+        m_out += fmt::format("    // {}\n", name);
+        m_out += fmt::format("    uint32_t code_{}(bond::JitState *state, uint32_t ip) {{\n", m_number);
+        line("Window w(state);");
+        line("switch (ip) {{");
+        for (auto &ins: m_instructions) {
+            if (m_labels[ins.offset]) line("    case {0}: goto i{0};", ins.offset);
+        }
+        line("    default: return ip;");
+        line("}}");
+
+        for (auto &ins: m_instructions) {
+            auto comment = t_string(opcode_name(ins.opcode));
+            for (uint32_t i = 0; i < oprand_count(ins.opcode); i++) comment += fmt::format(" {}", ins.oprands[i]);
+
+            if (m_labels[ins.offset]) {
+                m_out += fmt::format("    i{}: // {}\n", ins.offset, comment);
+            } else {
+                m_out += fmt::format("    // {} {}\n", ins.offset, comment);
+            }
+            emit(ins);
+        }
+
+        if (m_labels[size]) m_out += fmt::format("    i{}:\n", size);
+        line("return w.leave({});", size);
+        m_out += "    }\n\n";
+        return m_out;
+    }
+
+    t_string AotEmitter::step(const Instruction &ins) {
+        auto call = fmt::format("if (auto next = w.step({}); next != {}) ", ins.offset, ins.next);
+        if (is_jump(ins.opcode)) {
+            return call + fmt::format("{{ if (next == {0}) goto i{0}; return next; }}", ins.target());
+        }
+        return call + "return next;";
+    }
+
+    // constants of other kinds stay reachable through the code object, they are read from it
+    void AotEmitter::push_constant(uint32_t index) {
+        auto constant = m_code->get_constant(index);
+        if (constant.is_immediate_int()) {
+            line("w.push_int((int64_t) {}ull);", (uint64_t) constant.immediate_int());
+        } else if (constant.is_immediate_float()) {
+            line("w.push_float(std::bit_cast<double>({:#018x}ull)); // {}",
+                 std::bit_cast<uint64_t>(constant.immediate_float()), constant.immediate_float());
+        } else {
+            line("w.push(codes[{}]->get_constant({}));", m_number, index);
+        }
+    }
+
+    void AotEmitter::emit(const Instruction &ins) {
+        auto opcode = generic_form(ins.opcode);
+
+        switch (opcode) {
+            case Opcode::LOAD_CONST:
+                push_constant(ins.oprands[0]);
+                break;
+            case Opcode::PUSH_TRUE:
+                line("w.push(bond::Runtime::ins()->C_TRUE);");
+                break;
+            case Opcode::PUSH_FALSE:
+                line("w.push(bond::Runtime::ins()->C_FALSE);");
+                break;
+            case Opcode::PUSH_NIL:
+                line("w.push(bond::Runtime::ins()->C_NONE);");
+                break;
+            case Opcode::LOAD_FAST:
+                line("w.push(w.local({}));", ins.oprands[0]);
+                break;
+            case Opcode::LOAD_FAST_LOAD_FAST:
+                line("w.push(w.local({}));", ins.oprands[0]);
+                line("w.push(w.local({}));", ins.oprands[1]);
+                break;
+            case Opcode::STORE_FAST:
+                line("w.local({}) = *w.top;", ins.oprands[0]);
+                break;
+            case Opcode::CREATE_LOCAL:
+                line("w.local({}) = *w.top;", ins.oprands[0]);
+                line("w.pop();");
+                break;
+            case Opcode::POP_TOP:
+                line("if (!w.pop_top()) {{ {} }}", step(ins));
+                break;
+            case Opcode::JUMP:
+            case Opcode::BREAK:
+            case Opcode::CONTINUE:
+                line("goto i{};", ins.target());
+                break;
+            case Opcode::JUMP_IF_FALSE:
+                line("if (auto truth = w.truth(); truth == 0) goto i{};", ins.target());
+                line("else if (truth < 0) {{ {} }}", step(ins));
+                break;
+            case Opcode::COMPARE_AND_JUMP:
+                line("if (auto result = w.compare_and_pop<Opcode::{}>(); result == 0) goto i{};",
+                     opcode_name(generic_form(static_cast<Opcode>(ins.oprands[0]))), ins.target());
+                line("else if (result < 0) {{ {} }}", step(ins));
+                break;
+            case Opcode::BIN_ADD:
+            case Opcode::BIN_SUB:
+            case Opcode::BIN_MUL:
+            case Opcode::BIN_DIV:
+            case Opcode::BIN_MOD:
+                line("if (!w.arithmetic<Opcode::{}>()) {{ {} }}", opcode_name(opcode), step(ins));
+                break;
+            case Opcode::LT:
+            case Opcode::LE:
+            case Opcode::GT:
+            case Opcode::GE:
+            case Opcode::EQ:
+            case Opcode::NE:
+                line("if (!w.compare<Opcode::{}>()) {{ {} }}", opcode_name(opcode), step(ins));
+                break;
+            case Opcode::NOT:
+                line("if (!w.not_()) {{ {} }}", step(ins));
+                break;
+            case Opcode::UNARY_SUB:
+                line("if (!w.unary_sub()) {{ {} }}", step(ins));
+                break;
+            // returns have to run in the interpreter, which knows where its exec stops
+            case Opcode::RETURN:
+            case Opcode::IMPORT:
+            case Opcode::IMPORT_PRE_COMPILED:
+                line("return w.leave({});", ins.offset);
+                break;
+            default:
+                line("{}", step(ins));
+                break;
+        }
+    }
+
+    // reads back what emit_aot_module embeds, the archive's magic number and version followed by
+    // the module's code
+    static std::expected<GcPtr<Code>, t_string> read_aot_bytecode(std::span<const uint8_t> bytecode) {
+        std::istringstream stream(std::string((const char *) bytecode.data(), bytecode.size()), std::ios::binary);
+        try {
+            auto magic_number = read_val<std::istringstream, uint32_t>(stream);
+            auto version = read_val<std::istringstream, uint32_t>(stream);
+            if (!stream or magic_number != BOND_MAGIC_NUMBER) {
+                return std::unexpected("the module does not carry bond bytecode");
+            }
+            if (version != BOND_BAR_VERSION) {
+                return std::unexpected(fmt::format("the module was compiled for bytecode version {}, this bond "
+                                                   "runs version {}, compile it again with bond --aot", version,
+                                                   BOND_BAR_VERSION));
+            }
+            return read_code_impl(stream);
+        } catch (std::exception &e) {
+            return std::unexpected(fmt::format("unable to read the module's bytecode: {}", e.what()));
+        }
+    }
+
+    std::expected<t_string, t_string> emit_aot_module(const GcPtr<Code> &code, const t_string &path) {
+        std::ostringstream stream(std::ios::binary);
+        try {
+            // stamped like an archive, bytecode from another version of bond is refused at load
+            write_val<std::ostringstream, uint32_t>(stream, BOND_MAGIC_NUMBER);
+            write_val<std::ostringstream, uint32_t>(stream, BOND_BAR_VERSION);
+            write_code_impl(stream, code);
+        } catch (std::exception &e) {
+            return std::unexpected(fmt::format("unable to compile {} ahead of time: {}", path, e.what()));
+        }
+        auto bytecode = stream.str();
+
+        // numbered from the bytecode read back, exactly as bond_module_init will see it
+        auto read = read_aot_bytecode({(const uint8_t *) bytecode.data(), bytecode.size()});
+        TRY(read);
+        auto objects = aot_code_objects(read.value(), "module " + path);
+
+        auto stem = std::filesystem::path(path.c_str()).stem().string();
+        t_string out;
+        out += fmt::format("//\n// compiled ahead of time from {} by bond --aot, do not edit\n//\n", path);
+        out += fmt::format("// build it as a shared library named lib{0}, linked against bond-lib, and\n", stem);
+        out += fmt::format("// import \"{0}\" loads it in place of {0}.bd\n//\n\n", stem);
+        out += "#include \"bond.h\"\n#include \"core/aot.h\"\n\n";
+        out += "namespace {\n";
+        out += "    using bond::Opcode;\n    using bond::aot::Window;\n\n";
+        out += fmt::format("    bond::Code *codes[{}];\n\n", objects.size());
+
+        t_string functions;
+        for (size_t i = 0; i < objects.size(); i++) {
+            auto function = AotEmitter(objects[i].code.get(), i).emit(objects[i].name);
+            out += function;
+            functions += fmt::format("{}{}", i == 0 ? "" : ", ", function.empty() ? "nullptr" : fmt::format("code_{}", i));
+        }
+
+        out += fmt::format("    const bond::AotFunction functions[] = {{{}}};\n\n", functions);
+
+        out += "    const uint8_t bytecode[] = {";
+        for (size_t i = 0; i < bytecode.size(); i++) {
+            if (i % 16 == 0) out += "\n           ";
+            out += fmt::format(" {:#04x},", (uint8_t) bytecode[i]);
+        }
+        out += "\n    };\n}\n\n";
+
+        out += "EXPORT void bond_module_init(bond::Context *ctx, bond::Vm *current_vm, bond::Mod &mod) {\n";
+        out += fmt::format("    bond::aot_module_init(ctx, current_vm, mod, R\"bond({})bond\", bytecode, functions, codes);\n",
+                           path);
+        out += "}\n";
+        return out;
+    }
+
+    // spans carry the id the compiling context gave the module, the loading one numbers it
+    // differently
+    static void set_module_id(const std::vector<AotCode> &objects, uint32_t id) {
+        auto set_params = [id](const GcPtr<Function> &function) {
+            for (auto &param: function->get_arguments()) param->span->module_id = id;
+        };
+
+        for (auto &object: objects) {
+            object.code->set_module_id(id);
+
+            for (auto &constant: object.code->get_constants()) {
+                if (constant.is_immediate()) continue;
+
+                if (constant->is<Function>()) {
+                    set_params(constant->as<Function>());
+                } else if (constant->is<Struct>()) {
+                    for (auto &[_, method]: constant->as<Struct>()->get_methods()) set_params(method);
+                }
+            }
+        }
+    }
+
+    void aot_module_init(Context *ctx, Vm *current_vm, Mod &mod, const char *source,
+                         std::span<const uint8_t> bytecode, std::span<const AotFunction> functions,
+                         std::span<Code *> codes) {
+        GC_INIT();
+        Runtime::ins()->set_runtime(current_vm->runtime());
+        set_current_vm(current_vm);
+        // the library carries its own copy of the runtime's globals, imports of core made by
+        // its top level look there
+        if (!core_module) build_core_module();
+
+        auto code = read_aot_bytecode(bytecode);
+        if (!code) {
+            mod.set_error(code.error());
+            return;
+        }
+
+        // the code is run without the vm checking it as it goes, like an archive's
+        auto objects = aot_code_objects(code.value(), "");
+        for (auto &object: objects) {
+            if (auto verified = object.code->verify(); !verified) {
+                mod.set_error(fmt::format("the module holds invalid bytecode\n  {}", verified.error()));
+                return;
+            }
+        }
+
+        set_module_id(objects, ctx->new_module(source));
+
+        // bytecode that numbers differently from when it was emitted is left to the interpreter
+        if (objects.size() == functions.size() and objects.size() == codes.size()) {
+            for (size_t i = 0; i < objects.size(); i++) {
+                codes[i] = objects[i].code.get();
+                objects[i].code->set_aot_function(functions[i]);
+            }
+            current_vm->enable_aot();
+        }
+
+        auto vm = Vm(ctx);
+        set_current_vm(&vm);
+        vm.run(code.value());
+        set_current_vm(current_vm);
+
+        if (vm.had_error() or ctx->has_error()) {
+            mod.set_error("its top level failed");
+            return;
+        }
+
+        for (auto &[name, value]: vm.get_globals()->get_value()) {
+            mod.add(name, value);
+        }
+    }
+}
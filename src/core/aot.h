@@ -0,0 +1,236 @@
+//
+// ahead of time compiler, turns the bytecode of a program's modules into C++ that builds into
+// native modules import loads like any other, see load_dynamic_lib in import.cpp
+//
+// the C++ of a code object follows the templates of the baseline jit, see jit/jit.h. locals,
+// constants, jumps and arithmetic and comparisons on immediates run inline, anything else runs
+// that one instruction with the interpreter. the module carries its bytecode as well,
+// bond_module_init reads it back, hands every code object its native function and runs the
+// module's top level the way importing the source would
+//
+
+#ifndef BOND_AOT_H
+#define BOND_AOT_H
+
+#include "../object.h"
+#include "../runtime.h"
+#include "../traits.hpp"
+#include "../vm.h"
+#include "../jit/jit.h"
+#include <span>
+
+namespace bond {
+    struct AotCode {
+        // what the code belongs to, for comments in the generated source
+        t_string name;
+        GcPtr<Code> code;
+    };
+
+    // every code object of a module, the module's own first, then the code of its functions,
+    // closures and struct methods depth first. the emitter and bond_module_init both number
+    // code objects in this order
+    std::vector<AotCode> aot_code_objects(const GcPtr<Code> &code, const t_string &name);
+
+    // the C++ source of a native module made from the compiled module at path
+    std::expected<t_string, t_string> emit_aot_module(const GcPtr<Code> &code, const t_string &path);
+
+    // what bond_module_init of a module compiled ahead of time does, functions and codes are
+    // indexed like aot_code_objects, a null function leaves that code to the interpreter. source
+    // is the file the module was compiled from, errors point into it. bytecode that is stale or
+    // does not verify, or a top level that fails, is reported through mod
+    void aot_module_init(Context *ctx, Vm *current_vm, Mod &mod, const char *source,
+                         std::span<const uint8_t> bytecode, std::span<const AotFunction> functions,
+                         std::span<Code *> codes);
+
+    namespace aot {
+        // the window on the vm state generated code works on. top is kept here and written back
+        // before the interpreter runs an instruction or the code returns
+        struct Window {
+            JitState *state;
+            GcPtr<Object> *locals;
+            GcPtr<Object> *top;
+
+            explicit Window(JitState *state) : state(state) { reload(); }
+
+            void reload() {
+                locals = state->locals;
+                top = state->stack + state->top;
+            }
+
+            GcPtr<Object> &local(uint32_t slot) { return locals[slot]; }
+
+            void push(const GcPtr<Object> &value) { *++top = value; }
+
+            void push_int(int64_t value) { *++top = GcPtr<Object>::from_int(value); }
+
+            void push_float(double value) { *++top = GcPtr<Object>::from_float(value); }
+
+            // clears popped slots like the interpreter does, so they do not keep objects alive
+            void pop(int32_t count = 1) {
+                for (int32_t i = 0; i < count; i++) (top--)->reset();
+            }
+
+            // runs the instruction at ip with the interpreter, returns where the frame carries
+            // on or JIT_EXIT
+            uint32_t step(uint32_t ip) {
+                state->top = top - state->stack;
+                auto next = state->vm->jit_step(state, ip);
+                if (next != JIT_EXIT) reload();
+                return next;
+            }
+
+            // hands the frame back to the interpreter at ip
+            uint32_t leave(uint32_t ip) {
+                state->top = top - state->stack;
+                return ip;
+            }
+
+            static bool is(const GcPtr<Object> &value, const GcPtr<Object> &object) {
+                return !value.is_immediate() and value.get() == object.get();
+            }
+
+            void set_bool(GcPtr<Object> &slot, bool value) {
+                slot = value ? Runtime::ins()->C_TRUE : Runtime::ins()->C_FALSE;
+            }
+
+            // the fast paths below leave the stack alone and return false, or -1, when the
+            // interpreter has to run the instruction
+
+            template<Opcode OPERATION>
+            bool arithmetic() {
+                auto &left = top[-1];
+                auto &right = top[0];
+
+                if (left.is_immediate_int() and right.is_immediate_int()) {
+                    auto a = (uint64_t) left.immediate_int();
+                    auto b = (uint64_t) right.immediate_int();
+                    int64_t result;
+                    if constexpr (OPERATION == Opcode::BIN_ADD) {
+                        result = (int64_t) (a + b);
+                    } else if constexpr (OPERATION == Opcode::BIN_SUB) {
+                        result = (int64_t) (a - b);
+                    } else if constexpr (OPERATION == Opcode::BIN_MUL) {
+                        result = (int64_t) (a * b);
+                    } else {
+                        // zero and the minimum divided by -1 are left to the interpreter
+                        auto divisor = right.immediate_int();
+                        if (divisor == 0 or divisor == -1) return false;
+                        result = OPERATION == Opcode::BIN_MOD ? left.immediate_int() % divisor
+                                                              : left.immediate_int() / divisor;
+                    }
+                    left = GcPtr<Object>::from_int(result);
+                    pop();
+                    return true;
+                }
+
+                // there is no specialised float modulo, it stays with the interpreter
+                if constexpr (OPERATION == Opcode::BIN_MOD) {
+                    return false;
+                } else {
+                    if (!left.is_immediate_float() or !right.is_immediate_float()) return false;
+
+                    auto a = left.immediate_float();
+                    auto b = right.immediate_float();
+                    double result;
+                    if constexpr (OPERATION == Opcode::BIN_ADD) {
+                        result = a + b;
+                    } else if constexpr (OPERATION == Opcode::BIN_SUB) {
+                        result = a - b;
+                    } else if constexpr (OPERATION == Opcode::BIN_MUL) {
+                        result = a * b;
+                    } else {
+                        // a zero or nan divisor is left to the interpreter's error
+                        if (!(b < 0 or b > 0)) return false;
+                        result = a / b;
+                    }
+                    left = GcPtr<Object>::from_float(result);
+                    pop();
+                    return true;
+                }
+            }
+
+            template<Opcode COMPARE, typename T>
+            static bool compare_values(T a, T b) {
+                if constexpr (COMPARE == Opcode::LT) return a < b;
+                else if constexpr (COMPARE == Opcode::LE) return a <= b;
+                else if constexpr (COMPARE == Opcode::GT) return a > b;
+                else if constexpr (COMPARE == Opcode::GE) return a >= b;
+                else if constexpr (COMPARE == Opcode::EQ) return a == b;
+                else return a != b;
+            }
+
+            // 1 or 0 for a comparison of two immediates of the same kind, -1 for anything else
+            template<Opcode COMPARE>
+            int32_t compare_top() const {
+                auto &left = top[-1];
+                auto &right = top[0];
+                if (left.is_immediate_int() and right.is_immediate_int()) {
+                    return compare_values<COMPARE>(left.immediate_int(), right.immediate_int());
+                }
+                if (left.is_immediate_float() and right.is_immediate_float()) {
+                    return compare_values<COMPARE>(left.immediate_float(), right.immediate_float());
+                }
+                return -1;
+            }
+
+            template<Opcode COMPARE>
+            bool compare() {
+                auto result = compare_top<COMPARE>();
+                if (result < 0) return false;
+                set_bool(top[-1], result);
+                pop();
+                return true;
+            }
+
+            // pops both sides when the comparison could be made
+            template<Opcode COMPARE>
+            int32_t compare_and_pop() {
+                auto result = compare_top<COMPARE>();
+                if (result >= 0) pop(2);
+                return result;
+            }
+
+            // pops the condition of a JUMP_IF_FALSE when it is a bool or an int
+            int32_t truth() {
+                int32_t result = -1;
+                if (is(*top, Runtime::ins()->C_FALSE)) result = 0;
+                else if (is(*top, Runtime::ins()->C_TRUE)) result = 1;
+                else if (top->is_immediate_int()) result = top->immediate_int() != 0;
+
+                if (result >= 0) pop();
+                return result;
+            }
+
+            // results are checked by the interpreter, only values that can not be one are popped
+            bool pop_top() {
+                auto &value = *top;
+                if (!value.is_immediate() and !is(value, Runtime::ins()->C_NONE) and
+                    !is(value, Runtime::ins()->C_TRUE) and !is(value, Runtime::ins()->C_FALSE)) {
+                    return false;
+                }
+                pop();
+                return true;
+            }
+
+            bool not_() {
+                if (is(*top, Runtime::ins()->C_TRUE)) set_bool(*top, false);
+                else if (is(*top, Runtime::ins()->C_FALSE)) set_bool(*top, true);
+                else return false;
+                return true;
+            }
+
+            bool unary_sub() {
+                if (top->is_immediate_int()) {
+                    *top = GcPtr<Object>::from_int((int64_t) (0 - (uint64_t) top->immediate_int()));
+                } else if (top->is_immediate_float()) {
+                    *top = GcPtr<Object>::from_float(-top->immediate_float());
+                } else {
+                    return false;
+                }
+                return true;
+            }
+        };
+    }
+}
+
+#endif //BOND_AOT_H
@@ -5,6 +5,7 @@
 
 #include <iosfwd>
 #include "build.h"
+#include "aot.h"
 #include "../import.h"
 
 namespace bond{
@@ -48,6 +49,10 @@ namespace bond{
                     return std::unexpected(res.error());
                 }
 
+                // native libraries are loaded when the module runs, there is nothing to compile
+                auto ext = std::filesystem::path(res.value().c_str()).extension();
+                if (ext == ".so" or ext == ".dll") continue;
+
                 import_def->set_actual_path(res.value().c_str());
 
                 dependencies.push_back(res.value());
@@ -121,6 +126,45 @@ namespace bond{
     }
 
 
+    std::expected<std::vector<t_string>, t_string> Build::aot() {
+        try {
+            TRY(find_deps(main_file));
+            if (context.has_error()) return std::unexpected("build failed");
+
+            std::vector<t_string> outputs;
+            for (auto &[path, unit]: units) {
+                // native modules find each other by name when they run, imports do not point
+                // into an archive
+                for (auto &node: unit->get_nodes()) {
+                    if (instanceof<ImportDef>(node.get())) {
+                        std::dynamic_pointer_cast<ImportDef>(node)->set_actual_path("");
+                    }
+                }
+
+                auto code = unit->compile();
+                TRY(code);
+                auto source = emit_aot_module(code.value(), path);
+                TRY(source);
+
+                auto file = std::filesystem::path(path.c_str());
+                auto output = (file.parent_path() / ("lib" + file.stem().string() + ".cpp")).string();
+                std::ofstream stream(output);
+                if (!stream) {
+                    return std::unexpected(fmt::format("could not open {}", output));
+                }
+                stream << source.value();
+
+                fmt::print("[{}/{}] {} -> {}\n", outputs.size() + 1, units.size(), path, output);
+                outputs.push_back(output);
+            }
+            return outputs;
+        }
+        catch (std::exception& e) {
+            return std::unexpected(fmt::format("build failed: {}", e.what()));
+        }
+    }
+
+
     std::vector<t_string> required_files = {
             "gc.dll", "gccpp.dll", "gctba.dll"
     };
@@ -24,6 +24,10 @@ namespace bond {
         Context *get_context() { return &context; }
         std::expected<t_string, t_string> build();
 
+        // writes the C++ of the main file and every module it imports next to their sources,
+        // each builds into a native module, see aot.h. returns the files written
+        std::expected<std::vector<t_string>, t_string> aot();
+
     private:
         t_string main_file;
         Context context;
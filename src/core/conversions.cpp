@@ -5,7 +5,7 @@
 #include "conversions.h"
 
 namespace bond {
-    obj_result to_int(const bond::t_vector &args) {
+    obj_result to_int(bond::t_args args) {
         Object *obj;
         TRY(parse_args(args, obj));
 
@@ -25,13 +25,13 @@ namespace bond {
         return make_error(make_string(fmt::format("unable to convert {} to int", obj->str())));
     }
 
-    obj_result to_string(const t_vector &args) {
+    obj_result to_string(t_args args) {
         Object *obj;
         TRY(parse_args(args, obj));
         return OK(make_string(obj->str()));
     }
 
-    obj_result to_float(const t_vector &args) {
+    obj_result to_float(t_args args) {
         Object *obj;
         TRY(parse_args(args, obj));
 
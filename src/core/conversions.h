@@ -5,9 +5,9 @@
 #include "../object.h"
 
 namespace bond {
-    obj_result to_string(const t_vector &args);
-    obj_result to_int(const t_vector &args);
-    obj_result to_float(const t_vector &args);
+    obj_result to_string(t_args args);
+    obj_result to_int(t_args args);
+    obj_result to_float(t_args args);
 }
 
 
@@ -23,7 +23,7 @@ namespace bond {
             m_step = step->get_value();
         }
 
-        static obj_result c_Range(const t_vector &args) {
+        static obj_result c_Range(t_args args) {
             Int *start;
             Int *end;
             Int *step;
@@ -34,25 +34,32 @@ namespace bond {
             return OK(make<Range>(start, end, step));
         }
 
-        static obj_result iter(const GcPtr<Object> &Self, const t_vector &args) {
+        static obj_result iter(const GcPtr<Object> &Self, t_args args) {
             auto self = Self->as<Range>();
             return self;
         }
 
-        static obj_result has_next(const GcPtr<Object> &Self, const t_vector &args) {
+        static obj_result has_next(const GcPtr<Object> &Self, t_args args) {
             auto self = Self->as<Range>();
             return OK(AS_BOOL(self->m_start < self->m_end));
         }
 
-        static obj_result next(const GcPtr<Object> &Self, const t_vector &args) {
+        static obj_result next(const GcPtr<Object> &Self, t_args args) {
             auto self = Self->as<Range>();
             auto res = self->m_start;
             self->m_start += self->m_step;
             return OK(make_int(res));
         }
+
+        IterStep iter_next(GcPtr<Object> &next) override {
+            if (m_start >= m_end) return IterStep::Done;
+            next = make_int(m_start);
+            m_start += m_step;
+            return IterStep::Next;
+        }
     };
 
-    obj_result is_callable(const t_vector &args) {
+    obj_result is_callable(t_args args) {
         Object *obj;
         TRY(parse_args(args, obj));
 
@@ -60,7 +67,7 @@ namespace bond {
                           obj->is<Struct>() || obj->is<BoundMethod>()));
     }
 
-    obj_result is_function(const t_vector &args) {
+    obj_result is_function(t_args args) {
         Object *obj;
         TRY(parse_args(args, obj));
 
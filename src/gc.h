@@ -17,18 +17,74 @@
 #include <optional>
 #include <ranges>
 #include <cassert>
+#include <bit>
+#include <cstdint>
+#include <typeinfo>
 
 
 namespace bond {
 
     class GcObject;
 
+    /**
+     * @brief Compact identifier for the builtin object types.
+     *
+     * Every builtin type stamps its id into GcObject during construction, so type
+     * checks against builtins are an integer compare. Object and NativeInstance
+     * are bases; ids of types derived from them sort after them.
+     */
+    enum class TypeId : uint8_t {
+        Unknown,
+        Object,
+        NativeStruct,
+        NativeInstance,
+        Float,
+        HashMap,
+        Int,
+        Bool,
+        String,
+        StringIterator,
+        None,
+        StringMap,
+        Code,
+        Function,
+        Future,
+        Struct,
+        Instance,
+        NativeFunction,
+        Module,
+        BoundMethod,
+        List,
+        ListIterator,
+        Result,
+        Closure,
+        Cell,
+    };
+
+    constexpr bool type_id_matches(TypeId id, TypeId expected) {
+        switch (expected) {
+            case TypeId::Object:
+                return id >= TypeId::Object;
+            case TypeId::NativeInstance:
+                return id >= TypeId::NativeInstance;
+            default:
+                return id == expected;
+        }
+    }
+
+    // only a type that declares its own tag has one, a subclass without one would
+    // otherwise inherit its base's id and pass checks for the base
+    template<typename T>
+    concept HasTypeId = requires {
+        T::TYPE_ID;
+        typename T::tagged_self;
+    } and std::is_same_v<typename T::tagged_self, T>;
+
     /**
  * @brief Determines if the given pointer is an instance of a specified base type.
  *
- * This function uses the dynamic_cast operator to check if the pointer `ptr` can be safely
- * casted to a pointer of the base type `Base`. It returns true if the cast is successful and
- * false otherwise.
+ * Builtin types carry a TypeId and are checked with an integer compare. Other types,
+ * such as those defined by extension modules, fall back to dynamic_cast.
  *
  * @tparam Base The base type.
  * @tparam T The derived type.
@@ -38,67 +94,140 @@ namespace bond {
 
     template<typename Base, typename T>
     inline bool instanceof(const T *ptr) {
-        return dynamic_cast<const Base *>(ptr) != nullptr;
+        if constexpr (HasTypeId<Base>) {
+            return ptr != nullptr and type_id_matches(ptr->get_type_id(), Base::TYPE_ID);
+        } else {
+            return dynamic_cast<const Base *>(ptr) != nullptr;
+        }
     }
 
+    /**
+     * @brief Materialises a heap object for an immediate Int or Float held by a GcPtr.
+     *
+     * Defined alongside the runtime factories, the returned object is only created the
+     * first time an immediate is dereferenced.
+     */
+    GcObject *box_immediate(uintptr_t tag, uint64_t bits);
+
+    constexpr uintptr_t IMMEDIATE_TAG_MASK = 0b11;
+    constexpr uintptr_t IMMEDIATE_INT_TAG = 0b01;
+    constexpr uintptr_t IMMEDIATE_FLOAT_TAG = 0b10;
+
+    /**
+     * @brief Smart pointer to a garbage collected object.
+     *
+     * Besides plain object pointers a GcPtr can hold an Int or Float by value, tagged in
+     * the low bits of the pointer word. Immediates let numeric code run without a heap
+     * allocation per result; dereferencing one boxes it on demand and remembers the box.
+     */
     template<typename T>
     class GcPtr: public gc {
+        template<typename K> friend class GcPtr;
+
     public:
         GcPtr() = default;
 
-        GcPtr(T *GcPtr) : m_ptr(GcPtr) {}
+        GcPtr(T *ptr) : m_bits(reinterpret_cast<uintptr_t>(ptr)) {}
 
-        GcPtr(const GcPtr &other) : m_ptr(other.m_ptr) {}
+        GcPtr(const GcPtr &other) = default;
 
-        GcPtr(GcPtr &&other) noexcept: m_ptr(other.m_ptr) { other.m_ptr = nullptr; }
+        GcPtr(GcPtr &&other) noexcept: m_bits(other.m_bits), m_value(other.m_value) { other.m_bits = 0; }
 
-        virtual ~GcPtr() { m_ptr = nullptr; }
+        ~GcPtr() = default;
 
-        GcPtr &operator=(const GcPtr &other) {
-            if (this == &other)
-                return *this;
-            m_ptr = other.m_ptr;
-            return *this;
-        }
+        GcPtr &operator=(const GcPtr &other) = default;
 
         GcPtr &operator=(const GcPtr *other) {
-            m_ptr = other->m_ptr;
+            m_bits = other->m_bits;
+            m_value = other->m_value;
             return *this;
         }
 
         GcPtr &operator=(T *other) {
-            m_ptr = other;
+            set(other);
             return *this;
         }
 
         GcPtr &operator=(GcPtr &&other) noexcept {
-            m_ptr = other.m_ptr;
-            other.m_ptr = nullptr;
+            m_bits = other.m_bits;
+            m_value = other.m_value;
+            other.m_bits = 0;
             return *this;
         }
 
-        T *operator->() const { return m_ptr; }
+        static GcPtr from_int(int64_t value) {
+            GcPtr ptr;
+            ptr.m_bits = IMMEDIATE_INT_TAG;
+            ptr.m_value = static_cast<uint64_t>(value);
+            return ptr;
+        }
+
+        static GcPtr from_float(double value) {
+            GcPtr ptr;
+            ptr.m_bits = IMMEDIATE_FLOAT_TAG;
+            ptr.m_value = std::bit_cast<uint64_t>(value);
+            return ptr;
+        }
+
+        [[nodiscard]] bool is_immediate() const { return (m_bits & IMMEDIATE_TAG_MASK) != 0; }
+
+        [[nodiscard]] bool is_immediate_int() const { return (m_bits & IMMEDIATE_TAG_MASK) == IMMEDIATE_INT_TAG; }
+
+        [[nodiscard]] bool is_immediate_float() const { return (m_bits & IMMEDIATE_TAG_MASK) == IMMEDIATE_FLOAT_TAG; }
+
+        [[nodiscard]] int64_t immediate_int() const { return static_cast<int64_t>(m_value); }
 
-        T &operator*() const { return *m_ptr; }
+        [[nodiscard]] double immediate_float() const { return std::bit_cast<double>(m_value); }
 
-        [[nodiscard]] T *get() const { return m_ptr; }
+        T *operator->() const { return get(); }
 
-        void set(T *ptr) { m_ptr = ptr; }
+        T &operator*() const { return *get(); }
+
+        [[nodiscard]] T *get() const {
+            if ((m_bits & IMMEDIATE_TAG_MASK) == 0) [[likely]] {
+                return reinterpret_cast<T *>(m_bits);
+            }
+            return box();
+        }
+
+        void set(T *ptr) { m_bits = reinterpret_cast<uintptr_t>(ptr); }
 
         [[nodiscard]] const char *type_name() const {
-            return typeid(*m_ptr).name();
+            return typeid(*get()).name();
         }
 
-        explicit operator bool() const { return m_ptr != nullptr; }
+        explicit operator bool() const { return m_bits != 0; }
 
-        void reset() { m_ptr = nullptr; }
+        void reset() { m_bits = 0; }
 
         template<typename K>
-        GcPtr(const GcPtr <K> &other) : m_ptr(other.get()) {}
+        GcPtr(const GcPtr <K> &other) {
+            if (other.is_immediate()) {
+                m_bits = other.m_bits;
+                m_value = other.m_value;
+            } else {
+                set(other.get());
+            }
+        }
 
 
     private:
-        T *m_ptr = nullptr;
+        T *box() const {
+            auto ptr = m_bits & ~IMMEDIATE_TAG_MASK;
+            if (ptr == 0) {
+                ptr = reinterpret_cast<uintptr_t>(box_immediate(m_bits & IMMEDIATE_TAG_MASK, m_value));
+                m_bits |= ptr;
+            }
+            if constexpr (std::is_base_of_v<GcObject, T>) {
+                return static_cast<T *>(reinterpret_cast<GcObject *>(ptr));
+            } else {
+                return nullptr;
+            }
+        }
+
+        // object pointer, or tag bits plus the lazily created box for immediates
+        mutable uintptr_t m_bits = 0;
+        uint64_t m_value = 0;
     };
 
     enum class RuntimeError {
@@ -128,24 +257,46 @@ namespace bond {
         }
 
         template<typename T>
-        bool is() { return instanceof<T>(this); }
+        bool is() const { return instanceof<T>(this); }
 
         template<typename T>
         GcPtr<T> as() {
-            return GcPtr<T>(dynamic_cast<T *>(this));
+            if constexpr (HasTypeId<T>) {
+                return GcPtr<T>(is<T>() ? static_cast<T *>(this) : nullptr);
+            } else {
+                return GcPtr<T>(dynamic_cast<T *>(this));
+            }
         }
 
         template<typename T>
         static GcPtr<T> as(GcPtr<GcObject> const &obj) {
-            return GcPtr<T>(dynamic_cast<T *>(obj.get()));
+            auto ptr = obj.get();
+            return ptr ? ptr->as<T>() : GcPtr<T>();
         }
 
+        [[nodiscard]] TypeId get_type_id() const { return m_type_id; }
+
+        void set_type_id(TypeId id) { m_type_id = id; }
+
         template<typename ...Args>
         bool is_one_of() {
             return (is<Args>() || ...);
         }
 
         bool operator==(GcObject const &other) const { return this == &other; }
+
+    private:
+        TypeId m_type_id = TypeId::Unknown;
+    };
+
+    /**
+     * @brief Empty member that stamps a TypeId into the enclosing object while it is constructed.
+     *
+     * Members are initialised after the base classes, so the most derived builtin wins.
+     */
+    template<TypeId ID>
+    struct TypeIdTag {
+        explicit TypeIdTag(GcObject *object) { object->set_type_id(ID); }
     };
 
 }
\ No newline at end of file
@@ -90,6 +90,9 @@ namespace bond {
 
 #endif
         init(ctx, get_current_vm(), &mod);
+        if (mod.get_error()) {
+            return std::unexpected(fmt::format("unable to import module {}: {}", path, *mod.get_error()));
+        }
         return mod.build();
     }
 
@@ -231,14 +234,52 @@ namespace bond {
     }
 
 
+    // verifies code and the code of the functions and struct methods among its constants
+    static std::expected<void, t_string> verify_archive_code(const GcPtr<Code> &code) {
+        if (auto verified = code->verify(); !verified) {
+            return std::unexpected(verified.error());
+        }
+
+        for (auto &constant: code->get_constants()) {
+            if (constant.is_immediate()) continue;
+
+            if (constant->is<Function>()) {
+                TRY(verify_archive_code(constant->as<Function>()->get_code()));
+            } else if (constant->is<Struct>()) {
+                for (auto &[_, method]: constant->as<Struct>()->get_methods()) {
+                    TRY(verify_archive_code(method->get_code()));
+                }
+            }
+        }
+        return {};
+    }
+
     std::expected<GcPtr<Code>, t_string> Import::import_archive(Context *ctx, const t_string &path) {
         if (!std::filesystem::exists(path.c_str())) {
             return std::unexpected(fmt::format("archive {} does not exist", path));
         }
 
-        auto res = read_archive_file(path);
+        std::expected<std::unordered_map<uint32_t, GcPtr<Code>>, t_string> res;
+        try {
+            res = read_archive_file(path);
+        } catch (std::exception &e) {
+            return std::unexpected(fmt::format("unable to read archive {}: {}", path, e.what()));
+        }
         TRY(res);
 
+        // archives come from disk, their bytecode is checked once here so the vm can run it
+        // without checking as it goes
+        for (auto &[id, code]: res.value()) {
+            if (auto verified = verify_archive_code(code); !verified) {
+                return std::unexpected(fmt::format("archive {} holds invalid bytecode in module {}\n  {}", path, id,
+                                                   verified.error()));
+            }
+        }
+
+        if (!res.value().contains(0)) {
+            return std::unexpected(fmt::format("archive {} has no main module", path));
+        }
+
         m_context = ctx;
         m_compiled_archive = res.value();
         return res.value()[0];
@@ -246,6 +287,9 @@ namespace bond {
 
     std::expected<GcPtr<Module>, t_string> Import::get_pre_compiled(uint32_t id) {
         if (m_compiled_modules.contains(id)) return m_compiled_modules[id];
+        if (!m_compiled_archive.contains(id)) {
+            return std::unexpected(fmt::format("module {} is not in the archive", id));
+        }
 
         auto code = m_compiled_archive[id];
         auto pre_vm = get_current_vm();
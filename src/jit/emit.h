@@ -0,0 +1,41 @@
+//
+// register assignment, slot layout and templates shared by the baseline and trace compilers
+//
+
+#ifndef BOND_EMIT_H
+#define BOND_EMIT_H
+
+#include "jit.h"
+#include "x64.h"
+#include <limits>
+
+namespace bond {
+    // native code keeps the vm state in callee saved registers
+    constexpr x64::Reg STATE = x64::RBX;
+    constexpr x64::Reg STACK = x64::R12;
+    constexpr x64::Reg LOCALS = x64::R13;
+    // the slot on top of the operand stack, one slot below STACK when it is empty
+    constexpr x64::Reg TOP = x64::R14;
+
+    // a slot is a GcPtr, the pointer word and then the value word of an immediate
+    constexpr int32_t SLOT = sizeof(GcPtr<Object>);
+    static_assert(SLOT == 16);
+    constexpr int32_t VALUE = 8;
+
+    constexpr uint32_t NO_ENTRY = std::numeric_limits<uint32_t>::max();
+
+    // called from native code to run one instruction with the interpreter, see Vm::jit_step
+    uint32_t jit_step(JitState *state, uint32_t ip);
+
+    // the plain form of a specialised arithmetic or comparison opcode
+    Opcode generic_form(Opcode opcode);
+
+    // the condition a signed compare of two ints leaves for compare
+    x64::Cond int_condition(Opcode compare);
+
+    // compares the floats in left and right, jumping to target when compare is false
+    void float_jump_if_false(x64::Assembler &assembler, Opcode compare, x64::Xmm left, x64::Xmm right,
+                             x64::Label target);
+}
+
+#endif //BOND_EMIT_H
@@ -0,0 +1,760 @@
+//
+// bytecode to machine code templates for the baseline jit, see jit.h
+//
+
+#include "jit.h"
+#include "emit.h"
+#include "../runtime.h"
+#include "../vm.h"
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define BOND_JIT_X64
+#include <sys/mman.h>
+#endif
+
+namespace bond {
+    using namespace x64;
+
+    // the tags of the two values on top of the stack, left | right << 2
+    constexpr int32_t INT_PAIR = IMMEDIATE_INT_TAG | IMMEDIATE_INT_TAG << 2;
+    constexpr int32_t FLOAT_PAIR = IMMEDIATE_FLOAT_TAG | IMMEDIATE_FLOAT_TAG << 2;
+
+    uint32_t jit_step(JitState *state, uint32_t ip) { return state->vm->jit_step(state, ip); }
+
+    Opcode generic_form(Opcode opcode) {
+        switch (opcode) {
+            case Opcode::BIN_ADD_INT_INT:
+            case Opcode::BIN_ADD_FLOAT_FLOAT:
+                return Opcode::BIN_ADD;
+            case Opcode::BIN_SUB_INT_INT:
+            case Opcode::BIN_SUB_FLOAT_FLOAT:
+                return Opcode::BIN_SUB;
+            case Opcode::BIN_MUL_INT_INT:
+            case Opcode::BIN_MUL_FLOAT_FLOAT:
+                return Opcode::BIN_MUL;
+            case Opcode::BIN_DIV_INT_INT:
+            case Opcode::BIN_DIV_FLOAT_FLOAT:
+                return Opcode::BIN_DIV;
+            case Opcode::BIN_MOD_INT_INT:
+                return Opcode::BIN_MOD;
+            case Opcode::LT_INT_INT:
+            case Opcode::LT_FLOAT_FLOAT:
+                return Opcode::LT;
+            case Opcode::LE_INT_INT:
+            case Opcode::LE_FLOAT_FLOAT:
+                return Opcode::LE;
+            case Opcode::GT_INT_INT:
+            case Opcode::GT_FLOAT_FLOAT:
+                return Opcode::GT;
+            case Opcode::GE_INT_INT:
+            case Opcode::GE_FLOAT_FLOAT:
+                return Opcode::GE;
+            case Opcode::EQ_INT_INT:
+            case Opcode::EQ_FLOAT_FLOAT:
+                return Opcode::EQ;
+            case Opcode::NE_INT_INT:
+            case Opcode::NE_FLOAT_FLOAT:
+                return Opcode::NE;
+            default:
+                return opcode;
+        }
+    }
+
+    Cond int_condition(Opcode compare) {
+        switch (compare) {
+            case Opcode::LT:
+                return LESS;
+            case Opcode::LE:
+                return LESS_EQUAL;
+            case Opcode::GT:
+                return GREATER;
+            case Opcode::GE:
+                return GREATER_EQUAL;
+            case Opcode::EQ:
+                return EQUAL;
+            default:
+                return NOT_EQUAL;
+        }
+    }
+
+    void float_jump_if_false(Assembler &assembler, Opcode compare, Xmm left, Xmm right, Label target) {
+        switch (compare) {
+            case Opcode::LT:
+                assembler.ucomisd(right, left);
+                assembler.jcc(BELOW_EQUAL, target);
+                break;
+            case Opcode::LE:
+                assembler.ucomisd(right, left);
+                assembler.jcc(BELOW, target);
+                break;
+            case Opcode::GT:
+                assembler.ucomisd(left, right);
+                assembler.jcc(BELOW_EQUAL, target);
+                break;
+            case Opcode::GE:
+                assembler.ucomisd(left, right);
+                assembler.jcc(BELOW, target);
+                break;
+            case Opcode::EQ:
+                assembler.ucomisd(left, right);
+                assembler.jcc(NOT_EQUAL, target);
+                assembler.jcc(PARITY, target);
+                break;
+            default: {
+                auto unordered = assembler.new_label();
+                assembler.ucomisd(left, right);
+                assembler.jcc(PARITY, unordered);
+                assembler.jcc(EQUAL, target);
+                assembler.bind(unordered);
+                break;
+            }
+        }
+    }
+
+    class JitCompiler {
+    public:
+        explicit JitCompiler(Code *code) : m_code(code) {}
+
+        // false for bytecode that does not decode or executable memory that could not be had
+        bool compile(JitCode &out);
+
+    private:
+        struct Instruction {
+            Opcode opcode;
+            uint32_t offset;
+            uint32_t next;
+            std::array<uint32_t, 2> oprands;
+
+            [[nodiscard]] uint32_t target() const { return oprands[oprand_count(opcode) - 1]; }
+        };
+
+        Code *m_code;
+        Assembler m_asm;
+        std::vector<Instruction> m_instructions;
+        // label of each instruction by its offset, the one past the end included
+        std::vector<Label> m_labels;
+        // out of line calls into the vm for guards that failed, by index into m_instructions
+        std::vector<std::pair<Label, size_t>> m_slow_paths;
+        // returns with the ip in eax after writing back top
+        Label m_exit = 0;
+        // returns with eax as it is
+        Label m_return = 0;
+
+        uintptr_t m_true = (uintptr_t) Runtime::ins()->C_TRUE.get();
+        uintptr_t m_false = (uintptr_t) Runtime::ins()->C_FALSE.get();
+        uintptr_t m_nil = (uintptr_t) Runtime::ins()->C_NONE.get();
+
+        static Mem top(int32_t depth = 0) { return {TOP, -depth * SLOT}; }
+
+        static Mem top_value(int32_t depth = 0) { return {TOP, -depth * SLOT + VALUE}; }
+
+        static Mem local(uint32_t slot) { return {LOCALS, (int32_t) slot * SLOT}; }
+
+        bool decode();
+
+        void emit(const Instruction &ins, size_t index);
+
+        void sync_top();
+
+        void reload();
+
+        // runs the instruction with the interpreter and carries on wherever it left the frame
+        void step(const Instruction &ins, bool fall_through);
+
+        Label slow_path(size_t index);
+
+        void exit_at(uint32_t ip);
+
+        void push_bits(uint64_t bits, uint64_t value);
+
+        void push_pointer(uintptr_t pointer) { push_bits(pointer, 0); }
+
+        void push_constant(uint32_t index);
+
+        void load_local(uint32_t slot);
+
+        void pop(int32_t count);
+
+        // leaves the tag pair of the two values on top of the stack in rax
+        void load_tags();
+
+        void arithmetic(Opcode operation, size_t index);
+
+        void compare(Opcode compare, size_t index);
+
+        void compare_and_jump(const Instruction &ins, size_t index);
+
+        void jump_if_false(const Instruction &ins, size_t index);
+
+        void pop_top(size_t index);
+
+        void not_(size_t index);
+
+        void unary_sub(size_t index);
+    };
+
+    bool JitCompiler::decode() {
+        auto &bytes = m_code->get_opcodes();
+        auto size = bytes.size();
+        std::vector<bool> starts(size + 1, false);
+
+        for (size_t offset = 0; offset < size;) {
+            auto opcode = bytes[offset];
+            if (opcode >= OPCODE_COUNT) return false;
+
+            Instruction ins{static_cast<Opcode>(opcode), (uint32_t) offset++, 0, {0, 0}};
+            for (uint32_t i = 0; i < oprand_count(ins.opcode); i++) {
+                ins.oprands[i] = read_oprand(ins.opcode, i, bytes.data(), offset);
+            }
+            if (offset > size) return false;
+
+            ins.next = (uint32_t) offset;
+            starts[ins.offset] = true;
+            m_instructions.push_back(ins);
+        }
+        starts[size] = true;
+
+        for (auto &ins: m_instructions) {
+            if (is_jump(ins.opcode) and (ins.target() > size or !starts[ins.target()])) return false;
+        }
+
+        m_labels.resize(size + 1);
+        for (size_t i = 0; i <= size; i++) {
+            if (starts[i]) m_labels[i] = m_asm.new_label();
+        }
+        return true;
+    }
+
+    bool JitCompiler::compile(JitCode &out) {
+        if (!decode()) return false;
+
+        m_exit = m_asm.new_label();
+        m_return = m_asm.new_label();
+
+        // entered as run(state, entry), five pushes leave the stack 16 byte aligned for calls
+        for (auto reg: {RBX, R12, R13, R14, R15}) m_asm.push(reg);
+        m_asm.mov(STATE, RDI);
+        reload();
+        m_asm.jmp(RSI);
+
+        std::vector<uint32_t> entries(m_code->get_code_size(), NO_ENTRY);
+        for (size_t i = 0; i < m_instructions.size(); i++) {
+            auto &ins = m_instructions[i];
+            m_asm.bind(m_labels[ins.offset]);
+            entries[ins.offset] = (uint32_t) m_asm.position();
+            emit(ins, i);
+        }
+
+        m_asm.bind(m_labels[m_code->get_code_size()]);
+        exit_at(m_code->get_code_size());
+
+        for (auto [label, index]: m_slow_paths) {
+            m_asm.bind(label);
+            step(m_instructions[index], false);
+        }
+
+        m_asm.bind(m_exit);
+        sync_top();
+        m_asm.bind(m_return);
+        for (auto reg: {R15, R14, R13, R12, RBX}) m_asm.pop(reg);
+        m_asm.ret();
+
+        if (!m_asm.finish()) return false;
+
+        return out.load(m_asm.code(), std::move(entries));
+    }
+
+    void JitCompiler::emit(const Instruction &ins, size_t index) {
+        auto opcode = generic_form(ins.opcode);
+
+        switch (opcode) {
+            case Opcode::LOAD_CONST:
+                push_constant(ins.oprands[0]);
+                break;
+            case Opcode::PUSH_TRUE:
+                push_pointer(m_true);
+                break;
+            case Opcode::PUSH_FALSE:
+                push_pointer(m_false);
+                break;
+            case Opcode::PUSH_NIL:
+                push_pointer(m_nil);
+                break;
+            case Opcode::LOAD_FAST:
+                load_local(ins.oprands[0]);
+                break;
+            case Opcode::LOAD_FAST_LOAD_FAST:
+                load_local(ins.oprands[0]);
+                load_local(ins.oprands[1]);
+                break;
+            case Opcode::STORE_FAST:
+                m_asm.movups(XMM0, top());
+                m_asm.movups(local(ins.oprands[0]), XMM0);
+                break;
+            case Opcode::CREATE_LOCAL:
+                m_asm.movups(XMM0, top());
+                m_asm.movups(local(ins.oprands[0]), XMM0);
+                pop(1);
+                break;
+            case Opcode::POP_TOP:
+                pop_top(index);
+                break;
+            case Opcode::JUMP:
+            case Opcode::BREAK:
+            case Opcode::CONTINUE:
+                m_asm.jmp(m_labels[ins.target()]);
+                break;
+            case Opcode::JUMP_IF_FALSE:
+                jump_if_false(ins, index);
+                break;
+            case Opcode::COMPARE_AND_JUMP:
+                compare_and_jump(ins, index);
+                break;
+            case Opcode::BIN_ADD:
+            case Opcode::BIN_SUB:
+            case Opcode::BIN_MUL:
+            case Opcode::BIN_DIV:
+            case Opcode::BIN_MOD:
+                arithmetic(opcode, index);
+                break;
+            case Opcode::LT:
+            case Opcode::LE:
+            case Opcode::GT:
+            case Opcode::GE:
+            case Opcode::EQ:
+            case Opcode::NE:
+                compare(opcode, index);
+                break;
+            case Opcode::NOT:
+                not_(index);
+                break;
+            case Opcode::UNARY_SUB:
+                unary_sub(index);
+                break;
+            // returns have to run in the interpreter, which knows where its exec stops
+            case Opcode::RETURN:
+            case Opcode::IMPORT:
+            case Opcode::IMPORT_PRE_COMPILED:
+                exit_at(ins.offset);
+                break;
+            default:
+                step(ins, true);
+                break;
+        }
+    }
+
+    void JitCompiler::sync_top() {
+        m_asm.mov(RCX, TOP);
+        m_asm.sub(RCX, STACK);
+        m_asm.sar(RCX, 4);
+        m_asm.mov(Mem{STATE, offsetof(JitState, top)}, RCX);
+    }
+
+    void JitCompiler::reload() {
+        m_asm.mov(STACK, Mem{STATE, offsetof(JitState, stack)});
+        m_asm.mov(LOCALS, Mem{STATE, offsetof(JitState, locals)});
+        m_asm.mov(RCX, Mem{STATE, offsetof(JitState, top)});
+        m_asm.shl(RCX, 4);
+        m_asm.mov(TOP, STACK);
+        m_asm.add(TOP, RCX);
+    }
+
+    void JitCompiler::step(const Instruction &ins, bool fall_through) {
+        sync_top();
+        m_asm.mov(RDI, STATE);
+        m_asm.mov32(RSI, ins.offset);
+        m_asm.mov(RAX, (uint64_t) (uintptr_t) &jit_step);
+        m_asm.call(RAX);
+        m_asm.cmp32(RAX, JIT_EXIT);
+        m_asm.jcc(EQUAL, m_return);
+        reload();
+
+        if (is_jump(ins.opcode)) {
+            m_asm.cmp32(RAX, ins.target());
+            m_asm.jcc(EQUAL, m_labels[ins.target()]);
+        }
+
+        // anywhere else the vm already wrote back the frame, eax holds where it is
+        m_asm.cmp32(RAX, ins.next);
+        m_asm.jcc(NOT_EQUAL, m_return);
+        if (!fall_through) m_asm.jmp(m_labels[ins.next]);
+    }
+
+    Label JitCompiler::slow_path(size_t index) {
+        auto label = m_asm.new_label();
+        m_slow_paths.emplace_back(label, index);
+        return label;
+    }
+
+    void JitCompiler::exit_at(uint32_t ip) {
+        m_asm.mov32(RAX, ip);
+        m_asm.jmp(m_exit);
+    }
+
+    void JitCompiler::push_bits(uint64_t bits, uint64_t value) {
+        m_asm.mov(RAX, bits);
+        m_asm.mov(top(-1), RAX);
+        if (value == 0) {
+            m_asm.mov(top_value(-1), 0);
+        } else {
+            m_asm.mov(RAX, value);
+            m_asm.mov(top_value(-1), RAX);
+        }
+        m_asm.add(TOP, SLOT);
+    }
+
+    // constants stay reachable through the code object, so their pointers can be baked in
+    void JitCompiler::push_constant(uint32_t index) {
+        auto constant = m_code->get_constant(index);
+        if (constant.is_immediate_int()) {
+            push_bits(IMMEDIATE_INT_TAG, (uint64_t) constant.immediate_int());
+        } else if (constant.is_immediate_float()) {
+            push_bits(IMMEDIATE_FLOAT_TAG, std::bit_cast<uint64_t>(constant.immediate_float()));
+        } else {
+            push_pointer((uintptr_t) constant.get());
+        }
+    }
+
+    void JitCompiler::load_local(uint32_t slot) {
+        m_asm.movups(XMM0, local(slot));
+        m_asm.movups(top(-1), XMM0);
+        m_asm.add(TOP, SLOT);
+    }
+
+    // clears the pointer words of popped slots like the interpreter does, so they do not
+    // keep objects alive
+    void JitCompiler::pop(int32_t count) {
+        for (int32_t i = 0; i < count; i++) m_asm.mov(top(i), 0);
+        m_asm.sub(TOP, count * SLOT);
+    }
+
+    void JitCompiler::load_tags() {
+        m_asm.mov(RAX, top(1));
+        m_asm.and_(RAX, (int32_t) IMMEDIATE_TAG_MASK);
+        m_asm.mov(RCX, top());
+        m_asm.and_(RCX, (int32_t) IMMEDIATE_TAG_MASK);
+        m_asm.shl(RCX, 2);
+        m_asm.or_(RAX, RCX);
+    }
+
+    void JitCompiler::arithmetic(Opcode operation, size_t index) {
+        auto slow = slow_path(index);
+        auto floats = m_asm.new_label();
+        auto done = m_asm.new_label();
+
+        load_tags();
+        m_asm.cmp(RAX, INT_PAIR);
+        m_asm.jcc(NOT_EQUAL, floats);
+
+        m_asm.mov(RAX, top_value(1));
+        m_asm.mov(RCX, top_value());
+        switch (operation) {
+            case Opcode::BIN_ADD:
+                m_asm.add(RAX, RCX);
+                break;
+            case Opcode::BIN_SUB:
+                m_asm.sub(RAX, RCX);
+                break;
+            case Opcode::BIN_MUL:
+                m_asm.imul(RAX, RCX);
+                break;
+            default:
+                // zero faults and so does the minimum divided by -1, both go to the interpreter
+                m_asm.test(RCX, RCX);
+                m_asm.jcc(EQUAL, slow);
+                m_asm.cmp(RCX, -1);
+                m_asm.jcc(EQUAL, slow);
+                m_asm.cqo();
+                m_asm.idiv(RCX);
+                if (operation == Opcode::BIN_MOD) m_asm.mov(RAX, RDX);
+                break;
+        }
+        m_asm.mov(top(1), (int32_t) IMMEDIATE_INT_TAG);
+        m_asm.mov(top_value(1), RAX);
+        pop(1);
+        m_asm.jmp(done);
+
+        m_asm.bind(floats);
+        // there is no specialised float modulo, it stays with the interpreter
+        if (operation == Opcode::BIN_MOD) {
+            m_asm.jmp(slow);
+            m_asm.bind(done);
+            return;
+        }
+
+        m_asm.cmp(RAX, FLOAT_PAIR);
+        m_asm.jcc(NOT_EQUAL, slow);
+        m_asm.movsd(XMM0, top_value(1));
+        m_asm.movsd(XMM1, top_value());
+        switch (operation) {
+            case Opcode::BIN_ADD:
+                m_asm.addsd(XMM0, XMM1);
+                break;
+            case Opcode::BIN_SUB:
+                m_asm.subsd(XMM0, XMM1);
+                break;
+            case Opcode::BIN_MUL:
+                m_asm.mulsd(XMM0, XMM1);
+                break;
+            default:
+                // a zero or nan divisor is left to the interpreter's error
+                m_asm.xorpd(XMM2, XMM2);
+                m_asm.ucomisd(XMM1, XMM2);
+                m_asm.jcc(EQUAL, slow);
+                m_asm.divsd(XMM0, XMM1);
+                break;
+        }
+        m_asm.mov(top(1), (int32_t) IMMEDIATE_FLOAT_TAG);
+        m_asm.movsd(top_value(1), XMM0);
+        pop(1);
+        m_asm.bind(done);
+    }
+
+    void JitCompiler::compare(Opcode compare, size_t index) {
+        auto slow = slow_path(index);
+        auto floats = m_asm.new_label();
+        auto store = m_asm.new_label();
+
+        // the result goes in rsi, rdx and r8 hold the two it can be
+        m_asm.mov(RDX, (uint64_t) m_true);
+        m_asm.mov(R8, (uint64_t) m_false);
+        m_asm.mov(RSI, R8);
+
+        load_tags();
+        m_asm.cmp(RAX, INT_PAIR);
+        m_asm.jcc(NOT_EQUAL, floats);
+        m_asm.mov(RAX, top_value(1));
+        m_asm.mov(RCX, top_value());
+        m_asm.cmp(RAX, RCX);
+        m_asm.cmov(int_condition(compare), RSI, RDX);
+        m_asm.jmp(store);
+
+        m_asm.bind(floats);
+        m_asm.cmp(RAX, FLOAT_PAIR);
+        m_asm.jcc(NOT_EQUAL, slow);
+        m_asm.movsd(XMM0, top_value(1));
+        m_asm.movsd(XMM1, top_value());
+        // unordered sets the carry, zero and parity flags, which must read as false for
+        // everything but NE
+        switch (compare) {
+            case Opcode::LT:
+                m_asm.ucomisd(XMM1, XMM0);
+                m_asm.cmov(ABOVE, RSI, RDX);
+                break;
+            case Opcode::LE:
+                m_asm.ucomisd(XMM1, XMM0);
+                m_asm.cmov(ABOVE_EQUAL, RSI, RDX);
+                break;
+            case Opcode::GT:
+                m_asm.ucomisd(XMM0, XMM1);
+                m_asm.cmov(ABOVE, RSI, RDX);
+                break;
+            case Opcode::GE:
+                m_asm.ucomisd(XMM0, XMM1);
+                m_asm.cmov(ABOVE_EQUAL, RSI, RDX);
+                break;
+            case Opcode::EQ:
+                m_asm.ucomisd(XMM0, XMM1);
+                m_asm.cmov(EQUAL, RSI, RDX);
+                m_asm.cmov(PARITY, RSI, R8);
+                break;
+            default:
+                m_asm.ucomisd(XMM0, XMM1);
+                m_asm.cmov(NOT_EQUAL, RSI, RDX);
+                m_asm.cmov(PARITY, RSI, RDX);
+                break;
+        }
+
+        m_asm.bind(store);
+        m_asm.mov(top(1), RSI);
+        m_asm.mov(top_value(1), 0);
+        pop(1);
+    }
+
+    void JitCompiler::compare_and_jump(const Instruction &ins, size_t index) {
+        auto compare = generic_form(static_cast<Opcode>(ins.oprands[0]));
+        auto target = m_labels[ins.target()];
+        auto slow = slow_path(index);
+        auto floats = m_asm.new_label();
+        auto done = m_asm.new_label();
+
+        load_tags();
+        m_asm.cmp(RAX, INT_PAIR);
+        m_asm.jcc(NOT_EQUAL, floats);
+        m_asm.mov(RAX, top_value(1));
+        m_asm.mov(RCX, top_value());
+        pop(2);
+        m_asm.cmp(RAX, RCX);
+        m_asm.jcc(negate(int_condition(compare)), target);
+        m_asm.jmp(done);
+
+        m_asm.bind(floats);
+        m_asm.cmp(RAX, FLOAT_PAIR);
+        m_asm.jcc(NOT_EQUAL, slow);
+        m_asm.movsd(XMM0, top_value(1));
+        m_asm.movsd(XMM1, top_value());
+        pop(2);
+        float_jump_if_false(m_asm, compare, XMM0, XMM1, target);
+        m_asm.bind(done);
+    }
+
+    void JitCompiler::jump_if_false(const Instruction &ins, size_t index) {
+        auto slow = slow_path(index);
+        auto is_false = m_asm.new_label();
+        auto is_true = m_asm.new_label();
+
+        m_asm.mov(RAX, top());
+        m_asm.mov(RCX, (uint64_t) m_false);
+        m_asm.cmp(RAX, RCX);
+        m_asm.jcc(EQUAL, is_false);
+        m_asm.mov(RCX, (uint64_t) m_true);
+        m_asm.cmp(RAX, RCX);
+        m_asm.jcc(EQUAL, is_true);
+
+        // an int is false when it is zero, anything else asks the interpreter
+        m_asm.and_(RAX, (int32_t) IMMEDIATE_TAG_MASK);
+        m_asm.cmp(RAX, (int32_t) IMMEDIATE_INT_TAG);
+        m_asm.jcc(NOT_EQUAL, slow);
+        m_asm.mov(RCX, top_value());
+        m_asm.test(RCX, RCX);
+        m_asm.jcc(NOT_EQUAL, is_true);
+
+        m_asm.bind(is_false);
+        pop(1);
+        m_asm.jmp(m_labels[ins.target()]);
+
+        m_asm.bind(is_true);
+        pop(1);
+    }
+
+    // results are checked by the interpreter, only values that can not be one are popped here
+    void JitCompiler::pop_top(size_t index) {
+        auto slow = slow_path(index);
+        auto discard = m_asm.new_label();
+
+        m_asm.mov(RAX, top());
+        m_asm.test(RAX, (int32_t) IMMEDIATE_TAG_MASK);
+        m_asm.jcc(NOT_EQUAL, discard);
+        for (auto pointer: {m_nil, m_true, m_false}) {
+            m_asm.mov(RCX, (uint64_t) pointer);
+            m_asm.cmp(RAX, RCX);
+            m_asm.jcc(EQUAL, discard);
+        }
+        m_asm.jmp(slow);
+
+        m_asm.bind(discard);
+        pop(1);
+    }
+
+    void JitCompiler::not_(size_t index) {
+        auto slow = slow_path(index);
+        auto was_false = m_asm.new_label();
+        auto done = m_asm.new_label();
+
+        m_asm.mov(RAX, top());
+        m_asm.mov(RCX, (uint64_t) m_true);
+        m_asm.mov(RDX, (uint64_t) m_false);
+        m_asm.cmp(RAX, RCX);
+        m_asm.jcc(NOT_EQUAL, was_false);
+        m_asm.mov(top(), RDX);
+        m_asm.jmp(done);
+
+        m_asm.bind(was_false);
+        m_asm.cmp(RAX, RDX);
+        m_asm.jcc(NOT_EQUAL, slow);
+        m_asm.mov(top(), RCX);
+        m_asm.bind(done);
+    }
+
+    void JitCompiler::unary_sub(size_t index) {
+        auto slow = slow_path(index);
+        auto floats = m_asm.new_label();
+        auto done = m_asm.new_label();
+
+        m_asm.mov(RAX, top());
+        m_asm.and_(RAX, (int32_t) IMMEDIATE_TAG_MASK);
+        m_asm.cmp(RAX, (int32_t) IMMEDIATE_INT_TAG);
+        m_asm.jcc(NOT_EQUAL, floats);
+        m_asm.mov(RCX, top_value());
+        m_asm.neg(RCX);
+        m_asm.jmp(done);
+
+        // flips the sign bit
+        m_asm.bind(floats);
+        m_asm.cmp(RAX, (int32_t) IMMEDIATE_FLOAT_TAG);
+        m_asm.jcc(NOT_EQUAL, slow);
+        m_asm.mov(RCX, top_value());
+        m_asm.mov(RDX, (uint64_t) 1 << 63);
+        m_asm.xor_(RCX, RDX);
+
+        // the tag alone, dropping any box the old value had
+        m_asm.bind(done);
+        m_asm.mov(top(), RAX);
+        m_asm.mov(top_value(), RCX);
+    }
+
+    JitCode::~JitCode() {
+#ifdef BOND_JIT_X64
+        if (m_memory) munmap(m_memory, m_size);
+#endif
+    }
+
+    bool JitCode::load(const std::vector<uint8_t> &bytes, std::vector<uint32_t> entries) {
+#ifdef BOND_JIT_X64
+        auto memory = mmap(nullptr, bytes.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) return false;
+
+        std::memcpy(memory, bytes.data(), bytes.size());
+        if (mprotect(memory, bytes.size(), PROT_READ | PROT_EXEC) != 0) {
+            munmap(memory, bytes.size());
+            return false;
+        }
+
+        m_memory = static_cast<uint8_t *>(memory);
+        m_size = bytes.size();
+        m_entries = std::move(entries);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    const uint8_t *JitCode::entry(size_t ip) const {
+        if (!m_memory or ip >= m_entries.size() or m_entries[ip] == NO_ENTRY) return nullptr;
+        return m_memory + m_entries[ip];
+    }
+
+    uint32_t JitCode::run(JitState *state, const uint8_t *entry) const {
+        using Native = uint32_t (*)(JitState *, const uint8_t *);
+        return reinterpret_cast<Native>(m_memory)(state, entry);
+    }
+
+    Jit &Jit::instance() {
+        static Jit jit;
+        return jit;
+    }
+
+    bool Jit::is_supported() {
+#ifdef BOND_JIT_X64
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    JitCode *Jit::get(Code *code, uint32_t threshold) {
+        if (auto compiled = code->get_jit_code()) return compiled;
+        if (code->count_jit_entry() < threshold) return nullptr;
+
+        // code that fails to compile keeps an empty JitCode, so it is not tried again
+        auto compiled = std::make_unique<JitCode>();
+        JitCompiler(code).compile(*compiled);
+        code->set_jit_code(compiled.get());
+        m_compiled.push_back(std::move(compiled));
+        return code->get_jit_code();
+    }
+}
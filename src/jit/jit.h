@@ -0,0 +1,112 @@
+//
+// baseline jit, turns the bytecode of hot code objects into x86-64 machine code
+//
+// every instruction gets a fixed template. locals, constants, jumps and arithmetic and
+// comparisons on immediates run inline, anything else calls back into the vm which runs
+// that one instruction with the interpreter. native code can be entered at any instruction
+// and leaves at a RETURN or when the vm moves to another frame, so the interpreter carries
+// on wherever it stopped
+//
+// loops can also be traced, see trace.cpp. the vm records the instructions one pass round a
+// hot loop runs and the types it saw, and the trace is compiled to straight line code that
+// guards those types and branches and leaves for the interpreter when one does not hold
+//
+
+#ifndef BOND_JIT_H
+#define BOND_JIT_H
+
+#include "../object.h"
+#include <array>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace bond {
+    class Vm;
+
+    // the vm state native code works on, read and written at fixed offsets. native code keeps
+    // it in registers and writes top back before it calls into the vm or returns
+    struct JitState {
+        // bottom of the vm's current stack segment
+        GcPtr<Object> *stack;
+        // local slots of the frame being run
+        GcPtr<Object> *locals;
+        // index of the top of the operand stack
+        int64_t top;
+        Vm *vm;
+    };
+
+    // returned in place of an ip when the vm moved to another frame or stopped, the frame and
+    // the stack are left as the vm set them
+    constexpr uint32_t JIT_EXIT = std::numeric_limits<uint32_t>::max();
+
+    // an instruction the vm ran while recording a loop trace
+    struct TraceStep {
+        uint32_t ip;
+        // the generic form of what ran
+        Opcode opcode;
+        std::array<uint32_t, 2> oprands;
+        // immediate tags of the value on top of the stack and the one below it before it ran
+        uint8_t top_tag;
+        uint8_t below_tag;
+        // operand stack depth above where it stood at the loop header, before it ran
+        int32_t depth;
+        // where the frame went on to
+        uint32_t next;
+    };
+
+    class JitCode {
+    public:
+        JitCode() = default;
+
+        JitCode(const JitCode &) = delete;
+
+        JitCode &operator=(const JitCode &) = delete;
+
+        ~JitCode();
+
+        // machine code for the instruction at ip, null when none starts there or the code
+        // could not be compiled
+        [[nodiscard]] const uint8_t *entry(size_t ip) const;
+
+        // runs from entry until an instruction the interpreter has to run, returns its ip
+        // with state.top written back, or JIT_EXIT
+        uint32_t run(JitState *state, const uint8_t *entry) const;
+
+    private:
+        friend class JitCompiler;
+
+        friend class TraceCompiler;
+
+        uint8_t *m_memory = nullptr;
+        size_t m_size = 0;
+        // offset into m_memory of each instruction by the offset of its bytecode
+        std::vector<uint32_t> m_entries;
+
+        // copies bytes into executable memory
+        bool load(const std::vector<uint8_t> &bytes, std::vector<uint32_t> entries);
+    };
+
+    class Jit {
+    public:
+        static Jit &instance();
+
+        // machine code is only emitted for x86-64 with the System V calling convention
+        static bool is_supported();
+
+        // the compiled form of code, counting this entry towards compiling it. null while
+        // code has been entered no more than threshold times
+        JitCode *get(Code *code, uint32_t threshold);
+
+        // compiles a trace that starts at a loop header and runs back round to it, entered
+        // at the header. null when the trace could not be compiled
+        JitCode *compile_trace(Code *code, const std::vector<TraceStep> &steps);
+
+    private:
+        Jit() = default;
+
+        std::vector<std::unique_ptr<JitCode>> m_compiled;
+    };
+}
+
+#endif //BOND_JIT_H
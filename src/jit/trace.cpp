@@ -0,0 +1,642 @@
+//
+// compiles the loop traces the vm records into straight line machine code, see jit.h
+//
+// the operand stack is kept virtual while the trace runs. loads of locals and constants are
+// only noted, an int result stays in rax and a float result in xmm0, and values are written
+// to their stack slots when an instruction has to run in the interpreter or the trace leaves
+//
+
+#include "jit.h"
+#include "emit.h"
+#include "../runtime.h"
+#include <bit>
+#include <unordered_map>
+
+namespace bond {
+    using namespace x64;
+
+    // where the operand stack stood at the loop header, values the trace pushes go above it
+    constexpr Reg BASE = TOP;
+    // index of that slot, BASE is rebuilt from it after the vm ran an instruction
+    constexpr Reg BASE_INDEX = R15;
+
+    constexpr int8_t UNKNOWN_TAG = -1;
+    constexpr int8_t OBJECT_TAG = 0;
+    constexpr auto INT_TAG = (int8_t) IMMEDIATE_INT_TAG;
+    constexpr auto FLOAT_TAG = (int8_t) IMMEDIATE_FLOAT_TAG;
+
+    // the recording saw tag on both operands of a binary instruction
+    static bool both(const TraceStep &step, int8_t tag) {
+        return step.below_tag == (uint8_t) tag and step.top_tag == (uint8_t) tag;
+    }
+
+    class TraceCompiler {
+    public:
+        TraceCompiler(Code *code, const std::vector<TraceStep> &steps) : m_code(code), m_steps(steps) {}
+
+        bool compile(JitCode &out);
+
+    private:
+        // where a value on the operand stack is while the trace runs
+        enum class Kind : uint8_t {
+            // written to its slot above BASE
+            Stack,
+            // still in a local slot
+            Local,
+            Const,
+            // an int in rax, only one value is ever kept there
+            Int,
+            // a float in xmm0, only one value is ever kept there
+            Float,
+        };
+
+        struct Value {
+            Kind kind;
+            // the local of a Local, the stack position of a Stack
+            uint32_t slot = 0;
+            // the two words of a Const
+            uint64_t bits = 0;
+            uint64_t value = 0;
+            // immediate tag when it is known, a Local's is kept in m_local_tags
+            int8_t tag = UNKNOWN_TAG;
+        };
+
+        // writes the stack back as it stood before the instruction at ip and leaves for the
+        // interpreter to run it
+        struct Exit {
+            Label label;
+            uint32_t ip;
+            std::vector<Value> values;
+        };
+
+        Code *m_code;
+        const std::vector<TraceStep> &m_steps;
+        Assembler m_asm;
+        std::vector<Value> m_values;
+        // tags of locals checked or stored since the interpreter last ran an instruction
+        std::unordered_map<uint32_t, int8_t> m_local_tags;
+        std::vector<Exit> m_exits;
+        Label m_return = 0;
+
+        uintptr_t m_true = (uintptr_t) Runtime::ins()->C_TRUE.get();
+        uintptr_t m_false = (uintptr_t) Runtime::ins()->C_FALSE.get();
+        uintptr_t m_nil = (uintptr_t) Runtime::ins()->C_NONE.get();
+
+        static Mem slot(size_t index) { return {BASE, (int32_t) (index + 1) * SLOT}; }
+
+        static Mem local(uint32_t slot) { return {LOCALS, (int32_t) slot * SLOT}; }
+
+        static Mem value_of(Mem mem) { return {mem.base, mem.disp + VALUE}; }
+
+        // the step's effect on the virtual stack, false when the trace can not be compiled
+        bool emit(const TraceStep &step, size_t next_depth);
+
+        // runs the step in the interpreter, leaving the trace unless it goes on to step.next
+        void interpret(const TraceStep &step, size_t next_depth);
+
+        int8_t tag_of(const Value &value);
+
+        Value constant(uint64_t bits, uint64_t value, int8_t tag) { return {Kind::Const, 0, bits, value, tag}; }
+
+        Value constant(const GcPtr<Object> &object);
+
+        // stores the two words of value to a slot
+        void write(const Value &value, Mem to);
+
+        void materialize(size_t index);
+
+        void materialize_all();
+
+        // writes values of kind kept in a register below index to their slots
+        void spill(Kind kind, size_t below);
+
+        Label exit_here(uint32_t ip);
+
+        // false when value is known to have another tag
+        bool guard(Value &value, int8_t tag, Label exit);
+
+        void load_int(const Value &value, Reg reg);
+
+        void load_float(const Value &value, Xmm reg);
+
+        // clears the pointer word of a popped stack slot that may keep an object alive
+        void discard(const Value &value);
+
+        bool store_local(uint32_t slot, bool keep);
+
+        bool jump_if_false(const TraceStep &step, size_t next_depth);
+
+        bool compare_and_jump(const TraceStep &step, size_t next_depth);
+
+        bool int_arithmetic(const TraceStep &step, Opcode operation);
+
+        bool float_arithmetic(const TraceStep &step, Opcode operation);
+
+        bool int_compare(const TraceStep &step, Opcode compare);
+    };
+
+    bool TraceCompiler::compile(JitCode &out) {
+        auto header = m_steps.front().ip;
+        if (m_steps.front().depth != 0 or m_steps.back().next != header) return false;
+
+        m_return = m_asm.new_label();
+        auto loop = m_asm.new_label();
+
+        for (auto reg: {RBX, R12, R13, R14, R15}) m_asm.push(reg);
+        m_asm.mov(STATE, RDI);
+        m_asm.mov(STACK, Mem{STATE, offsetof(JitState, stack)});
+        m_asm.mov(LOCALS, Mem{STATE, offsetof(JitState, locals)});
+        m_asm.mov(BASE_INDEX, Mem{STATE, offsetof(JitState, top)});
+        m_asm.mov(BASE, BASE_INDEX);
+        m_asm.shl(BASE, 4);
+        m_asm.add(BASE, STACK);
+
+        m_asm.bind(loop);
+        for (size_t i = 0; i < m_steps.size(); i++) {
+            auto &step = m_steps[i];
+            if (m_values.size() != (size_t) step.depth) return false;
+
+            auto next_depth = i + 1 < m_steps.size() ? m_steps[i + 1].depth : 0;
+            if (next_depth < 0 or !emit(step, next_depth)) return false;
+        }
+        if (!m_values.empty()) return false;
+        m_asm.jmp(loop);
+
+        for (auto &exit: m_exits) {
+            m_asm.bind(exit.label);
+            m_values = exit.values;
+            materialize_all();
+            m_asm.mov(RCX, BASE_INDEX);
+            m_asm.add(RCX, (int32_t) m_values.size());
+            m_asm.mov(Mem{STATE, offsetof(JitState, top)}, RCX);
+            m_asm.mov32(RAX, exit.ip);
+            m_asm.jmp(m_return);
+        }
+
+        m_asm.bind(m_return);
+        for (auto reg: {R15, R14, R13, R12, RBX}) m_asm.pop(reg);
+        m_asm.ret();
+
+        if (!m_asm.finish()) return false;
+
+        std::vector<uint32_t> entries(m_code->get_code_size(), NO_ENTRY);
+        entries[header] = 0;
+        return out.load(m_asm.code(), std::move(entries));
+    }
+
+    bool TraceCompiler::emit(const TraceStep &step, size_t next_depth) {
+        auto opcode = generic_form(step.opcode);
+
+        switch (opcode) {
+            case Opcode::LOAD_CONST:
+                m_values.push_back(constant(m_code->get_constant(step.oprands[0])));
+                return true;
+            case Opcode::PUSH_TRUE:
+                m_values.push_back(constant(m_true, 0, OBJECT_TAG));
+                return true;
+            case Opcode::PUSH_FALSE:
+                m_values.push_back(constant(m_false, 0, OBJECT_TAG));
+                return true;
+            case Opcode::PUSH_NIL:
+                m_values.push_back(constant(m_nil, 0, OBJECT_TAG));
+                return true;
+            case Opcode::LOAD_FAST:
+                m_values.push_back({Kind::Local, step.oprands[0]});
+                return true;
+            case Opcode::LOAD_FAST_LOAD_FAST:
+                m_values.push_back({Kind::Local, step.oprands[0]});
+                m_values.push_back({Kind::Local, step.oprands[1]});
+                return true;
+            case Opcode::STORE_FAST:
+                return store_local(step.oprands[0], true);
+            case Opcode::CREATE_LOCAL:
+                return store_local(step.oprands[0], false);
+            case Opcode::JUMP:
+            case Opcode::BREAK:
+            case Opcode::CONTINUE:
+                return true;
+            case Opcode::JUMP_IF_FALSE:
+                return jump_if_false(step, next_depth);
+            case Opcode::COMPARE_AND_JUMP:
+                return compare_and_jump(step, next_depth);
+            case Opcode::POP_TOP: {
+                // anything that may be a Result is checked by the interpreter
+                auto &top = m_values.back();
+                auto tag = tag_of(top);
+                auto singleton = top.kind == Kind::Const and
+                                 (top.bits == m_nil or top.bits == m_true or top.bits == m_false);
+                if (tag != INT_TAG and tag != FLOAT_TAG and !singleton) break;
+                discard(top);
+                m_values.pop_back();
+                return true;
+            }
+            case Opcode::BIN_ADD:
+            case Opcode::BIN_SUB:
+            case Opcode::BIN_MUL:
+            case Opcode::BIN_DIV:
+            case Opcode::BIN_MOD:
+                if (both(step, INT_TAG)) return int_arithmetic(step, opcode);
+                if (opcode != Opcode::BIN_MOD and both(step, FLOAT_TAG)) return float_arithmetic(step, opcode);
+                break;
+            case Opcode::LT:
+            case Opcode::LE:
+            case Opcode::GT:
+            case Opcode::GE:
+            case Opcode::EQ:
+            case Opcode::NE:
+                if (both(step, INT_TAG)) return int_compare(step, opcode);
+                break;
+            // the recorder never records these, they leave the frame's exec
+            case Opcode::RETURN:
+            case Opcode::IMPORT:
+            case Opcode::IMPORT_PRE_COMPILED:
+                return false;
+            default:
+                break;
+        }
+
+        interpret(step, next_depth);
+        return true;
+    }
+
+    void TraceCompiler::interpret(const TraceStep &step, size_t next_depth) {
+        materialize_all();
+        m_asm.mov(RCX, BASE_INDEX);
+        m_asm.add(RCX, (int32_t) m_values.size());
+        m_asm.mov(Mem{STATE, offsetof(JitState, top)}, RCX);
+
+        m_asm.mov(RDI, STATE);
+        m_asm.mov32(RSI, step.ip);
+        m_asm.mov(RAX, (uint64_t) (uintptr_t) &jit_step);
+        m_asm.call(RAX);
+
+        // off the trace the vm already wrote back the frame, eax holds where it is or JIT_EXIT
+        m_asm.cmp32(RAX, step.next);
+        m_asm.jcc(NOT_EQUAL, m_return);
+
+        m_asm.mov(STACK, Mem{STATE, offsetof(JitState, stack)});
+        m_asm.mov(LOCALS, Mem{STATE, offsetof(JitState, locals)});
+        m_asm.mov(BASE, BASE_INDEX);
+        m_asm.shl(BASE, 4);
+        m_asm.add(BASE, STACK);
+
+        m_values.clear();
+        for (size_t i = 0; i < next_depth; i++) m_values.push_back({Kind::Stack, (uint32_t) i});
+        m_local_tags.clear();
+    }
+
+    int8_t TraceCompiler::tag_of(const Value &value) {
+        if (value.kind != Kind::Local) return value.tag;
+        auto it = m_local_tags.find(value.slot);
+        return it == m_local_tags.end() ? UNKNOWN_TAG : it->second;
+    }
+
+    // constants stay reachable through the code object, so their pointers can be baked in
+    TraceCompiler::Value TraceCompiler::constant(const GcPtr<Object> &object) {
+        if (object.is_immediate_int()) {
+            return constant(IMMEDIATE_INT_TAG, (uint64_t) object.immediate_int(), INT_TAG);
+        }
+        if (object.is_immediate_float()) {
+            return constant(IMMEDIATE_FLOAT_TAG, std::bit_cast<uint64_t>(object.immediate_float()), FLOAT_TAG);
+        }
+        return constant((uintptr_t) object.get(), 0, OBJECT_TAG);
+    }
+
+    void TraceCompiler::write(const Value &value, Mem to) {
+        switch (value.kind) {
+            case Kind::Stack:
+                m_asm.movups(XMM1, slot(value.slot));
+                m_asm.movups(to, XMM1);
+                break;
+            case Kind::Local:
+                m_asm.movups(XMM1, local(value.slot));
+                m_asm.movups(to, XMM1);
+                break;
+            case Kind::Const:
+                m_asm.mov(RCX, value.bits);
+                m_asm.mov(to, RCX);
+                m_asm.mov(RCX, value.value);
+                m_asm.mov(value_of(to), RCX);
+                break;
+            case Kind::Int:
+                m_asm.mov(to, (int32_t) IMMEDIATE_INT_TAG);
+                m_asm.mov(value_of(to), RAX);
+                break;
+            case Kind::Float:
+                m_asm.mov(to, (int32_t) IMMEDIATE_FLOAT_TAG);
+                m_asm.movsd(value_of(to), XMM0);
+                break;
+        }
+    }
+
+    void TraceCompiler::materialize(size_t index) {
+        auto &value = m_values[index];
+        if (value.kind == Kind::Stack) return;
+
+        write(value, slot(index));
+        value = {Kind::Stack, (uint32_t) index, 0, 0, tag_of(value)};
+    }
+
+    void TraceCompiler::materialize_all() {
+        for (size_t i = 0; i < m_values.size(); i++) materialize(i);
+    }
+
+    void TraceCompiler::spill(Kind kind, size_t below) {
+        for (size_t i = 0; i < below; i++) {
+            if (m_values[i].kind == kind) materialize(i);
+        }
+    }
+
+    Label TraceCompiler::exit_here(uint32_t ip) {
+        m_exits.push_back({m_asm.new_label(), ip, m_values});
+        return m_exits.back().label;
+    }
+
+    bool TraceCompiler::guard(Value &value, int8_t tag, Label exit) {
+        auto known = tag_of(value);
+        if (known != UNKNOWN_TAG) return known == tag;
+
+        auto mem = value.kind == Kind::Local ? local(value.slot) : slot(value.slot);
+        m_asm.mov(RCX, mem);
+        m_asm.and_(RCX, (int32_t) IMMEDIATE_TAG_MASK);
+        m_asm.cmp(RCX, (int32_t) tag);
+        m_asm.jcc(NOT_EQUAL, exit);
+
+        if (value.kind == Kind::Local) {
+            m_local_tags[value.slot] = tag;
+        } else {
+            value.tag = tag;
+        }
+        return true;
+    }
+
+    void TraceCompiler::load_int(const Value &value, Reg reg) {
+        switch (value.kind) {
+            case Kind::Stack:
+                m_asm.mov(reg, value_of(slot(value.slot)));
+                break;
+            case Kind::Local:
+                m_asm.mov(reg, value_of(local(value.slot)));
+                break;
+            case Kind::Const:
+                m_asm.mov(reg, value.value);
+                break;
+            default:
+                if (reg != RAX) m_asm.mov(reg, RAX);
+                break;
+        }
+    }
+
+    void TraceCompiler::load_float(const Value &value, Xmm reg) {
+        switch (value.kind) {
+            case Kind::Stack:
+                m_asm.movsd(reg, value_of(slot(value.slot)));
+                break;
+            case Kind::Local:
+                m_asm.movsd(reg, value_of(local(value.slot)));
+                break;
+            case Kind::Const:
+                m_asm.mov(RCX, value.value);
+                m_asm.movq(reg, RCX);
+                break;
+            default:
+                if (reg != XMM0) m_asm.movsd(reg, XMM0);
+                break;
+        }
+    }
+
+    void TraceCompiler::discard(const Value &value) {
+        auto tag = tag_of(value);
+        if (value.kind == Kind::Stack and tag != INT_TAG and tag != FLOAT_TAG) {
+            m_asm.mov(slot(value.slot), 0);
+        }
+    }
+
+    bool TraceCompiler::store_local(uint32_t slot, bool keep) {
+        auto top = m_values.back();
+
+        if (top.kind != Kind::Local or top.slot != slot) {
+            // values that still read the local have to be copied out before it changes
+            for (size_t i = 0; i + 1 < m_values.size(); i++) {
+                if (m_values[i].kind == Kind::Local and m_values[i].slot == slot) materialize(i);
+            }
+            auto tag = tag_of(top);
+            write(top, local(slot));
+            m_local_tags[slot] = tag;
+        }
+
+        if (!keep) {
+            discard(top);
+            m_values.pop_back();
+        }
+        return true;
+    }
+
+    bool TraceCompiler::jump_if_false(const TraceStep &step, size_t next_depth) {
+        auto jumped = step.next == step.oprands[0];
+        auto &condition = m_values.back();
+
+        // a constant condition goes the same way every time round
+        if (condition.kind == Kind::Const) {
+            bool truthy;
+            if (condition.bits == m_true) {
+                truthy = true;
+            } else if (condition.bits == m_false) {
+                truthy = false;
+            } else if (condition.tag == INT_TAG) {
+                truthy = condition.value != 0;
+            } else {
+                interpret(step, next_depth);
+                return true;
+            }
+            if (truthy == jumped) return false;
+            m_values.pop_back();
+            return true;
+        }
+
+        auto exit = exit_here(step.ip);
+        if (step.top_tag == INT_TAG) {
+            if (!guard(condition, INT_TAG, exit)) return false;
+            auto reg = condition.kind == Kind::Int ? RAX : RCX;
+            load_int(condition, reg);
+            m_asm.test(reg, reg);
+            m_asm.jcc(jumped ? NOT_EQUAL : EQUAL, exit);
+        } else if (step.top_tag == OBJECT_TAG and (condition.kind == Kind::Stack or condition.kind == Kind::Local)) {
+            // only the bool the recording saw stays on the trace, other values leave it
+            auto mem = condition.kind == Kind::Local ? local(condition.slot) : slot(condition.slot);
+            m_asm.mov(RCX, mem);
+            m_asm.mov(RDX, (uint64_t) (jumped ? m_false : m_true));
+            m_asm.cmp(RCX, RDX);
+            m_asm.jcc(NOT_EQUAL, exit);
+        } else {
+            m_exits.pop_back();
+            interpret(step, next_depth);
+            return true;
+        }
+
+        m_values.pop_back();
+        return true;
+    }
+
+    bool TraceCompiler::compare_and_jump(const TraceStep &step, size_t next_depth) {
+        auto compare = generic_form(static_cast<Opcode>(step.oprands[0]));
+        auto jumped = step.next == step.oprands[1];
+        auto size = m_values.size();
+        auto &left = m_values[size - 2];
+        auto &right = m_values[size - 1];
+
+        if (both(step, INT_TAG)) {
+            auto exit = exit_here(step.ip);
+            if (!guard(left, INT_TAG, exit) or !guard(right, INT_TAG, exit)) return false;
+
+            auto l = left.kind == Kind::Int ? RAX : RCX;
+            auto r = right.kind == Kind::Int ? RAX : RDX;
+            load_int(left, l);
+            load_int(right, r);
+            m_asm.cmp(l, r);
+            auto condition = int_condition(compare);
+            m_asm.jcc(jumped ? condition : negate(condition), exit);
+        } else if (both(step, FLOAT_TAG)) {
+            auto exit = exit_here(step.ip);
+            if (!guard(left, FLOAT_TAG, exit) or !guard(right, FLOAT_TAG, exit)) return false;
+
+            // xmm0 is left alone, the exit may still have to write it back
+            auto l = left.kind == Kind::Float ? XMM0 : XMM1;
+            auto r = right.kind == Kind::Float ? XMM0 : XMM2;
+            load_float(left, l);
+            load_float(right, r);
+            if (!jumped) {
+                float_jump_if_false(m_asm, compare, l, r, exit);
+            } else {
+                auto stays = m_asm.new_label();
+                float_jump_if_false(m_asm, compare, l, r, stays);
+                m_asm.jmp(exit);
+                m_asm.bind(stays);
+            }
+        } else {
+            interpret(step, next_depth);
+            return true;
+        }
+
+        m_values.pop_back();
+        m_values.pop_back();
+        return true;
+    }
+
+    bool TraceCompiler::int_arithmetic(const TraceStep &step, Opcode operation) {
+        auto size = m_values.size();
+        spill(Kind::Int, size - 2);
+
+        auto exit = exit_here(step.ip);
+        auto &left = m_values[size - 2];
+        auto &right = m_values[size - 1];
+        if (!guard(left, INT_TAG, exit) or !guard(right, INT_TAG, exit)) return false;
+
+        switch (operation) {
+            case Opcode::BIN_DIV:
+            case Opcode::BIN_MOD:
+                // zero faults and so does the minimum divided by -1, both leave the trace
+                load_int(right, RCX);
+                m_asm.test(RCX, RCX);
+                m_asm.jcc(EQUAL, exit);
+                m_asm.cmp(RCX, -1);
+                m_asm.jcc(EQUAL, exit);
+                load_int(left, RAX);
+                m_asm.cqo();
+                m_asm.idiv(RCX);
+                if (operation == Opcode::BIN_MOD) m_asm.mov(RAX, RDX);
+                break;
+            default:
+                if (right.kind == Kind::Int) {
+                    m_asm.mov(RCX, RAX);
+                    load_int(left, RAX);
+                } else {
+                    load_int(left, RAX);
+                    load_int(right, RCX);
+                }
+                if (operation == Opcode::BIN_ADD) {
+                    m_asm.add(RAX, RCX);
+                } else if (operation == Opcode::BIN_SUB) {
+                    m_asm.sub(RAX, RCX);
+                } else {
+                    m_asm.imul(RAX, RCX);
+                }
+                break;
+        }
+
+        m_values.pop_back();
+        m_values.back() = {Kind::Int, 0, 0, 0, INT_TAG};
+        return true;
+    }
+
+    bool TraceCompiler::float_arithmetic(const TraceStep &step, Opcode operation) {
+        auto size = m_values.size();
+        spill(Kind::Float, size - 2);
+
+        auto exit = exit_here(step.ip);
+        auto &left = m_values[size - 2];
+        auto &right = m_values[size - 1];
+        if (!guard(left, FLOAT_TAG, exit) or !guard(right, FLOAT_TAG, exit)) return false;
+
+        load_float(right, XMM1);
+        if (operation == Opcode::BIN_DIV) {
+            // a zero or nan divisor is left to the interpreter's error
+            m_asm.xorpd(XMM2, XMM2);
+            m_asm.ucomisd(XMM1, XMM2);
+            m_asm.jcc(EQUAL, exit);
+        }
+        load_float(left, XMM0);
+
+        switch (operation) {
+            case Opcode::BIN_ADD:
+                m_asm.addsd(XMM0, XMM1);
+                break;
+            case Opcode::BIN_SUB:
+                m_asm.subsd(XMM0, XMM1);
+                break;
+            case Opcode::BIN_MUL:
+                m_asm.mulsd(XMM0, XMM1);
+                break;
+            default:
+                m_asm.divsd(XMM0, XMM1);
+                break;
+        }
+
+        m_values.pop_back();
+        m_values.back() = {Kind::Float, 0, 0, 0, FLOAT_TAG};
+        return true;
+    }
+
+    bool TraceCompiler::int_compare(const TraceStep &step, Opcode compare) {
+        auto size = m_values.size();
+        auto exit = exit_here(step.ip);
+        auto &left = m_values[size - 2];
+        auto &right = m_values[size - 1];
+        if (!guard(left, INT_TAG, exit) or !guard(right, INT_TAG, exit)) return false;
+
+        auto l = left.kind == Kind::Int ? RAX : RCX;
+        auto r = right.kind == Kind::Int ? RAX : RDX;
+        load_int(left, l);
+        load_int(right, r);
+        m_asm.mov(R8, (uint64_t) m_false);
+        m_asm.mov(R9, (uint64_t) m_true);
+        m_asm.cmp(l, r);
+        m_asm.cmov(int_condition(compare), R8, R9);
+
+        // the result takes the left operand's slot
+        m_values.pop_back();
+        m_asm.mov(slot(size - 2), R8);
+        m_asm.mov(value_of(slot(size - 2)), 0);
+        m_values.back() = {Kind::Stack, (uint32_t) size - 2, 0, 0, OBJECT_TAG};
+        return true;
+    }
+
+    JitCode *Jit::compile_trace(Code *code, const std::vector<TraceStep> &steps) {
+        if (steps.empty()) return nullptr;
+
+        auto compiled = std::make_unique<JitCode>();
+        if (!TraceCompiler(code, steps).compile(*compiled)) return nullptr;
+        m_compiled.push_back(std::move(compiled));
+        return m_compiled.back().get();
+    }
+}
@@ -0,0 +1,222 @@
+//
+// instruction encodings for the assembler in x64.h
+//
+
+#include "x64.h"
+
+namespace bond::x64 {
+    Label Assembler::new_label() {
+        m_labels.push_back(-1);
+        return (Label) m_labels.size() - 1;
+    }
+
+    void Assembler::bind(Label label) { m_labels[label] = (int64_t) m_code.size(); }
+
+    bool Assembler::finish() {
+        for (auto [offset, label]: m_fixups) {
+            if (m_labels[label] < 0) return false;
+            auto rel = (int32_t) (m_labels[label] - (int64_t) (offset + 4));
+            for (int i = 0; i < 4; i++) m_code[offset + i] = (uint8_t) ((uint32_t) rel >> (8 * i));
+        }
+        m_fixups.clear();
+        return true;
+    }
+
+    void Assembler::emit32(uint32_t value) {
+        for (int i = 0; i < 4; i++) emit((uint8_t) (value >> (8 * i)));
+    }
+
+    void Assembler::emit64(uint64_t value) {
+        for (int i = 0; i < 8; i++) emit((uint8_t) (value >> (8 * i)));
+    }
+
+    void Assembler::rex(bool wide, uint8_t reg, uint8_t base) {
+        uint8_t prefix = 0x40 | (wide ? 0x08 : 0) | (reg & 8 ? 0x04 : 0) | (base & 8 ? 0x01 : 0);
+        if (prefix != 0x40) emit(prefix);
+    }
+
+    void Assembler::modrm(uint8_t reg, Mem mem) {
+        emit(0x80 | (reg & 7) << 3 | (mem.base & 7));
+        if ((mem.base & 7) == RSP) emit(0x24);
+        emit32((uint32_t) mem.disp);
+    }
+
+    void Assembler::mov(Reg dst, Reg src) { alu(0x89, dst, src); }
+
+    void Assembler::mov(Reg dst, Mem src) {
+        rex(true, dst, src.base);
+        emit(0x8B);
+        modrm(dst, src);
+    }
+
+    void Assembler::mov(Mem dst, Reg src) {
+        rex(true, src, dst.base);
+        emit(0x89);
+        modrm(src, dst);
+    }
+
+    void Assembler::mov(Reg dst, uint64_t imm) {
+        rex(true, 0, dst);
+        emit(0xB8 + (dst & 7));
+        emit64(imm);
+    }
+
+    void Assembler::mov(Mem dst, int32_t imm) {
+        rex(true, 0, dst.base);
+        emit(0xC7);
+        modrm(0, dst);
+        emit32((uint32_t) imm);
+    }
+
+    void Assembler::mov32(Reg dst, uint32_t imm) {
+        rex(false, 0, dst);
+        emit(0xB8 + (dst & 7));
+        emit32(imm);
+    }
+
+    void Assembler::movups(Xmm dst, Mem src) {
+        rex(false, dst, src.base);
+        emit(0x0F);
+        emit(0x10);
+        modrm(dst, src);
+    }
+
+    void Assembler::movups(Mem dst, Xmm src) {
+        rex(false, src, dst.base);
+        emit(0x0F);
+        emit(0x11);
+        modrm(src, dst);
+    }
+
+    void Assembler::movsd(Xmm dst, Mem src) { sse(0xF2, 0x10, dst, src); }
+
+    void Assembler::movsd(Mem dst, Xmm src) { sse(0xF2, 0x11, src, dst); }
+
+    void Assembler::movq(Xmm dst, Reg src) {
+        emit(0x66);
+        rex(true, dst, src);
+        emit(0x0F);
+        emit(0x6E);
+        modrm(dst, src);
+    }
+
+    void Assembler::cmp32(Reg left, uint32_t imm) {
+        rex(false, 0, left);
+        emit(0x81);
+        modrm(7, left);
+        emit32(imm);
+    }
+
+    void Assembler::test(Reg left, int32_t imm) {
+        rex(true, 0, left);
+        emit(0xF7);
+        modrm(0, left);
+        emit32((uint32_t) imm);
+    }
+
+    void Assembler::neg(Reg dst) {
+        rex(true, 0, dst);
+        emit(0xF7);
+        modrm(3, dst);
+    }
+
+    void Assembler::imul(Reg dst, Reg src) {
+        rex(true, dst, src);
+        emit(0x0F);
+        emit(0xAF);
+        modrm(dst, src);
+    }
+
+    void Assembler::cqo() {
+        emit(0x48);
+        emit(0x99);
+    }
+
+    void Assembler::idiv(Reg divisor) {
+        rex(true, 0, divisor);
+        emit(0xF7);
+        modrm(7, divisor);
+    }
+
+    void Assembler::cmov(Cond cond, Reg dst, Reg src) {
+        rex(true, dst, src);
+        emit(0x0F);
+        emit(0x40 + cond);
+        modrm(dst, src);
+    }
+
+    void Assembler::alu(uint8_t opcode, Reg dst, Reg src) {
+        rex(true, src, dst);
+        emit(opcode);
+        modrm(src, dst);
+    }
+
+    void Assembler::alu(uint8_t extension, Reg dst, int32_t imm) {
+        rex(true, 0, dst);
+        emit(0x81);
+        modrm(extension, dst);
+        emit32((uint32_t) imm);
+    }
+
+    void Assembler::shift(uint8_t extension, Reg dst, uint8_t count) {
+        rex(true, 0, dst);
+        emit(0xC1);
+        modrm(extension, dst);
+        emit(count);
+    }
+
+    // the mandatory prefix goes before rex
+    void Assembler::sse(uint8_t prefix, uint8_t opcode, Xmm dst, Xmm src) {
+        emit(prefix);
+        rex(false, dst, src);
+        emit(0x0F);
+        emit(opcode);
+        modrm(dst, src);
+    }
+
+    void Assembler::sse(uint8_t prefix, uint8_t opcode, Xmm reg, Mem mem) {
+        emit(prefix);
+        rex(false, reg, mem.base);
+        emit(0x0F);
+        emit(opcode);
+        modrm(reg, mem);
+    }
+
+    void Assembler::rel32(Label label) {
+        m_fixups.emplace_back(m_code.size(), label);
+        emit32(0);
+    }
+
+    void Assembler::jmp(Label label) {
+        emit(0xE9);
+        rel32(label);
+    }
+
+    void Assembler::jcc(Cond cond, Label label) {
+        emit(0x0F);
+        emit(0x80 + cond);
+        rel32(label);
+    }
+
+    void Assembler::jmp(Reg target) {
+        rex(false, 0, target);
+        emit(0xFF);
+        modrm(4, target);
+    }
+
+    void Assembler::call(Reg target) {
+        rex(false, 0, target);
+        emit(0xFF);
+        modrm(2, target);
+    }
+
+    void Assembler::push(Reg reg) {
+        rex(false, 0, reg);
+        emit(0x50 + (reg & 7));
+    }
+
+    void Assembler::pop(Reg reg) {
+        rex(false, 0, reg);
+        emit(0x58 + (reg & 7));
+    }
+}
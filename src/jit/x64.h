@@ -0,0 +1,182 @@
+//
+// a small x86-64 assembler, only the instructions the baseline jit emits
+//
+
+#ifndef BOND_X64_H
+#define BOND_X64_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace bond::x64 {
+    enum Reg : uint8_t {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8, R9, R10, R11, R12, R13, R14, R15,
+    };
+
+    enum Xmm : uint8_t {
+        XMM0, XMM1, XMM2,
+    };
+
+    // condition codes as encoded in jcc and cmovcc, a code with its low bit flipped is its negation
+    enum Cond : uint8_t {
+        BELOW = 0x2, ABOVE_EQUAL = 0x3, EQUAL = 0x4, NOT_EQUAL = 0x5, BELOW_EQUAL = 0x6, ABOVE = 0x7,
+        PARITY = 0xA, LESS = 0xC, GREATER_EQUAL = 0xD, LESS_EQUAL = 0xE, GREATER = 0xF,
+    };
+
+    constexpr Cond negate(Cond cond) { return static_cast<Cond>(cond ^ 1); }
+
+    // base register plus displacement
+    struct Mem {
+        Reg base;
+        int32_t disp = 0;
+    };
+
+    using Label = uint32_t;
+
+    class Assembler {
+    public:
+        Label new_label();
+
+        void bind(Label label);
+
+        // patches every jump to a label, false when one was never bound
+        bool finish();
+
+        [[nodiscard]] std::size_t position() const { return m_code.size(); }
+
+        [[nodiscard]] const std::vector<uint8_t> &code() const { return m_code; }
+
+        void mov(Reg dst, Reg src);
+
+        void mov(Reg dst, Mem src);
+
+        void mov(Mem dst, Reg src);
+
+        // movabs, the full 64 bit immediate
+        void mov(Reg dst, uint64_t imm);
+
+        // stores a sign extended 32 bit immediate to a quadword
+        void mov(Mem dst, int32_t imm);
+
+        // loads a 32 bit immediate, zeroing the upper half
+        void mov32(Reg dst, uint32_t imm);
+
+        void movups(Xmm dst, Mem src);
+
+        void movups(Mem dst, Xmm src);
+
+        void movsd(Xmm dst, Mem src);
+
+        void movsd(Mem dst, Xmm src);
+
+        void movsd(Xmm dst, Xmm src) { sse(0xF2, 0x10, dst, src); }
+
+        // moves the bits of a general register into the low quadword
+        void movq(Xmm dst, Reg src);
+
+        void add(Reg dst, Reg src) { alu(0x01, dst, src); }
+
+        void sub(Reg dst, Reg src) { alu(0x29, dst, src); }
+
+        void or_(Reg dst, Reg src) { alu(0x09, dst, src); }
+
+        void xor_(Reg dst, Reg src) { alu(0x31, dst, src); }
+
+        void cmp(Reg left, Reg right) { alu(0x39, left, right); }
+
+        void test(Reg left, Reg right) { alu(0x85, left, right); }
+
+        void add(Reg dst, int32_t imm) { alu(0, dst, imm); }
+
+        void sub(Reg dst, int32_t imm) { alu(5, dst, imm); }
+
+        void and_(Reg dst, int32_t imm) { alu(4, dst, imm); }
+
+        void cmp(Reg left, int32_t imm) { alu(7, left, imm); }
+
+        // compares the low 32 bits of a register
+        void cmp32(Reg left, uint32_t imm);
+
+        void test(Reg left, int32_t imm);
+
+        void shl(Reg dst, uint8_t count) { shift(4, dst, count); }
+
+        void sar(Reg dst, uint8_t count) { shift(7, dst, count); }
+
+        void neg(Reg dst);
+
+        void imul(Reg dst, Reg src);
+
+        // sign extends rax into rdx
+        void cqo();
+
+        // divides rdx:rax, quotient in rax and remainder in rdx
+        void idiv(Reg divisor);
+
+        void cmov(Cond cond, Reg dst, Reg src);
+
+        void addsd(Xmm dst, Xmm src) { sse(0xF2, 0x58, dst, src); }
+
+        void mulsd(Xmm dst, Xmm src) { sse(0xF2, 0x59, dst, src); }
+
+        void subsd(Xmm dst, Xmm src) { sse(0xF2, 0x5C, dst, src); }
+
+        void divsd(Xmm dst, Xmm src) { sse(0xF2, 0x5E, dst, src); }
+
+        void ucomisd(Xmm left, Xmm right) { sse(0x66, 0x2E, left, right); }
+
+        void xorpd(Xmm dst, Xmm src) { sse(0x66, 0x57, dst, src); }
+
+        void jmp(Label label);
+
+        void jcc(Cond cond, Label label);
+
+        void jmp(Reg target);
+
+        void call(Reg target);
+
+        void push(Reg reg);
+
+        void pop(Reg reg);
+
+        void ret() { emit(0xC3); }
+
+    private:
+        std::vector<uint8_t> m_code;
+        // bound position of each label, -1 until bind
+        std::vector<int64_t> m_labels;
+        // offset of each rel32 field and the label it jumps to
+        std::vector<std::pair<std::size_t, Label>> m_fixups;
+
+        void emit(uint8_t byte) { m_code.push_back(byte); }
+
+        void emit32(uint32_t value);
+
+        void emit64(uint64_t value);
+
+        // the rex prefix, left out when it would carry no bits
+        void rex(bool wide, uint8_t reg, uint8_t base);
+
+        void modrm(uint8_t reg, uint8_t rm) { emit(0xC0 | (reg & 7) << 3 | (rm & 7)); }
+
+        // [base + disp32], rsp and r12 as a base need a sib byte
+        void modrm(uint8_t reg, Mem mem);
+
+        void alu(uint8_t opcode, Reg dst, Reg src);
+
+        void alu(uint8_t extension, Reg dst, int32_t imm);
+
+        void shift(uint8_t extension, Reg dst, uint8_t count);
+
+        void sse(uint8_t prefix, uint8_t opcode, Xmm dst, Xmm src);
+
+        void sse(uint8_t prefix, uint8_t opcode, Xmm reg, Mem mem);
+
+        void rel32(Label label);
+    };
+}
+
+#endif //BOND_X64_H
@@ -112,7 +112,7 @@ namespace bond::bnk {
 
     // API
 
-    obj_result bnk_init(const t_vector &args) {
+    obj_result bnk_init(t_args args) {
         Int *width;
         Int *height;
         String *title;
@@ -127,39 +127,39 @@ namespace bond::bnk {
         }
     }
 
-    obj_result bnk_new_frame(const t_vector &args) {
+    obj_result bnk_new_frame(t_args args) {
         TRY(parse_args(args));
         new_frame();
         return Runtime::ins()->C_NONE;
     }
 
-    obj_result bnk_end_a(const t_vector &args) {
+    obj_result bnk_end_a(t_args args) {
         TRY(parse_args(args));
 
         bnk_end();
         return Runtime::ins()->C_NONE;
     }
 
-    obj_result bnk_render_a(const t_vector &args) {
+    obj_result bnk_render_a(t_args args) {
         TRY(parse_args(args));
 
         bnk_render();
         return Runtime::ins()->C_NONE;
     }
 
-    obj_result bnk_de_init_a(const t_vector &args) {
+    obj_result bnk_de_init_a(t_args args) {
         TRY(parse_args(args));
 
         de_init();
         return Runtime::ins()->C_NONE;
     }
 
-    obj_result bnk_should_close_a(const t_vector &args) {
+    obj_result bnk_should_close_a(t_args args) {
         TRY(parse_args(args));
         return AS_BOOL(glfwWindowShouldClose(window));
     }
 
-//    obj_result bnk_set_should_close(const t_vector& args) {
+//    obj_result bnk_set_should_close(t_args args) {
 //        Bool* should_close;
 //        TRY(parse_args(args, should_close));
 //
@@ -173,7 +173,7 @@ namespace bond::bnk {
 
         explicit Enum(t_map values) : values(std::move(values)) {}
 
-        static obj_result get_attr(const GcPtr<Object> &self, const t_vector &args) {
+        static obj_result get_attr(const GcPtr<Object> &self, t_args args) {
             String *name;
             TRY(parse_args(args, name));
 
@@ -229,7 +229,7 @@ namespace bond::bnk {
 
         property(h, BnkRect, rect)
 
-        static obj_result constructor(const t_vector &args) {
+        static obj_result constructor(t_args args) {
             Float *x;
             Float *y;
             Float *w;
@@ -243,7 +243,7 @@ namespace bond::bnk {
 
     // widgets
 
-    obj_result bnk_layout_row_dynamic(const t_vector &args) {
+    obj_result bnk_layout_row_dynamic(t_args args) {
         Float *height;
         Int *cols;
         TRY(parse_args(args, height, cols));
@@ -252,7 +252,7 @@ namespace bond::bnk {
         return Runtime::ins()->C_NONE;
     }
 
-    obj_result bnk_layout_row_static(const t_vector &args) {
+    obj_result bnk_layout_row_static(t_args args) {
         Float *height;
         Int *item_width;
         Int *cols;
@@ -262,7 +262,7 @@ namespace bond::bnk {
         return Runtime::ins()->C_NONE;
     }
 
-    obj_result bnk_begin(const t_vector &args) {
+    obj_result bnk_begin(t_args args) {
         String *name;
         BnkRect *bounds;
         Int *flags;
@@ -273,14 +273,14 @@ namespace bond::bnk {
         return AS_BOOL(res);
     }
 
-    obj_result bnk_button_label(const t_vector &args) {
+    obj_result bnk_button_label(t_args args) {
         String *label;
         TRY(parse_args(args, label));
         auto res = nk_button_label(ctx, label->get_value().c_str());
         return AS_BOOL(res);
     }
 
-    obj_result bnk_label(const t_vector &args) {
+    obj_result bnk_label(t_args args) {
         String *label;
         Int *align;
         TRY(parse_args(args, label, align));
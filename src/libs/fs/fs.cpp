@@ -8,13 +8,13 @@
 
 
 namespace bond::fs {
-    static obj_result exists(const t_vector &args) {
+    static obj_result exists(t_args args) {
         String *path;
         TRY(parse_args(args, path));
         return AS_BOOL(std::filesystem::exists(path->get_value().c_str()));
     }
 
-    static obj_result full_path(const t_vector &args) {
+    static obj_result full_path(t_args args) {
         String *path;
         TRY(parse_args(args, path));
 
@@ -25,7 +25,7 @@ namespace bond::fs {
         return make_ok_t(std::filesystem::absolute(path->get_value().c_str()).string());
     }
 
-    static obj_result is_dir(const t_vector &args) {
+    static obj_result is_dir(t_args args) {
         String *path;
         TRY(parse_args(args, path));
 
@@ -36,7 +36,7 @@ namespace bond::fs {
         return make_ok(AS_BOOL(std::filesystem::is_directory(path->get_value().c_str())));
     }
 
-    static obj_result is_file(const t_vector &args) {
+    static obj_result is_file(t_args args) {
         String *path;
         TRY(parse_args(args, path));
 
@@ -46,7 +46,7 @@ namespace bond::fs {
         return make_ok(AS_BOOL(std::filesystem::is_regular_file(path->get_value().c_str())));
     }
 
-    static obj_result is_symlink(const t_vector &args) {
+    static obj_result is_symlink(t_args args) {
         String *path;
         TRY(parse_args(args, path));
 
@@ -57,7 +57,7 @@ namespace bond::fs {
         return make_ok(AS_BOOL(std::filesystem::is_symlink(path->get_value().c_str())));
     }
 
-    static obj_result is_empty(const t_vector &args) {
+    static obj_result is_empty(t_args args) {
         String *path;
         TRY(parse_args(args, path));
 
@@ -68,7 +68,7 @@ namespace bond::fs {
         return make_ok(AS_BOOL(std::filesystem::is_empty(path->get_value().c_str())));
     }
 
-    static obj_result is_relative(const t_vector &args) {
+    static obj_result is_relative(t_args args) {
         String *path;
         TRY(parse_args(args, path));
 
@@ -79,7 +79,7 @@ namespace bond::fs {
         return make_ok(AS_BOOL(std::filesystem::path(path->get_value().c_str()).is_relative()));
     }
 
-    static obj_result is_absolute(const t_vector &args) {
+    static obj_result is_absolute(t_args args) {
         String *path;
         TRY(parse_args(args, path));
 
@@ -90,12 +90,12 @@ namespace bond::fs {
         return make_ok(AS_BOOL(std::filesystem::path(path->get_value().c_str()).is_absolute()));
     }
 
-    static obj_result cwd(const t_vector &args) {
+    static obj_result cwd(t_args args) {
         TRY(parse_args(args));
         return make_string(std::filesystem::current_path().string());
     }
 
-    static obj_result set_cwd(const t_vector &args) {
+    static obj_result set_cwd(t_args args) {
         String *path;
         TRY(parse_args(args, path));
 
@@ -108,7 +108,7 @@ namespace bond::fs {
     }
 
 
-    static obj_result join(const t_vector &args) {
+    static obj_result join(t_args args) {
         if (args.empty()) {
             return make_error_t("expected at least one argument");
         }
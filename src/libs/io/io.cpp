@@ -69,7 +69,7 @@ namespace bond::io {
     )
     )";
 
-    obj_result fs_open(const t_vector& args) {
+    obj_result fs_open(t_args args) {
         String* path;
         String* mode;
         TRY(parse_args(args, path, mode));
@@ -110,7 +110,7 @@ namespace bond::io {
         encoding: The encoding of the file.
     )";
 
-    obj_result fs_read(const t_vector& args) {
+    obj_result fs_read(t_args args) {
         FileHandle* f_h;
         TRY(parse_args(args, f_h));
 
@@ -152,7 +152,7 @@ namespace bond::io {
         close a file.
     )";
 
-    obj_result fs_close(const t_vector& args) {
+    obj_result fs_close(t_args args) {
         FileHandle* f_h;
         TRY(parse_args(args, f_h));
 
@@ -225,7 +225,7 @@ namespace bond::io {
         path: The path of the file.
     )";
 
-    auto fs_read_file(const t_vector& args) -> obj_result {
+    auto fs_read_file(t_args args) -> obj_result {
         String* path;
         TRY(parse_args(args, path));
 
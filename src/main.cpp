@@ -25,6 +25,11 @@ int main(int32_t argc, char **argv) {
     std::string file;
     bool build;
     bool experimental_type_checker;
+    int optimize_level;
+    bool jit;
+    bool trace;
+    bool aot;
+    bool register_vm;
 
     using namespace argumentum;
     auto parser = argument_parser{};
@@ -39,6 +44,22 @@ int main(int32_t argc, char **argv) {
                            "-c")
             .nargs(0)
             .help("turn on experimental type checking");
+    params.add_parameter(optimize_level, "--optimize", "-O")
+            .nargs(1)
+            .absent(1)
+            .help("bytecode optimization level, 0 turns the optimizer off, 2 adds inlining and the ssa passes (default 1)");
+    params.add_parameter(jit, "--jit")
+            .nargs(0)
+            .help("compile hot functions and loops to machine code");
+    params.add_parameter(trace, "--trace")
+            .nargs(0)
+            .help("record the path hot loops take and compile it to machine code");
+    params.add_parameter(aot, "--aot")
+            .nargs(0)
+            .help("compile the file and the modules it imports to C++ that builds into native modules");
+    params.add_parameter(register_vm, "--register-vm")
+            .nargs(0)
+            .help("run the functions it can on the register based bytecode");
 
     auto engine = bond::create_engine(lib_path, args);
 
@@ -52,6 +73,13 @@ int main(int32_t argc, char **argv) {
     }
 
     engine->set_checker(experimental_type_checker);
+    engine->get_context()->set_optimize_level((uint32_t) std::max(0, optimize_level));
+    engine->get_context()->set_jit(jit);
+    engine->get_context()->set_trace(trace);
+    engine->get_context()->set_register_vm(register_vm);
+    if ((jit or trace) and !bond::Jit::is_supported()) {
+        fmt::print("the jit is not supported on this platform, running in the interpreter\n");
+    }
 
     if (!std::filesystem::exists(file)) {
         fmt::print("File not found: {}\n", file);
@@ -73,6 +101,7 @@ int main(int32_t argc, char **argv) {
         }
 
         auto builder = bond::Build(lib_path, full_path);
+        builder.get_context()->set_optimize_level(engine->get_context()->get_optimize_level());
         auto res = builder.build();
 
         if (!res) {
@@ -84,6 +113,26 @@ int main(int32_t argc, char **argv) {
         return 0;
     }
 
+    if (aot) {
+        if (is_archive) {
+            fmt::print("File is an archive, compile its sources instead: {}\n", full_path);
+            return 1;
+        }
+
+        auto builder = bond::Build(lib_path, full_path);
+        builder.get_context()->set_optimize_level(engine->get_context()->get_optimize_level());
+        auto res = builder.aot();
+
+        if (!res) {
+            fmt::print("Ahead of time compilation failed: {}\n", res.error());
+            return 1;
+        }
+
+        fmt::print("Build each file as a shared library linked against bond-lib, see bond_aot_module in "
+                   "CMakeLists.txt\n");
+        return 0;
+    }
+
     int exit_code;
 
     auto vm = bond::Vm(engine->get_context());
@@ -98,11 +147,23 @@ int main(int32_t argc, char **argv) {
         }
         vm.run(res.value());
         exit_code = vm.had_error() or engine->get_context()->has_error() ? 1 : 0;
+    } else if (f_path.extension() == ".so" or f_path.extension() == ".dll") {
+        // a module compiled ahead of time runs its top level when it is imported
+        t_string alias = f_path.stem().string();
+        auto res = bond::Import::instance().import_module(engine->get_context(), full_path, alias);
+        if (!res) {
+            fmt::print("Failed to load native module: {}\n", res.error());
+        }
+        exit_code = !res or vm.had_error() or engine->get_context()->has_error() ? 1 : 0;
     } else {
         engine->run_file(full_path);
         exit_code = engine->get_context()->has_error() ? 1 : 0;
     }
 
+#ifdef BOND_OPCODE_PROFILE
+    fmt::print(stderr, "{}", bond::opcode_pair_report(20));
+#endif
+
     bond::Runtime::ins()->exit();
     return exit_code;
 }
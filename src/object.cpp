@@ -13,6 +13,13 @@ namespace bond {
         return m_methods.at(name).first;
     }
 
+    const NativeMethodPtr *NativeStruct::find_method(const t_string &name) const {
+        auto it = m_methods.find(name);
+        if (it == m_methods.end())
+            return nullptr;
+        return &it->second.first;
+    }
+
     obj_result NativeStruct::create(const t_vector &args) const {
         auto res = m_constructor(args);
         TRY(res);
@@ -141,7 +148,7 @@ namespace bond {
         return m_methods.contains(name);
     }
 
-    [[nodiscard]] obj_result NativeInstance::call_method(const t_string &name, const t_vector &args) {
+    [[nodiscard]] obj_result NativeInstance::call_method(const t_string &name, t_args args) {
         auto method = m_native_struct->get_method(name);
         if (!method)
             return ERR(fmt::format("method {} not found", name));
@@ -151,7 +158,7 @@ namespace bond {
     }
 
     // is this better than call_method ?
-    obj_result NativeInstance::call_slot(Slot slot, const t_vector &args) {
+    obj_result NativeInstance::call_slot(Slot slot, t_args args) {
         auto method = m_native_struct->get_slot(slot);
         if (!method)
             return ERR("not implemented");
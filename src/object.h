@@ -4,8 +4,11 @@
 #include "gc.h"
 //#include "vm.h"
 #include <optional>
+#include <span>
 #include <utility>
 #include <cassert>
+#include <array>
+#include <cstring>
 #include "object_helpers.h"
 #include <thread>
 #include <mutex>
@@ -43,71 +46,176 @@ struct ::std::hash<t_string> {
 };
 
 namespace bond {
+    // every opcode with the number of oprands that follow it in the instruction stream
+#define BOND_OPCODES(X) \
+        X(LOAD_CONST, 1) \
+        X(BIN_ADD, 0) \
+        X(BIN_SUB, 0) \
+        X(BIN_MUL, 0) \
+        X(BIN_DIV, 0) \
+        X(RETURN, 0) \
+        X(PUSH_TRUE, 0) \
+        X(PUSH_FALSE, 0) \
+        X(PUSH_NIL, 0) \
+        X(LOAD_GLOBAL, 1) \
+        X(STORE_GLOBAL, 1) \
+        X(LOAD_FAST, 1) \
+        X(STORE_FAST, 1) \
+        X(NE, 0) \
+        X(EQ, 0) \
+        X(LE, 0) \
+        X(GT, 0) \
+        X(GE, 0) \
+        X(LT, 0) \
+        X(OR, 0) \
+        X(AND, 0) \
+        X(POP_TOP, 0) \
+        X(CREATE_GLOBAL, 1) \
+        X(CREATE_LOCAL, 1) \
+        X(CREATE_FUNCTION, 1) \
+        X(CREATE_STRUCT, 1) \
+        X(BUILD_LIST, 1) \
+        X(GET_ITEM, 0) \
+        X(SET_ITEM, 0) \
+        X(JUMP_IF_FALSE, 1) \
+        X(JUMP, 1) \
+        X(CALL, 1) \
+        X(ITER, 0) \
+        X(ITER_NEXT, 1) \
+        X(ITER_END, 1) \
+        X(GET_ATTRIBUTE, 1) \
+        X(SET_ATTRIBUTE, 1) \
+        X(IMPORT, 1) \
+        X(TRY, 1) \
+        X(BREAK, 1) \
+        X(CONTINUE, 1) \
+        X(BIN_MOD, 0) \
+        X(NOT, 0) \
+        X(UNARY_SUB, 0) \
+        X(BIT_OR, 0) \
+        X(BIT_AND, 0) \
+        X(BIT_XOR, 0) \
+        X(MAKE_ASYNC, 1) \
+        X(AWAIT, 0) \
+        X(UNPACK_SEQ, 1) \
+        X(CALL_METHOD, 2) \
+        X(MAKE_ERROR, 0) \
+        X(MAKE_OK, 0) \
+        X(CREATE_CLOSURE, 1) \
+        X(IMPORT_PRE_COMPILED, 1) \
+        X(BUILD_DICT, 1) \
+        /* CALL whose result is returned straight away, script callees reuse the frame */ \
+        X(TAIL_CALL, 1) \
+        X(LOAD_CELL, 1) \
+        X(STORE_CELL, 1) \
+        X(CREATE_CELL, 1) \
+        /* superinstructions the code generator emits for common sequences */ \
+        X(COMPARE_AND_JUMP, 2) /* compare opcode, target taken when the comparison is false */ \
+        X(LOAD_FAST_ATTR, 2) /* local slot, attribute name constant */ \
+        X(LOAD_FAST_LOAD_FAST, 2) \
+        X(FOR_ITER, 2) /* local slot, target taken when the iterator is exhausted */ \
+        /* specialised forms the vm rewrites generic instructions into, see Code::quicken */ \
+        X(BIN_ADD_INT_INT, 0) \
+        X(BIN_SUB_INT_INT, 0) \
+        X(BIN_MUL_INT_INT, 0) \
+        X(BIN_DIV_INT_INT, 0) \
+        X(BIN_MOD_INT_INT, 0) \
+        X(BIN_ADD_FLOAT_FLOAT, 0) \
+        X(BIN_SUB_FLOAT_FLOAT, 0) \
+        X(BIN_MUL_FLOAT_FLOAT, 0) \
+        X(BIN_DIV_FLOAT_FLOAT, 0) \
+        X(LT_INT_INT, 0) \
+        X(LE_INT_INT, 0) \
+        X(GT_INT_INT, 0) \
+        X(GE_INT_INT, 0) \
+        X(EQ_INT_INT, 0) \
+        X(NE_INT_INT, 0) \
+        X(LT_FLOAT_FLOAT, 0) \
+        X(LE_FLOAT_FLOAT, 0) \
+        X(GT_FLOAT_FLOAT, 0) \
+        X(GE_FLOAT_FLOAT, 0) \
+        X(EQ_FLOAT_FLOAT, 0) \
+        X(NE_FLOAT_FLOAT, 0)
+
     enum class Opcode : uint32_t {
-        LOAD_CONST,
-        BIN_ADD,
-        BIN_SUB,
-        BIN_MUL,
-        BIN_DIV,
-        RETURN,
-        PUSH_TRUE,
-        PUSH_FALSE,
-        PUSH_NIL,
-        LOAD_GLOBAL,
-        STORE_GLOBAL,
-        LOAD_FAST,
-        STORE_FAST,
-
-        NE,
-        EQ,
-        LE,
-        GT,
-        GE,
-        LT,
-        OR,
-        AND,
+#define BOND_OPCODE_ENUM(name, oprands) name,
+        BOND_OPCODES(BOND_OPCODE_ENUM)
+#undef BOND_OPCODE_ENUM
+    };
 
-        POP_TOP,
+#define BOND_OPCODE_COUNT(name, oprands) + 1
+    constexpr uint32_t OPCODE_COUNT = 0 BOND_OPCODES(BOND_OPCODE_COUNT);
+#undef BOND_OPCODE_COUNT
+
+    constexpr uint32_t oprand_count(Opcode opcode) {
+        constexpr uint32_t counts[] = {
+#define BOND_OPCODE_OPRANDS(name, oprands) oprands,
+                BOND_OPCODES(BOND_OPCODE_OPRANDS)
+#undef BOND_OPCODE_OPRANDS
+        };
+        return counts[static_cast<uint32_t>(opcode)];
+    }
 
-        CREATE_GLOBAL,
-        CREATE_LOCAL,
-        CREATE_FUNCTION,
-        CREATE_STRUCT,
-        BUILD_LIST,
-        GET_ITEM,
-        SET_ITEM,
-        JUMP_IF_FALSE,
-        JUMP,
-        CALL,
+    constexpr const char *opcode_name(Opcode opcode) {
+        constexpr const char *names[] = {
+#define BOND_OPCODE_NAME(name, oprands) #name,
+                BOND_OPCODES(BOND_OPCODE_NAME)
+#undef BOND_OPCODE_NAME
+        };
+        return names[static_cast<uint32_t>(opcode)];
+    }
 
-        ITER,
-        ITER_NEXT,
-        ITER_END,
-        GET_ATTRIBUTE,
-        SET_ATTRIBUTE,
-        IMPORT,
-        TRY,
-        BREAK,
-        CONTINUE,
-        BIN_MOD,
-        NOT,
-        UNARY_SUB,
+    // bytecode is a stream of bytes, each opcode takes one
+    static_assert(OPCODE_COUNT <= 256);
+
+    // oprands follow their opcode as little endian base 128 varints, seven bits per byte with
+    // the high bit set on every byte except the last, so small oprands take a single byte
+    constexpr uint32_t MAX_OPRAND_WIDTH = 5;
+
+    // jump targets are the last oprand of a jump and always take four bytes in host byte order,
+    // so they can be patched in place and read without a decode loop
+    constexpr uint32_t JUMP_OPRAND_WIDTH = 4;
+
+    constexpr bool is_jump(Opcode opcode) {
+        switch (opcode) {
+            case Opcode::JUMP_IF_FALSE:
+            case Opcode::JUMP:
+            case Opcode::ITER_END:
+            case Opcode::TRY:
+            case Opcode::BREAK:
+            case Opcode::CONTINUE:
+            case Opcode::COMPARE_AND_JUMP:
+            case Opcode::FOR_ITER:
+                return true;
+            default:
+                return false;
+        }
+    }
 
-        BIT_OR,
-        BIT_AND,
-        BIT_XOR,
-        MAKE_ASYNC,
-        AWAIT,
-        UNPACK_SEQ,
-        CALL_METHOD,
-        MAKE_ERROR,
-        MAKE_OK,
-
-        CREATE_CLOSURE,
-        CREATE_CLOSURE_EX,
-        IMPORT_PRE_COMPILED,
-        BUILD_DICT
-    };
+    // rest of an oprand that did not fit in its first byte, kept out of line so the single
+    // byte case stays small enough to inline into the dispatch loop
+    uint32_t read_wide_oprand(const uint8_t *code, size_t &offset, uint32_t first);
+
+    inline uint32_t read_oprand(const uint8_t *code, size_t &offset) {
+        uint32_t value = code[offset++];
+        if (value < 0x80) [[likely]] return value;
+        return read_wide_oprand(code, offset, value);
+    }
+
+    inline uint32_t read_jump_target(const uint8_t *code, size_t &offset) {
+        uint32_t target;
+        std::memcpy(&target, code + offset, JUMP_OPRAND_WIDTH);
+        offset += JUMP_OPRAND_WIDTH;
+        return target;
+    }
+
+    // reads oprand number index of opcode, whichever way it is encoded
+    inline uint32_t read_oprand(Opcode opcode, uint32_t index, const uint8_t *code, size_t &offset) {
+        if (is_jump(opcode) and index + 1 == oprand_count(opcode)) {
+            return read_jump_target(code, offset);
+        }
+        return read_oprand(code, offset);
+    }
 
     enum Slot : uint32_t {
         NE = 0,
@@ -145,8 +253,14 @@ namespace bond {
 
     t_string Slot_to_string(Slot slot);
 
+#define TYPE_TAG(NAME) static constexpr TypeId TYPE_ID = TypeId::NAME; \
+        using tagged_self = NAME; \
+        [[no_unique_address]] TypeIdTag<TypeId::NAME> m_type_id_tag{this};
+
     class Object : public GcObject {
     public:
+        TYPE_TAG(Object)
+
         Object() = default;
 
         [[nodiscard]] virtual t_string str() const {
@@ -161,12 +275,16 @@ namespace bond {
     }
 
     using t_vector = std::vector<GcPtr<Object>, gc_allocator<GcPtr<Object>>>;
+    using t_string_vector = std::vector<t_string, gc_allocator<t_string>>;
     using t_map = std::unordered_map<t_string, GcPtr<Object>, std::hash<t_string>, std::equal_to<>,
             gc_allocator<std::pair<const t_string, GcPtr<Object>>>>;
 
 
-    using NativeMethodPtr = std::function<obj_result(const GcPtr<Object> &self, const t_vector &)>;
-    using NativeFunctionPtr = std::function<obj_result(const t_vector &)>;
+    // arguments of a native call, a view of the caller's operand stack or of a t_vector
+    using t_args = std::span<const GcPtr<Object>>;
+
+    using NativeMethodPtr = std::function<obj_result(const GcPtr<Object> &self, t_args)>;
+    using NativeFunctionPtr = std::function<obj_result(t_args)>;
 
 //    using NativeFunctionPtr = obj_result (*)(const t_vector &);
     class NativeInstance;
@@ -180,6 +298,8 @@ namespace bond {
 
     class NativeStruct : public Object {
     public:
+        TYPE_TAG(NativeStruct)
+
         NativeStruct(t_string name, t_string doc, NativeFunctionPtr constructor)
                 : m_name(std::move(name)), m_doc(std::move(doc)), m_constructor(std::move(constructor)) { set_slots(); }
 
@@ -198,6 +318,9 @@ namespace bond {
 
         [[nodiscard]] std::optional<NativeMethodPtr> get_method(const t_string &name) const;
 
+        // stable pointer to a method for inline caches, nullptr when it does not exist
+        [[nodiscard]] const NativeMethodPtr *find_method(const t_string &name) const;
+
         [[nodiscard]] t_string get_name() const { return m_name; }
 
         [[nodiscard]] t_string get_doc() const { return m_doc; }
@@ -259,19 +382,21 @@ namespace bond {
 
     class NativeInstance : public Object {
     public:
+        TYPE_TAG(NativeInstance)
+
         explicit NativeInstance(NativeStruct *native_struct) : m_native_struct(native_struct) {}
 
         NativeInstance() = default;
 
         [[nodiscard]] NativeStruct *get_native_struct() const { return m_native_struct; }
 
-        [[nodiscard]] obj_result call_method(const t_string &name, const t_vector &args);
+        [[nodiscard]] obj_result call_method(const t_string &name, t_args args);
 
         bool has_method(const t_string &name);
 
         void set_native_struct(NativeStruct *native_struct) { m_native_struct = native_struct; }
 
-        obj_result call_slot(Slot slot, const t_vector &args);
+        obj_result call_slot(Slot slot, t_args args);
 
         virtual bool has_slot(Slot slot);
 
@@ -283,6 +408,12 @@ namespace bond {
 
         std::optional<obj_result> set_attr(const t_string &name, const GcPtr<Object> &value);
 
+        enum class IterStep : uint8_t { Next, Done, Generic };
+
+        // advances a builtin iterator for FOR_ITER without calling its __has_next__ and __next__
+        // slots, leaving the element in next. Generic when it can only be driven through them
+        virtual IterStep iter_next(GcPtr<Object> &next) { return IterStep::Generic; }
+
 
     protected:
         NativeStruct *m_native_struct = nullptr;
@@ -298,7 +429,8 @@ namespace bond {
 
 // builtin types
 
-#define INSTANCE(NAME) static const char *name() { return #NAME; }
+#define INSTANCE(NAME) static const char *name() { return #NAME; } \
+        TYPE_TAG(NAME)
 
     class Float : public NativeInstance {
     public:
@@ -420,6 +552,8 @@ namespace bond {
 
         [[nodiscard]] t_string str() const override { return fmt::format("<string iterator at {}>", (void *) this); }
 
+        IterStep iter_next(GcPtr<Object> &next) override;
+
         t_string m_value;
         size_t m_index = 0;
     };
@@ -437,38 +571,91 @@ namespace bond {
         INSTANCE(StringMap)
         StringMap() = default;
 
-        StringMap(const t_map &map) : m_value(map) {}
+        StringMap(const t_map &map) { set_value(map); }
 
-        [[nodiscard]] t_map get_value() const { return m_value; }
+        [[nodiscard]] t_map get_value() const;
 
-        void set_value(t_map value) { m_value = std::move(value); }
+        void set_value(const t_map &value);
 
-        void set(const t_string &key, const GcPtr<Object> &obj);
+        uint32_t set(const t_string &key, const GcPtr<Object> &obj);
 
         std::optional<GcPtr<Object>> get(const t_string &key);
 
         GcPtr<Object> get_unchecked(const t_string &key);
 
-        bool has(const t_string &key) { return m_value.contains(key); }
+        bool has(const t_string &key) { return m_index.contains(key); }
+
+        // values are kept in dense slots that are never removed, a slot found while
+        // the version is unchanged can be used without looking up the name again
+        std::optional<uint32_t> find_slot(const t_string &key);
+
+        [[nodiscard]] const GcPtr<Object> &get_slot(uint32_t slot) const { return m_slots[slot]; }
+
+        void set_slot(uint32_t slot, const GcPtr<Object> &obj) { m_slots[slot] = obj; }
+
+        [[nodiscard]] uint64_t get_version() const { return m_version; }
 
     private:
-        t_map m_value;
+        static uint64_t next_version();
+
+        std::unordered_map<t_string, uint32_t, std::hash<t_string>, std::equal_to<>,
+                gc_allocator<std::pair<const t_string, uint32_t>>> m_index;
+        t_vector m_slots;
+        uint64_t m_version = next_version();
+    };
+
+    // inline cache of a LOAD_GLOBAL / STORE_GLOBAL site, versions are unique across
+    // every StringMap so a cache filled for one module never matches another
+    struct GlobalCache {
+        uint64_t version = 0;
+        uint32_t slot = 0;
     };
 
+    class Function;
+
+    // resolved target of a CALL_METHOD site for one receiver type, the receiver is the
+    // NativeStruct of a native instance, the Struct of an Instance, or the Struct itself
+    // for a static call
+    struct MethodCacheEntry {
+        const void *receiver = nullptr;
+        bool is_static = false;
+        const NativeMethodPtr *native = nullptr;
+        GcPtr<Function> function;
+    };
+
+    // polymorphic inline cache of a CALL_METHOD site, full caches stop recording
+    struct MethodCache {
+        static constexpr uint32_t SIZE = 4;
+        std::array<MethodCacheEntry, SIZE> entries;
+        uint32_t count = 0;
+    };
+
+
+    class JitCode;
+
+    class RegisterCode;
+
+    struct JitState;
+
+    // native code compiled ahead of time for a code object, entered at ip with the same
+    // contract as JitCode::run, see core/aot.h
+    using AotFunction = uint32_t (*)(JitState *state, uint32_t ip);
 
     class Code : public NativeInstance {
     public:
         INSTANCE(Code)
         Code() = default;
 
-        Code(std::vector<uint32_t> instructions, std::vector<std::shared_ptr<Span>> spans,
+        Code(std::vector<uint8_t> instructions, std::vector<uint8_t> span_table,
              t_vector constants)
-                : m_instructions(std::move(instructions)), m_spans(std::move(spans)),
-                  m_constants(std::move(constants)) {}
+                : m_instructions(std::move(instructions)), m_span_table(std::move(span_table)),
+                  m_constants(std::move(constants)), m_global_caches(m_constants.size()) {
+            restore_last_run();
+        }
 
-        [[nodiscard]] std::vector<uint32_t> get_instructions() const { return m_instructions; }
+        [[nodiscard]] std::vector<uint8_t> get_instructions() const { return m_instructions; }
 
-        [[nodiscard]] std::vector<std::shared_ptr<Span>> get_spans() const { return m_spans; }
+        [[nodiscard]] const std::vector<uint8_t> &get_span_table() const { return m_span_table; }
 
         [[nodiscard]] t_vector get_constants() const { return m_constants; }
 
@@ -476,9 +663,25 @@ namespace bond {
 
         void add_ins(Opcode code, uint32_t oprand, const std::shared_ptr<Span> &span);
 
+        void add_ins(Opcode code, uint32_t oprand, uint32_t oprand_2, const std::shared_ptr<Span> &span);
+
+        // emits a jump whose target is not known yet, returns the offset to patch_code once it is
+        uint32_t add_jump(Opcode code, const std::shared_ptr<Span> &span);
+
+        // same as above for jumps that take a leading oprand before their target
+        uint32_t add_jump(Opcode code, uint32_t oprand, const std::shared_ptr<Span> &span);
+
         uint32_t add_constant(const GcPtr<Object> &obj);
 
-        void patch_code(uint32_t offset, uint32_t oprand) { m_instructions[offset] = oprand; }
+        void patch_code(uint32_t offset, uint32_t target) {
+            std::memcpy(&m_instructions[offset], &target, JUMP_OPRAND_WIDTH);
+        }
+
+        // replaces the instruction at offset with a specialised form of it
+        void quicken(uint32_t offset, Opcode opcode);
+
+        // puts back the generic instruction after a specialised one failed its guard
+        void deopt(uint32_t offset, Opcode generic);
 
         uint32_t current_index() { return (uint32_t)m_instructions.size(); }
 
@@ -486,26 +689,128 @@ namespace bond {
 
         GcPtr<Object> get_constant(size_t index) { return m_constants[index]; }
 
-        uint32_t get_code(size_t index) { return m_instructions[index]; }
+        GlobalCache &get_global_cache(size_t index) { return m_global_caches[index]; }
+
+        uint32_t add_method_cache() {
+            m_method_caches.emplace_back();
+            return (uint32_t) m_method_caches.size() - 1;
+        }
+
+        MethodCache &get_method_cache(size_t index) { return m_method_caches[index]; }
+
+        [[nodiscard]] uint32_t get_method_cache_count() const { return (uint32_t) m_method_caches.size(); }
+
+        uint8_t get_code(size_t index) { return m_instructions[index]; }
 
         uint32_t get_code_size() { return (uint32_t)m_instructions.size(); }
 
-        SharedSpan get_span(size_t index) { return m_spans[index]; }
+        // source location of the instruction byte at index, decoded from the span table so
+        // it is only paid for when an error needs it
+        [[nodiscard]] SharedSpan get_span(size_t index) const;
+
+        // the span of every instruction byte, bytes in the same run share one Span
+        [[nodiscard]] std::vector<SharedSpan> decode_spans() const;
+
+        // points every span at module id, for bytecode loaded into a context that numbers its
+        // modules differently from the one that compiled it
+        void set_module_id(uint32_t id);
+
+        // takes the instructions and spans of code, used by the optimizer which builds a
+        // rewritten copy of a code object and swaps it in
+        void replace_bytecode(const GcPtr<Code> &code);
+
+        std::vector<uint8_t> &get_instructions() { return m_instructions; }
+
+        std::vector<uint8_t> &get_opcodes() { return m_instructions; }
+
+
+        void set_locals(t_string_vector locals) { m_locals = std::move(locals); }
+
+        [[nodiscard]] const t_string_vector &get_locals() const { return m_locals; }
 
-        SharedSpan last_span() { return m_spans[m_spans.size() - 1]; }
+        [[nodiscard]] uint32_t get_local_count() const { return (uint32_t)m_locals.size(); }
 
-        std::vector<uint32_t> &get_instructions() { return m_instructions; }
+        void set_captures(std::vector<Capture> captures) { m_captures = std::move(captures); }
 
-        std::vector<uint32_t> &get_opcodes() { return m_instructions; }
+        [[nodiscard]] const std::vector<Capture> &get_captures() const { return m_captures; }
 
+        // deepest the operand stack gets while this code runs, recorded by verify so frames can
+        // reserve their stack slots once when they are entered
+        [[nodiscard]] uint32_t get_max_stack() const { return m_max_stack.value_or(0); }
 
-        std::vector<SharedSpan> &get_spans() { return m_spans; }
+        // checks the bytecode can run without the vm checking it as it goes: every opcode is
+        // known, oprands name locals, constants and method caches that exist, jumps land on
+        // instructions and the stack is as deep wherever paths meet. runs once, the max
+        // stack depth is recorded on success
+        std::expected<uint32_t, t_string> verify();
+
+        // machine code the jit made of this code, null until it has been compiled
+        [[nodiscard]] JitCode *get_jit_code() const { return m_jit_code; }
+
+        void set_jit_code(JitCode *jit_code) { m_jit_code = jit_code; }
+
+        // native code a module compiled ahead of time supplied for this code, null for none
+        [[nodiscard]] AotFunction get_aot_function() const { return m_aot_function; }
+
+        void set_aot_function(AotFunction function) { m_aot_function = function; }
+
+        // the same function as register code, null when it was not generated or the register
+        // backend does not run it, see compiler/regcodegen.h
+        [[nodiscard]] RegisterCode *get_register_code() const { return m_register_code.get(); }
+
+        void set_register_code(std::shared_ptr<RegisterCode> code) { m_register_code = std::move(code); }
+
+        // counts an entry into this code towards compiling it, returns the count before it
+        uint32_t count_jit_entry() { return m_jit_entries++; }
+
+        // a loop the tracing jit watches, by the ip its backward jump goes to
+        struct LoopTrace {
+            uint32_t count = 0;
+            uint32_t failures = 0;
+            JitCode *native = nullptr;
+        };
+
+        LoopTrace &get_loop_trace(uint32_t header) { return m_loop_traces[header]; }
 
 
     private:
-        std::vector<uint32_t> m_instructions;
-        std::vector<std::shared_ptr<Span>> m_spans;
+        std::vector<uint8_t> m_instructions;
+        // the span of every instruction byte as runs of bytes that share a span, each run is
+        // varints for the change in module id, start, length and line from the previous run
+        // followed by the number of bytes it covers
+        std::vector<uint8_t> m_span_table;
+        // the last run stays open so instructions with the same span extend it in place
+        Span m_last_span{0, 0, 0, 0};
+        size_t m_last_run_offset = 0;
+        uint32_t m_last_run_length = 0;
         t_vector m_constants{};
+        std::vector<GlobalCache> m_global_caches;
+        std::vector<MethodCache, gc_allocator<MethodCache>> m_method_caches;
+
+        // names of the local slots, arguments come first
+        t_string_vector m_locals;
+        std::vector<Capture> m_captures;
+        std::optional<uint32_t> m_max_stack;
+        JitCode *m_jit_code = nullptr;
+        AotFunction m_aot_function = nullptr;
+        std::shared_ptr<RegisterCode> m_register_code;
+        uint32_t m_jit_entries = 0;
+        std::unordered_map<uint32_t, LoopTrace> m_loop_traces;
+
+        void add_oprand(uint32_t oprand, bool jump_target, const std::shared_ptr<Span> &span);
+
+        // records that the next count instruction bytes come from span
+        void add_span(const std::shared_ptr<Span> &span, uint32_t count);
+
+        // calls visit(first byte, byte count, span, offset of the count in the table) for each
+        // run in the span table until it returns false
+        template<typename F>
+        void for_each_span_run(F &&visit) const;
+
+        void restore_last_run();
+
+        // decodes the instruction at offset, leaving offset at the next one
+        std::array<uint32_t, 2> read_instruction(size_t &offset) const;
 
         size_t simple_instruction(std::stringstream &ss, const char *name, size_t offset) const;
 
@@ -513,6 +818,30 @@ namespace bond {
 
         size_t oprand_instruction(std::stringstream &ss, const char *name, size_t offset) const;
 
+        size_t local_instruction(std::stringstream &ss, const char *name, size_t offset) const;
+
+        size_t call_method_instruction(std::stringstream &ss, const char *name, size_t offset) const;
+
+        size_t compare_jump_instruction(std::stringstream &ss, const char *name, size_t offset) const;
+
+        size_t local_attr_instruction(std::stringstream &ss, const char *name, size_t offset) const;
+
+        size_t two_local_instruction(std::stringstream &ss, const char *name, size_t offset) const;
+
+        // checks the oprands of one instruction, see verify
+        std::expected<void, t_string> check_instruction(Opcode opcode, const std::array<uint32_t, 2> &oprands) const;
+
+        size_t local_jump_instruction(std::stringstream &ss, const char *name, size_t offset) const;
+
+        // sites that deopt this many times are left generic
+        static constexpr uint32_t MAX_DEOPTS = 4;
+        std::unordered_map<uint32_t, uint32_t> m_deopts;
+
+        // sites quicken once their operands have matched this many times, so
+        // a single odd call at start up does not pick the form
+        static constexpr uint32_t QUICKEN_AFTER = 8;
+        std::unordered_map<uint32_t, uint32_t> m_warmups;
+
         std::unordered_map<uint64_t, uint32_t> m_int_map;
         std::unordered_map<double, uint32_t> m_float_map;
         std::unordered_map<t_string, uint32_t> m_string_map;
@@ -587,13 +916,16 @@ namespace bond {
     public:
         INSTANCE(Struct)
 
-        Struct(t_string name, const std::vector<t_string> &fields) : m_name(std::move(name)), m_fields(fields) {}
+        Struct(t_string name, const std::vector<t_string> &fields);
 
         [[nodiscard]] t_string get_name() const { return m_name; }
 
-        [[nodiscard]] std::vector<t_string> get_fields() const { return m_fields; }
+        [[nodiscard]] const t_string_vector &get_fields() const { return m_fields; }
+
+        // position of a field in every instance of this struct
+        [[nodiscard]] std::optional<uint32_t> get_field_index(const t_string &name) const;
 
-        [[nodiscard]] GcPtr<Instance> create_instance(const t_map &fields);
+        [[nodiscard]] GcPtr<Instance> create_instance(t_args values);
 
         void add_method(const t_string &name, const GcPtr<Function> &func) { m_methods[name] = func; }
 
@@ -612,23 +944,29 @@ namespace bond {
 
     private:
         t_string m_name;
-        std::vector<t_string> m_fields;
+        t_string_vector m_fields;
+        std::unordered_map<t_string, uint32_t, std::hash<t_string>, std::equal_to<>,
+                gc_allocator<std::pair<const t_string, uint32_t>>> m_field_index;
         std::unordered_map<t_string, GcPtr<Function>> m_methods;
         GcPtr<StringMap> m_globals;
     };
 
 
-    class Instance : public NativeInstance {
+    // fields are stored inline after the object in Struct field order, see Instance::allocate
+    class Instance final : public NativeInstance {
     public:
         INSTANCE(Instance)
-        Instance(Struct *type, t_map fields)
-                : m_type(type), m_fields(std::move(fields)) {}
+
+        // one allocation holding the instance and its fields, missing values are Nil
+        static GcPtr<Instance> allocate(Struct *type, t_args values);
 
         [[nodiscard]] GcPtr<Struct> get_type() const { return m_type; }
 
-        [[nodiscard]] t_map get_fields() const { return m_fields; }
+        [[nodiscard]] uint32_t get_field_count() const { return m_field_count; }
+
+        [[nodiscard]] const GcPtr<Object> &get_field(uint32_t index) const { return fields()[index]; }
 
-        void set_fields(t_map fields) { m_fields = std::move(fields); }
+        void set_field(uint32_t index, const GcPtr<Object> &value) { fields()[index] = value; }
 
         obj_result bind_method(const t_string &name);
 
@@ -648,9 +986,15 @@ namespace bond {
 
 
     private:
-        Struct *m_type;
-        t_map m_fields;
+        Instance(Struct *type, uint32_t field_count) : m_type(type), m_field_count(field_count) {}
 
+        [[nodiscard]] GcPtr<Object> *fields() const {
+            return reinterpret_cast<GcPtr<Object> *>(reinterpret_cast<char *>(const_cast<Instance *>(this)) +
+                                                     sizeof(Instance));
+        }
+
+        Struct *m_type;
+        uint32_t m_field_count;
     };
 
     class NativeFunction : public NativeInstance {
@@ -750,8 +1094,10 @@ namespace bond {
         INSTANCE(ListIterator)
         explicit ListIterator(const GcPtr<List> &list) : m_list(list) {}
 
+        IterStep iter_next(GcPtr<Object> &next) override;
+
         GcPtr<List> m_list;
-        int64_t m_index;
+        int64_t m_index = 0;
     };
 
 
@@ -776,23 +1122,42 @@ namespace bond {
     class Closure : public NativeInstance {
     public:
         INSTANCE(Closure)
-        Closure(GcPtr<Function> function, GcPtr<StringMap> up_values) : m_function(std::move(function)),
-                                                                        m_up_values(std::move(up_values)) {}
+        Closure(GcPtr<Function> function, t_vector up_values) : m_function(std::move(function)),
+                                                                 m_up_values(std::move(up_values)) {}
 
         [[nodiscard]] GcPtr<Function> get_function() const { return m_function; }
 
-        [[nodiscard]] GcPtr<StringMap> get_up_values() const { return m_up_values; }
+        // one Cell per entry in the function's captures
+        [[nodiscard]] const t_vector &get_up_values() const { return m_up_values; }
 
     private:
         GcPtr<Function> m_function;
-        GcPtr<StringMap> m_up_values;
+        t_vector m_up_values;
+    };
+
+    // a local that closures capture. the function declaring it and every closure that captures
+    // it keep the same cell in their slot for it, so they all see each other's assignments.
+    // a declaration that runs again, like one in a loop body, makes a new cell
+    class Cell : public NativeInstance {
+    public:
+        INSTANCE(Cell)
+        explicit Cell(GcPtr<Object> value) : m_value(std::move(value)) {}
+
+        [[nodiscard]] const GcPtr<Object> &get() const { return m_value; }
+
+        void set(const GcPtr<Object> &value) { m_value = value; }
+
+        [[nodiscard]] t_string str() const override { return fmt::format("Cell({})", m_value->str()); }
+
+    private:
+        GcPtr<Object> m_value;
     };
 
 
 #define TRY(expr) if (auto result = (expr); !result) return std::unexpected(result.error())
 
     template<typename T>
-    obj_result c_Default(const t_vector args) {
+    obj_result c_Default(t_args args) {
         T *value;
         auto res = parse_args(args, value);
         TRY(res);
@@ -808,7 +1173,7 @@ namespace bond {
 
 
     template<typename... Values>
-    obj_result parse_args(const t_vector &args, Values &... values) {
+    obj_result parse_args(t_args args, Values &... values) {
         if (args.size() != sizeof...(Values)) {
             return ERR(fmt::format("Expected {} arguments, but {} were given", sizeof...(Values), args.size()));
         }
@@ -818,11 +1183,16 @@ namespace bond {
 
     template<typename T>
     T *get_value(const GcPtr<Object> &obj) {
-        return dynamic_cast<T *>(obj.get());
+        auto ptr = obj.get();
+        if constexpr (HasTypeId<T>) {
+            return instanceof<T>(ptr) ? static_cast<T *>(ptr) : nullptr;
+        } else {
+            return dynamic_cast<T *>(ptr);
+        }
     }
 
     template<size_t I, typename... Values>
-    obj_result assign_args(const t_vector &args, Values &... values) {
+    obj_result assign_args(t_args args, Values &... values) {
         constexpr size_t N = sizeof...(Values);
         if constexpr (I < N) {
             using ValueType = std::remove_pointer<typename std::tuple_element<I, std::tuple<Values...>>::type>::type;
@@ -3,7 +3,7 @@
 
 
 namespace bond {
-    obj_result Bool_construct(const t_vector &args) {
+    obj_result Bool_construct(t_args args) {
         if (args.size() != 1) {
             return ERR("Bool constructor takes exactly one argument");
         }
@@ -27,7 +27,7 @@ namespace bond {
     auto TRUE_CONST = make_immortal<Bool>(true);
     auto FALSE_CONST = make_immortal<Bool>(false);
 
-    obj_result Bool_eq(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result Bool_eq(const GcPtr<Object>& self, t_args args) {
         auto self_bool = self->as<Bool>();
         Object *other;
 
@@ -43,7 +43,7 @@ namespace bond {
 
     }
 
-    obj_result Bool_ne(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result Bool_ne(const GcPtr<Object>& self, t_args args) {
         auto self_bool = self->as<Bool>();
         Object *other;
 
@@ -8,5 +8,6 @@ namespace bond {
 
     void init_closure() {
         Runtime::ins()->CLOSURE_STRUCT = make_immortal<NativeStruct>("Closure", "Closure(closure)", c_Default<Closure>);
+        Runtime::ins()->CELL_STRUCT = make_immortal<NativeStruct>("Cell", "Cell(value)", c_Default<Cell>);
     }
 }
\ No newline at end of file
@@ -7,20 +7,80 @@
 
 
 namespace bond {
+    uint32_t read_wide_oprand(const uint8_t *code, size_t &offset, uint32_t first) {
+        auto value = first & 0x7f;
+        for (uint32_t shift = 7; shift < 7 * MAX_OPRAND_WIDTH; shift += 7) {
+            uint32_t byte = code[offset++];
+            value |= (byte & 0x7f) << shift;
+            if (byte < 0x80) break;
+        }
+        return value;
+    }
+
     size_t Code::simple_instruction(std::stringstream &ss, const char *name, size_t offset) const {
         ss << fmt::format("{}\n", name);
         return offset + 1;
     }
 
+    std::array<uint32_t, 2> Code::read_instruction(size_t &offset) const {
+        auto opcode = static_cast<Opcode>(m_instructions[offset++]);
+        std::array<uint32_t, 2> oprands{0, 0};
+        for (uint32_t i = 0; i < oprand_count(opcode); i++) {
+            oprands[i] = read_oprand(opcode, i, m_instructions.data(), offset);
+        }
+        return oprands;
+    }
+
     size_t Code::constant_instruction(std::stringstream &ss, const char *name, size_t offset) const {
-        auto constant = m_constants[m_instructions[offset + 1]];
-        ss << fmt::format("{:<16} {:0>4}, {:<16}\n", name, m_instructions[offset + 1], constant->str());
-        return offset + 2;
+        auto [index, _] = read_instruction(offset);
+        ss << fmt::format("{:<16} {:0>4}, {:<16}\n", name, index, m_constants[index]->str());
+        return offset;
     }
 
     size_t Code::oprand_instruction(std::stringstream &ss, const char *name, size_t offset) const {
-        ss << fmt::format("{:<16} {:<4}\n", name, m_instructions[offset + 1]);
-        return offset + 2;
+        auto [oprand, _] = read_instruction(offset);
+        ss << fmt::format("{:<16} {:<4}\n", name, oprand);
+        return offset;
+    }
+
+    size_t Code::local_instruction(std::stringstream &ss, const char *name, size_t offset) const {
+        auto [slot, _] = read_instruction(offset);
+        auto local = slot < m_locals.size() ? m_locals[slot] : t_string("?");
+        ss << fmt::format("{:<16} {:0>4}, {:<16}\n", name, slot, local);
+        return offset;
+    }
+
+    size_t Code::call_method_instruction(std::stringstream &ss, const char *name, size_t offset) const {
+        auto [arg_count, cache] = read_instruction(offset);
+        ss << fmt::format("{:<16} {:0>4}, cache {}\n", name, arg_count, cache);
+        return offset;
+    }
+
+    size_t Code::compare_jump_instruction(std::stringstream &ss, const char *name, size_t offset) const {
+        auto [compare, target] = read_instruction(offset);
+        ss << fmt::format("{:<16} {}, {:<4}\n", name, opcode_name(static_cast<Opcode>(compare)), target);
+        return offset;
+    }
+
+    size_t Code::local_attr_instruction(std::stringstream &ss, const char *name, size_t offset) const {
+        auto [slot, name_index] = read_instruction(offset);
+        auto local = slot < m_locals.size() ? m_locals[slot] : t_string("?");
+        ss << fmt::format("{:<16} {:0>4}, {}.{}\n", name, slot, local, m_constants[name_index]->str());
+        return offset;
+    }
+
+    size_t Code::two_local_instruction(std::stringstream &ss, const char *name, size_t offset) const {
+        auto local = [&](uint32_t slot) { return slot < m_locals.size() ? m_locals[slot] : t_string("?"); };
+        auto [first, second] = read_instruction(offset);
+        ss << fmt::format("{:<16} {:0>4}, {:<8} {:0>4}, {}\n", name, first, local(first), second, local(second));
+        return offset;
+    }
+
+    size_t Code::local_jump_instruction(std::stringstream &ss, const char *name, size_t offset) const {
+        auto [slot, target] = read_instruction(offset);
+        auto local = slot < m_locals.size() ? m_locals[slot] : t_string("?");
+        ss << fmt::format("{:<16} {:0>4}, {:<8} {:<4}\n", name, slot, local, target);
+        return offset;
     }
 
     uint32_t Code::add_constant(const GcPtr<Object> &obj) {
@@ -31,6 +91,7 @@ namespace bond {
             } else {
                 m_int_map[value] = m_constants.size();
                 m_constants.push_back(obj);
+                m_global_caches.emplace_back();
                 return m_constants.size() - 1;
             }
         } else if (instanceof<Float>(obj.get())) {
@@ -40,25 +101,490 @@ namespace bond {
             } else {
                 m_float_map[value] = m_constants.size();
                 m_constants.push_back(obj);
+                m_global_caches.emplace_back();
+                return m_constants.size() - 1;
+            }
+        } else if (instanceof<String>(obj.get())) {
+            auto &value = obj->as<String>()->get_value_ref();
+            if (m_string_map.contains(value)) {
+                return m_string_map[value];
+            } else {
+                m_string_map[value] = m_constants.size();
+                m_constants.push_back(obj);
+                m_global_caches.emplace_back();
                 return m_constants.size() - 1;
             }
         }
 
         m_constants.push_back(obj);
+        m_global_caches.emplace_back();
         return m_constants.size() - 1;
     }
 
 
+    void Code::quicken(uint32_t offset, Opcode opcode) {
+        if (!m_deopts.empty()) {
+            auto it = m_deopts.find(offset);
+            if (it != m_deopts.end() and it->second >= MAX_DEOPTS) return;
+        }
+
+        auto &seen = m_warmups[offset];
+        if (++seen < QUICKEN_AFTER) return;
+
+        m_warmups.erase(offset);
+        m_instructions[offset] = static_cast<uint8_t>(opcode);
+    }
+
+    void Code::deopt(uint32_t offset, Opcode generic) {
+        m_instructions[offset] = static_cast<uint8_t>(generic);
+        m_deopts[offset]++;
+    }
+
+    // operand stack slots an instruction takes and leaves
+    struct StackUse {
+        int pops;
+        int pushes;
+    };
+
+    static StackUse stack_use(Opcode opcode, uint32_t oprand) {
+        switch (opcode) {
+            case Opcode::LOAD_CONST:
+            case Opcode::PUSH_TRUE:
+            case Opcode::PUSH_FALSE:
+            case Opcode::PUSH_NIL:
+            case Opcode::LOAD_GLOBAL:
+            case Opcode::LOAD_FAST:
+            case Opcode::CREATE_FUNCTION:
+            case Opcode::CREATE_STRUCT:
+            case Opcode::CREATE_CLOSURE:
+            case Opcode::LOAD_FAST_ATTR:
+            case Opcode::LOAD_CELL:
+            case Opcode::MAKE_ASYNC:
+                return {0, 1};
+            case Opcode::LOAD_FAST_LOAD_FAST:
+                return {0, 2};
+            case Opcode::JUMP:
+            case Opcode::BREAK:
+            case Opcode::CONTINUE:
+                return {0, 0};
+            case Opcode::COMPARE_AND_JUMP:
+                return {2, 0};
+            case Opcode::BUILD_LIST:
+                return {(int) oprand, 1};
+            case Opcode::BUILD_DICT:
+                return {2 * (int) oprand, 1};
+            case Opcode::UNPACK_SEQ:
+                return {1, (int) oprand};
+            case Opcode::CALL:
+            case Opcode::TAIL_CALL:
+                return {(int) oprand + 1, 1};
+            case Opcode::CALL_METHOD:
+                return {(int) oprand + 2, 1};
+            case Opcode::SET_ITEM:
+                return {3, 1};
+            case Opcode::SET_ATTRIBUTE:
+                return {2, 1};
+            // the iterator stays on the stack for the whole loop
+            case Opcode::STORE_GLOBAL:
+            case Opcode::STORE_FAST:
+            case Opcode::STORE_CELL:
+            case Opcode::ITER:
+            case Opcode::ITER_NEXT:
+            case Opcode::ITER_END:
+            case Opcode::FOR_ITER:
+            case Opcode::GET_ATTRIBUTE:
+            case Opcode::NOT:
+            case Opcode::UNARY_SUB:
+            case Opcode::MAKE_ERROR:
+            case Opcode::MAKE_OK:
+            case Opcode::TRY:
+            case Opcode::AWAIT:
+                return {1, 1};
+            case Opcode::POP_TOP:
+            case Opcode::CREATE_GLOBAL:
+            case Opcode::CREATE_LOCAL:
+            case Opcode::CREATE_CELL:
+            case Opcode::JUMP_IF_FALSE:
+            case Opcode::RETURN:
+            case Opcode::IMPORT:
+            case Opcode::IMPORT_PRE_COMPILED:
+                return {1, 0};
+            default:
+                // binary and compare operators, and their specialised forms
+                return {2, 1};
+        }
+    }
+
+    static bool is_compare(Opcode opcode) {
+        switch (opcode) {
+            case Opcode::LT:
+            case Opcode::LE:
+            case Opcode::GT:
+            case Opcode::GE:
+            case Opcode::EQ:
+            case Opcode::NE:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // read_oprand for bytecode that may end in the middle of an oprand
+    static std::optional<uint32_t> read_checked_oprand(const std::vector<uint8_t> &code, Opcode opcode,
+                                                       uint32_t index, size_t &offset) {
+        if (is_jump(opcode) and index + 1 == oprand_count(opcode)) {
+            if (offset + JUMP_OPRAND_WIDTH > code.size()) return std::nullopt;
+            return read_jump_target(code.data(), offset);
+        }
+
+        auto first = offset;
+        for (uint32_t i = 0; i < MAX_OPRAND_WIDTH; i++) {
+            if (offset >= code.size()) return std::nullopt;
+            if (code[offset++] < 0x80) break;
+        }
+        return read_oprand(code.data(), first);
+    }
+
+    std::expected<void, t_string> Code::check_instruction(Opcode opcode, const std::array<uint32_t, 2> &oprands) const {
+        auto local = [&](uint32_t slot) -> std::expected<void, t_string> {
+            if (slot >= m_locals.size()) {
+                return std::unexpected(fmt::format("{} uses local {} of {}", opcode_name(opcode), slot, m_locals.size()));
+            }
+            return {};
+        };
+
+        // constants the vm casts without looking are checked for their type as well
+        auto constant = [&](uint32_t index, bool (*is_expected)(const GcPtr<Object> &),
+                            const char *expected) -> std::expected<void, t_string> {
+            if (index >= m_constants.size()) {
+                return std::unexpected(
+                        fmt::format("{} uses constant {} of {}", opcode_name(opcode), index, m_constants.size()));
+            }
+            if (is_expected and !is_expected(m_constants[index])) {
+                return std::unexpected(fmt::format("{} expects constant {} to be a {}", opcode_name(opcode), index,
+                                                   expected));
+            }
+            return {};
+        };
+        auto is_string = +[](const GcPtr<Object> &value) { return !value.is_immediate() and value->is<String>(); };
+        auto is_function = +[](const GcPtr<Object> &value) { return !value.is_immediate() and value->is<Function>(); };
+        auto is_struct = +[](const GcPtr<Object> &value) { return !value.is_immediate() and value->is<Struct>(); };
+
+        switch (opcode) {
+            case Opcode::LOAD_FAST:
+            case Opcode::STORE_FAST:
+            case Opcode::CREATE_LOCAL:
+            case Opcode::ITER_NEXT:
+            case Opcode::FOR_ITER:
+            case Opcode::LOAD_CELL:
+            case Opcode::STORE_CELL:
+            case Opcode::CREATE_CELL:
+                return local(oprands[0]);
+            case Opcode::LOAD_FAST_LOAD_FAST:
+                TRY(local(oprands[0]));
+                return local(oprands[1]);
+            case Opcode::LOAD_FAST_ATTR:
+                TRY(local(oprands[0]));
+                return constant(oprands[1], is_string, "string");
+            case Opcode::LOAD_CONST:
+                return constant(oprands[0], nullptr, "");
+            case Opcode::LOAD_GLOBAL:
+            case Opcode::STORE_GLOBAL:
+            case Opcode::CREATE_GLOBAL:
+            case Opcode::GET_ATTRIBUTE:
+            case Opcode::SET_ATTRIBUTE:
+            case Opcode::IMPORT:
+                return constant(oprands[0], is_string, "string");
+            case Opcode::CREATE_FUNCTION:
+            case Opcode::MAKE_ASYNC:
+                return constant(oprands[0], is_function, "function");
+            case Opcode::CREATE_STRUCT:
+                return constant(oprands[0], is_struct, "struct");
+            case Opcode::CREATE_CLOSURE: {
+                TRY(constant(oprands[0], is_function, "function"));
+                // the closure takes the cells of its captures from this code's locals
+                for (auto &capture: m_constants[oprands[0]]->as<Function>()->get_code()->get_captures()) {
+                    TRY(local(capture.from));
+                }
+                return {};
+            }
+            case Opcode::CALL_METHOD:
+                if (oprands[1] >= m_method_caches.size()) {
+                    return std::unexpected(fmt::format("CALL_METHOD uses method cache {} of {}", oprands[1],
+                                                       m_method_caches.size()));
+                }
+                return {};
+            case Opcode::COMPARE_AND_JUMP:
+                if (oprands[0] >= OPCODE_COUNT or !is_compare(static_cast<Opcode>(oprands[0]))) {
+                    return std::unexpected(fmt::format("COMPARE_AND_JUMP with {}, which is not a comparison",
+                                                       oprands[0]));
+                }
+                return {};
+            default:
+                return {};
+        }
+    }
+
+    std::expected<uint32_t, t_string> Code::verify() {
+        if (m_max_stack.has_value()) return *m_max_stack;
+
+        // every instruction, reachable or not, has to decode and name oprands that exist
+        auto size = (uint32_t) m_instructions.size();
+        std::vector<bool> starts(size, false);
+
+        for (size_t offset = 0; offset < size;) {
+            auto start = offset;
+            if (m_instructions[offset] >= OPCODE_COUNT) {
+                return std::unexpected(fmt::format("unknown opcode {} at {}", m_instructions[offset], start));
+            }
+
+            auto opcode = static_cast<Opcode>(m_instructions[offset++]);
+            std::array<uint32_t, 2> oprands{0, 0};
+            for (uint32_t i = 0; i < oprand_count(opcode); i++) {
+                auto oprand = read_checked_oprand(m_instructions, opcode, i, offset);
+                if (!oprand) {
+                    return std::unexpected(fmt::format("{} at {} is cut off", opcode_name(opcode), start));
+                }
+                oprands[i] = *oprand;
+            }
+
+            if (auto checked = check_instruction(opcode, oprands); !checked) {
+                return std::unexpected(fmt::format("{} at {}", checked.error(), start));
+            }
+            starts[start] = true;
+        }
+
+        for (auto &capture: m_captures) {
+            if (capture.to >= m_locals.size()) {
+                return std::unexpected(fmt::format("capture into local {} of {}", capture.to, m_locals.size()));
+            }
+        }
+
+        // then every path through the code is walked once. the stack must be as deep wherever
+        // paths meet, never give up more than it holds and every path has to end in a RETURN
+        std::vector<int> depths(size, -1);
+        std::vector<uint32_t> pending;
+        int max_depth = 0;
+
+        auto reach = [&](uint32_t target, int depth, uint32_t from) -> std::expected<bool, t_string> {
+            if (target >= size or !starts[target]) {
+                return std::unexpected(fmt::format("jump at {} to {}, which is not an instruction", from, target));
+            }
+            if (depths[target] < 0) {
+                depths[target] = depth;
+                return true;
+            }
+            if (depths[target] != depth) {
+                return std::unexpected(fmt::format("stack is {} deep at {} coming from {}, {} on another path",
+                                                   depth, target, from, depths[target]));
+            }
+            return false;
+        };
+
+        if (size == 0) return std::unexpected("code has no instructions");
+        depths[0] = 0;
+        pending.push_back(0);
+
+        while (!pending.empty()) {
+            auto ip = pending.back();
+            pending.pop_back();
+            auto depth = depths[ip];
+
+            while (true) {
+                auto opcode = static_cast<Opcode>(m_instructions[ip]);
+                size_t next = ip;
+                auto oprands = read_instruction(next);
+
+                auto use = stack_use(opcode, oprands[0]);
+                if (depth < use.pops) {
+                    return std::unexpected(fmt::format("{} at {} takes {} values from a stack {} deep",
+                                                       opcode_name(opcode), ip, use.pops, depth));
+                }
+                depth += use.pushes - use.pops;
+                max_depth = std::max(max_depth, depth);
+
+                if (is_jump(opcode)) {
+                    auto target = oprands[oprand_count(opcode) - 1];
+                    auto reached = reach(target, depth, ip);
+                    TRY(reached);
+                    if (reached.value()) pending.push_back(target);
+                }
+
+                if (opcode == Opcode::RETURN or opcode == Opcode::JUMP or opcode == Opcode::BREAK or
+                    opcode == Opcode::CONTINUE) {
+                    break;
+                }
+
+                if (next >= size) {
+                    return std::unexpected(fmt::format("{} at {} runs past the end of the code",
+                                                       opcode_name(opcode), ip));
+                }
+
+                auto reached = reach((uint32_t) next, depth, ip);
+                TRY(reached);
+                if (!reached.value()) break;
+                ip = (uint32_t) next;
+            }
+        }
+
+        m_max_stack = (uint32_t) max_depth;
+        return *m_max_stack;
+    }
+
+    static void write_varint(std::vector<uint8_t> &out, uint32_t value) {
+        do {
+            auto byte = static_cast<uint8_t>(value & 0x7f);
+            value >>= 7;
+            out.push_back(value ? byte | 0x80 : byte);
+        } while (value);
+    }
+
+    // maps signed deltas onto varints, 0, -1, 1, -2 ... become 0, 1, 2, 3 ...
+    static uint32_t zigzag(int64_t value) {
+        return (uint32_t) ((value << 1) ^ (value >> 63));
+    }
+
+    static int64_t unzigzag(uint32_t value) {
+        return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+    }
+
+    void Code::add_span(const SharedSpan &span, uint32_t count) {
+        auto same = m_last_span.module_id == span->module_id and m_last_span.start == span->start and
+                    m_last_span.end == span->end and m_last_span.line == span->line;
+
+        if (m_last_run_length > 0 and same) {
+            m_span_table.resize(m_last_run_offset);
+            m_last_run_length += count;
+            write_varint(m_span_table, m_last_run_length);
+            return;
+        }
+
+        write_varint(m_span_table, zigzag((int64_t) span->module_id - m_last_span.module_id));
+        write_varint(m_span_table, zigzag((int64_t) span->start - m_last_span.start));
+        write_varint(m_span_table, zigzag((int64_t) span->end - span->start));
+        write_varint(m_span_table, zigzag((int64_t) span->line - m_last_span.line));
+
+        m_last_span = *span;
+        m_last_run_offset = m_span_table.size();
+        m_last_run_length = count;
+        write_varint(m_span_table, count);
+    }
+
+    template<typename F>
+    void Code::for_each_span_run(F &&visit) const {
+        Span span{0, 0, 0, 0};
+        size_t offset = 0;
+        size_t first = 0;
+
+        while (offset < m_span_table.size()) {
+            span.module_id += unzigzag(read_oprand(m_span_table.data(), offset));
+            span.start += unzigzag(read_oprand(m_span_table.data(), offset));
+            span.end = span.start + unzigzag(read_oprand(m_span_table.data(), offset));
+            span.line += unzigzag(read_oprand(m_span_table.data(), offset));
+            auto run_offset = offset;
+            auto count = read_oprand(m_span_table.data(), offset);
+
+            if (!visit(first, count, span, run_offset)) return;
+            first += count;
+        }
+    }
+
+    void Code::restore_last_run() {
+        for_each_span_run([&](size_t, uint32_t count, const Span &span, size_t run_offset) {
+            m_last_span = span;
+            m_last_run_offset = run_offset;
+            m_last_run_length = count;
+            return true;
+        });
+    }
+
+    SharedSpan Code::get_span(size_t index) const {
+        SharedSpan found;
+
+        for_each_span_run([&](size_t first, uint32_t count, const Span &span, size_t) {
+            found = std::make_shared<Span>(span);
+            return index >= first + count;
+        });
+
+        return found ? found : std::make_shared<Span>(0, 0, 0, 0);
+    }
+
+    std::vector<SharedSpan> Code::decode_spans() const {
+        std::vector<SharedSpan> spans;
+        spans.reserve(m_instructions.size());
+
+        for_each_span_run([&](size_t, uint32_t count, const Span &span, size_t) {
+            spans.resize(spans.size() + count, std::make_shared<Span>(span));
+            return true;
+        });
+
+        spans.resize(m_instructions.size(), spans.empty() ? std::make_shared<Span>(0, 0, 0, 0) : spans.back());
+        return spans;
+    }
+
+    void Code::set_module_id(uint32_t id) {
+        std::vector<std::pair<Span, uint32_t>> runs;
+        for_each_span_run([&](size_t, uint32_t count, const Span &span, size_t) {
+            runs.emplace_back(span, count);
+            return true;
+        });
+
+        m_span_table.clear();
+        m_last_span = {0, 0, 0, 0};
+        m_last_run_length = 0;
+        for (auto &[span, count]: runs) {
+            span.module_id = id;
+            add_span(std::make_shared<Span>(span), count);
+        }
+    }
+
+    void Code::replace_bytecode(const GcPtr<Code> &code) {
+        m_instructions = code->m_instructions;
+        m_span_table = code->m_span_table;
+        m_last_span = code->m_last_span;
+        m_last_run_offset = code->m_last_run_offset;
+        m_last_run_length = code->m_last_run_length;
+        m_max_stack.reset();
+        m_deopts.clear();
+    }
+
     void Code::add_ins(Opcode code, const SharedSpan &span) {
         m_instructions.push_back(static_cast<uint8_t>(code));
-        m_spans.push_back(span);
+        add_span(span, 1);
+    }
+
+    void Code::add_oprand(uint32_t oprand, bool jump_target, const SharedSpan &span) {
+        auto offset = (uint32_t) m_instructions.size();
+
+        if (jump_target) {
+            m_instructions.resize(offset + JUMP_OPRAND_WIDTH);
+            patch_code(offset, oprand);
+        } else {
+            write_varint(m_instructions, oprand);
+        }
+
+        add_span(span, (uint32_t) m_instructions.size() - offset);
     }
 
     void Code::add_ins(Opcode code, uint32_t oprand, const SharedSpan &span) {
-        m_instructions.push_back(static_cast<uint8_t>(code));
-        m_instructions.push_back(oprand);
-        m_spans.push_back(span);
-        m_spans.push_back(span);
+        add_ins(code, span);
+        add_oprand(oprand, is_jump(code) and oprand_count(code) == 1, span);
+    }
+
+    void Code::add_ins(Opcode code, uint32_t oprand, uint32_t oprand_2, const SharedSpan &span) {
+        add_ins(code, span);
+        add_oprand(oprand, false, span);
+        add_oprand(oprand_2, is_jump(code), span);
+    }
+
+    uint32_t Code::add_jump(Opcode code, const SharedSpan &span) {
+        add_ins(code, 0, span);
+        return current_index() - JUMP_OPRAND_WIDTH;
+    }
+
+    uint32_t Code::add_jump(Opcode code, uint32_t oprand, const SharedSpan &span) {
+        add_ins(code, oprand, 0, span);
+        return current_index() - JUMP_OPRAND_WIDTH;
     }
 
 
@@ -79,15 +605,30 @@ namespace bond {
         case Opcode::name:    \
             count = oprand_instruction(ss, #name, count);\
             break
+#define LOCAL_INSTRUCTION(name) \
+        case Opcode::name:    \
+            count = local_instruction(ss, #name, count);\
+            break
 
         size_t pre_line = 0;
 
+        // (end of run, line) for each run of the span table
+        std::vector<std::pair<size_t, uint32_t>> lines;
+        for_each_span_run([&](size_t first, uint32_t run, const Span &span, size_t) {
+            lines.emplace_back(first + run, span.line);
+            return true;
+        });
+        size_t run = 0;
+
         while (count < m_instructions.size()) {
             auto opcode = static_cast<Opcode>(m_instructions[count]);
 
-            if (pre_line != m_spans[count]->line) {
-                ss << fmt::format("{:6}  {:04} ", m_spans[count]->line, count);
-                pre_line = m_spans[count]->line;
+            while (run + 1 < lines.size() and lines[run].first <= count) run++;
+            auto line = lines.empty() ? 0 : lines[run].second;
+
+            if (pre_line != line) {
+                ss << fmt::format("{:6}  {:04} ", line, count);
+                pre_line = line;
 
             } else {
                 ss << fmt::format("{:6}  {:04} ", "", count);
@@ -98,16 +639,19 @@ namespace bond {
                 CONSTANT_INSTRUCTION(STORE_GLOBAL);
                 CONSTANT_INSTRUCTION(LOAD_GLOBAL);
                 CONSTANT_INSTRUCTION(CREATE_GLOBAL);
-                CONSTANT_INSTRUCTION(CREATE_LOCAL);
-                CONSTANT_INSTRUCTION(STORE_FAST);
-                CONSTANT_INSTRUCTION(LOAD_FAST);
-                CONSTANT_INSTRUCTION(ITER_NEXT);
                 CONSTANT_INSTRUCTION(GET_ATTRIBUTE);
                 CONSTANT_INSTRUCTION(SET_ATTRIBUTE);
                 CONSTANT_INSTRUCTION(IMPORT);
                 CONSTANT_INSTRUCTION(MAKE_ASYNC);
                 CONSTANT_INSTRUCTION(CREATE_CLOSURE);
-                CONSTANT_INSTRUCTION(CREATE_CLOSURE_EX);
+
+                LOCAL_INSTRUCTION(CREATE_LOCAL);
+                LOCAL_INSTRUCTION(STORE_FAST);
+                LOCAL_INSTRUCTION(LOAD_FAST);
+                LOCAL_INSTRUCTION(ITER_NEXT);
+                LOCAL_INSTRUCTION(LOAD_CELL);
+                LOCAL_INSTRUCTION(STORE_CELL);
+                LOCAL_INSTRUCTION(CREATE_CELL);
 
 
                 OPRAND_INSTRUCTION(UNPACK_SEQ);
@@ -116,13 +660,29 @@ namespace bond {
                 OPRAND_INSTRUCTION(JUMP_IF_FALSE);
                 OPRAND_INSTRUCTION(JUMP);
                 OPRAND_INSTRUCTION(CALL);
+                OPRAND_INSTRUCTION(TAIL_CALL);
                 OPRAND_INSTRUCTION(ITER_END);
                 OPRAND_INSTRUCTION(CREATE_FUNCTION);
                 OPRAND_INSTRUCTION(CREATE_STRUCT);
                 OPRAND_INSTRUCTION(TRY);
                 OPRAND_INSTRUCTION(BREAK);
                 OPRAND_INSTRUCTION(CONTINUE);
-                OPRAND_INSTRUCTION(CALL_METHOD);
+
+                case Opcode::CALL_METHOD:
+                    count = call_method_instruction(ss, "CALL_METHOD", count);
+                    break;
+                case Opcode::COMPARE_AND_JUMP:
+                    count = compare_jump_instruction(ss, "COMPARE_AND_JUMP", count);
+                    break;
+                case Opcode::LOAD_FAST_ATTR:
+                    count = local_attr_instruction(ss, "LOAD_FAST_ATTR", count);
+                    break;
+                case Opcode::LOAD_FAST_LOAD_FAST:
+                    count = two_local_instruction(ss, "LOAD_FAST_LOAD_FAST", count);
+                    break;
+                case Opcode::FOR_ITER:
+                    count = local_jump_instruction(ss, "FOR_ITER", count);
+                    break;
                 OPRAND_INSTRUCTION(IMPORT_PRE_COMPILED);
 
                 SIMPLE_INSTRUCTION(BIT_OR);
@@ -154,12 +714,36 @@ namespace bond {
                 SIMPLE_INSTRUCTION(AWAIT);
                 SIMPLE_INSTRUCTION(MAKE_OK);
                 SIMPLE_INSTRUCTION(MAKE_ERROR);
+
+                SIMPLE_INSTRUCTION(BIN_ADD_INT_INT);
+                SIMPLE_INSTRUCTION(BIN_SUB_INT_INT);
+                SIMPLE_INSTRUCTION(BIN_MUL_INT_INT);
+                SIMPLE_INSTRUCTION(BIN_DIV_INT_INT);
+                SIMPLE_INSTRUCTION(BIN_MOD_INT_INT);
+                SIMPLE_INSTRUCTION(BIN_ADD_FLOAT_FLOAT);
+                SIMPLE_INSTRUCTION(BIN_SUB_FLOAT_FLOAT);
+                SIMPLE_INSTRUCTION(BIN_MUL_FLOAT_FLOAT);
+                SIMPLE_INSTRUCTION(BIN_DIV_FLOAT_FLOAT);
+                SIMPLE_INSTRUCTION(LT_INT_INT);
+                SIMPLE_INSTRUCTION(LE_INT_INT);
+                SIMPLE_INSTRUCTION(GT_INT_INT);
+                SIMPLE_INSTRUCTION(GE_INT_INT);
+                SIMPLE_INSTRUCTION(EQ_INT_INT);
+                SIMPLE_INSTRUCTION(NE_INT_INT);
+                SIMPLE_INSTRUCTION(LT_FLOAT_FLOAT);
+                SIMPLE_INSTRUCTION(LE_FLOAT_FLOAT);
+                SIMPLE_INSTRUCTION(GT_FLOAT_FLOAT);
+                SIMPLE_INSTRUCTION(GE_FLOAT_FLOAT);
+                SIMPLE_INSTRUCTION(EQ_FLOAT_FLOAT);
+                SIMPLE_INSTRUCTION(NE_FLOAT_FLOAT);
             }
 
         }
 
 #undef SIMPLE_INSTRUCTION
 #undef CONSTANT_INSTRUCTION
+#undef OPRAND_INSTRUCTION
+#undef LOCAL_INSTRUCTION
 
         for (auto &constant: m_constants) {
             if (constant->is<Function>()) {
@@ -180,7 +764,7 @@ namespace bond {
     }
 
 
-    obj_result Code_construct(const t_vector &args) {
+    obj_result Code_construct(t_args args) {
         Code *code;
         auto opt = parse_args(args, code);
         TRY(opt);
@@ -3,7 +3,7 @@
 
 
 namespace bond {
-    obj_result Float_construct(const t_vector &args) {
+    obj_result Float_construct(t_args args) {
         Float *num;
 
         auto opt = parse_args(args, num);
@@ -12,7 +12,7 @@ namespace bond {
         return OK(GcPtr<Object>(num));
     }
 
-    obj_result check_args_f(const t_vector &args) {
+    obj_result check_args_f(t_args args) {
         if (args.size() != 1) {
             return ERR("Expected 1 argument");
         }
@@ -60,21 +60,21 @@ if (args[0]->is<Float>()) { \
         return AS_BOOL(self_num->get_value() op other->get_value()); \
     }
 
-    obj_result Float_add(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Float_add(const GcPtr<Object> &self, t_args args) {
         float_op(+)
     }
 
-    obj_result Float_sub(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Float_sub(const GcPtr<Object> &self, t_args args) {
         float_op(-)
     }
 
 
-    obj_result Float_mul(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Float_mul(const GcPtr<Object> &self, t_args args) {
        float_op(*)
     }
 
 
-    obj_result Float_div(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Float_div(const GcPtr<Object> &self, t_args args) {
         auto self_num = self->as<Float>();
         TRY(check_args_f(args));
 
@@ -95,31 +95,31 @@ if (args[0]->is<Float>()) { \
         }
     }
 
-    obj_result Float_lt(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result Float_lt(const GcPtr<Object>& self, t_args args) {
         compare_float_op(<)
     }
 
-    obj_result Float_eq(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result Float_eq(const GcPtr<Object>& self, t_args args) {
         equality_float_op(==, false)
     }
 
-    obj_result Float_ne(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result Float_ne(const GcPtr<Object>& self, t_args args) {
         equality_float_op(!=, true)
     }
 
-    obj_result Float_gt(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result Float_gt(const GcPtr<Object>& self, t_args args) {
         compare_float_op(>)
     }
 
-    obj_result Float_le(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result Float_le(const GcPtr<Object>& self, t_args args) {
         compare_float_op(<=)
     }
 
-    obj_result Float_ge(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result Float_ge(const GcPtr<Object>& self, t_args args) {
         compare_float_op(>=)
     }
 
-    obj_result Float_hash(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result Float_hash(const GcPtr<Object>& self, t_args args) {
         auto self_str = self->as<Float>();
         TRY(parse_args(args));
         return make_int((int64_t )std::hash<double>{}(self_str->get_value()));
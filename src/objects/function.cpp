@@ -8,7 +8,7 @@
 #include "../runtime.h"
 
 namespace bond {
-    obj_result c_Function(const t_vector &args) {
+    obj_result c_Function(t_args args) {
         Function *func;
         auto res = parse_args(args, func);
         TRY(res);
@@ -16,7 +16,7 @@ namespace bond {
     }
 
 
-    obj_result F_get_attribute(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result F_get_attribute(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<Function>();
         String *n;
         auto res = parse_args(args, n);
@@ -60,6 +60,13 @@ namespace bond {
         return Runtime::ins()->make_int(value);
     }
 
+    GcObject *box_immediate(uintptr_t tag, uint64_t bits) {
+        if (tag == IMMEDIATE_FLOAT_TAG) {
+            return Runtime::ins()->FLOAT_STRUCT->create_instance<Float>(std::bit_cast<double>(bits)).get();
+        }
+        return Runtime::ins()->INT_STRUCT->create_instance<Int>(static_cast<int64_t>(bits)).get();
+    }
+
     GcPtr<String> make_string(const t_string& value) {
         return Runtime::ins()->make_string(value);
     }
@@ -8,19 +8,19 @@
 
 
 namespace bond {
-    obj_result is_ready(const GcPtr<Object>&Self, const t_vector& args) {
+    obj_result is_ready(const GcPtr<Object>&Self, t_args args) {
         TRY(parse_args(args));
         auto self = Self->as<Future>();
         return OK(AS_BOOL(self->is_ready()));
     }
 
-    obj_result get_res_value(const GcPtr<Object>&Self, const t_vector& args) {
+    obj_result get_res_value(const GcPtr<Object>&Self, t_args args) {
         TRY(parse_args(args));
         auto self = Self->as<Future>();
         return self->get_value();
     }
 
-    obj_result then(const GcPtr<Object>&Self, const t_vector& args) {
+    obj_result then(const GcPtr<Object>&Self, t_args args) {
         Function* func;
         TRY(parse_args(args, func));
         auto self = Self->as<Future>();
@@ -49,7 +49,7 @@ namespace bond {
     }
 
 
-    obj_result f_constructor(const t_vector& args) {
+    obj_result f_constructor(t_args args) {
         Object *obj;
         TRY(parse_args(args, obj));
         auto f = Runtime::ins()->make_future();
@@ -255,7 +255,7 @@ namespace bond {
         return res;
     }
 
-    obj_result HashMap_getitem(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result HashMap_getitem(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<HashMap>();
         Object *key;
         auto opt = parse_args(args, key);
@@ -267,7 +267,7 @@ namespace bond {
         return OK(res.value());
     }
 
-    obj_result HashMap_setitem(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result HashMap_setitem(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<HashMap>();
         Object *key;
         Object *value;
@@ -280,13 +280,13 @@ namespace bond {
         return OK();
     }
 
-    obj_result HashMap_len(const GcPtr<Object> &Self, [[maybe_unused]] const t_vector &args) {
+    obj_result HashMap_len(const GcPtr<Object> &Self, [[maybe_unused]] t_args args) {
         auto self = Self->as<HashMap>();
         return OK(make_int(self->size()));
     }
 
 
-    obj_result HashMap_get(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result HashMap_get(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<HashMap>();
         Object *key;
 
@@ -300,7 +300,7 @@ namespace bond {
         return make_ok(res.value());
     }
 
-    obj_result HashMap_set(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result HashMap_set(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<HashMap>();
         Object *key;
         Object *value;
@@ -313,7 +313,7 @@ namespace bond {
         return make_ok(value);
     }
 
-    obj_result HashMap_contains(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result HashMap_contains(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<HashMap>();
         Object *key;
         TRY(parse_args(args, key));
@@ -325,7 +325,7 @@ namespace bond {
         return AS_BOOL(res.value());
     }
 
-    obj_result HashMap_remove(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result HashMap_remove(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<HashMap>();
         Object *key;
         TRY(parse_args(args, key));
@@ -373,13 +373,13 @@ namespace bond {
         GcPtr<HashMap> m_map;
     };
 
-    obj_result Hash_it_next(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result Hash_it_next(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<HashMapIterator>();
         TRY(parse_args(args));
         return self->next();
     }
 
-    obj_result Hash_it_has_next(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result Hash_it_has_next(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<HashMapIterator>();
         TRY(parse_args(args));
         return AS_BOOL(self->has_next());
@@ -391,7 +391,7 @@ namespace bond {
                     {"__has_next__", {Hash_it_has_next, "__has_next__() -> Bool"}},
             });
 
-    obj_result HashMap_iter(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result HashMap_iter(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<HashMap>();
         TRY(parse_args(args));
         return HASH_ITER_STRUCT->create_instance<HashMapIterator>(self);
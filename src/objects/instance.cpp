@@ -2,6 +2,19 @@
 #include "../runtime.h"
 
 namespace bond {
+    GcPtr<Instance> Instance::allocate(Struct *type, t_args values) {
+        auto count = (uint32_t) type->get_fields().size();
+        auto memory = gc::operator new(sizeof(Instance) + count * sizeof(GcPtr<Object>), GC);
+        auto instance = new(memory) Instance(type, count);
+
+        auto fields = instance->fields();
+        for (uint32_t i = 0; i < count; i++) {
+            new(&fields[i]) GcPtr<Object>(i < values.size() ? values[i] : GcPtr<Object>(Runtime::ins()->C_NONE));
+        }
+
+        return instance;
+    }
+
     obj_result Instance::bind_method(const t_string &name) {
         auto meth = m_type->get_method(name);
         if (!meth)
@@ -22,15 +35,15 @@ namespace bond {
     }
 
     obj_result Instance::get_field(const t_string &name) {
-        if (m_fields.contains(name)) {
-            return OK(m_fields[name]);
+        if (auto index = m_type->get_field_index(name)) {
+            return OK(fields()[*index]);
         }
         return ERR("Field " + name + " not found");
     }
 
     obj_result Instance::set_field(const t_string &name, const GcPtr<Object> &value) {
-        if (m_fields.contains(name)) {
-            m_fields[name] = value;
+        if (auto index = m_type->get_field_index(name)) {
+            fields()[*index] = value;
             return OK(value);
         }
         return ERR("Field " + name + " not found");
@@ -45,16 +58,18 @@ namespace bond {
 
     t_string Instance::str() const {
         std::vector<t_string> fields;
-        for (auto const &[key, value]: m_fields) {
+        auto &names = m_type->get_fields();
+        for (uint32_t i = 0; i < m_field_count; i++) {
+            auto &value = get_field(i);
             if (value.get() == this)
-                fields.push_back(key + ": <self>");
+                fields.push_back(names[i] + ": <self>");
             else
-                fields.push_back(key + ": " + value->str());
+                fields.push_back(names[i] + ": " + value->str());
         }
         return fmt::format("{}({})", m_type->get_name(), fmt::join(fields, ", "));
     }
 
-    obj_result I_get_attribute(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result I_get_attribute(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<Instance>();
         String *name;
         auto opt = parse_args(args, name);
@@ -72,7 +87,7 @@ namespace bond {
         return res;
     }
 
-    obj_result I_set_attribute(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result I_set_attribute(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<Instance>();
         String *name;
         Object *value;
@@ -82,7 +97,7 @@ namespace bond {
         return self->set_field(name->get_value(), value);
     }
 
-    obj_result get_type(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result get_type(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<Instance>();
         TRY(parse_args(args));
         return self->get_type();
@@ -113,7 +128,7 @@ namespace bond {
     //    HAS_NEXT,
 
     auto slot_wrapper(const t_string &slot_name) -> NativeMethodPtr {
-        return [slot_name](const GcPtr<Object> &Self, const t_vector &args) -> obj_result {
+        return [slot_name](const GcPtr<Object> &Self, t_args args) -> obj_result {
             auto self = Self->as<Instance>();
             TRY(parse_args(args));
             auto res = self->get_method(slot_name);
@@ -2,7 +2,7 @@
 #include "../runtime.h"
 
 namespace bond {
-    obj_result Int_construct(const t_vector &args) {
+    obj_result Int_construct(t_args args) {
         Int *num;
 
         auto opt = parse_args(args, num);
@@ -11,7 +11,7 @@ namespace bond {
         return GcPtr<Object>(num);
     }
 
-    obj_result check_args(const t_vector &args) {
+    obj_result check_args(t_args args) {
         if (args.size() != 1) {
             return ERR("Expected 1 argument");
         }
@@ -23,10 +23,11 @@ namespace bond {
         return OK();
     }
 
+// ints wrap on overflow, the same as the specialised opcodes and the jit
 #define apply_int_op(op) \
 if (args[0]->is<Int>()) { \
         auto other = args[0]->as<Int>(); \
-        return make_int(self_num->get_value() op other->get_value()); \
+        return make_int((int64_t) ((uint64_t) self_num->get_value() op (uint64_t) other->get_value())); \
     } else { \
         auto other = args[0]->as<Float>(); \
         return make_float(self_num->get_value() op other->get_value()); \
@@ -59,21 +60,21 @@ if (args[0]->is<Int>()) { \
         return AS_BOOL(self_num->get_value() op other->get_value()); \
     }
 
-    obj_result Int_add(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Int_add(const GcPtr<Object> &self, t_args args) {
         int_op(+)
     }
 
-    obj_result Int_sub(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Int_sub(const GcPtr<Object> &self, t_args args) {
         int_op(-)
     }
 
-    obj_result Int_mul(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Int_mul(const GcPtr<Object> &self, t_args args) {
         int_op(*)
     }
 
 
 
-    obj_result Int_div(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Int_div(const GcPtr<Object> &self, t_args args) {
         auto self_num = self->as<Int>();
         TRY(check_args(args));
 
@@ -82,6 +83,10 @@ if (args[0]->is<Int>()) { \
             if (other->get_value() == 0)
                 return ERR("Division by zero");
 
+            // the minimum divided by -1 traps on x86, negate with wrapping instead
+            if (other->get_value() == -1)
+                return make_int((int64_t) (0 - (uint64_t) self_num->get_value()));
+
             return make_int(self_num->get_value() / other->get_value());
         } else {
             auto other = args[0]->as<Float>();
@@ -92,7 +97,7 @@ if (args[0]->is<Int>()) { \
         }
     }
 
-    obj_result Int_mod(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Int_mod(const GcPtr<Object> &self, t_args args) {
         auto self_num = self->as<Int>();
         Int *other;
 
@@ -102,34 +107,37 @@ if (args[0]->is<Int>()) { \
         if (other->get_value() == 0)
             return ERR("Division by zero");
 
+        if (other->get_value() == -1)
+            return make_int(0);
+
         return make_int(self_num->get_value() % other->get_value());
     }
 
-    obj_result Int_lt(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Int_lt(const GcPtr<Object> &self, t_args args) {
         compare_int_op(<)
     }
 
-    obj_result Int_eq(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Int_eq(const GcPtr<Object> &self, t_args args) {
         equality_int_op(==, false)
     }
 
-    obj_result Int_ne(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Int_ne(const GcPtr<Object> &self, t_args args) {
         equality_int_op(!=, true)
     }
 
-    obj_result Int_gt(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Int_gt(const GcPtr<Object> &self, t_args args) {
         compare_int_op(>)
     }
 
-    obj_result Int_le(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Int_le(const GcPtr<Object> &self, t_args args) {
         compare_int_op(<=)
     }
 
-    obj_result Int_ge(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Int_ge(const GcPtr<Object> &self, t_args args) {
         compare_int_op(>=)
     }
 
-    obj_result Int_hash(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result Int_hash(const GcPtr<Object> &self, t_args args) {
         TRY(parse_args(args));
         auto self_num = self->as<Int>();
         return make_int((int64_t)std::hash<int64_t>{}(self_num->get_value()));
@@ -30,7 +30,7 @@ namespace bond {
         return m_elements.size();
     }
 
-    obj_result get_item(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result get_item(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<List>();
         Int *index;
         TRY(parse_args(args, index));
@@ -38,7 +38,7 @@ namespace bond {
         return self->get_item(index->get_value());
     }
 
-    obj_result set_item(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result set_item(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<List>();
         Int *index;
         Object *item;
@@ -47,7 +47,7 @@ namespace bond {
         return self->set_item(index->get_value(), item);
     }
 
-    obj_result size(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result size(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<List>();
         TRY(parse_args(args));
 
@@ -81,7 +81,7 @@ namespace bond {
         return fmt::format("[{}]", fmt::join(strs, ", "));
     }
 
-    obj_result List_append(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result List_append(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<List>();
         Object *item;
         TRY(parse_args(args, item));
@@ -90,7 +90,7 @@ namespace bond {
         return OK();
     }
 
-    obj_result List_insert(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result List_insert(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<List>();
         Int *index;
         Object *item;
@@ -100,14 +100,14 @@ namespace bond {
         return OK();
     }
 
-    obj_result List_pop(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result List_pop(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<List>();
         TRY(parse_args(args));
 
         return self->pop();
     }
 
-    obj_result List_contains(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result List_contains(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<List>();
         Object *item;
         TRY(parse_args(args, item));
@@ -124,13 +124,20 @@ namespace bond {
         return Runtime::ins()->C_FALSE;
     }
 
-    obj_result list_iterator_next(const GcPtr<Object> &Self, const t_vector &args) {
+    NativeInstance::IterStep ListIterator::iter_next(GcPtr<Object> &next) {
+        auto &elements = m_list->get_elements();
+        if (m_index >= (int64_t) elements.size()) return IterStep::Done;
+        next = elements[m_index++];
+        return IterStep::Next;
+    }
+
+    obj_result list_iterator_next(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<ListIterator>();
         TRY(parse_args(args));
         return self->m_list->get_item(self->m_index++);
     }
 
-    obj_result list_iterator_has_next(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result list_iterator_has_next(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<ListIterator>();
         TRY(parse_args(args));
         return OK(AS_BOOL(self->m_index < self->m_list->get_size()));
@@ -142,7 +149,7 @@ namespace bond {
                     {"__has_next__", {list_iterator_has_next, "__has_next__()"}},
             });
 
-    obj_result list_iter(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result list_iter(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<List>();
         TRY(parse_args(args));
 
@@ -1,20 +1,59 @@
 #include "../object.h"
 #include "../runtime.h"
+#include <atomic>
 
 
 namespace bond {
-    void StringMap::set(const t_string& key, const GcPtr<Object>& obj) {
-        m_value[key] = obj;
+    uint64_t StringMap::next_version() {
+        static std::atomic<uint64_t> version = 1;
+        return version++;
     }
+
+    t_map StringMap::get_value() const {
+        t_map value;
+        for (auto &[key, slot]: m_index) {
+            value[key] = m_slots[slot];
+        }
+        return value;
+    }
+
+    void StringMap::set_value(const t_map &value) {
+        m_index.clear();
+        m_slots.clear();
+        m_version = next_version();
+
+        for (auto &[key, obj]: value) {
+            set(key, obj);
+        }
+    }
+
+    uint32_t StringMap::set(const t_string& key, const GcPtr<Object>& obj) {
+        if (auto it = m_index.find(key); it != m_index.end()) {
+            m_slots[it->second] = obj;
+            return it->second;
+        }
+
+        auto slot = (uint32_t)m_slots.size();
+        m_index[key] = slot;
+        m_slots.push_back(obj);
+        return slot;
+    }
+
     std::optional<GcPtr<Object>> StringMap::get(const t_string& key) {
-        if (m_value.contains(key)) return m_value[key];
+        if (auto it = m_index.find(key); it != m_index.end()) return m_slots[it->second];
         return std::nullopt;
     }
+
     GcPtr<Object> StringMap::get_unchecked(const t_string& key) {
-        return m_value[key];
+        return m_slots[m_index.at(key)];
+    }
+
+    std::optional<uint32_t> StringMap::find_slot(const t_string &key) {
+        if (auto it = m_index.find(key); it != m_index.end()) return it->second;
+        return std::nullopt;
     }
 
-    obj_result c_Map(const t_vector &args) {
+    obj_result c_Map(t_args args) {
         StringMap* map;
         auto res = parse_args(args, map);
         TRY(res);
@@ -30,7 +30,7 @@ namespace bond {
         m_globals->set(name, mod);
     }
 
-    obj_result get_attribute(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result get_attribute(const GcPtr<Object> &Self, t_args args) {
         auto self = Self->as<Module>();
         String *name;
 
@@ -47,7 +47,7 @@ namespace bond {
         }
     }
 
-    obj_result get_values(const GcPtr<Object> &Self, const t_vector &args) {
+    obj_result get_values(const GcPtr<Object> &Self, t_args args) {
         TRY(parse_args(args));
         auto self = Self->as<Module>();
 
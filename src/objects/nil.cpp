@@ -6,13 +6,13 @@ namespace bond {
 
     auto NONE_CONST = make_immortal<None>();
 
-    obj_result None_construct(const t_vector &args) {
+    obj_result None_construct(t_args args) {
         auto opt = parse_args(args);
         TRY(opt);
         return NONE_CONST;
     }
 
-    obj_result None_eq(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result None_eq(const GcPtr<Object> &self, t_args args) {
         auto self_num = self->as<None>();
         Object *other;
 
@@ -22,7 +22,7 @@ namespace bond {
         return AS_BOOL(other->is<None>());
     }
 
-    obj_result None_ne(const GcPtr<Object> &self, const t_vector &args) {
+    obj_result None_ne(const GcPtr<Object> &self, t_args args) {
         auto self_num = self->as<None>();
         Object *other;
 
@@ -7,27 +7,27 @@
 
 namespace bond {
 
-    obj_result Result_construct(const t_vector &args) {
+    obj_result Result_construct(t_args args) {
         Object* value;
         Bool* is_error;
         TRY(parse_args(args, value, is_error));
         return make_result(value, is_error->get_value());
     }
 
-    obj_result Result_is_ok(const GcPtr<Object>& Self, const t_vector &args) {
+    obj_result Result_is_ok(const GcPtr<Object>& Self, t_args args) {
         auto self = Self->as<Result>();
         TRY(parse_args(args));
         return AS_BOOL(self->has_value());
     }
 
-    obj_result  Result_is_error(const GcPtr<Object>& Self, const t_vector &args) {
+    obj_result  Result_is_error(const GcPtr<Object>& Self, t_args args) {
         auto self = Self->as<Result>();
         TRY(parse_args(args));
         return AS_BOOL(self->has_error());
 
     }
 
-    obj_result Result_value(const GcPtr<Object>& Self, const t_vector &args) {
+    obj_result Result_value(const GcPtr<Object>& Self, t_args args) {
         auto self = Self->as<Result>();
         TRY(parse_args(args));
         if (self->has_value()) {
@@ -37,7 +37,7 @@ namespace bond {
         }
     }
 
-    obj_result  Result_error(const GcPtr<Object>& Self, const t_vector &args) {
+    obj_result  Result_error(const GcPtr<Object>& Self, t_args args) {
         auto self = Self->as<Result>();
         TRY(parse_args(args));
         if (self->has_error()) {
@@ -47,7 +47,7 @@ namespace bond {
         }
     }
 
-    obj_result  Result_or_else(const GcPtr<Object>& Self, const t_vector &args) {
+    obj_result  Result_or_else(const GcPtr<Object>& Self, t_args args) {
         auto self = Self->as<Result>();
         Object* else_value;
         TRY(parse_args(args, else_value));
@@ -3,7 +3,7 @@
 
 
 namespace bond {
-    obj_result String_construct(const t_vector &args) {
+    obj_result String_construct(t_args args) {
         String *num;
 
         auto opt = parse_args(args, num);
@@ -12,7 +12,7 @@ namespace bond {
         return GcPtr<Object>(num);
     }
 
-    obj_result String_add(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result String_add(const GcPtr<Object>& self, t_args args) {
         auto self_num = self->as<String>();
         String *other;
 
@@ -22,7 +22,7 @@ namespace bond {
         return make_string(fmt::format("{}{}", self_num->get_value().c_str(), other->get_value().c_str()));
     }
 
-    obj_result String_join(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result String_join(const GcPtr<Object>& self, t_args args) {
         auto self_str = self->as<String>();
 
         std::vector<t_string> strings;
@@ -34,13 +34,13 @@ namespace bond {
         return make_string(fmt::format("{}", fmt::join(strings, self_str->get_value())));
     }
 
-    obj_result String_size(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result String_size(const GcPtr<Object>& self, t_args args) {
         auto self_str = self->as<String>();
         TRY(parse_args(args));
         return make_int(self_str->get_value().size());
     }
 
-    obj_result String_get_item(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result String_get_item(const GcPtr<Object>& self, t_args args) {
         auto self_str = self->as<String>();
         Int* index;
         TRY(parse_args(args, index));
@@ -52,7 +52,7 @@ namespace bond {
         return make_string(fmt::format("{}", self_str->get_value()[index->get_value()]));
     }
 
-    obj_result String_sub_string(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result String_sub_string(const GcPtr<Object>& self, t_args args) {
         auto self_str = self->as<String>();
         Int* start;
         Int* end;
@@ -70,13 +70,19 @@ namespace bond {
         return make_string(sub);
     }
 
-    obj_result String_it_next(const GcPtr<Object>& self, const t_vector &args) {
+    NativeInstance::IterStep StringIterator::iter_next(GcPtr<Object> &next) {
+        if (m_index >= m_value.size()) return IterStep::Done;
+        next = make_string(fmt::format("{}", m_value[m_index++]));
+        return IterStep::Next;
+    }
+
+    obj_result String_it_next(const GcPtr<Object>& self, t_args args) {
         auto self_str = self->as<StringIterator>();
         TRY(parse_args(args));
         return make_string(fmt::format("{}", self_str->m_value[self_str->m_index++]));
     }
 
-    obj_result String_it_has_next(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result String_it_has_next(const GcPtr<Object>& self, t_args args) {
         auto self_str = self->as<StringIterator>();
         TRY(parse_args(args));
         return AS_BOOL(self_str->m_index < self_str->m_value.size());
@@ -87,27 +93,27 @@ namespace bond {
             {"__has_next__", {String_it_has_next, "__has_next__() -> Bool"}},
     });
 
-    obj_result String_iter(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result String_iter(const GcPtr<Object>& self, t_args args) {
         auto self_str = self->as<String>();
         TRY(parse_args(args));
         return OK(STRING_ITER_STRUCT->create_instance<StringIterator>(self_str->get_value()));
     }
 
-    obj_result String_eq(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result String_eq(const GcPtr<Object>& self, t_args args) {
         auto self_str = self->as<String>();
         String* other;
         TRY(parse_args(args, other));
         return AS_BOOL(self_str->get_value() == other->get_value());
     }
 
-    obj_result String_neq(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result String_neq(const GcPtr<Object>& self, t_args args) {
         auto self_str = self->as<String>();
         String* other;
         TRY(parse_args(args, other));
         return AS_BOOL(self_str->get_value() != other->get_value());
     }
 
-    obj_result String_hash(const GcPtr<Object>& self, const t_vector &args) {
+    obj_result String_hash(const GcPtr<Object>& self, t_args args) {
         auto self_str = self->as<String>();
         TRY(parse_args(args));
         return make_int(std::hash<t_string>{}(self_str->get_value()));
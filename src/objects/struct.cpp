@@ -3,8 +3,22 @@
 
 
 namespace bond {
-    GcPtr<Instance> Struct::create_instance(const t_map &fields) {
-        return Runtime::ins()->make_instance(this, fields);
+    Struct::Struct(t_string name, const std::vector<t_string> &fields) : m_name(std::move(name)),
+                                                                         m_fields(fields.begin(), fields.end()) {
+        for (uint32_t i = 0; i < m_fields.size(); i++) {
+            m_field_index[m_fields[i]] = i;
+        }
+    }
+
+    std::optional<uint32_t> Struct::get_field_index(const t_string &name) const {
+        auto it = m_field_index.find(name);
+        if (it == m_field_index.end())
+            return std::nullopt;
+        return it->second;
+    }
+
+    GcPtr<Instance> Struct::create_instance(t_args values) {
+        return Runtime::ins()->make_instance(this, values);
     }
 
     void Struct::set_globals(const GcPtr<StringMap> &globals) {
@@ -23,7 +37,7 @@ namespace bond {
     }
 
 
-    obj_result c_Struct(const t_vector &args) {
+    obj_result c_Struct(t_args args) {
         Struct *strct;
         auto res = parse_args(args, strct);
         TRY(res);
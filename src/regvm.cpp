@@ -0,0 +1,547 @@
+//
+// the vm's register backend, runs the register code RegisterGenerator made, see regcodegen.h
+//
+// a register frame is an ordinary frame, its registers are the frame's locals and its operand
+// stack holds the windows of the calls it makes. register code runs to its end on the native
+// stack, calls into stack code run their frames with exec and come back here
+//
+
+#include "vm.h"
+
+namespace bond {
+    // the stack opcode that runs the generic form of a register instruction
+    static Opcode generic_opcode(RegOpcode opcode) {
+        switch (opcode) {
+            case RegOpcode::ADD:
+                return Opcode::BIN_ADD;
+            case RegOpcode::SUB:
+                return Opcode::BIN_SUB;
+            case RegOpcode::MUL:
+                return Opcode::BIN_MUL;
+            case RegOpcode::DIV:
+                return Opcode::BIN_DIV;
+            case RegOpcode::MOD:
+                return Opcode::BIN_MOD;
+            case RegOpcode::LT:
+            case RegOpcode::JUMP_IF_NOT_LT:
+                return Opcode::LT;
+            case RegOpcode::LE:
+            case RegOpcode::JUMP_IF_NOT_LE:
+                return Opcode::LE;
+            case RegOpcode::GT:
+            case RegOpcode::JUMP_IF_NOT_GT:
+                return Opcode::GT;
+            case RegOpcode::GE:
+            case RegOpcode::JUMP_IF_NOT_GE:
+                return Opcode::GE;
+            case RegOpcode::EQ:
+            case RegOpcode::JUMP_IF_NOT_EQ:
+                return Opcode::EQ;
+            case RegOpcode::NE:
+            case RegOpcode::JUMP_IF_NOT_NE:
+                return Opcode::NE;
+            case RegOpcode::BIT_OR:
+                return Opcode::BIT_OR;
+            case RegOpcode::BIT_AND:
+                return Opcode::BIT_AND;
+            default:
+                return Opcode::BIT_XOR;
+        }
+    }
+
+    // a + b and the rest on two immediates, false when the vm has to run the operation
+    template<RegOpcode OPERATION>
+    static bool arithmetic(GcPtr<Object> &dest, const GcPtr<Object> &left, const GcPtr<Object> &right) {
+        if (left.is_immediate_int() and right.is_immediate_int()) {
+            auto a = (uint64_t) left.immediate_int();
+            auto b = (uint64_t) right.immediate_int();
+            int64_t result;
+            if constexpr (OPERATION == RegOpcode::ADD) {
+                result = (int64_t) (a + b);
+            } else if constexpr (OPERATION == RegOpcode::SUB) {
+                result = (int64_t) (a - b);
+            } else if constexpr (OPERATION == RegOpcode::MUL) {
+                result = (int64_t) (a * b);
+            } else {
+                // zero and the minimum divided by -1 are left to the vm
+                auto divisor = right.immediate_int();
+                if (divisor == 0 or divisor == -1) return false;
+                result = OPERATION == RegOpcode::MOD ? left.immediate_int() % divisor
+                                                     : left.immediate_int() / divisor;
+            }
+            dest = GcPtr<Object>::from_int(result);
+            return true;
+        }
+
+        if constexpr (OPERATION == RegOpcode::MOD) {
+            return false;
+        } else {
+            if (!left.is_immediate_float() or !right.is_immediate_float()) return false;
+
+            auto a = left.immediate_float();
+            auto b = right.immediate_float();
+            double result;
+            if constexpr (OPERATION == RegOpcode::ADD) {
+                result = a + b;
+            } else if constexpr (OPERATION == RegOpcode::SUB) {
+                result = a - b;
+            } else if constexpr (OPERATION == RegOpcode::MUL) {
+                result = a * b;
+            } else {
+                // a zero or nan divisor is left to the vm's error
+                if (!(b < 0 or b > 0)) return false;
+                result = a / b;
+            }
+            dest = GcPtr<Object>::from_float(result);
+            return true;
+        }
+    }
+
+    template<typename T>
+    static bool compare_values(RegOpcode compare, T a, T b) {
+        switch (compare) {
+            case RegOpcode::LT:
+            case RegOpcode::JUMP_IF_NOT_LT:
+                return a < b;
+            case RegOpcode::LE:
+            case RegOpcode::JUMP_IF_NOT_LE:
+                return a <= b;
+            case RegOpcode::GT:
+            case RegOpcode::JUMP_IF_NOT_GT:
+                return a > b;
+            case RegOpcode::GE:
+            case RegOpcode::JUMP_IF_NOT_GE:
+                return a >= b;
+            case RegOpcode::EQ:
+            case RegOpcode::JUMP_IF_NOT_EQ:
+                return a == b;
+            default:
+                return a != b;
+        }
+    }
+
+    // 1 or 0 for a comparison of two immediates of the same kind, -1 for anything else
+    static int32_t compare(RegOpcode opcode, const GcPtr<Object> &left, const GcPtr<Object> &right) {
+        if (left.is_immediate_int() and right.is_immediate_int()) {
+            return compare_values(opcode, left.immediate_int(), right.immediate_int());
+        }
+        if (left.is_immediate_float() and right.is_immediate_float()) {
+            return compare_values(opcode, left.immediate_float(), right.immediate_float());
+        }
+        return -1;
+    }
+
+    bool Vm::call_registers(const GcPtr<Function> &function, t_args args, const GcPtr<Object> *self) {
+        auto code = function->get_code()->get_register_code();
+        if (!code or m_register_depth >= REGISTER_MAX_DEPTH) return false;
+
+        check_argument_count(args.size() + (self ? 1 : 0), function->get_arguments());
+        if (m_stop) return true;
+
+        update_frame_pointer();
+        if (m_stop) return true;
+
+        auto frame = &m_frames[m_frame_pointer - 1];
+        auto size = code->get_frame_size();
+        reserve_locals(size);
+
+        auto base = m_locals_top;
+        auto registers = &m_locals[base];
+        m_locals_top += size;
+
+        size_t i = 0;
+        if (self) {
+            registers[i++] = *self;
+        }
+
+        for (auto &arg: args) {
+            registers[i++] = arg;
+        }
+
+        for (; i < code->get_register_count(); i++) {
+            registers[i].reset();
+        }
+
+        for (auto &constant: code->get_constants()) {
+            registers[i++] = constant;
+        }
+
+        frame->set_locals(registers, base);
+        reserve_stack(frame, code->get_stack_size() + STACK_SLACK);
+        frame->set_function(function);
+        frame->set_globals(function->get_globals());
+        frame->set_register_code(code);
+
+        auto caller = m_current_frame;
+        m_current_frame = frame;
+
+        m_register_depth++;
+        auto result = exec_registers(frame, *code);
+        m_register_depth--;
+
+        // the failed frame stays where it is for the traceback, like it does on the stack vm
+        if (m_stop) return true;
+
+        m_locals_top = base;
+        drop_frame_stack(frame);
+        frame->clear();
+        m_frame_pointer--;
+        m_current_frame = caller;
+        push(result);
+        process_events_if_needed();
+        return true;
+    }
+
+    GcPtr<Object> Vm::exec_registers(Frame *frame, const RegisterCode &code) {
+        auto begin = code.get_instructions().data();
+        auto ip = begin;
+        auto r = frame->get_locals();
+
+        // the frame's ip follows the instruction that may fail, so its span is the one reported
+#define SAVE_IP() frame->jump_absolute(ip - begin)
+        // anything that ran script code may have moved the registers or stopped the vm
+#define RELOAD() do { if (m_stop) return nullptr; r = frame->get_locals(); } while (0)
+#define ARITHMETIC(op) \
+            case RegOpcode::op: \
+                if (arithmetic<RegOpcode::op>(r[ins.a], r[ins.b], r[ins.c])) break; \
+                goto generic_binary;
+
+        for (;;) {
+            auto &ins = *ip++;
+
+            switch (ins.opcode) {
+                case RegOpcode::MOVE:
+                    r[ins.a] = r[ins.b];
+                    break;
+
+                case RegOpcode::LOAD_GLOBAL: {
+                    auto &globals = frame->get_globals();
+                    auto &cache = frame->get_global_cache(ins.b);
+
+                    if (cache.version != globals->get_version()) {
+                        auto &name = frame->get_constant(ins.b)->as<String>()->get_value_ref();
+                        auto slot = globals->find_slot(name);
+
+                        if (!slot.has_value()) {
+                            SAVE_IP();
+                            runtime_error(fmt::format("Global variable {} is not defined at this point", name),
+                                          RuntimeError::GenericError, frame->get_span());
+                            return nullptr;
+                        }
+
+                        cache = {globals->get_version(), slot.value()};
+                    }
+
+                    r[ins.a] = globals->get_slot(cache.slot);
+                    break;
+                }
+
+                case RegOpcode::STORE_GLOBAL: {
+                    auto &globals = frame->get_globals();
+                    auto &cache = frame->get_global_cache(ins.a);
+
+                    if (cache.version == globals->get_version()) {
+                        globals->set_slot(cache.slot, r[ins.b]);
+                        break;
+                    }
+
+                    auto &name = frame->get_constant(ins.a)->as<String>()->get_value_ref();
+                    cache = {globals->get_version(), globals->set(name, r[ins.b])};
+                    break;
+                }
+
+                ARITHMETIC(ADD)
+                ARITHMETIC(SUB)
+                ARITHMETIC(MUL)
+                ARITHMETIC(DIV)
+                ARITHMETIC(MOD)
+
+                case RegOpcode::LT:
+                case RegOpcode::LE:
+                case RegOpcode::GT:
+                case RegOpcode::GE:
+                case RegOpcode::EQ:
+                case RegOpcode::NE: {
+                    auto result = compare(ins.opcode, r[ins.b], r[ins.c]);
+                    if (result < 0) goto generic_binary;
+                    r[ins.a] = result ? m_True : m_False;
+                    break;
+                }
+
+                case RegOpcode::BIT_OR:
+                case RegOpcode::BIT_AND:
+                case RegOpcode::BIT_XOR: {
+                    auto &left = r[ins.b];
+                    auto &right = r[ins.c];
+                    if (!left.is_immediate_int() or !right.is_immediate_int()) goto generic_binary;
+
+                    auto a = left.immediate_int();
+                    auto b = right.immediate_int();
+                    auto result = ins.opcode == RegOpcode::BIT_OR ? a | b : ins.opcode == RegOpcode::BIT_AND ? a & b : a ^ b;
+                    r[ins.a] = GcPtr<Object>::from_int(result);
+                    break;
+                }
+
+                generic_binary: {
+                    SAVE_IP();
+                    auto value = binary_slot(generic_opcode(ins.opcode), r[ins.b], r[ins.c]);
+                    RELOAD();
+                    r[ins.a] = value;
+                    break;
+                }
+
+                case RegOpcode::OR: {
+                    auto left = r[ins.b];
+                    auto right = r[ins.c];
+                    auto truth = is_truthy(left);
+                    r = frame->get_locals();
+                    r[ins.a] = truth ? left : right;
+                    break;
+                }
+
+                case RegOpcode::AND: {
+                    auto left = r[ins.b];
+                    auto right = r[ins.c];
+                    auto truth = is_truthy(left);
+                    r = frame->get_locals();
+                    r[ins.a] = truth ? right : left;
+                    break;
+                }
+
+                case RegOpcode::NEG: {
+                    auto &value = r[ins.b];
+                    if (value.is_immediate_int()) {
+                        r[ins.a] = GcPtr<Object>::from_int((int64_t) (0 - (uint64_t) value.immediate_int()));
+                    } else if (value.is_immediate_float()) {
+                        r[ins.a] = GcPtr<Object>::from_float(-value.immediate_float());
+                    } else if (value->is<Int>()) {
+                        r[ins.a] = make_int(-value->as<Int>()->get_value());
+                    } else if (value->is<Float>()) {
+                        r[ins.a] = make_float(-value->as<Float>()->get_value());
+                    } else {
+                        SAVE_IP();
+                        runtime_error(fmt::format("unable to apply unary - to {}", value->str()),
+                                      RuntimeError::GenericError, frame->get_span());
+                        return nullptr;
+                    }
+                    break;
+                }
+
+                case RegOpcode::NOT: {
+                    auto truth = is_truthy(r[ins.b]);
+                    r = frame->get_locals();
+                    r[ins.a] = truth ? m_False : m_True;
+                    break;
+                }
+
+                case RegOpcode::JUMP:
+                    ip = begin + ins.a;
+                    break;
+
+                case RegOpcode::JUMP_IF_FALSE:
+                    if (!is_truthy(r[ins.a])) ip = begin + ins.b;
+                    r = frame->get_locals();
+                    break;
+
+                case RegOpcode::JUMP_IF_NOT_LT:
+                case RegOpcode::JUMP_IF_NOT_LE:
+                case RegOpcode::JUMP_IF_NOT_GT:
+                case RegOpcode::JUMP_IF_NOT_GE:
+                case RegOpcode::JUMP_IF_NOT_EQ:
+                case RegOpcode::JUMP_IF_NOT_NE: {
+                    auto result = compare(ins.opcode, r[ins.a], r[ins.b]);
+                    if (result < 0) {
+                        SAVE_IP();
+                        auto value = binary_slot(generic_opcode(ins.opcode), r[ins.a], r[ins.b]);
+                        RELOAD();
+                        result = is_truthy(value);
+                        r = frame->get_locals();
+                    }
+
+                    if (!result) ip = begin + ins.c;
+                    break;
+                }
+
+                case RegOpcode::CALL:
+                case RegOpcode::CALL_METHOD: {
+                    SAVE_IP();
+                    // a callee with register code reads its arguments straight from the registers,
+                    // which must not move while they are copied
+                    if (ins.opcode == RegOpcode::CALL and !r[ins.b].is_immediate() and r[ins.b]->is<Function>()) {
+                        auto function = r[ins.b]->as<Function>();
+                        if (auto callee = function->get_code()->get_register_code()) {
+                            reserve_locals(callee->get_frame_size());
+                            r = frame->get_locals();
+                            if (call_registers(function, t_args(r + ins.b + 1, ins.c))) {
+                                RELOAD();
+                                r[ins.a] = pop();
+                                break;
+                            }
+                        }
+                    }
+
+                    // the callee and its arguments are copied to a window on the operand stack,
+                    // for a method the name goes after the receiver like CALL_METHOD's
+                    auto base = m_stack_pointer + 1;
+                    push(r[ins.b]);
+                    if (ins.opcode == RegOpcode::CALL_METHOD) push(frame->get_constant(ip->b));
+                    auto args = m_stack_pointer + 1;
+                    for (uint32_t i = 1; i <= ins.c; i++) push(r[ins.b + i]);
+
+                    auto top = m_stack_pointer;
+                    auto depth = m_frame_pointer;
+                    if (ins.opcode == RegOpcode::CALL_METHOD) {
+                        call_method(frame->get_method_cache(ip->a), stack[base], stack[base + 1],
+                                    t_args(&stack[args], ins.c));
+                        ip++;
+                    } else {
+                        call_object(stack[base], t_args(&stack[args], ins.c));
+                    }
+
+                    if (m_frame_pointer > depth) {
+                        // a callee on the stack vm, its RETURN leaves the result at base
+                        if (m_stop) return nullptr;
+                        m_current_frame->set_return_base(base);
+                        exec(m_frame_pointer);
+                    } else {
+                        drop_call(base, top);
+                    }
+
+                    RELOAD();
+                    r[ins.a] = pop();
+                    break;
+                }
+
+                case RegOpcode::GET_ATTR: {
+                    SAVE_IP();
+                    auto object = r[ins.b];
+                    get_attribute(object, frame->get_constant(ins.c));
+                    RELOAD();
+                    r[ins.a] = pop();
+                    break;
+                }
+
+                case RegOpcode::SET_ATTR: {
+                    SAVE_IP();
+                    auto object = r[ins.a];
+                    set_attribute(object, frame->get_constant(ins.b), r[ins.c]);
+                    RELOAD();
+                    pop();
+                    break;
+                }
+
+                case RegOpcode::GET_ITEM: {
+                    SAVE_IP();
+                    auto object = r[ins.b];
+                    get_item(object, r[ins.c]);
+                    RELOAD();
+                    r[ins.a] = pop();
+                    break;
+                }
+
+                case RegOpcode::SET_ITEM: {
+                    SAVE_IP();
+                    auto object = r[ins.a];
+                    set_item(object, r[ins.b], r[ins.c]);
+                    RELOAD();
+                    pop();
+                    break;
+                }
+
+                case RegOpcode::BUILD_LIST:
+                    r[ins.a] = Runtime::ins()->make_list(t_vector(r + ins.b, r + ins.b + ins.c));
+                    break;
+
+                case RegOpcode::BUILD_DICT: {
+                    auto dict = Runtime::ins()->HASHMAP_STRUCT->create_instance<HashMap>();
+
+                    // set from the last pair like the stack vm, which pops them
+                    for (auto i = ins.c; i > 0; i--) {
+                        auto pair = ins.b + (i - 1) * 2;
+                        auto res = dict->set(r[pair], r[pair + 1]);
+
+                        if (!res.has_value()) {
+                            SAVE_IP();
+                            runtime_error(fmt::format("unable to build dict\n  {}", res.error()));
+                            return nullptr;
+                        }
+                        r = frame->get_locals();
+                    }
+                    r[ins.a] = dict;
+                    break;
+                }
+
+                case RegOpcode::ITER: {
+                    SAVE_IP();
+                    auto iterable = r[ins.b];
+                    get_iterator(iterable);
+                    RELOAD();
+                    r[ins.a] = pop();
+                    break;
+                }
+
+                case RegOpcode::FOR_ITER: {
+                    auto iterator = r[ins.b];
+                    GcPtr<Object> next;
+                    auto step = iterator->as<NativeInstance>()->iter_next(next);
+                    if (step == NativeInstance::IterStep::Generic) {
+                        SAVE_IP();
+                        step = iterate_slots(iterator, next);
+                        RELOAD();
+                    }
+
+                    if (step == NativeInstance::IterStep::Done) {
+                        ip = begin + ins.c;
+                        break;
+                    }
+
+                    r[ins.a] = next;
+                    break;
+                }
+
+                case RegOpcode::MAKE_OK:
+                    r[ins.a] = make_result(r[ins.b], false);
+                    break;
+
+                case RegOpcode::MAKE_ERROR:
+                    r[ins.a] = make_result(r[ins.b], true);
+                    break;
+
+                case RegOpcode::TRY: {
+                    auto &value = r[ins.b];
+                    if (!value.is_immediate() and value->is<Result>()) {
+                        auto result = value->as<Result>();
+                        if (result->has_error()) return value;
+                        r[ins.a] = result->get_value();
+                        break;
+                    }
+
+                    SAVE_IP();
+                    runtime_error("try statement expects a Result", RuntimeError::GenericError, frame->get_span());
+                    return nullptr;
+                }
+
+                case RegOpcode::DISCARD: {
+                    auto &value = r[ins.a];
+                    if (!value.is_immediate() and value->is<Result>()) {
+                        SAVE_IP();
+                        runtime_error(fmt::format("result must be handled: {}", value->str()),
+                                      RuntimeError::GenericError, frame->get_span());
+                        return nullptr;
+                    }
+                    break;
+                }
+
+                case RegOpcode::RETURN:
+                    return r[ins.a];
+
+                case RegOpcode::EXTRA:
+                    break;
+            }
+        }
+
+#undef ARITHMETIC
+#undef RELOAD
+#undef SAVE_IP
+    }
+}
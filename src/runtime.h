@@ -21,7 +21,6 @@ namespace bond {
     std::string get_exe_path();
 
     class Runtime {
-        GcPtr<Int> int_cache[256];
         std::unordered_map<t_string, GcPtr<String>> string_cache;
         std::vector<GcPtr<Object>> m_immortals;
         std::vector<std::function<void()>> m_exit_callbacks;
@@ -60,14 +59,9 @@ namespace bond {
             }
         }
 
-        void init_caches() {
-            for (int i = 0; i < 256; i++) {
-                int_cache[i] = INT_STRUCT->create_immortal<Int>(i);
-            }
-        }
-
         void set_runtime(Runtime *runtime_ptr) {
             CLOSURE_STRUCT = runtime_ptr->CLOSURE_STRUCT;
+            CELL_STRUCT = runtime_ptr->CELL_STRUCT;
             RESULT_STRUCT = runtime_ptr->RESULT_STRUCT;
             FLOAT_STRUCT = runtime_ptr->FLOAT_STRUCT;
             INT_STRUCT = runtime_ptr->INT_STRUCT;
@@ -93,8 +87,6 @@ namespace bond {
             C_NONE_RESULT = runtime_ptr->C_NONE_RESULT;
             C_NONE_FUTURE = runtime_ptr->C_NONE_FUTURE;
             C_NONE_RESULT_FUTURE = runtime_ptr->C_NONE_RESULT_FUTURE;
-
-            init_caches();
         }
 
         void init() {
@@ -115,8 +107,6 @@ namespace bond {
             init_hash_map();
             init_future();
 
-            ins()->init_caches();
-
             C_NONE_RESULT = make_result(C_NONE, false);
             C_NONE_RESULT_FUTURE = make_future();
             C_NONE_RESULT_FUTURE->set_value(C_NONE_RESULT);
@@ -125,6 +115,7 @@ namespace bond {
         }
 
         GcPtr<NativeStruct> CLOSURE_STRUCT;
+        GcPtr<NativeStruct> CELL_STRUCT;
         GcPtr<NativeStruct> RESULT_STRUCT;
         GcPtr<NativeStruct> FLOAT_STRUCT;
         GcPtr<NativeStruct> INT_STRUCT;
@@ -152,29 +143,28 @@ namespace bond {
         GcPtr<Future> C_NONE_RESULT_FUTURE;
 
         // create functions
-        [[nodiscard]] GcPtr<Closure> make_closure(const GcPtr<Function>& function, const GcPtr<StringMap>& up_values) const {
+        [[nodiscard]] GcPtr<Closure> make_closure(const GcPtr<Function>& function, const t_vector& up_values) const {
             return CLOSURE_STRUCT->create_instance<Closure>(function, up_values);
         }
 
+        [[nodiscard]] GcPtr<Cell> make_cell(const GcPtr<Object>& value) const {
+            return CELL_STRUCT->create_instance<Cell>(value);
+        }
+
         [[nodiscard]] GcPtr<Result> make_result(const GcPtr<Object>& value, bool is_error) const {
             return RESULT_STRUCT->create_instance<Result>(value, is_error);
         }
 
-        [[nodiscard]] GcPtr<Float> make_float(double value) const {
-            return FLOAT_STRUCT->create_instance<Float>(value);
+        [[nodiscard]] static GcPtr<Float> make_float(double value) {
+            return GcPtr<Float>::from_float(value);
         }
 
         [[nodiscard]] GcPtr<List> make_list(const t_vector &values) const {
             return LIST_STRUCT->create_instance<List>(values);
         }
 
-        GcPtr<Int> make_int(int64_t value) {
-            if (value > -1 and value < 256) {
-                auto val = int_cache[value];
-                return val;
-            }
-
-            return INT_STRUCT->create_instance<Int>(value);
+        [[nodiscard]] static GcPtr<Int> make_int(int64_t value) {
+            return GcPtr<Int>::from_int(value);
         }
 
         [[nodiscard]] GcPtr<String> make_string(const t_string& value) const {
@@ -228,8 +218,10 @@ namespace bond {
         }
 
 
-        GcPtr <Instance> make_instance(Struct *pStruct, const t_map &map) const {
-            return INSTANCE_STRUCT->create_instance<Instance>(pStruct, map);
+        GcPtr <Instance> make_instance(Struct *pStruct, t_args values) const {
+            auto instance = Instance::allocate(pStruct, values);
+            instance->set_native_struct(INSTANCE_STRUCT.get());
+            return instance;
         }
 
         template<typename... Args>
@@ -30,14 +30,17 @@ namespace bond {
     template<typename Integer>
     struct bond_traits<Integer, std::enable_if_t<std::is_integral_v<Integer> && sizeof(Integer) <= sizeof(int64_t)>> {
         static Integer unwrap(const GcPtr<Object> &object) {
+            if (object.is_immediate_int()) return static_cast<Integer>(object.immediate_int());
             return object->as<Int>()->get_value();
         }
 
         static GcPtr<Int> wrap(const Integer &object) {
-            return make_int(object);
+            return GcPtr<Int>::from_int(static_cast<int64_t>(object));
         }
 
-        static bool can_unwrap(const GcPtr<Object> &object) { return object->is<Int>(); }
+        static bool can_unwrap(const GcPtr<Object> &object) {
+            return object.is_immediate_int() or (!object.is_immediate() and object->is<Int>());
+        }
 
         using type = Int;
     };
@@ -53,7 +56,9 @@ namespace bond {
             return AS_BOOL(object);
         }
 
-        static bool can_unwrap(const GcPtr<Object> &object) { return object->is<Bool>(); }
+        static bool can_unwrap(const GcPtr<Object> &object) {
+            return !object.is_immediate() and object->is<Bool>();
+        }
 
         using type = bool;
     };
@@ -61,14 +66,17 @@ namespace bond {
     template<>
     struct bond_traits<double> {
         static double unwrap(const GcPtr<Object> &object) {
+            if (object.is_immediate_float()) return object.immediate_float();
             return object->as<Float>()->get_value();
         }
 
         static GcPtr<Float> wrap(const double &object) {
-            return make_float(object);
+            return GcPtr<Float>::from_float(object);
         }
 
-        static bool can_unwrap(const GcPtr<Object> &object) { return object->is<Float>(); }
+        static bool can_unwrap(const GcPtr<Object> &object) {
+            return object.is_immediate_float() or (!object.is_immediate() and object->is<Float>());
+        }
 
         using type = Float;
     };
@@ -76,14 +84,17 @@ namespace bond {
     template<>
     struct bond_traits<float> {
         static double unwrap(const GcPtr<Object> &object) {
+            if (object.is_immediate_float()) return object.immediate_float();
             return object->as<Float>()->get_value();
         }
 
         static GcPtr<Object> wrap(const double &object) {
-            return make_float(object);
+            return GcPtr<Float>::from_float(object);
         }
 
-        static bool can_unwrap(const GcPtr<Object> &object) { return object->is<Float>(); }
+        static bool can_unwrap(const GcPtr<Object> &object) {
+            return object.is_immediate_float() or (!object.is_immediate() and object->is<Float>());
+        }
 
         using type = Float;
     };
@@ -243,7 +254,7 @@ namespace bond {
             return wrap_impl;
         }
 
-        static return_type wrap_impl(const t_vector &args) {
+        static return_type wrap_impl(t_args args) {
             if (args.size() != sizeof...(Args)) {
                 return ERR("Expected " + std::to_string(sizeof...(Args)) + " arguments, got " +
                            std::to_string(args.size()));
@@ -257,7 +268,7 @@ namespace bond {
         }
 
         template <typename... InvokeArgs>
-        static return_type invoke_and_wrap_void(const t_vector &args) {
+        static return_type invoke_and_wrap_void(t_args args) {
             size_t i = sizeof ...(InvokeArgs) - 1;
             try {
                 F(do_unwrap<InvokeArgs>(args[i], i)...);
@@ -271,7 +282,7 @@ namespace bond {
         }
 
         template <typename Ret, typename... InvokeArgs>
-        static return_type invoke_and_wrap(const t_vector &args) {
+        static return_type invoke_and_wrap(t_args args) {
             size_t i = sizeof ...(InvokeArgs) - 1;
             try {
                 return bond_traits<Ret>::wrap(F(do_unwrap<InvokeArgs>(args[i], i)...));
@@ -372,16 +383,25 @@ namespace bond {
         GcPtr<StringMap> m_exports = Runtime::ins()->make_string_map();
         std::vector<std::shared_ptr<StructBuilder>> m_structs;
         t_string m_path;
+        std::optional<t_string> m_error;
 
     public:
         explicit Mod(t_string path) : m_path(std::move(path)) {}
 
+        [[nodiscard]] const t_string &get_path() const { return m_path; }
+
+        // a bond_module_init that could not set the module up says why here, the import then
+        // fails with it
+        void set_error(t_string error) { m_error = std::move(error); }
+
+        [[nodiscard]] const std::optional<t_string> &get_error() const { return m_error; }
+
         GcPtr<Module> build() {
             for (auto &builder: m_structs) {
                 auto struct_ = make<NativeStruct>(builder->m_name, builder->m_doc, builder->m_constructor,
                                                   builder->m_methods, builder->m_fields);
                 auto constructor = builder->m_constructor;
-                auto wrapper = [constructor, struct_](const t_vector &args) -> obj_result {
+                auto wrapper = [constructor, struct_](t_args args) -> obj_result {
                     auto res = constructor(args);
                     if (!res.has_value()) {
                         return res;
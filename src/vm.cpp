@@ -7,6 +7,8 @@
 #include "import.h"
 #include "object.h"
 
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
 
 namespace bond {
@@ -26,16 +28,15 @@ namespace bond {
 
         func->set_globals(m_globals);
         push(func);
-        call_function(func, t_vector());
+        call_function(func, t_args());
         exec();
         process_events_if_needed();
     }
 
     void Vm::update_frame_pointer() {
-        m_frame_pointer++;
-
-        if (m_frame_pointer >= FRAME_MAX) {
-            const char *stack_overflow_error = "stack overflow";
+        if (m_frame_pointer >= m_max_depth) {
+            auto stack_overflow_error = fmt::format("stack overflow, more than {} frames are active",
+                                                    m_max_depth);
             if (m_current_frame != nullptr) {
                 runtime_error(stack_overflow_error, RuntimeError::GenericError,
                               m_current_frame->get_span());
@@ -44,12 +45,219 @@ namespace bond {
             }
             return;
         }
+
+        if (m_frame_pointer == m_frames.size()) {
+            m_frames.emplace_back();
+        }
+        m_frame_pointer++;
+    }
+
+    void Vm::init_stack() {
+        m_stack_segments.emplace_back(STACK_SEGMENT_SIZE);
+        use_stack_segment(0);
+    }
+
+    void Vm::init_jit() {
+        m_aot = m_ctx->get_aot();
+        m_registers = m_ctx->get_register_vm();
+        if (!Jit::is_supported()) return;
+        if (m_ctx->get_jit()) m_jit = &Jit::instance();
+        m_trace = m_ctx->get_trace();
+        m_jit_threshold = m_ctx->get_jit_threshold();
+    }
+
+    // native code leaves at instructions it does not run itself, those go back to exec
+    static bool is_jit_exit(const GcPtr<Code> &code, size_t ip) {
+        if (ip >= code->get_code_size()) return true;
+        auto opcode = static_cast<Opcode>(code->get_opcodes()[ip]);
+        return opcode == Opcode::RETURN or opcode == Opcode::IMPORT or opcode == Opcode::IMPORT_PRE_COMPILED;
+    }
+
+    void Vm::run_jit() {
+        while (!m_stop) {
+            auto &code = m_current_frame->get_code();
+            auto entry_ip = (uint32_t) m_current_frame->get_ip();
+            JitState state{stack, m_current_frame->get_locals(), m_stack_pointer, this};
+            uint32_t ip;
+
+            // code compiled ahead of time is preferred, it never has to be compiled here
+            auto aot = m_aot ? code->get_aot_function() : nullptr;
+            if (aot) {
+                ip = aot(&state, entry_ip);
+            } else {
+                auto native = m_jit ? m_jit->get(code.get(), m_jit_threshold) : nullptr;
+                auto entry = native ? native->entry(entry_ip) : nullptr;
+                if (!entry) return;
+
+                ip = native->run(&state, entry);
+            }
+            if (ip == JIT_EXIT) continue;
+
+            m_stack_pointer = (int) state.top;
+            m_current_frame->jump_absolute(ip);
+            // native code compiled ahead of time hands back where it was entered when it has
+            // nothing to run there
+            if (is_jit_exit(code, ip) or (aot and ip == entry_ip)) return;
+        }
+    }
+
+    void Vm::run_trace() {
+        auto code = m_current_frame->get_code();
+        auto header = (uint32_t) m_current_frame->get_ip();
+        auto native = code->get_loop_trace(header).native;
+
+        if (!native) {
+            auto &loop = code->get_loop_trace(header);
+            if (loop.failures >= TRACE_MAX_ATTEMPTS or loop.count++ < m_jit_threshold) return;
+
+            auto steps = record_trace(header);
+            // recording runs the loop, which may have run other loops of this code and moved
+            // the entry
+            auto &recorded = code->get_loop_trace(header);
+            recorded.native = Jit::instance().compile_trace(code.get(), steps);
+            if (!recorded.native) {
+                recorded.failures++;
+                recorded.count = 0;
+                return;
+            }
+            native = recorded.native;
+        }
+
+        JitState state{stack, m_current_frame->get_locals(), m_stack_pointer, this};
+        auto ip = native->run(&state, native->entry(header));
+        if (ip == JIT_EXIT) return;
+
+        m_stack_pointer = (int) state.top;
+        m_current_frame->jump_absolute(ip);
+    }
+
+    std::vector<TraceStep> Vm::record_trace(uint32_t header) {
+        std::vector<TraceStep> steps;
+        auto frame = m_current_frame;
+        auto code = frame->get_code();
+        auto depth = m_frame_pointer;
+        auto base = m_stack_pointer;
+        auto &bytes = code->get_opcodes();
+
+        auto tag_at = [&](int index) -> uint8_t {
+            if (index < 0 or !stack[index].is_immediate()) return 0;
+            return stack[index].is_immediate_int() ? IMMEDIATE_INT_TAG : IMMEDIATE_FLOAT_TAG;
+        };
+
+        do {
+            auto ip = (uint32_t) frame->get_ip();
+            auto opcode = static_cast<Opcode>(bytes[ip]);
+            if (steps.size() == TRACE_MAX_LENGTH or m_stack_pointer < base or opcode == Opcode::RETURN or
+                opcode == Opcode::IMPORT or opcode == Opcode::IMPORT_PRE_COMPILED) {
+                return {};
+            }
+
+            TraceStep step{ip, opcode, {0, 0}, tag_at(m_stack_pointer), tag_at(m_stack_pointer - 1),
+                           m_stack_pointer - base, 0};
+            size_t offset = ip + 1;
+            for (uint32_t i = 0; i < oprand_count(opcode); i++) {
+                step.oprands[i] = read_oprand(opcode, i, bytes.data(), offset);
+            }
+
+            exec<true>();
+            // a specialised instruction that deopts rewinds to run its generic form
+            if (!m_stop and m_current_frame == frame and frame->get_ip() == ip and bytes[ip] != (uint8_t) opcode) {
+                exec<true>();
+            }
+
+            if (m_stop or m_frame_pointer != depth or m_current_frame != frame or
+                frame->get_code().get() != code.get()) {
+                return {};
+            }
+
+            step.next = (uint32_t) frame->get_ip();
+            steps.push_back(step);
+        } while (steps.back().next != header);
+
+        return steps;
+    }
+
+    uint32_t Vm::jit_step(JitState *state, uint32_t ip) {
+        m_stack_pointer = (int) state->top;
+        m_current_frame->jump_absolute(ip);
+
+        auto frame = m_current_frame;
+        auto code = frame->get_code().get();
+        auto depth = m_frame_pointer;
+        auto opcode = code->get_opcodes()[ip];
+
+        exec<true>();
+        // a specialised instruction that deopts rewinds to run its generic form
+        if (!m_stop and m_current_frame == frame and frame->get_ip() == ip and code->get_opcodes()[ip] != opcode) {
+            exec<true>();
+        }
+
+        if (m_stop or m_frame_pointer != depth or m_current_frame != frame or frame->get_code().get() != code) {
+            return JIT_EXIT;
+        }
+
+        state->stack = stack;
+        state->locals = frame->get_locals();
+        state->top = m_stack_pointer;
+        return (uint32_t) frame->get_ip();
+    }
+
+    void Vm::use_stack_segment(size_t segment) {
+        m_stack_segment = segment;
+        stack = m_stack_segments[segment].data();
+        m_stack_limit = (int) m_stack_segments[segment].size();
+    }
+
+    void Vm::reserve_stack(Frame *frame, size_t count) {
+        frame->set_caller_stack(m_stack_segment, m_stack_pointer);
+        if (m_stack_pointer + 1 + (int) count <= m_stack_limit) return;
+
+        // the frame does not fit above its caller, it starts at the bottom of the next segment.
+        // segments above the current one are unused, so resizing one moves nothing in use
+        auto next = m_stack_segment + 1;
+        if (next == m_stack_segments.size()) {
+            m_stack_segments.emplace_back(std::max<size_t>(STACK_SEGMENT_SIZE, count));
+        } else if (m_stack_segments[next].size() < count) {
+            m_stack_segments[next].resize(count);
+        }
+
+        use_stack_segment(next);
+        m_stack_pointer = -1;
     }
 
-    void Vm::check_argument_count(const t_vector &args, const VectorArgs &params) {
-        if (args.size() != params.size()) {
+    void Vm::drop_frame_stack(Frame *frame) {
+        auto top = frame->get_caller_top();
+        if (frame->get_caller_segment() != m_stack_segment) {
+            for (int i = 0; i <= m_stack_pointer; i++) {
+                stack[i].reset();
+            }
+
+            use_stack_segment(frame->get_caller_segment());
+        } else {
+            for (int i = top + 1; i <= m_stack_pointer; i++) {
+                stack[i].reset();
+            }
+        }
+
+        m_stack_pointer = top;
+    }
+
+    void Vm::return_stack(Frame *frame, GcPtr<Object> result) {
+        drop_frame_stack(frame);
+
+        auto base = frame->get_return_base();
+        for (int i = base; i <= m_stack_pointer; i++) {
+            stack[i].reset();
+        }
+
+        m_stack_pointer = base - 1;
+        push(result);
+    }
+
+    void Vm::check_argument_count(size_t count, const VectorArgs &params) {
+        if (count != params.size()) {
             auto error_message = fmt::format("expected {} arguments, got {}",
-                                             params.size(), args.size());
+                                             params.size(), count);
             if (m_current_frame != nullptr) {
                 runtime_error(error_message, RuntimeError::GenericError,
                               m_current_frame->get_span());
@@ -61,42 +269,124 @@ namespace bond {
         }
     }
 
-    void Vm::set_local_arguments(Frame *frame, const t_vector &args,
-                                 const VectorArgs &params,
-                                 const GcPtr<StringMap> &locals) {
-        auto local_args = Runtime::ins()->make_string_map();
+    void Vm::reserve_locals(size_t count) {
+        if (m_locals_top + count <= m_locals.size()) return;
+
+        m_locals.resize(std::max(m_locals.size() * 2, m_locals_top + count));
+
+        // the array moved, point the active frames at their new slots
+        for (size_t i = 0; i < m_frame_pointer; i++) {
+            auto base = m_frames[i].get_locals_base();
+            m_frames[i].set_locals(&m_locals[base], base);
+        }
+    }
+
+    void Vm::set_local_arguments(Frame *frame, const GcPtr<Code> &code, t_args args,
+                                 const t_vector *up_values, const GcPtr<Object> *self) {
+        auto count = code->get_local_count();
+        reserve_locals(count);
+
+        auto base = m_locals_top;
+        auto locals = &m_locals[base];
+        m_locals_top += count;
+
+        // arguments always take the first slots, the receiver of a bound call
+        // goes before them. they are copied straight from the caller's stack.
+        size_t i = 0;
+        if (self) {
+            locals[i++] = *self;
+        }
+
+        for (auto &arg: args) {
+            locals[i++] = arg;
+        }
 
-        for (size_t i = 0; i < args.size(); i++) {
-            local_args->set(params[i]->name, args[i]);
+        for (; i < count; i++) {
+            locals[i].reset();
         }
 
-        if (locals) {
-            for (auto &[name, obj]: locals->get_value()) {
-                local_args->set(name, obj);
+        if (up_values) {
+            auto &captures = code->get_captures();
+            for (size_t j = 0; j < captures.size(); j++) {
+                locals[captures[j].to] = (*up_values)[j];
             }
         }
 
-        frame->set_locals(local_args);
+        frame->set_locals(locals, base);
     }
 
-    void Vm::call_function(const GcPtr<Function> &function, const t_vector &args,
-                           const GcPtr<StringMap> &locals) {
-        auto frame = &m_frames[m_frame_pointer];
+    Cell *Vm::get_cell(uint32_t slot) {
+        // compiled code only reads cells from slots it put one in, archives are not as careful
+        auto &local = m_current_frame->get_local(slot);
+        if (local and !local.is_immediate() and local->is<Cell>()) [[likely]] {
+            return static_cast<Cell *>(local.get());
+        }
+
+        runtime_error(fmt::format("captured variable {} is not bound", m_current_frame->get_code()->get_locals()[slot]),
+                      RuntimeError::GenericError, m_current_frame->get_span());
+        return nullptr;
+    }
+
+    // code made by the compiler is verified on its first call, archives are verified as they
+    // are loaded, see Import::import_archive
+    bool Vm::verify_code(const GcPtr<Function> &function) {
+        auto verified = function->get_code()->verify();
+        if (!verified) {
+            runtime_error(fmt::format("invalid bytecode in {}, {}", function->get_name(), verified.error()));
+            return false;
+        }
+        return true;
+    }
+
+    void Vm::call_function(const GcPtr<Function> &function, t_args args,
+                           const t_vector *up_values, const GcPtr<Object> *self) {
+        auto &params = function->get_arguments();
+        check_argument_count(args.size() + (self ? 1 : 0), params);
+
+        if (m_stop or !verify_code(function)) {
+            return;
+        }
+
         update_frame_pointer();
-        auto params = function->get_arguments();
-        check_argument_count(args, params);
 
         if (m_stop) {
             return;
         }
 
-        set_local_arguments(frame, args, params, locals);
+        auto frame = &m_frames[m_frame_pointer - 1];
+        auto code = function->get_code();
+        set_local_arguments(frame, code, args, up_values, self);
+        reserve_stack(frame, code->get_max_stack() + STACK_SLACK);
         frame->set_function(function);
         frame->set_globals(function->get_globals());
         m_current_frame = frame;
     }
 
 
+    void Vm::tail_call_function(const GcPtr<Function> &function, t_args args, const t_vector *up_values) {
+        check_argument_count(args.size(), function->get_arguments());
+
+        if (m_stop or !verify_code(function)) {
+            return;
+        }
+
+        auto frame = m_current_frame;
+        auto code = function->get_code();
+
+        // the arguments sit on this frame's operand stack, they are copied over its locals
+        // before the stack is dropped
+        m_locals_top = frame->get_locals_base();
+        set_local_arguments(frame, code, args, up_values, nullptr);
+
+        auto return_base = frame->get_return_base();
+        drop_frame_stack(frame);
+        reserve_stack(frame, code->get_max_stack() + STACK_SLACK);
+        frame->set_return_base(return_base);
+
+        frame->set_function(function);
+        frame->set_globals(function->get_globals());
+    }
+
     GcPtr<Object> Vm::call_function_ex(const GcPtr<Function> &function, const t_vector &args) {
         std::lock_guard<std::mutex> lock(m_func_ex_lock);
 
@@ -105,6 +395,10 @@ namespace bond {
         }
 
         m_stop = false;
+        if (m_registers and call_registers(function, args)) {
+            return pop();
+        }
+
         call_function(function, args);
         auto pre_stop_frame = m_stop_frame;
         m_stop_frame = m_frame_pointer;
@@ -115,8 +409,8 @@ namespace bond {
     }
 
     void Vm::setup_bound_call(const GcPtr<Object> &instance,
-                              const GcPtr<Function> &function, t_vector &args) {
-        auto params = function->get_arguments();
+                              const GcPtr<Function> &function, t_args args) {
+        auto &params = function->get_arguments();
         if (params.size() - 1 != args.size()) {
             runtime_error(fmt::format("fn {} expected {} arguments, got {}",
                                       function->get_name(), params.size() - 1, args.size()),
@@ -124,12 +418,11 @@ namespace bond {
             return;
         }
 
-        args.insert(args.begin(), instance);
-        call_function(function, args);
+        call_function(function, args, nullptr, &instance);
     }
 
     void Vm::call_bound_method(const GcPtr<BoundMethod> &bound_method,
-                               t_vector &args) {
+                               t_args args) {
         auto method = bound_method->get_method()->as<Function>();
         setup_bound_call(bound_method->get_instance(), method, args);
     }
@@ -148,22 +441,16 @@ namespace bond {
  * \param args Vector of arguments.
  */
 
-    void Vm::create_instance(const GcPtr<Struct> &_struct, const t_vector &args) {
-        auto variables = _struct->get_fields();
-        if (variables.size() != args.size()) {
-            runtime_error(fmt::format("expected {} arguments, got {}", variables.size(),
+    void Vm::create_instance(const GcPtr<Struct> &_struct, t_args args) {
+        auto field_count = _struct->get_fields().size();
+        if (field_count != args.size()) {
+            runtime_error(fmt::format("expected {} arguments, got {}", field_count,
                                       args.size()),
                           RuntimeError::GenericError, m_current_frame->get_span());
             return;
         }
 
-        t_map fields;
-
-        for (size_t i = 0; i < args.size(); i++) {
-            fields[variables[i]] = args[i];
-        }
-
-        push(_struct->create_instance(fields));
+        push(_struct->create_instance(args));
     }
 
     void Vm::runtime_error(const t_string &error, RuntimeError e,
@@ -191,7 +478,14 @@ namespace bond {
         m_has_error = true;
         push(make_string(err));
 
+        // runaway recursion leaves a huge number of frames, only the ones at either end are shown
+        constexpr size_t TRACEBACK_EDGE = 16;
         for (size_t i = 0; i < m_frame_pointer; i++) {
+            if (i == TRACEBACK_EDGE and m_frame_pointer > TRACEBACK_EDGE * 2) {
+                fmt::print("  ... {} frames not shown\n", m_frame_pointer - TRACEBACK_EDGE * 2);
+                i = m_frame_pointer - TRACEBACK_EDGE;
+            }
+
             if (m_frames[i].get_function().get() == nullptr)
                 continue;
             m_ctx->error(m_frames[i].get_span(), "");
@@ -302,8 +596,428 @@ namespace bond {
  * @see Vm::call_slot()
  */
 
+    void Vm::specialize(Opcode int_form, Opcode float_form) {
+        auto right = peek();
+        auto left = peek(1);
+
+        if (left.is_immediate_int() and right.is_immediate_int()) {
+            m_current_frame->quicken(int_form);
+        } else if (left.is_immediate_float() and right.is_immediate_float()) {
+            m_current_frame->quicken(float_form);
+        }
+    }
+
+    // type checks that answer for immediates from their tag instead of boxing them
+    static bool is_int(const GcPtr<Object> &value) {
+        return value.is_immediate() ? value.is_immediate_int() : value->is<Int>();
+    }
+
+    static bool is_float(const GcPtr<Object> &value) {
+        return value.is_immediate() ? value.is_immediate_float() : value->is<Float>();
+    }
+
+    static int64_t int_value(const GcPtr<Object> &value) {
+        return value.is_immediate() ? value.immediate_int() : value->as<Int>()->get_value();
+    }
+
+    static bool is_instance(const GcPtr<Object> &value) {
+        return !value.is_immediate() and value->is<Instance>();
+    }
+
+    // immediates are ints and floats, both native
+    static bool is_native(const GcPtr<Object> &value) {
+        return value.is_immediate() or value->is<NativeInstance>();
+    }
+
+    // key of a receiver in a MethodCache, nullptr for receivers whose methods can not be cached
+    static const void *method_receiver(const GcPtr<Object> &obj, bool &is_static) {
+        is_static = false;
+        if (obj.is_immediate()) {
+            auto runtime = Runtime::ins();
+            return obj.is_immediate_int() ? runtime->INT_STRUCT.get() : runtime->FLOAT_STRUCT.get();
+        }
+        if (obj->is<Instance>()) return static_cast<Instance *>(obj.get())->get_struct();
+        if (obj->is<Struct>()) {
+            is_static = true;
+            return obj.get();
+        }
+        if (obj->is<Module>()) return nullptr;
+        if (obj->is<NativeInstance>()) return static_cast<NativeInstance *>(obj.get())->get_native_struct();
+        return nullptr;
+    }
+
+    bool Vm::call_cached_method(const MethodCache &cache, const GcPtr<Object> &obj, const GcPtr<Object> &name,
+                                t_args args) {
+        if (cache.count == 0) return false;
+
+        bool is_static;
+        auto receiver = method_receiver(obj, is_static);
+
+        for (uint32_t i = 0; i < cache.count; i++) {
+            auto &entry = cache.entries[i];
+            if (entry.receiver != receiver or entry.is_static != is_static) continue;
+
+            if (entry.native) {
+                auto res = (*entry.native)(obj, args);
+                if (!res.has_value()) {
+                    runtime_error(fmt::format("unable to call method {}\n  {}", name->str(), res.error()));
+                    return true;
+                }
+                push(res.value());
+            } else if (is_static) {
+                call_function(entry.function, args);
+            } else {
+                call_bound_function(obj, entry.function, args);
+            }
+            return true;
+        }
+
+        return false;
+    }
+
+    void Vm::cache_method(MethodCache &cache, const GcPtr<Object> &obj, const NativeMethodPtr *native,
+                          const GcPtr<Function> &function) {
+        if (cache.count == MethodCache::SIZE) return;
+
+        bool is_static;
+        auto receiver = method_receiver(obj, is_static);
+        if (receiver == nullptr) return;
+
+        cache.entries[cache.count++] = {receiver, is_static, native, function};
+    }
+
+    void Vm::call_method(MethodCache &cache, const GcPtr<Object> &obj, const GcPtr<Object> &method_name,
+                         t_args args) {
+        if (call_cached_method(cache, obj, method_name, args)) {
+            return;
+        }
+
+        auto &name = method_name->as<String>()->get_value_ref();
+
+        if (!obj->is<NativeInstance>()) {
+            runtime_error(
+                    fmt::format("method {} of {} does not exist", name, obj->str()),
+                    RuntimeError::GenericError, m_current_frame->get_span());
+            return;
+        }
+
+        auto o = obj->as<NativeInstance>();
+        if (auto native = o->get_native_struct()->find_method(name)) {
+            cache_method(cache, obj, native, nullptr);
+            auto res = (*native)(obj, args);
+
+            if (!res.has_value()) {
+                runtime_error(
+                        fmt::format("unable to call method {}\n  {}", name, res.error()));
+                return;
+            }
+            push(res.value());
+            return;
+        }
+
+        if (is_instance(obj)) {
+            auto o = obj->as<Instance>();
+            auto meth = o->get_method(name);
+
+            if (!meth.has_value()) {
+                auto attr = call_slot(Slot::GET_ATTR, obj, {make_string(name)});
+
+                if (attr.has_value()) {
+                    call_object(attr.value(), args);
+                    return;
+                }
+
+                runtime_error(fmt::format("attribute {} is not callable \n  {}", name,
+                                          meth.error()));
+                return;
+            }
+
+            auto function = meth.value()->as<Function>();
+            cache_method(cache, obj, nullptr, function);
+            call_bound_function(obj, function, args);
+            return;
+        } else if (obj->is<Struct>()) {
+            auto o = obj->as<Struct>();
+            auto meth = o->get_method(name);
+
+            if (!meth.has_value()) {
+                runtime_error(
+                        fmt::format("static method {} does not exist in struct {}", name,
+                                    o->get_name()));
+                return;
+            }
+            cache_method(cache, obj, nullptr, meth.value());
+            call_function(meth.value(), args);
+            return;
+        } else if (obj->is<Module>()) {
+            auto o = obj->as<Module>();
+            auto meth = o->get_attribute(name);
+
+            if (!meth.has_value()) {
+                runtime_error(fmt::format("method {} does not exist in module {}",
+                                          name, o->get_path()));
+                return;
+            }
+            call_object(meth.value(), args);
+            return;
+        }
+
+        runtime_error(fmt::format("method {} of type {} does not exist", name,
+                                  get_type_name(obj)),
+                      RuntimeError::AttributeNotFound,
+                      m_current_frame->get_span());
+    }
+
+    void Vm::call_bound_function(const GcPtr<Object> &instance, const GcPtr<Function> &function, t_args args) {
+        // a wrong argument count is reported by setup_bound_call
+        if (m_registers and function->get_arguments().size() == args.size() + 1 and
+            call_registers(function, args, &instance)) {
+            return;
+        }
+        setup_bound_call(instance, function, args);
+    }
+
+    void Vm::finish_call(size_t depth, int base, int top) {
+        if (m_frame_pointer > depth) {
+            // a script callee is running, its RETURN drops the window
+            m_current_frame->set_return_base(base);
+            return;
+        }
+
+        drop_call(base, top);
+    }
+
+    void Vm::drop_call(int base, int top) {
+        auto pushed = m_stack_pointer - top;
+        if (pushed > 0) {
+            stack[base] = std::move(stack[m_stack_pointer]);
+        }
+
+        for (int i = base + pushed; i <= m_stack_pointer; i++) {
+            stack[i].reset();
+        }
+
+        m_stack_pointer = base + pushed - 1;
+    }
+
+
+    template<typename T>
+    static bool compare_values(Opcode compare, T left, T right) {
+        switch (compare) {
+            case Opcode::NE:
+                return left != right;
+            case Opcode::EQ:
+                return left == right;
+            case Opcode::LT:
+                return left < right;
+            case Opcode::LE:
+                return left <= right;
+            case Opcode::GT:
+                return left > right;
+            case Opcode::GE:
+                return left >= right;
+            default:
+                return false;
+        }
+    }
+
+    void Vm::compare_slot(Opcode compare) {
+        switch (compare) {
+            case Opcode::NE:
+                compare_op(Slot::NE, "compare (!=)");
+                break;
+            case Opcode::EQ:
+                compare_op(Slot::EQ, "compare (==)");
+                break;
+            case Opcode::LT:
+                bin_op(Slot::LT, "compare (<)");
+                break;
+            case Opcode::LE:
+                bin_op(Slot::LE, "compare (<=)");
+                break;
+            case Opcode::GT:
+                bin_op(Slot::GT, "compare (>)");
+                break;
+            case Opcode::GE:
+                bin_op(Slot::GE, "compare (>=)");
+                break;
+            default:
+                runtime_error(fmt::format("{} is not a comparison", opcode_name(compare)));
+                break;
+        }
+    }
+
+    void Vm::get_attribute(const GcPtr<Object> &obj, const GcPtr<Object> &attr) {
+        if (is_instance(obj)) {
+            auto instance = static_cast<Instance *>(obj.get());
+            if (auto index = instance->get_struct()->get_field_index(attr->as<String>()->get_value_ref())) {
+                push(instance->get_field(*index));
+                return;
+            }
+        }
+
+        if (obj->is<NativeInstance>()) {
+            auto result = obj->as<NativeInstance>()->get_attr(attr->as<String>()->get_value_ref());
+            if (result.has_value()) {
+                auto res = result.value();
+                if (res.has_value()) {
+                    push(res.value());
+                } else {
+                    runtime_error(fmt::format("unable to get attribute {} of {}\n  {}",
+                                              attr->str(), obj->str(), res.error()));
+                }
+                return;
+            }
+        }
+
+        auto call_res = call_slot(Slot::GET_ATTR, obj, {attr});
+
+        if (!call_res.has_value()) {
+            runtime_error(fmt::format("unable to get attribute {} of {}", attr->str(), obj->str()));
+            return;
+        }
+        push(call_res.value());
+    }
+
+    void Vm::set_attribute(const GcPtr<Object> &obj, const GcPtr<Object> &attr, const GcPtr<Object> &value) {
+        if (is_instance(obj)) {
+            auto instance = static_cast<Instance *>(obj.get());
+            if (auto index = instance->get_struct()->get_field_index(attr->as<String>()->get_value_ref())) {
+                instance->set_field(*index, value);
+                push(value);
+                return;
+            }
+        }
+
+        if (obj->is<NativeInstance>()) {
+            auto result = obj->as<NativeInstance>()->set_attr(attr->as<String>()->get_value_ref(), value);
+            if (result.has_value()) {
+                auto res = result.value();
+                if (res.has_value()) {
+                    push(res.value());
+                } else {
+                    runtime_error(fmt::format("unable to set attribute {} of {}\n  {}",
+                                              attr->str(), obj->str(), res.error()));
+                }
+                return;
+            }
+        }
+        push(call_slot(Slot::SET_ATTR, obj, {attr, value},
+                       "unable to set attribute {} of {}", attr->str(),
+                       obj->str()));
+    }
+
+    void Vm::get_iterator(const GcPtr<Object> &expr) {
+        auto iter = call_slot(
+                Slot::ITER, expr, {},
+                "unable to iterate over expression\n  __iter__ is not defined");
+
+        if (!iter) {
+            return;
+        }
+
+        auto iterator = iter->as<NativeInstance>();
+        if (!iterator) {
+            runtime_error(fmt::format(
+                    "unable to iterate over {}\n  iterator is not an instance",
+                    iterator->str()));
+            return;
+        }
+
+        if (!iterator->has_slot(Slot::NEXT)) {
+            runtime_error(
+                    fmt::format(
+                            "unable to iterate over {}, __next__ is not implemented",
+                            iterator->str()),
+                    RuntimeError::GenericError, m_current_frame->get_span());
+            return;
+        }
+
+        if (!iterator->has_slot(Slot::HAS_NEXT)) {
+            runtime_error(
+                    fmt::format(
+                            "unable to iterate over {}, __has_next__ is not implemented",
+                            iterator->str()),
+                    RuntimeError::GenericError, m_current_frame->get_span());
+            return;
+        }
+
+        push(iterator);
+    }
+
+    void Vm::get_item(const GcPtr<Object> &obj, const GcPtr<Object> &index) {
+        push(call_slot(Slot::GET_ITEM, obj, {index}, "unable to get item"));
+    }
+
+    void Vm::set_item(const GcPtr<Object> &obj, const GcPtr<Object> &index, const GcPtr<Object> &value) {
+        push(call_slot(Slot::SET_ITEM, obj, {index, value}, "unable to set item"));
+    }
+
+    NativeInstance::IterStep Vm::iterate_slots(const GcPtr<Object> &iterator, GcPtr<Object> &next) {
+        auto has_next = call_slot(Slot::HAS_NEXT, iterator, {}, "unable to get next item on {}",
+                                  get_type_name(iterator));
+        if (!has_next) return NativeInstance::IterStep::Done;
+        if (!is_truthy(has_next)) return NativeInstance::IterStep::Done;
+
+        next = call_slot(Slot::NEXT, iterator, {}, "unable to get next item");
+        return next ? NativeInstance::IterStep::Next : NativeInstance::IterStep::Done;
+    }
+
+    GcPtr<Object> Vm::binary_slot(Opcode opcode, const GcPtr<Object> &left, const GcPtr<Object> &right) {
+        push(left);
+        push(right);
+
+        // the same choices the stack instructions make, less the quickening
+        auto arithmetic = [this](const NativeMethodPtr &int_method, const NativeMethodPtr &float_method, Slot slot,
+                                 const char *name) {
+            if (is_int(peek(1))) bin_alt(int_method, name);
+            else if (is_float(peek(1))) bin_alt(float_method, name);
+            else bin_op(slot, name);
+        };
+
+        switch (opcode) {
+            case Opcode::BIN_ADD:
+                arithmetic(i_add, f_add, Slot::BIN_ADD, "add");
+                break;
+            case Opcode::BIN_SUB:
+                arithmetic(i_sub, f_sub, Slot::BIN_SUB, "subtract");
+                break;
+            case Opcode::BIN_MUL:
+                arithmetic(i_mul, f_mul, Slot::BIN_MUL, "multiply");
+                break;
+            case Opcode::BIN_DIV:
+                arithmetic(i_div, f_div, Slot::BIN_DIV, "divide");
+                break;
+            case Opcode::BIN_MOD:
+                bin_op(Slot::BIN_MOD, "modulo");
+                break;
+            case Opcode::BIT_OR:
+            case Opcode::BIT_AND:
+            case Opcode::BIT_XOR: {
+                auto symbol = opcode == Opcode::BIT_OR ? "|" : opcode == Opcode::BIT_AND ? "&" : "^";
+                pop();
+                pop();
+                if (!is_int(right) or !is_int(left)) {
+                    runtime_error(fmt::format("unable to apply {} to {} and {}", symbol, left->str(), right->str()),
+                                  RuntimeError::GenericError, m_current_frame->get_span());
+                    return nullptr;
+                }
+
+                auto l = int_value(left);
+                auto r = int_value(right);
+                return GcPtr<Object>::from_int(opcode == Opcode::BIT_OR ? l | r : opcode == Opcode::BIT_AND ? l & r : l ^ r);
+            }
+            default:
+                compare_slot(opcode);
+                break;
+        }
+
+        if (m_stop) return nullptr;
+        return pop();
+    }
+
     void Vm::compare_op(Slot slot, const t_string &op_name) {
-        if (!peek(1)->is<NativeInstance>() or !peek()->is<NativeInstance>()) {
+        if (!is_native(peek(1)) or !is_native(peek())) {
             runtime_error(fmt::format("unable to {} values of type {} and {}", op_name,
                                       peek(1).type_name(), peek().type_name()),
                           RuntimeError::TypeError);
@@ -360,8 +1074,7 @@ namespace bond {
                 return nullptr;
             }
 
-            auto args_ = const_cast<t_vector &>(args);
-            setup_bound_call(instance, result.value()->as<Function>(), args_);
+            setup_bound_call(instance, result.value()->as<Function>(), args);
             exec(m_frame_pointer);
 
             if (m_stop) {
@@ -387,9 +1100,11 @@ namespace bond {
         return *result;
     }
 
-    bool Vm::call_object_ex(const GcPtr<Object> &obj, t_vector &args) {
+    bool Vm::call_object_ex(const GcPtr<Object> &obj, t_args args) {
+        // natives and functions run on the register backend have already returned
+        auto depth = m_frame_pointer;
         call_object(obj, args);
-        exec(m_frame_pointer);
+        if (m_frame_pointer > depth) exec(m_frame_pointer);
         return had_error();
     }
 
@@ -406,8 +1121,7 @@ namespace bond {
             auto res = instance->as<Instance>()->call_slot(slot, {});
             TRY(res);
 
-            auto args_ = const_cast<t_vector &>(args);
-            setup_bound_call(instance, res.value()->as<Function>(), args_);
+            setup_bound_call(instance, res.value()->as<Function>(), args);
             exec(m_frame_pointer);
 
             if (m_stop) {
@@ -423,7 +1137,7 @@ namespace bond {
         return *res;
     }
 
-    void Vm::call_object(const GcPtr<Object> &func, t_vector &args) {
+    void Vm::call_object(const GcPtr<Object> &func, t_args args) {
         if (func->is<NativeFunction>()) {
             call_native_function(func, args);
         } else if (func->is<Function>()) {
@@ -443,7 +1157,7 @@ namespace bond {
 
     }
 
-    void Vm::call_native_function(const GcPtr<Object> &func, t_vector &args) {
+    void Vm::call_native_function(const GcPtr<Object> &func, t_args args) {
         auto f = func->as<NativeFunction>();
         auto result = f->get_function()(args);
 
@@ -454,22 +1168,23 @@ namespace bond {
         }
     }
 
-    void Vm::call_script_function(const GcPtr<Object> &func, t_vector &args) {
+    void Vm::call_script_function(const GcPtr<Object> &func, t_args args) {
         auto f = func->as<Function>();
+        if (m_registers and call_registers(f, args)) return;
         call_function(f, args);
     }
 
-    void Vm::call_struct(const GcPtr<Object> &func, t_vector &args) {
+    void Vm::call_struct(const GcPtr<Object> &func, t_args args) {
         auto st = func->as<Struct>();
         create_instance(st, args);
     }
 
-    void Vm::call_bound_method(const GcPtr<Object> &func, t_vector &args) {
+    void Vm::call_bound_method(const GcPtr<Object> &func, t_args args) {
         auto bm = func->as<BoundMethod>();
         call_bound_method(bm, args);
     }
 
-    void Vm::call_native_struct(const GcPtr<Object> &func, t_vector &args) {
+    void Vm::call_native_struct(const GcPtr<Object> &func, t_args args) {
         auto st = func->as<NativeStruct>();
         auto res = st->get_constructor()(args);
 
@@ -480,9 +1195,9 @@ namespace bond {
         }
     }
 
-    void Vm::call_closure(const GcPtr<Object> &func, t_vector &args) {
+    void Vm::call_closure(const GcPtr<Object> &func, t_args args) {
         auto cl = func->as<Closure>();
-        call_function(cl->get_function(), args, cl->get_up_values());
+        call_function(cl->get_function(), args, &cl->get_up_values());
     }
 
 
@@ -502,9 +1217,10 @@ namespace bond {
         for (size_t i = 0; i < m_yield_frames.size(); i++) {
             auto &frame = m_yield_frames[i];
             if (frame.future->is_ready()) {
-                m_frames[m_frame_pointer] = frame.frame;
-                m_current_frame = &m_frames[m_frame_pointer];
                 update_frame_pointer();
+                m_frames[m_frame_pointer - 1] = frame.frame;
+                m_current_frame = &m_frames[m_frame_pointer - 1];
+                reserve_stack(m_current_frame, m_current_frame->get_max_stack() + STACK_SLACK);
                 push(frame.future->get_value());
 
                 std::swap(m_yield_frames[i], m_yield_frames.back());
@@ -516,25 +1232,94 @@ namespace bond {
     }
 
 
+#if defined(BOND_COMPUTED_GOTO) && (defined(__GNUC__) || defined(__clang__))
+#define BOND_USE_COMPUTED_GOTO
+#endif
+
+#ifdef BOND_OPCODE_PROFILE
+    static std::array<std::atomic<uint64_t>, OPCODE_COUNT * OPCODE_COUNT> opcode_pairs;
+    static thread_local uint32_t previous_opcode = OPCODE_COUNT;
+
+    static Opcode count_opcode(Opcode opcode) {
+        auto current = static_cast<uint32_t>(opcode);
+        if (previous_opcode != OPCODE_COUNT) {
+            opcode_pairs[previous_opcode * OPCODE_COUNT + current].fetch_add(1, std::memory_order_relaxed);
+        }
+        previous_opcode = current;
+        return opcode;
+    }
+
+    t_string opcode_pair_report(size_t count) {
+        std::vector<std::pair<uint64_t, uint32_t>> pairs;
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < opcode_pairs.size(); i++) {
+            auto n = opcode_pairs[i].load(std::memory_order_relaxed);
+            if (n == 0) continue;
+            total += n;
+            pairs.emplace_back(n, i);
+        }
+
+        std::sort(pairs.begin(), pairs.end(), std::greater<>());
+
+        auto report = fmt::format("opcode pairs, {} dispatches\n", total);
+        for (size_t i = 0; i < std::min(count, pairs.size()); i++) {
+            auto [n, pair] = pairs[i];
+            report += fmt::format("  {:>12} {:>6.2f}%  {} -> {}\n", n, 100.0 * (double) n / (double) total,
+                                  opcode_name(static_cast<Opcode>(pair / OPCODE_COUNT)),
+                                  opcode_name(static_cast<Opcode>(pair % OPCODE_COUNT)));
+        }
+        return report;
+    }
+
+#define NEXT_OPCODE() count_opcode(m_current_frame->get_opcode())
+#else
+#define NEXT_OPCODE() m_current_frame->get_opcode()
+#endif
+
+#ifdef BOND_USE_COMPUTED_GOTO
+    // each handler jumps straight to the next one through the label table instead of
+    // going back through the switch, so every handler gets its own indirect branch
+#define TARGET(op) case Opcode::op: TARGET_##op
+#define DISPATCH() if (STEP or m_stop) [[unlikely]] break; else goto *dispatch_table[static_cast<uint32_t>(NEXT_OPCODE())]
+#else
+#define TARGET(op) case Opcode::op
+#define DISPATCH() break
+#endif
+
+// hands the frame to native code once it is compiled, never while stepping for it
+#define JIT_HOOK() if (!STEP and (m_jit or m_aot)) [[unlikely]] run_jit()
+#define TRACE_HOOK() if (!STEP and m_trace) [[unlikely]] run_trace()
+
+    template<bool STEP>
     void Vm::exec(uint32_t stop_frame) {
         if (m_frame_pointer == 0)
             return;
-        while (!m_stop  ) {
 
-            auto opcode = m_current_frame->get_opcode();
+#ifdef BOND_USE_COMPUTED_GOTO
+        static void *dispatch_table[] = {
+#define BOND_DISPATCH_LABEL(name, oprands) &&TARGET_##name,
+                BOND_OPCODES(BOND_DISPATCH_LABEL)
+#undef BOND_DISPATCH_LABEL
+        };
+        static_assert(sizeof(dispatch_table) / sizeof(void *) == OPCODE_COUNT);
+#endif
+
+        for (bool first = true; !m_stop and (!STEP or first); first = false) {
+
+            auto opcode = NEXT_OPCODE();
             switch (opcode) {
-                case Opcode::LOAD_CONST:
+                TARGET(LOAD_CONST):
                     push(m_current_frame->get_constant());
-                    break;
+                    DISPATCH();
 
-                case Opcode::CREATE_FUNCTION: {
+                TARGET(CREATE_FUNCTION): {
                     auto func = m_current_frame->get_constant()->as<Function>();
                     func->set_globals(m_globals);
                     push(func);
-                    break;
+                    DISPATCH();
                 }
 
-                case Opcode::IMPORT_PRE_COMPILED: {
+                TARGET(IMPORT_PRE_COMPILED): {
                     auto id = m_current_frame->get_oprand();
                     auto &alias = pop()->as<String>()->get_value_ref();
                     auto module = Import::instance().get_pre_compiled(id);
@@ -544,10 +1329,10 @@ namespace bond {
                         continue;
                     }
                     m_current_frame->set_global(alias, module.value());
-                    break;
+                    DISPATCH();
                 }
 
-                case Opcode::IMPORT: {
+                TARGET(IMPORT): {
                     auto &path = pop()->as<String>()->get_value_ref();
                     auto constant = m_current_frame->get_constant();
                     auto &alias = constant->as<String>()->get_value_ref();
@@ -563,104 +1348,124 @@ namespace bond {
                     if (m_ctx->has_error())
                         m_stop = true;
                     m_current_frame->set_global(alias, module.value());
-                    break;
+                    DISPATCH();
                 }
-                case Opcode::BIN_ADD:
-                    if (peek(1)->is<Int>()) {
+                TARGET(BIN_ADD):
+                    specialize(Opcode::BIN_ADD_INT_INT, Opcode::BIN_ADD_FLOAT_FLOAT);
+
+                    if (is_int(peek(1))) {
                         bin_alt(i_add, "add");
-                        break;
+                        DISPATCH();
                     }
 
-                    if (peek(1)->is<Float>()) {
+                    if (is_float(peek(1))) {
                         bin_alt(f_add, "add");
-                        break;
+                        DISPATCH();
                     }
                     bin_op(Slot::BIN_ADD, "add");
-                    break;
+                    DISPATCH();
 
-                case Opcode::BIN_SUB:
-                    if (peek(1)->is<Int>()) {
+                TARGET(BIN_SUB):
+                    specialize(Opcode::BIN_SUB_INT_INT, Opcode::BIN_SUB_FLOAT_FLOAT);
+
+                    if (is_int(peek(1))) {
                         bin_alt(i_sub, "subtract");
-                        break;
+                        DISPATCH();
                     }
-                    if (peek(1)->is<Float>()) {
+                    if (is_float(peek(1))) {
                         bin_alt(f_sub, "subtract");
-                        break;
+                        DISPATCH();
                     }
                     bin_op(Slot::BIN_SUB, "subtract");
-                    break;
+                    DISPATCH();
+
+                TARGET(BIN_MUL):
+                    specialize(Opcode::BIN_MUL_INT_INT, Opcode::BIN_MUL_FLOAT_FLOAT);
 
-                case Opcode::BIN_MUL:
-                    if (peek(1)->is<Int>()) {
+                    if (is_int(peek(1))) {
                         bin_alt(i_mul, "multiply");
-                        break;
+                        DISPATCH();
                     }
 
-                    if (peek(1)->is<Float>()) {
+                    if (is_float(peek(1))) {
                         bin_alt(f_mul, "multiply");
-                        break;
+                        DISPATCH();
                     }
                     bin_op(Slot::BIN_MUL, "multiply");
-                    break;
+                    DISPATCH();
+
+                TARGET(BIN_DIV):
+                    specialize(Opcode::BIN_DIV_INT_INT, Opcode::BIN_DIV_FLOAT_FLOAT);
 
-                case Opcode::BIN_DIV:
-                    if (peek(1)->is<Int>()) {
+                    if (is_int(peek(1))) {
                         bin_alt(i_div, "divide");
-                        break;
+                        DISPATCH();
                     }
 
-                    if (peek(1)->is<Float>()) {
+                    if (is_float(peek(1))) {
                         bin_alt(f_div, "divide");
-                        break;
+                        DISPATCH();
                     }
                     bin_op(Slot::BIN_DIV, "divide");
-                    break;
+                    DISPATCH();
+
+                TARGET(BIN_MOD):
+                    if (is_int(peek(1)) and is_int(peek())) {
+                        m_current_frame->quicken(Opcode::BIN_MOD_INT_INT);
+                    }
 
-                case Opcode::BIN_MOD:
                     bin_op(Slot::BIN_MOD, "modulo");
-                    break;
+                    DISPATCH();
 
-                case Opcode::NE:
+                TARGET(NE):
+                    specialize(Opcode::NE_INT_INT, Opcode::NE_FLOAT_FLOAT);
                     compare_op(Slot::NE, "compare (!=)");
-                    break;
-                case Opcode::EQ:
+                    DISPATCH();
+                TARGET(EQ):
+                    specialize(Opcode::EQ_INT_INT, Opcode::EQ_FLOAT_FLOAT);
                     compare_op(Slot::EQ, "compare (==)");
-                    break;
-                case Opcode::LT:
+                    DISPATCH();
+                TARGET(LT):
+                    specialize(Opcode::LT_INT_INT, Opcode::LT_FLOAT_FLOAT);
                     bin_op(Slot::LT, "compare (<)");
-                    break;
-                case Opcode::LE:
+                    DISPATCH();
+                TARGET(LE):
+                    specialize(Opcode::LE_INT_INT, Opcode::LE_FLOAT_FLOAT);
                     bin_op(Slot::LE, "compare (<=)");
-                    break;
-                case Opcode::GT:
+                    DISPATCH();
+                TARGET(GT):
+                    specialize(Opcode::GT_INT_INT, Opcode::GT_FLOAT_FLOAT);
                     bin_op(Slot::GT, "compare (>)");
-                    break;
-                case Opcode::GE:
+                    DISPATCH();
+                TARGET(GE):
+                    specialize(Opcode::GE_INT_INT, Opcode::GE_FLOAT_FLOAT);
                     bin_op(Slot::GE, "compare (>=)");
-                    break;
-                case Opcode::TRY: {
+                    DISPATCH();
+                TARGET(TRY): {
                     if (peek()->is<Result>()) {
                         auto result = pop()->as<Result>();
-                        auto jmp = m_current_frame->get_oprand();
+                        auto jmp = m_current_frame->get_jump_target();
                         if (result->has_error()) {
                             if (m_frame_pointer == 1) {
                                 runtime_error(result->str(), RuntimeError::GenericError,
                                               m_current_frame->get_span());
-                                break;
+                                DISPATCH();
                             }
                             push(result);
-                            break;
+                            DISPATCH();
                         } else {
                             push(result->get_value());
                             m_current_frame->jump_absolute(jmp);
-                            break;
+                            DISPATCH();
                         }
                     }
                     runtime_error("try statement expects a Result",
                                   RuntimeError::GenericError, m_current_frame->get_span());
-                    break;
+                    DISPATCH();
                 }
-                case Opcode::RETURN: {
+                TARGET(RETURN): {
+                    m_locals_top = m_current_frame->get_locals_base();
+                    return_stack(m_current_frame, pop());
                     m_current_frame->clear();
 
                     if (m_frame_pointer == stop_frame) {
@@ -677,488 +1482,462 @@ namespace bond {
                             if (result->has_error()) {
                                 runtime_error(result->str(), RuntimeError::GenericError,
                                               m_current_frame->get_span());
-                                break;
+                                DISPATCH();
                             }
                             push(result->get_value());
                         }
 
                         m_stop = true;
-                        break;
+                        DISPATCH();
                     }
                     m_frame_pointer--;
                     m_current_frame = &m_frames[m_frame_pointer - 1];
                     process_events_if_needed();
-                    break;
+                    JIT_HOOK();
+                    DISPATCH();
                 }
-                case Opcode::PUSH_TRUE:
+                TARGET(PUSH_TRUE):
                     push(m_True);
-                    break;
-                case Opcode::PUSH_FALSE:
+                    DISPATCH();
+                TARGET(PUSH_FALSE):
                     push(m_False);
-                    break;
-                case Opcode::PUSH_NIL:
+                    DISPATCH();
+                TARGET(PUSH_NIL):
                     push(m_Nil);
-                    break;
-                case Opcode::LOAD_GLOBAL: {
-                    auto &name =
-                            m_current_frame->get_constant()->as<String>()->get_value_ref();
-                    if (!m_current_frame->has_global(name)) {
-                        auto err = fmt::format(
-                                "Global variable {} is not defined at this point", name);
-                        runtime_error(err, RuntimeError::GenericError,
-                                      m_current_frame->get_span());
-                        continue;
+                    DISPATCH();
+                TARGET(LOAD_GLOBAL): {
+                    auto index = m_current_frame->get_oprand();
+                    auto &globals = m_current_frame->get_globals();
+                    auto &cache = m_current_frame->get_global_cache(index);
+
+                    if (cache.version != globals->get_version()) {
+                        auto &name = m_current_frame->get_constant(index)->as<String>()->get_value_ref();
+                        auto slot = globals->find_slot(name);
+
+                        if (!slot.has_value()) {
+                            auto err = fmt::format(
+                                    "Global variable {} is not defined at this point", name);
+                            runtime_error(err, RuntimeError::GenericError,
+                                          m_current_frame->get_span());
+                            continue;
+                        }
+
+                        cache = {globals->get_version(), slot.value()};
                     }
-                    push(m_current_frame->get_global(name));
 
-                    break;
+                    push(globals->get_slot(cache.slot));
+                    DISPATCH();
                 }
-                case Opcode::CREATE_GLOBAL: {
+                TARGET(CREATE_GLOBAL): {
                     auto &name =
                             m_current_frame->get_constant()->as<String>()->get_value_ref();
                     auto expr = pop();
                     m_current_frame->set_global(name, expr);
-                    break;
+                    DISPATCH();
                 }
-                case Opcode::STORE_GLOBAL: {
-                    auto &name =
-                            m_current_frame->get_constant()->as<String>()->get_value_ref();
-                    auto expr = peek();
+                TARGET(STORE_GLOBAL): {
+                    auto index = m_current_frame->get_oprand();
+                    auto &globals = m_current_frame->get_globals();
+                    auto &cache = m_current_frame->get_global_cache(index);
+
+                    if (cache.version == globals->get_version()) {
+                        globals->set_slot(cache.slot, peek());
+                        DISPATCH();
+                    }
 
-                    m_current_frame->set_global(name, expr);
-                    break;
+                    auto &name = m_current_frame->get_constant(index)->as<String>()->get_value_ref();
+                    cache = {globals->get_version(), globals->set(name, peek())};
+                    DISPATCH();
                 }
 
-                case Opcode::CREATE_LOCAL: {
-                    auto &name =
-                            m_current_frame->get_constant()->as<String>()->get_value_ref();
+                TARGET(CREATE_LOCAL): {
+                    auto slot = m_current_frame->get_oprand();
                     auto expr = pop();
 
-                    m_current_frame->set_local(name, expr);
-                    break;
+                    m_current_frame->set_local(slot, expr);
+                    DISPATCH();
                 }
 
-                case Opcode::STORE_FAST: {
-                    auto &name =
-                            m_current_frame->get_constant()->as<String>()->get_value_ref();
-                    auto expr = peek();
+                TARGET(STORE_FAST): {
+                    auto slot = m_current_frame->get_oprand();
+                    m_current_frame->set_local(slot, peek());
+                    DISPATCH();
+                }
 
-                    m_current_frame->set_local(name, expr);
-                    break;
+                TARGET(LOAD_FAST): {
+                    auto slot = m_current_frame->get_oprand();
+                    push(m_current_frame->get_local(slot));
+                    DISPATCH();
                 }
 
-                case Opcode::LOAD_FAST: {
-                    auto &name =
-                            m_current_frame->get_constant()->as<String>()->get_value_ref();
-                    //        if (!m_current_frame->has_local(name)) {
-                    //          auto err = fmt::format("Local variable {} does not exist",
-                    //          name->as<String>()->get_value()); runtime_error(err,
-                    //          RuntimeError::GenericError, m_current_frame->get_span());
-                    //          continue;
-                    //        }
-                    push(m_current_frame->get_local(name));
-                    break;
+                TARGET(LOAD_CELL): {
+                    auto cell = get_cell(m_current_frame->get_oprand());
+                    if (!cell) continue;
+                    push(cell->get());
+                    DISPATCH();
                 }
 
-                case Opcode::POP_TOP: {
-                    if (peek()->is<Result>()) {
+                TARGET(STORE_CELL): {
+                    auto cell = get_cell(m_current_frame->get_oprand());
+                    if (!cell) continue;
+                    cell->set(peek());
+                    DISPATCH();
+                }
+
+                TARGET(CREATE_CELL): {
+                    auto slot = m_current_frame->get_oprand();
+                    m_current_frame->set_local(slot, Runtime::ins()->make_cell(pop()));
+                    DISPATCH();
+                }
+
+                TARGET(POP_TOP): {
+                    auto &top = stack[m_stack_pointer];
+                    if (!top.is_immediate() and top->is<Result>()) {
                         runtime_error(fmt::format("result must be handled: {}", pop()->str()),
                                       RuntimeError::GenericError, m_current_frame->get_span());
                         continue;
                     }
                     pop();
                 }
-                    break;
+                    DISPATCH();
 
-                case Opcode::BUILD_LIST: {
+                TARGET(BUILD_LIST): {
 
                     auto size = m_current_frame->get_oprand();
                     auto list = Runtime::ins()->make_list({});
 
-                    for (int i = 0; i < size; i++) {
+                    for (uint32_t i = 0; i < size; i++) {
                         list->prepend(pop());
                     }
                     push(list);
-                    break;
+                    DISPATCH();
                 }
 
-                case Opcode::GET_ITEM: {
+                TARGET(GET_ITEM): {
                     auto index = pop();
                     auto list = pop();
 
-                    push(call_slot(Slot::GET_ITEM, list, {index}, "unable to get item"));
-                    break;
+                    get_item(list, index);
+                    DISPATCH();
                 }
 
-                case Opcode::SET_ITEM: {
+                TARGET(SET_ITEM): {
                     auto value = pop();
                     auto index = pop();
                     auto list = pop();
 
-                    push(call_slot(Slot::SET_ITEM, list, {index, value},
-                                   "unable to set item"));
-                    break;
+                    set_item(list, index, value);
+                    DISPATCH();
                 }
 
-                case Opcode::JUMP_IF_FALSE: {
-                    auto position = m_current_frame->get_oprand();
+                TARGET(JUMP_IF_FALSE): {
+                    auto position = m_current_frame->get_jump_target();
                     auto cond = pop();
 
-                    auto res = Runtime::ins()->BOOL_STRUCT->create({cond}).value()->as<Bool>();
-
-                    if (!res->get_value()) {
+                    if (!is_truthy(cond)) {
                         m_current_frame->jump_absolute(position);
                     }
-                    break;
+                    DISPATCH();
                 }
 
-                case Opcode::JUMP: {
-                    auto position = m_current_frame->get_oprand();
+                TARGET(JUMP): {
+                    auto position = m_current_frame->get_jump_target();
+                    auto backward = position < m_current_frame->get_ip();
                     m_current_frame->jump_absolute(position);
-                    break;
+                    if (backward) {
+                        TRACE_HOOK();
+                        JIT_HOOK();
+                    }
+                    DISPATCH();
                 }
 
-                case Opcode::OR: {
+                TARGET(OR): {
 
                     auto right = pop();
                     auto left = pop();
 
-                    auto res = Runtime::ins()->BOOL_STRUCT->create({left}).value()->as<Bool>();
-
-                    if (res->get_value()) {
+                    if (is_truthy(left)) {
                         push(left);
                     } else {
                         push(right);
                     }
-                    break;
+                    DISPATCH();
                 }
 
-                case Opcode::AND: {
+                TARGET(AND): {
 
                     auto right = pop();
                     auto left = pop();
 
-                    auto l_bool = Runtime::ins()->BOOL_STRUCT->create({left}).value()->as<Bool>();
-                    auto r_bool = Runtime::ins()->BOOL_STRUCT->create({right}).value()->as<Bool>();
-
-                    auto l = l_bool->get_value();
-                    auto r = r_bool->get_value();
+                    auto l = is_truthy(left);
+                    auto r = is_truthy(right);
 
                     if (l && r) {
                         push(right);
                     } else {
                         push(l ? right : left);
                     }
-                    break;
+                    DISPATCH();
                 }
 
-                case Opcode::ITER: {
-                    auto expr = pop();
-
-                    auto iter = call_slot(
-                            Slot::ITER, expr, {},
-                            "unable to iterate over expression\n  __iter__ is not defined");
-
-                    if (iter.get() == nullptr) {
-                        continue;
-                    }
-
-                    auto iterator = iter->as<NativeInstance>();
-                    if (iterator.get() == nullptr) {
-                        runtime_error(fmt::format(
-                                "unable to iterate over {}\n  iterator is not an instance",
-                                iterator->str()));
-                        continue;
-                    }
-
-                    if (!iterator->has_slot(Slot::NEXT)) {
-                        runtime_error(
-                                fmt::format(
-                                        "unable to iterate over {}, __next__ is not implemented",
-                                        iterator->str()),
-                                RuntimeError::GenericError, m_current_frame->get_span());
-                        continue;
-                    }
-
-                    if (!iterator->has_slot(Slot::HAS_NEXT)) {
-                        runtime_error(
-                                fmt::format(
-                                        "unable to iterate over {}, __has_next__ is not implemented",
-                                        iterator->str()),
-                                RuntimeError::GenericError, m_current_frame->get_span());
-                        continue;
-                    }
-
-                    push(iterator);
-                    break;
+                TARGET(ITER): {
+                    get_iterator(pop());
+                    DISPATCH();
                 }
 
-                case Opcode::ITER_NEXT: {
+                TARGET(ITER_NEXT): {
                     auto next = call_slot(Slot::NEXT, peek(), {}, "unable to get next item");
-                    if (next.get() == nullptr) {
+                    if (!next) {
                         continue;
                     }
-                    auto &local =
-                            m_current_frame->get_constant()->as<String>()->get_value_ref();
-                    m_current_frame->set_local(local, next);
-                    break;
+                    auto slot = m_current_frame->get_oprand();
+                    m_current_frame->set_local(slot, next);
+                    DISPATCH();
                 }
 
-                case Opcode::ITER_END: {
+                TARGET(ITER_END): {
                     auto next =
                             call_slot(Slot::HAS_NEXT, peek(), {}, "unable to get next item on {}",
                                       get_type_name(peek()));
-                    if (next.get() == nullptr) {
+                    if (!next) {
                         continue;
                     }
-                    auto jump_pos = m_current_frame->get_oprand();
-                    auto jump_condition = TO_BOOL(next);
-
-                    if (!jump_condition->get_value()) {
+                    auto jump_pos = m_current_frame->get_jump_target();
+                    if (!is_truthy(next)) {
                         m_current_frame->jump_absolute(jump_pos);
                     }
-                    break;
+                    DISPATCH();
                 }
 
-                case Opcode::CALL: {
+                TARGET(CALL): {
+                    auto arg_count = m_current_frame->get_oprand();
+
+                    // callees read their arguments in place from the operand stack
+                    auto top = m_stack_pointer;
+                    auto base = top - (int) arg_count;
+                    auto depth = m_frame_pointer;
+                    call_object(stack[base], t_args(&stack[base + 1], arg_count));
+                    finish_call(depth, base, top);
+                    JIT_HOOK();
+                    DISPATCH();
+                }
+                TARGET(TAIL_CALL): {
                     auto arg_count = m_current_frame->get_oprand();
-                    m_args.clear();
-                    m_args.resize(arg_count);
+                    auto top = m_stack_pointer;
+                    auto base = top - (int) arg_count;
+                    auto callee = stack[base];
+                    auto args = t_args(&stack[base + 1], arg_count);
+
+                    if (callee->is<Function>()) {
+                        tail_call_function(callee->as<Function>(), args, nullptr);
+                        JIT_HOOK();
+                        DISPATCH();
+                    }
 
-                    for (int i = arg_count - 1; i >= 0; i--) {
-                        m_args[i] = pop();
+                    if (callee->is<Closure>()) {
+                        auto closure = callee->as<Closure>();
+                        tail_call_function(closure->get_function(), args, &closure->get_up_values());
+                        JIT_HOOK();
+                        DISPATCH();
                     }
 
-                    call_object(pop(), m_args);
-                    continue;
+                    // other callees run as a plain CALL, the RETURN after this returns their result
+                    auto depth = m_frame_pointer;
+                    call_object(callee, args);
+                    finish_call(depth, base, top);
+                    JIT_HOOK();
+                    DISPATCH();
                 }
-                case Opcode::CREATE_STRUCT: {
+                TARGET(CREATE_STRUCT): {
                     auto st = m_current_frame->get_constant();
                     st->as<Struct>()->set_globals(m_globals);
                     push(st);
-                    break;
+                    DISPATCH();
                 }
-                case Opcode::GET_ATTRIBUTE: {
+                TARGET(GET_ATTRIBUTE): {
                     auto attr = m_current_frame->get_constant();
-                    auto obj = pop();
+                    get_attribute(pop(), attr);
+                    DISPATCH();
+                }
+                TARGET(LOAD_FAST_ATTR): {
+                    // copied, a getter run by get_attribute can grow the locals and leave a
+                    // reference dangling
+                    auto obj = m_current_frame->get_local(m_current_frame->get_oprand());
+                    get_attribute(obj, m_current_frame->get_constant());
+                    DISPATCH();
+                }
+                TARGET(LOAD_FAST_LOAD_FAST): {
+                    push(m_current_frame->get_local(m_current_frame->get_oprand()));
+                    push(m_current_frame->get_local(m_current_frame->get_oprand()));
+                    DISPATCH();
+                }
+                TARGET(FOR_ITER): {
+                    auto slot = m_current_frame->get_oprand();
+                    auto position = m_current_frame->get_jump_target();
+                    auto iterator = peek()->as<NativeInstance>();
+
+                    GcPtr<Object> next;
+                    auto step = iterator->iter_next(next);
+                    if (step == NativeInstance::IterStep::Generic) {
+                        // iterators defined in scripts or extensions go through their slots
+                        step = iterate_slots(peek(), next);
+                        if (m_stop) continue;
+                    }
 
-                    if (obj->is<NativeInstance>()) {
-                        auto result = obj->as<NativeInstance>()->get_attr(
-                                attr->as<String>()->get_value_ref());
-                        if (result.has_value()) {
-                            auto res = result.value();
-                            if (res.has_value()) {
-                                push(res.value());
-                                break;
-                            } else {
-                                runtime_error(fmt::format("unable to get attribute {} of {}\n  {}",
-                                                          attr->str(), obj->str(), res.error()));
-                                continue;
-                            }
-                        }
+                    if (step == NativeInstance::IterStep::Done) {
+                        m_current_frame->jump_absolute(position);
+                        DISPATCH();
                     }
 
-                    auto call_res = call_slot(Slot::GET_ATTR, obj, {attr});
+                    m_current_frame->set_local(slot, next);
+                    DISPATCH();
+                }
+                TARGET(COMPARE_AND_JUMP): {
+                    auto compare = static_cast<Opcode>(m_current_frame->get_oprand());
+                    auto position = m_current_frame->get_jump_target();
+                    auto &right = stack[m_stack_pointer];
+                    auto &left = stack[m_stack_pointer - 1];
+                    bool result;
+
+                    if (left.is_immediate_int() and right.is_immediate_int()) {
+                        result = compare_values(compare, left.immediate_int(), right.immediate_int());
+                        stack[m_stack_pointer--].reset();
+                        stack[m_stack_pointer--].reset();
+                    } else if (left.is_immediate_float() and right.is_immediate_float()) {
+                        result = compare_values(compare, left.immediate_float(), right.immediate_float());
+                        stack[m_stack_pointer--].reset();
+                        stack[m_stack_pointer--].reset();
+                    } else {
+                        // anything else compares like the plain instruction and tests the result
+                        compare_slot(compare);
+                        if (m_stop) {
+                            DISPATCH();
+                        }
+                        result = is_truthy(pop());
+                    }
 
-                    if (!call_res.has_value()) {
-                        runtime_error(fmt::format("unable to get attribute {} of {}",
-                                                  attr->str(), obj->str()));
-                        continue;
+                    if (!result) {
+                        m_current_frame->jump_absolute(position);
                     }
-                    push(call_res.value());
-                    break;
+                    DISPATCH();
                 }
-                case Opcode::SET_ATTRIBUTE: {
+                TARGET(SET_ATTRIBUTE): {
                     auto attr = m_current_frame->get_constant();
 
                     auto value = pop();
                     auto obj = pop();
+                    set_attribute(obj, attr, value);
+                    DISPATCH();
+                }
 
-                    if (obj->is<NativeInstance>()) {
-                        auto result = obj->as<NativeInstance>()->set_attr(
-                                attr->as<String>()->get_value_ref(), value);
-                        if (result.has_value()) {
-                            auto res = result.value();
-                            if (res.has_value()) {
-                                push(res.value());
-                                break;
-                            } else {
-                                runtime_error(fmt::format("unable to set attribute {} of {}\n  {}",
-                                                          attr->str(), obj->str(), res.error()));
-                                continue;
-                            }
-                        }
+                TARGET(BREAK):
+                TARGET(CONTINUE): {
+                    auto position = m_current_frame->get_jump_target();
+                    auto backward = position < m_current_frame->get_ip();
+                    m_current_frame->jump_absolute(position);
+                    if (backward) {
+                        TRACE_HOOK();
+                        JIT_HOOK();
                     }
-                    push(call_slot(Slot::SET_ATTR, obj, {attr, value},
-                                   "unable to set attribute {} of {}", attr->str(),
-                                   obj->str()));
-                    break;
+                    DISPATCH();
                 }
-
-                case Opcode::BREAK:
-                case Opcode::CONTINUE:
-                    m_current_frame->jump_absolute(m_current_frame->get_oprand());
-                    break;
-                case Opcode::MAKE_OK: {
+                TARGET(MAKE_OK): {
                     push(make_result(pop(), false));
-                    break;
+                    DISPATCH();
                 }
-                case Opcode::MAKE_ERROR: {
+                TARGET(MAKE_ERROR): {
                     push(make_result(pop(), true));
-                    break;
+                    DISPATCH();
                 }
-                case Opcode::UNARY_SUB: {
+                TARGET(UNARY_SUB): {
                     auto obj = pop();
-                    if (obj->is<Int>()) {
-                        push(make_int(-obj->as<Int>()->get_value()));
-                        break;
+                    if (obj.is_immediate_int()) {
+                        push(GcPtr<Object>::from_int((int64_t) (0 - (uint64_t) obj.immediate_int())));
+                        DISPATCH();
+                    } else if (obj.is_immediate_float()) {
+                        push(GcPtr<Object>::from_float(-obj.immediate_float()));
+                        DISPATCH();
+                    } else if (obj->is<Int>()) {
+                        push(make_int((int64_t) (0 - (uint64_t) obj->as<Int>()->get_value())));
+                        DISPATCH();
                     } else if (obj->is<Float>()) {
                         push(make_float(-obj->as<Float>()->get_value()));
-                        break;
+                        DISPATCH();
                     }
 
                     runtime_error(fmt::format("unable to apply unary - to {}", obj->str()),
                                   RuntimeError::GenericError, m_current_frame->get_span());
                     continue;
                 }
-                case Opcode::NOT: {
+                TARGET(NOT): {
                     auto obj = pop();
-                    auto res = Runtime::ins()->BOOL_STRUCT->create({obj}).value()->as<Bool>();
-                    push(AS_BOOL(!res->get_value()));
-                    break;
+                    push(AS_BOOL(!is_truthy(obj)));
+                    DISPATCH();
                 }
 
-                case Opcode::BIT_OR: {
+                TARGET(BIT_OR): {
                     auto right = pop();
                     auto left = pop();
 
-                    if (!right->is<Int>() or !left->is<Int>()) {
+                    if (!is_int(right) or !is_int(left)) {
                         runtime_error(fmt::format("unable to apply | to {} and {}", left->str(),
                                                   right->str()),
                                       RuntimeError::GenericError, m_current_frame->get_span());
                         continue;
                     }
 
-                    auto res = left->as<Int>()->get_value() | right->as<Int>()->get_value();
-                    push(make_int(res));
-                    break;
+                    auto res = int_value(left) | int_value(right);
+                    push(GcPtr<Object>::from_int(res));
+                    DISPATCH();
                 }
 
-                case Opcode::BIT_AND: {
+                TARGET(BIT_AND): {
                     auto right = pop();
                     auto left = pop();
 
-                    if (!right->is<Int>() or !left->is<Int>()) {
+                    if (!is_int(right) or !is_int(left)) {
                         runtime_error(fmt::format("unable to apply & to {} and {}", left->str(),
                                                   right->str()),
                                       RuntimeError::GenericError, m_current_frame->get_span());
                         continue;
                     }
 
-                    auto res = left->as<Int>()->get_value() & right->as<Int>()->get_value();
-                    push(make_int(res));
-                    break;
+                    auto res = int_value(left) & int_value(right);
+                    push(GcPtr<Object>::from_int(res));
+                    DISPATCH();
                 }
 
-                case Opcode::BIT_XOR: {
+                TARGET(BIT_XOR): {
                     auto right = pop();
                     auto left = pop();
 
-                    if (!right->is<Int>() or !left->is<Int>()) {
+                    if (!is_int(right) or !is_int(left)) {
                         runtime_error(fmt::format("unable to apply ^ to {} and {}", left->str(),
                                                   right->str()),
                                       RuntimeError::GenericError, m_current_frame->get_span());
                         continue;
                     }
 
-                    auto res = left->as<Int>()->get_value() ^ right->as<Int>()->get_value();
-                    push(make_int(res));
-                    break;
+                    auto res = int_value(left) ^ int_value(right);
+                    push(GcPtr<Object>::from_int(res));
+                    DISPATCH();
                 }
 
-                case Opcode::CALL_METHOD: {
+                TARGET(CALL_METHOD): {
                     auto arg_size = m_current_frame->get_oprand();
-                    m_args.clear();
-                    m_args.resize(arg_size);
-
-                    for (size_t i = arg_size; i > 0; i--) {
-                        m_args[i - 1] = pop();
-                    }
-
-                    auto &name = pop()->as<String>()->get_value_ref();
-                    auto obj = pop();
-
-                    if (!obj->is<NativeInstance>()) {
-                        runtime_error(
-                                fmt::format("method {} of {} does not exist", name, obj->str()),
-                                RuntimeError::GenericError, m_current_frame->get_span());
-                    }
-
-                    auto o = obj->as<NativeInstance>();
-                    if (o->has_method(name)) {
-                        auto res = o->call_method(name, m_args);
-
-                        if (!res.has_value()) {
-                            runtime_error(
-                                    fmt::format("unable to call method {}\n  {}", name, res.error()));
-                            break;
-                        }
-                        push(res.value());
-                        break;
-                    }
-
-                    if (obj->is<Instance>()) {
-                        auto o = obj->as<Instance>();
-                        auto meth = o->get_method(name);
-
-                        if (!meth.has_value()) {
-                            auto attr = call_slot(Slot::GET_ATTR, obj, {make_string(name)});
-
-                            if (attr.has_value()) {
-                                call_object(attr.value(), m_args);
-                                break;
-                            }
-
-                            runtime_error(fmt::format("attribute {} is not callable \n  {}", name,
-                                                      meth.error()));
-                            break;
-                        }
-
-                        setup_bound_call(o, meth.value()->as<Function>(), m_args);
-                        break;
-                    } else if (obj->is<Struct>()) {
-                        auto o = obj->as<Struct>();
-                        auto meth = o->get_method(name);
-
-                        if (!meth.has_value()) {
-                            runtime_error(
-                                    fmt::format("static method {} does not exist in struct {}", name,
-                                                o->get_name()));
-                            break;
-                        }
-                        call_function(meth.value(), m_args);
-                        break;
-                    } else if (obj->is<Module>()) {
-                        auto o = obj->as<Module>();
-                        auto meth = o->get_attribute(name);
-
-                        if (!meth.has_value()) {
-                            runtime_error(fmt::format("method {} does not exist in module {}",
-                                                      name, o->get_path()));
-                            break;
-                        }
-                        call_object(meth.value(), m_args);
-                        break;
-                    }
-
-                    runtime_error(fmt::format("method {} of type {} does not exist", name,
-                                              get_type_name(obj)),
-                                  RuntimeError::AttributeNotFound,
-                                  m_current_frame->get_span());
-                    break;
+                    auto &cache = m_current_frame->get_method_cache(m_current_frame->get_oprand());
+
+                    // the receiver, the method name and the arguments stay on the stack for the call
+                    auto top = m_stack_pointer;
+                    auto base = top - (int) arg_size - 1;
+                    auto depth = m_frame_pointer;
+                    call_method(cache, stack[base], stack[base + 1], t_args(&stack[base + 2], arg_size));
+                    finish_call(depth, base, top);
+                    JIT_HOOK();
+                    DISPATCH();
                 }
 
-                case Opcode::UNPACK_SEQ: {
+                TARGET(UNPACK_SEQ): {
                     auto obj = pop();
                     auto count = m_current_frame->get_oprand();
 
@@ -1182,7 +1961,7 @@ namespace bond {
                             call_slot(Slot::ITER, o, {}, "unable to unpack object of type {}",
                                       get_type_name(obj));
 
-                    if (iter.get() == nullptr) {
+                    if (!iter) {
                         runtime_error(fmt::format("object of type {} is not iterable",
                                                   get_type_name(obj)));
                         return;
@@ -1205,23 +1984,25 @@ namespace bond {
                         auto has_next =
                                 call_slot(Slot::HAS_NEXT, the_iterator, {},
                                           "unable to unpack object of type {}", get_type_name(obj));
-                        if (has_next.get() == nullptr) {
+                        if (!has_next) {
                             break;
                         }
 
-                        auto cond = TO_BOOL(has_next);
-                        if (!cond->get_value()) {
+                        if (!is_truthy(has_next)) {
                             break;
                         }
 
                         auto next =
                                 call_slot(Slot::NEXT, the_iterator, {},
                                           "unable to unpack object of type {}", get_type_name(obj));
-                        if (next.get() == nullptr) {
+                        if (!next) {
                             break;
                         }
 
-                        push(next);
+                        // only the expected elements are pushed, the frame reserved no more
+                        if (i < count) {
+                            push(next);
+                        }
                         i++;
                     }
 
@@ -1230,31 +2011,26 @@ namespace bond {
                                 "unable to unpack object of type {}, expected {} elements, got {}",
                                 get_type_name(obj), count, i));
                     }
-                    break;
+                    DISPATCH();
                 }
-                case Opcode::CREATE_CLOSURE: {
+                TARGET(CREATE_CLOSURE): {
                     auto func = m_current_frame->get_constant()->as<Function>();
                     func->set_globals(m_current_frame->get_globals());
-                    auto closure = Runtime::ins()->CLOSURE_STRUCT->create_instance<Closure>(
-                            func->as<Function>(), m_current_frame->get_locals());
-                    m_current_frame->set_local(func->get_name(), closure);
-                    break;
-                }
 
-                case Opcode::CREATE_CLOSURE_EX: {
-                    auto func = m_current_frame->get_constant()->as<Function>();
-                    func->set_globals(m_current_frame->get_globals());
-                    auto closure = Runtime::ins()->CLOSURE_STRUCT->create_instance<Closure>(
-                            func->as<Function>(), m_current_frame->get_locals());
-                    push(closure);
-                    break;
+                    t_vector up_values;
+                    for (auto &capture: func->get_code()->get_captures()) {
+                        up_values.push_back(m_current_frame->get_local(capture.from));
+                    }
+
+                    push(Runtime::ins()->make_closure(func, up_values));
+                    DISPATCH();
                 }
 
-                case Opcode::BUILD_DICT: {
+                TARGET(BUILD_DICT): {
                     auto count = m_current_frame->get_oprand();
                     auto dict = Runtime::ins()->HASHMAP_STRUCT->create_instance<HashMap>();
 
-                    for (int i = 0; i < count; i++) {
+                    for (uint32_t i = 0; i < count; i++) {
                         auto value = pop();
                         auto key = pop();
                         auto res = dict->set(key, value);
@@ -1265,19 +2041,66 @@ namespace bond {
                         }
                     }
                     push(dict);
-                    break;
+                    DISPATCH();
                 }
 
-                case Opcode::MAKE_ASYNC:
-                case Opcode::AWAIT:
+#define SPECIALISED_OP(name, generic, kind, guard, result) \
+                TARGET(name): { \
+                    auto &right = stack[m_stack_pointer]; \
+                    auto &left = stack[m_stack_pointer - 1]; \
+                    if (!left.is_immediate_##kind() or !right.is_immediate_##kind()) [[unlikely]] { \
+                        m_current_frame->deopt(Opcode::generic); \
+                        DISPATCH(); \
+                    } \
+                    auto l = left.immediate_##kind(); \
+                    auto r = right.immediate_##kind(); \
+                    if (!(guard)) [[unlikely]] { \
+                        m_current_frame->deopt(Opcode::generic); \
+                        DISPATCH(); \
+                    } \
+                    stack[m_stack_pointer--].reset(); \
+                    stack[m_stack_pointer] = result; \
+                    DISPATCH(); \
+                }
+
+                SPECIALISED_OP(BIN_ADD_INT_INT, BIN_ADD, int, true, GcPtr<Object>::from_int((int64_t) ((uint64_t) l + (uint64_t) r)))
+                SPECIALISED_OP(BIN_SUB_INT_INT, BIN_SUB, int, true, GcPtr<Object>::from_int((int64_t) ((uint64_t) l - (uint64_t) r)))
+                SPECIALISED_OP(BIN_MUL_INT_INT, BIN_MUL, int, true, GcPtr<Object>::from_int((int64_t) ((uint64_t) l * (uint64_t) r)))
+                SPECIALISED_OP(BIN_DIV_INT_INT, BIN_DIV, int, r != 0 and !(r == -1 and l == INT64_MIN), GcPtr<Object>::from_int(l / r))
+                SPECIALISED_OP(BIN_MOD_INT_INT, BIN_MOD, int, r != 0 and !(r == -1 and l == INT64_MIN), GcPtr<Object>::from_int(l % r))
+                SPECIALISED_OP(BIN_ADD_FLOAT_FLOAT, BIN_ADD, float, true, GcPtr<Object>::from_float(l + r))
+                SPECIALISED_OP(BIN_SUB_FLOAT_FLOAT, BIN_SUB, float, true, GcPtr<Object>::from_float(l - r))
+                SPECIALISED_OP(BIN_MUL_FLOAT_FLOAT, BIN_MUL, float, true, GcPtr<Object>::from_float(l * r))
+                SPECIALISED_OP(BIN_DIV_FLOAT_FLOAT, BIN_DIV, float, r != 0, GcPtr<Object>::from_float(l / r))
+                SPECIALISED_OP(LT_INT_INT, LT, int, true, AS_BOOL(l < r))
+                SPECIALISED_OP(LE_INT_INT, LE, int, true, AS_BOOL(l <= r))
+                SPECIALISED_OP(GT_INT_INT, GT, int, true, AS_BOOL(l > r))
+                SPECIALISED_OP(GE_INT_INT, GE, int, true, AS_BOOL(l >= r))
+                SPECIALISED_OP(EQ_INT_INT, EQ, int, true, AS_BOOL(l == r))
+                SPECIALISED_OP(NE_INT_INT, NE, int, true, AS_BOOL(l != r))
+                SPECIALISED_OP(LT_FLOAT_FLOAT, LT, float, true, AS_BOOL(l < r))
+                SPECIALISED_OP(LE_FLOAT_FLOAT, LE, float, true, AS_BOOL(l <= r))
+                SPECIALISED_OP(GT_FLOAT_FLOAT, GT, float, true, AS_BOOL(l > r))
+                SPECIALISED_OP(GE_FLOAT_FLOAT, GE, float, true, AS_BOOL(l >= r))
+                SPECIALISED_OP(EQ_FLOAT_FLOAT, EQ, float, true, AS_BOOL(l == r))
+                SPECIALISED_OP(NE_FLOAT_FLOAT, NE, float, true, AS_BOOL(l != r))
+
+#undef SPECIALISED_OP
+
+                TARGET(MAKE_ASYNC):
+                TARGET(AWAIT):
                     runtime_error("asyncio not implemented");
-                    break;
+                    DISPATCH();
             }
 
         }
 
     }
 
-
+#undef TARGET
+#undef DISPATCH
+#undef JIT_HOOK
+#undef TRACE_HOOK
+#undef NEXT_OPCODE
 
 } // namespace bond
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <array>
+#include <deque>
 #include <expected>
 #include <fmt/core.h>
 #include <type_traits>
@@ -14,6 +15,8 @@
 #include "builtins.h"
 #include "compiler/codegen.h"
 #include "compiler/context.h"
+#include "compiler/regcodegen.h"
+#include "jit/jit.h"
 #include "object.h"
 #include "runtime.h"
 
@@ -22,6 +25,34 @@
 namespace bond {
 #define TO_BOOL(X) Runtime::ins()->BOOL_STRUCT->create({(X)}).value()->as<Bool>()
 
+    /**
+     * @brief Truthiness of a value, matching the Bool constructor.
+     *
+     * Immediates and the Bool singletons are answered inline, anything else
+     * goes through the Bool constructor.
+     */
+    inline bool is_truthy(const GcPtr<Object> &obj) {
+        if (obj.is_immediate_int()) return obj.immediate_int() != 0;
+        if (obj.is_immediate_float()) return obj.immediate_float() != 0;
+
+        auto ptr = obj.get();
+        if (ptr == Runtime::ins()->C_TRUE.get()) return true;
+        if (ptr == Runtime::ins()->C_FALSE.get()) return false;
+
+        return TO_BOOL(obj)->get_value();
+    }
+
+#ifdef BOND_OPCODE_PROFILE
+    // the most executed pairs of consecutive opcodes, counted across every vm
+    t_string opcode_pair_report(size_t count);
+#endif
+
+#ifdef _MSC_VER
+#define BOND_ALWAYS_INLINE __forceinline
+#else
+#define BOND_ALWAYS_INLINE [[gnu::always_inline]] inline
+#endif
+
     class Frame {
     public:
         Frame() = default;
@@ -29,30 +60,51 @@ namespace bond {
         explicit Frame(const GcPtr<Code> &code) { m_code = code; }
 
         GcPtr<Object> get_constant() {
-            return m_code->get_constant(m_code->get_code(m_ip++));
+            return m_code->get_constant(get_oprand());
         }
 
-        Opcode get_opcode() { return static_cast<Opcode>(m_code->get_code(m_ip++)); }
+        GcPtr<Object> get_constant(uint32_t index) { return m_code->get_constant(index); }
 
-        uint32_t get_oprand() { return m_code->get_code(m_ip++); }
+        GlobalCache &get_global_cache(uint32_t index) { return m_code->get_global_cache(index); }
 
-        SharedSpan get_span() {
-            if (m_ip == 0) {
-                return m_code->get_span(0);
-            }
+        MethodCache &get_method_cache(uint32_t index) { return m_code->get_method_cache(index); }
 
-            if (m_ip >= m_code->get_code_size()) {
-                return m_code->get_span(m_code->get_code_size() - 1);
-            }
+        Opcode get_opcode() { return static_cast<Opcode>(m_instructions[m_ip++]); }
+
+        // same as read_oprand, forced inline since the dispatch loop is past the size where
+        // the compiler stops inlining calls into it
+        BOND_ALWAYS_INLINE uint32_t get_oprand() {
+            uint32_t value = m_instructions[m_ip++];
+            if (value < 0x80) [[likely]] return value;
+            return read_wide_oprand(m_instructions, m_ip, value);
+        }
+
+        BOND_ALWAYS_INLINE uint32_t get_jump_target() {
+            uint32_t target;
+            std::memcpy(&target, m_instructions + m_ip, JUMP_OPRAND_WIDTH);
+            m_ip += JUMP_OPRAND_WIDTH;
+            return target;
+        }
 
-            return m_code->get_span(m_ip - 1);
+        // verified code never leaves m_ip past its end, see Code::verify
+        SharedSpan get_span() {
+            auto index = m_ip == 0 ? 0 : m_ip - 1;
+            if (m_register_code) {
+                return m_register_code->get_span(index);
+            }
+            return m_code->get_span(index);
         }
 
         void set_code(const GcPtr<Code> &code) {
             m_code = code;
+            m_instructions = code->get_opcodes().data();
+            m_register_code = nullptr;
             m_ip = 0;
         }
 
+        // the frame runs register code, its ip is then one past the register instruction
+        void set_register_code(const RegisterCode *code) { m_register_code = code; }
+
         void set_function(const GcPtr<Function> &function) {
             m_function = function;
             set_code(function->get_code());
@@ -60,42 +112,63 @@ namespace bond {
 
         GcPtr<Function> get_function() { return m_function; }
 
+        const GcPtr<Code> &get_code() { return m_code; }
+
         void set_globals(const GcPtr<StringMap> &globals) { m_globals = globals; }
 
         void jump_absolute(size_t ip) { m_ip = ip; }
 
-        void set_locals(const GcPtr<StringMap> &locals) { m_locals = locals; }
+        // the instruction being executed has no oprands, so it starts just before m_ip
+        void quicken(Opcode opcode) { m_code->quicken(m_ip - 1, opcode); }
 
-        void set_global(const t_string &key, const GcPtr<Object> &value) {
-            m_globals->set(key, value);
+        // rewinds so the generic instruction runs in place of the failed specialised one
+        void deopt(Opcode generic) { m_code->deopt(--m_ip, generic); }
+
+        // locals live in the vm's locals array, base is where this frame's slots start
+        void set_locals(GcPtr<Object> *locals, size_t base) {
+            m_locals = locals;
+            m_locals_base = base;
         }
 
-        bool has_global(const t_string &key) { return m_globals->has(key); }
+        size_t get_locals_base() const { return m_locals_base; }
 
-        GcPtr<Object> get_global(const t_string &key) {
-            return m_globals->get_unchecked(key);
-        }
+        GcPtr<Object> *get_locals() { return m_locals; }
 
-        void set_local(const t_string &key, const GcPtr<Object> &value) {
-            m_locals->set(key, value);
+        // where the caller's operand stack stood when the frame was entered, the result of
+        // the call is left at return_base once the frame returns
+        void set_caller_stack(size_t segment, int top) {
+            m_caller_segment = segment;
+            m_caller_top = top;
+            m_return_base = top + 1;
         }
 
-        bool has_local(const t_string &key) { return m_locals->has(key); }
+        // a CALL leaves the callee and its arguments below the result until the frame returns
+        void set_return_base(int base) { m_return_base = base; }
 
-        GcPtr<Object> get_local(const t_string &key) {
-            return m_locals->get_unchecked(key);
+        size_t get_caller_segment() const { return m_caller_segment; }
+
+        int get_caller_top() const { return m_caller_top; }
+
+        int get_return_base() const { return m_return_base; }
+
+        void set_global(const t_string &key, const GcPtr<Object> &value) {
+            m_globals->set(key, value);
         }
 
-        GcPtr<StringMap> get_locals() { return m_locals; }
+        void set_local(uint32_t slot, const GcPtr<Object> &value) { m_locals[slot] = value; }
 
-        GcPtr<StringMap> get_globals() { return m_globals; }
+        const GcPtr<Object> &get_local(uint32_t slot) { return m_locals[slot]; }
+
+        const GcPtr<StringMap> &get_globals() { return m_globals; }
 
         size_t get_ip() { return m_ip; }
 
+        uint32_t get_max_stack() { return m_code->get_max_stack(); }
+
         bool is_at_end() { return m_ip >= m_code->get_code_size(); }
 
         void clear() {
-            m_locals.reset();
+            m_locals = nullptr;
             m_globals.reset();
 //            m_function.reset();
 //            m_code.reset();
@@ -105,9 +178,16 @@ namespace bond {
     private:
         GcPtr<Function> m_function;
         GcPtr<Code> m_code;
+        // instructions of m_code, kept here so fetching does not go through the code object
+        const uint8_t *m_instructions = nullptr;
+        const RegisterCode *m_register_code = nullptr;
         size_t m_ip = 0;
-        GcPtr<StringMap> m_locals;
+        GcPtr<Object> *m_locals = nullptr;
+        size_t m_locals_base = 0;
         GcPtr<StringMap> m_globals;
+        size_t m_caller_segment = 0;
+        int m_caller_top = -1;
+        int m_return_base = 0;
     };
 
 
@@ -118,7 +198,17 @@ namespace bond {
         AsyncFrame(Frame frame, const GcPtr<Future> &future) : frame(std::move(frame)), future(future) {}
     };
 
-#define FRAME_MAX 512
+#define MAX_DEPTH_DEFAULT 100000
+#define LOCALS_INITIAL 256
+#define STACK_SEGMENT_SIZE 1024
+// slots kept free above a frame's operands for results pushed before a call window is dropped
+// and for the message a runtime error pushes
+#define STACK_SLACK 4
+// longest loop trace that is recorded, and how often a loop is recorded before it is given up
+#define TRACE_MAX_LENGTH 512
+#define TRACE_MAX_ATTEMPTS 3
+// register frames nest on the native stack, calls deeper than this run on the stack vm
+#define REGISTER_MAX_DEPTH 256
 
     using VectorArgs = std::vector<std::shared_ptr<Param>>;
 
@@ -135,6 +225,8 @@ namespace bond {
             assert(m_globals.get() != nullptr);
             add_builtins_to_globals(m_globals);
             m_runtime = Runtime::ins();
+            init_stack();
+            init_jit();
         }
 
         Vm(Context *ctx, const GcPtr<StringMap> &globals) {
@@ -145,6 +237,8 @@ namespace bond {
             m_globals = globals;
             add_builtins_to_globals(m_globals);
             m_runtime = Runtime::ins();
+            init_stack();
+            init_jit();
         }
 
         void run(const GcPtr<Code> &code);
@@ -157,13 +251,37 @@ namespace bond {
 
         void set_globals(const GcPtr<StringMap> &globals) { m_globals = globals; }
 
-        void call_function(const GcPtr<Function> &function, const t_vector &args,
-                           const GcPtr<StringMap> &locals = nullptr);
+        // how many frames may be active before a call fails with a stack overflow
+        void set_max_depth(size_t depth) { m_max_depth = depth; }
+
+        [[nodiscard]] size_t get_max_depth() const { return m_max_depth; }
+
+        // runs function to its end on the register backend and pushes its result, when the
+        // context asked for it and the function has register code. false when the function
+        // has to go through call_function instead, see regvm.cpp
+        bool call_registers(const GcPtr<Function> &function, t_args args, const GcPtr<Object> *self = nullptr);
+
+        // sets up a frame for function, self is placed before the arguments for bound calls
+        void call_function(const GcPtr<Function> &function, t_args args,
+                           const t_vector *up_values = nullptr, const GcPtr<Object> *self = nullptr);
 
         GcPtr<Object> call_function_ex(const GcPtr<Function> &function, const t_vector &args);
 
+        // STEP runs a single instruction of the current frame, for the jit
+        template<bool STEP = false>
         void exec(uint32_t stop_frame = 0);
 
+        // runs the instruction at ip for native code and writes back what it changed, returns
+        // where the frame carries on or JIT_EXIT, see jit/jit.h
+        uint32_t jit_step(JitState *state, uint32_t ip);
+
+        // runs the native code of modules compiled ahead of time from now on, for this vm and
+        // vms created after it, see core/aot.h
+        void enable_aot() {
+            m_aot = true;
+            m_ctx->set_aot(true);
+        }
+
         void runtime_error(const t_string &error, RuntimeError e,
                            const SharedSpan &span);
 
@@ -178,9 +296,7 @@ namespace bond {
         call_slot(Slot slot, const GcPtr<Object> &instance, const t_vector &args);
 
         inline GcPtr<Object> pop() {
-            auto obj = stack[m_stack_pointer].get();
-            stack[m_stack_pointer--].reset();
-            return obj;
+            return std::move(stack[m_stack_pointer--]);
         }
 
         inline void push(GcPtr<Object> const &obj) { stack[++m_stack_pointer] = obj; }
@@ -192,7 +308,7 @@ namespace bond {
         }
 
         //        t_vector m_stack;
-        bool call_object_ex(const GcPtr<Object> &obj, t_vector &args);
+        bool call_object_ex(const GcPtr<Object> &obj, t_args args);
 
         void runtime_error(const t_string &error);
 
@@ -201,8 +317,15 @@ namespace bond {
 
     private:
         Runtime *m_runtime = nullptr;
-        GcPtr<Object> stack[1024];
+
+        // the operand stack is a list of segments that never move, a frame reserves its
+        // slots in one segment when it is entered so pushes need no bounds checks and
+        // arguments handed to natives as spans stay valid while the stack grows
+        std::vector<t_vector, gc_allocator<t_vector>> m_stack_segments;
+        size_t m_stack_segment = 0;
+        GcPtr<Object> *stack = nullptr;
         int m_stack_pointer = -1;
+        int m_stack_limit = 0;
 
         GcPtr<Bool> m_True;
         GcPtr<Bool> m_False;
@@ -212,50 +335,158 @@ namespace bond {
         bool m_has_error = false;
 
         size_t m_frame_pointer = 0;
-        std::array<Frame, FRAME_MAX> m_frames;
+        size_t m_max_depth = MAX_DEPTH_DEFAULT;
+        // a deque so frames keep their address as more are added
+        std::deque<Frame, gc_allocator<Frame>> m_frames;
         Frame *m_current_frame = nullptr;
-        t_vector m_args;
+
+        // local slots of every active frame, frames index into it by their base
+        t_vector m_locals = t_vector(LOCALS_INITIAL);
+        size_t m_locals_top = 0;
 
         void init_bin_funcs();
 
 
         GcPtr<StringMap> m_globals;
 
-        void create_instance(const GcPtr<Struct> &_struct, const t_vector &args);
+        void create_instance(const GcPtr<Struct> &_struct, t_args args);
 
 
-        void call_bound_method(const GcPtr<BoundMethod> &bound_method,
-                               t_vector &args);
+        void call_bound_method(const GcPtr<BoundMethod> &bound_method, t_args args);
 
 
         void bin_op(Slot slot, const t_string &op_name);
 
         void setup_bound_call(const GcPtr<Object> &instance,
-                              const GcPtr<Function> &function, t_vector &args);
+                              const GcPtr<Function> &function, t_args args);
 
         void compare_op(Slot slot, const t_string &op_name);
 
-        void call_native_function(const GcPtr<Object> &func, t_vector &args);
+        // runs the generic form of a comparison opcode on the two values on top of the stack
+        void compare_slot(Opcode compare);
+
+        // pushes the attribute of obj named by the string attr
+        void get_attribute(const GcPtr<Object> &obj, const GcPtr<Object> &attr);
+
+        // sets the attribute of obj named by the string attr and pushes what the set returned
+        void set_attribute(const GcPtr<Object> &obj, const GcPtr<Object> &attr, const GcPtr<Object> &value);
+
+        // push the item of obj at index, and what setting it returned
+        void get_item(const GcPtr<Object> &obj, const GcPtr<Object> &index);
+
+        void set_item(const GcPtr<Object> &obj, const GcPtr<Object> &index, const GcPtr<Object> &value);
+
+        // pushes an iterator over expr, checked for the slots FOR_ITER calls
+        void get_iterator(const GcPtr<Object> &expr);
+
+        // advances an iterator through its __has_next__ and __next__ slots, Next with the item
+        // left in next or Done. m_stop is set when a slot failed
+        NativeInstance::IterStep iterate_slots(const GcPtr<Object> &iterator, GcPtr<Object> &next);
+
+        // runs the generic form of a binary opcode on left and right and returns the result,
+        // null when it failed. for the register backend, which has no stack instruction to run
+        GcPtr<Object> binary_slot(Opcode opcode, const GcPtr<Object> &left, const GcPtr<Object> &right);
 
-        void call_script_function(const GcPtr<Object> &func, t_vector &args);
+        // a bound call from a CALL_METHOD site, on the register backend when the method can run there
+        void call_bound_function(const GcPtr<Object> &instance, const GcPtr<Function> &function, t_args args);
 
-        void call_struct(const GcPtr<Object> &func, t_vector &args);
+        void specialize(Opcode int_form, Opcode float_form);
 
-        void call_bound_method(const GcPtr<Object> &func, t_vector &args);
+        // calls the method recorded for obj's type at a CALL_METHOD site, false on a cache miss
+        bool call_cached_method(const MethodCache &cache, const GcPtr<Object> &obj, const GcPtr<Object> &name,
+                                t_args args);
 
-        void call_native_struct(const GcPtr<Object> &func, t_vector &args);
+        // resolves and calls a method at a CALL_METHOD site, filling the site's cache
+        void call_method(MethodCache &cache, const GcPtr<Object> &obj, const GcPtr<Object> &method_name,
+                         t_args args);
 
-        void call_closure(const GcPtr<Object> &func, t_vector &args);
+        // records the method resolved for obj's type, at most MethodCache::SIZE types per site
+        void cache_method(MethodCache &cache, const GcPtr<Object> &obj, const NativeMethodPtr *native,
+                          const GcPtr<Function> &function);
+
+        void call_native_function(const GcPtr<Object> &func, t_args args);
+
+        void call_script_function(const GcPtr<Object> &func, t_args args);
+
+        void call_struct(const GcPtr<Object> &func, t_args args);
+
+        void call_bound_method(const GcPtr<Object> &func, t_args args);
+
+        void call_native_struct(const GcPtr<Object> &func, t_args args);
+
+        void call_closure(const GcPtr<Object> &func, t_args args);
 
         void update_frame_pointer();
 
-        void check_argument_count(const t_vector &args, const VectorArgs &params);
+        void check_argument_count(size_t count, const VectorArgs &params);
+
+        void set_local_arguments(Frame *frame, const GcPtr<Code> &code, t_args args,
+                                 const t_vector *up_values, const GcPtr<Object> *self);
+
+        void reserve_locals(size_t count);
+
+        // the cell in a slot of the current frame, reports an error when there is none
+        Cell *get_cell(uint32_t slot);
+
+        void init_stack();
+
+        // null unless the context asked for the jit and it can run here
+        Jit *m_jit = nullptr;
+        // set when the context asked for loop traces and the jit can run here
+        bool m_trace = false;
+        // set when a module compiled ahead of time was loaded, code objects may carry native code
+        bool m_aot = false;
+        uint32_t m_jit_threshold = 0;
+        // set when the context asked for the register backend
+        bool m_registers = false;
+        // register frames running on the native stack
+        size_t m_register_depth = 0;
+
+        void init_jit();
+
+        // runs the register code of the frame call_registers set up, returns its result or null
+        // once the vm stopped
+        GcPtr<Object> exec_registers(Frame *frame, const RegisterCode &code);
+
+        // runs the current frame as native code for as long as it is compiled or was compiled
+        // ahead of time, after a call, a return or a backward jump
+        void run_jit();
+
+        // after a backward jump, runs the trace of the loop whose header the frame is at,
+        // recording one once the loop is hot
+        void run_trace();
+
+        // runs one pass round the loop at header with exec<true>, noting each instruction. empty
+        // when the pass left the frame, failed or did not come back round to header
+        std::vector<TraceStep> record_trace(uint32_t header);
+
+        void use_stack_segment(size_t segment);
+
+        // records the caller's stack in frame and makes room for count slots above it
+        void reserve_stack(Frame *frame, size_t count);
+
+        // drops what frame left on the stack, back to where its caller's stack stood
+        void drop_frame_stack(Frame *frame);
+
+        // drops what frame left on the stack and its call window, then pushes result for the caller
+        void return_stack(Frame *frame, GcPtr<Object> result);
+
+        // verifies the function's code before a frame is made for it, a runtime error when it
+        // does not verify
+        bool verify_code(const GcPtr<Function> &function);
+
+        // runs function in the current frame in place of the code returning its result
+        void tail_call_function(const GcPtr<Function> &function, t_args args, const t_vector *up_values);
+
+        void call_object(const GcPtr<Object> &func, t_args args);
 
-        static void set_local_arguments(Frame *frame, const t_vector &args,
-                                        const VectorArgs &params,
-                                        const GcPtr<StringMap> &locals);
+        // removes a callee and its arguments that sit at base on the operand stack, keeping
+        // a result the call may have pushed above them
+        void drop_call(int base, int top);
 
-        void call_object(const GcPtr<Object> &func, t_vector &args);
+        // after a CALL or CALL_METHOD, leaves the window to a callee frame that is still running
+        // or drops it now
+        void finish_call(size_t depth, int base, int top);
 
         void bin_alt(const NativeMethodPtr &meth, const char *op_name);
 
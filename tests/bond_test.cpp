@@ -2,16 +2,185 @@
 // Created by Travor Oguna Oneya on 28/03/2023.
 //
 #include "test.h"
+#include "../src/compiler/bfmt.h"
+#include "../src/import.h"
+#include "../src/compiler/optimizer.h"
 
 
+// a native type without a TypeId of its own, like the ones extension modules define
+struct UntaggedInstance : public bond::NativeInstance {};
 
-int main() {
+// a builtin only shares the base TypeId with such a type, parse_args has to reject it
+void test_parse_args_native_types() {
+    auto list = bond::Runtime::ins()->make_list({});
+    bond::t_vector args = {list};
+
+    UntaggedInstance *value;
+    ASSERT(!bond::parse_args(args, value).has_value())
+    ASSERT(!list->is<UntaggedInstance>())
+    ASSERT(list->is<bond::NativeInstance>())
+}
+
+static bond::GcPtr<bond::Code> make_test_code(uint32_t locals = 0, bond::t_vector constants = {}) {
+    auto code = bond::Runtime::ins()->CODE_STRUCT->create_instance<bond::Code>(
+            std::vector<uint8_t>{}, std::vector<uint8_t>{}, std::move(constants));
+    code->set_locals(bond::t_string_vector(locals, "local"));
+    return code;
+}
+
+// writes an archive holding code as its main module and imports it
+static std::expected<bond::GcPtr<bond::Code>, t_string>
+import_test_archive(bond::Context *ctx, const bond::GcPtr<bond::Code> &code) {
+    auto path = (std::filesystem::temp_directory_path() / "bond_verify_test.bar").string();
+    {
+        std::ofstream stream(path, std::ios::binary);
+        bond::write_val<std::ofstream, uint32_t>(stream, BOND_MAGIC_NUMBER);
+        bond::write_val<std::ofstream, uint32_t>(stream, BOND_BAR_VERSION);
+        bond::write_val<std::ofstream, uint32_t>(stream, 1);
+        bond::write_val<std::ofstream, uint32_t>(stream, 0);
+        bond::write_code_impl(stream, code);
+    }
+    auto imported = bond::Import::instance().import_archive(ctx, path.c_str());
+    std::filesystem::remove(path);
+    return imported;
+}
+
+// archives that would make the vm read or jump outside the code, or the stack, are refused
+// when they are loaded
+void test_verify_archives(bond::Context *ctx) {
+    auto span = std::make_shared<bond::Span>(0, 0, 0, 0);
+    auto rejected = [ctx](const bond::GcPtr<bond::Code> &code) { return !import_test_archive(ctx, code); };
+
+    auto valid = make_test_code();
+    valid->add_ins(bond::Opcode::PUSH_NIL, span);
+    valid->add_ins(bond::Opcode::RETURN, span);
+    ASSERT(import_test_archive(ctx, valid).has_value())
+
+    ASSERT(rejected(make_test_code()))
+
+    auto underflow = make_test_code();
+    underflow->add_ins(bond::Opcode::PUSH_NIL, span);
+    underflow->add_ins(bond::Opcode::BIN_ADD, span);
+    underflow->add_ins(bond::Opcode::RETURN, span);
+    ASSERT(rejected(underflow))
+
+    auto constant = make_test_code(0, {bond::make_int(1)});
+    constant->add_ins(bond::Opcode::LOAD_CONST, 1, span);
+    constant->add_ins(bond::Opcode::RETURN, span);
+    ASSERT(rejected(constant))
+
+    auto local = make_test_code(1);
+    local->add_ins(bond::Opcode::LOAD_FAST, 1, span);
+    local->add_ins(bond::Opcode::RETURN, span);
+    ASSERT(rejected(local))
+
+    auto truncated = make_test_code();
+    truncated->add_ins(bond::Opcode::PUSH_NIL, span);
+    truncated->add_jump(bond::Opcode::JUMP, span);
+    truncated->get_instructions().resize(truncated->get_code_size() - 2);
+    ASSERT(rejected(truncated))
+
+    auto mid_instruction = make_test_code(0, {bond::make_int(1)});
+    mid_instruction->add_ins(bond::Opcode::LOAD_CONST, 0, span);
+    mid_instruction->patch_code(mid_instruction->add_jump(bond::Opcode::JUMP_IF_FALSE, span), 1);
+    mid_instruction->add_ins(bond::Opcode::PUSH_NIL, span);
+    mid_instruction->add_ins(bond::Opcode::RETURN, span);
+    ASSERT(rejected(mid_instruction))
+
+    auto unbalanced = make_test_code();
+    unbalanced->add_ins(bond::Opcode::PUSH_NIL, span);
+    unbalanced->patch_code(unbalanced->add_jump(bond::Opcode::JUMP, span), 0);
+    ASSERT(rejected(unbalanced))
+
+    auto off_the_end = make_test_code();
+    off_the_end->add_ins(bond::Opcode::PUSH_NIL, span);
+    off_the_end->add_ins(bond::Opcode::POP_TOP, span);
+    ASSERT(rejected(off_the_end))
+
+    // code that reaches the vm without being loaded from an archive is checked on its first call
+    auto vm = bond::Vm(ctx);
+    vm.run(underflow);
+    ASSERT(vm.had_error())
+}
+
+// compiles source as a module of its own at an optimization level and disassembles it
+static t_string disassemble_source(bond::Context *ctx, std::string source, uint32_t optimize_level) {
+    auto level = ctx->get_optimize_level();
+    ctx->set_optimize_level(optimize_level);
+
+    auto lexer = bond::Lexer(std::move(source), ctx, ctx->new_module("compile_test"));
+    auto tokens = lexer.tokenize();
+    auto parser = bond::Parser(tokens, ctx);
+    auto nodes = parser.parse();
+    auto codegen = bond::CodeGenerator(ctx, parser.get_scopes());
+    auto code = codegen.generate_code(nodes);
+
+    ctx->set_optimize_level(level);
+    return code->disassemble();
+}
+
+// a literal expression reaches the vm as the one constant it computes
+void test_constant_folding(bond::Context *ctx) {
+    auto code = disassemble_source(ctx, "var day = 60 * 60 * 24;", bond::OPTIMIZE_PEEPHOLE);
+
+    size_t loads = 0;
+    for (auto at = code.find("LOAD_CONST"); at != t_string::npos; at = code.find("LOAD_CONST", at + 1)) loads++;
+
+    ASSERT(loads == 1)
+    ASSERT(code.find("86400") != t_string::npos)
+    ASSERT(code.find("BIN_MUL") == t_string::npos)
+}
+
+// a call in return position is inlined like any other call, from -O2 on
+void test_return_inlining(bond::Context *ctx) {
+    auto source = "fn square(a) { return a * a; } fn area(a) { return square(a); }";
+
+    ASSERT(disassemble_source(ctx, source, bond::OPTIMIZE_SSA).find("TAIL_CALL") == t_string::npos)
+    ASSERT(disassemble_source(ctx, source, bond::OPTIMIZE_PEEPHOLE).find("TAIL_CALL") != t_string::npos)
+}
+
+// every function is compiled once, however deep the closures capturing its locals are nested
+void test_nested_captures(bond::Context *ctx) {
+    constexpr int depth = 24;
+
+    std::string sum = "a0";
+    for (int i = 1; i < depth; i++) sum += fmt::format(" + a{}", i);
+
+    auto body = fmt::format("return {};", sum);
+    for (int i = depth - 1; i > 0; i--) {
+        body = fmt::format("fn f{0}(a{0}) {{ {1} }} return f{0}(1);", i, body);
+    }
+
+    auto code = disassemble_source(ctx, fmt::format("fn f0(a0) {{ {} }}", body), bond::OPTIMIZE_NONE);
+    ASSERT(code.find("LOAD_CELL") != t_string::npos)
+}
+
+// the optional arguments are the optimization level to run the tests at and "jit", which
+// compiles every function on its first call, "trace", which traces every loop on its
+// first pass, or "registers", which runs functions on the register backend
+int main(int argc, char **argv) {
     auto e = bond::create_engine("bond");
+    if (argc > 1) e->get_context()->set_optimize_level((uint32_t) std::stoi(argv[1]));
+    if (argc > 2 and std::string(argv[2]) == "jit") {
+        e->get_context()->set_jit(true);
+        e->get_context()->set_jit_threshold(0);
+    } else if (argc > 2 and std::string(argv[2]) == "trace") {
+        e->get_context()->set_trace(true);
+        e->get_context()->set_jit_threshold(0);
+    } else if (argc > 2 and std::string(argv[2]) == "registers") {
+        e->get_context()->set_register_vm(true);
+    }
     std::filesystem::current_path("../../tests/bond");
 
     auto vm = bond::Vm(e->get_context());
     bond::set_current_vm(&vm);
 
+    test_parse_args_native_types();
+    test_verify_archives(e->get_context());
+    test_constant_folding(e->get_context());
+    test_return_inlining(e->get_context());
+    test_nested_captures(e->get_context());
+
     e->run_file("main.bd");
     fmt::print("working directory {}\n", std::filesystem::current_path().string());
     ASSERT(e->get_context()->has_error() == false && "tests failed")